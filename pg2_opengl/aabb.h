@@ -0,0 +1,76 @@
+#ifndef AABB_H_
+#define AABB_H_
+
+#include "ray.h"
+#include "mymath.h"
+
+/*! \struct Aabb
+\brief Axis aligned bounding box.
+*/
+struct Aabb
+{
+	Vector3 lower{ FLT_MAX, FLT_MAX, FLT_MAX }; /*!< Minimal corner, an empty box has lower > upper. */
+	Vector3 upper{ -FLT_MAX, -FLT_MAX, -FLT_MAX }; /*!< Maximal corner. */
+
+	void Grow( const Vector3 & p )
+	{
+		lower = Vector3( min( lower.x, p.x ), min( lower.y, p.y ), min( lower.z, p.z ) );
+		upper = Vector3( max( upper.x, p.x ), max( upper.y, p.y ), max( upper.z, p.z ) );
+	}
+
+	void Grow( const Aabb & box )
+	{
+		lower = Vector3( min( lower.x, box.lower.x ), min( lower.y, box.lower.y ), min( lower.z, box.lower.z ) );
+		upper = Vector3( max( upper.x, box.upper.x ), max( upper.y, box.upper.y ), max( upper.z, box.upper.z ) );
+	}
+
+	/* intersection with the other box */
+	void Clip( const Aabb & box )
+	{
+		lower = Vector3( max( lower.x, box.lower.x ), max( lower.y, box.lower.y ), max( lower.z, box.lower.z ) );
+		upper = Vector3( min( upper.x, box.upper.x ), min( upper.y, box.upper.y ), min( upper.z, box.upper.z ) );
+	}
+
+	bool is_empty() const
+	{
+		return lower.x > upper.x || lower.y > upper.y || lower.z > upper.z;
+	}
+
+	Vector3 centroid() const
+	{
+		return ( lower + upper ) * 0.5f;
+	}
+
+	Vector3 extent() const
+	{
+		return upper - lower;
+	}
+
+	/* half of the surface area, the constant factor cancels out in SAH */
+	float half_area() const
+	{
+		if ( is_empty() ) return 0.0f;
+
+		const Vector3 e = extent();
+
+		return e.x * e.y + e.y * e.z + e.z * e.x;
+	}
+
+	/* slab test, returns the entry distance or FLT_MAX if the box is missed within <t_min, t_max> */
+	float Intersect( const Vector3 & origin, const Vector3 & inv_direction, const float t_min, const float t_max ) const
+	{
+		const float tx0 = ( lower.x - origin.x ) * inv_direction.x;
+		const float tx1 = ( upper.x - origin.x ) * inv_direction.x;
+		const float ty0 = ( lower.y - origin.y ) * inv_direction.y;
+		const float ty1 = ( upper.y - origin.y ) * inv_direction.y;
+		const float tz0 = ( lower.z - origin.z ) * inv_direction.z;
+		const float tz1 = ( upper.z - origin.z ) * inv_direction.z;
+
+		const float t_entry = max( max( min( tx0, tx1 ), min( ty0, ty1 ) ), max( min( tz0, tz1 ), t_min ) );
+		const float t_exit = min( min( max( tx0, tx1 ), max( ty0, ty1 ) ), min( max( tz0, tz1 ), t_max ) );
+
+		return ( t_entry <= t_exit ) ? t_entry : FLT_MAX;
+	}
+};
+
+#endif
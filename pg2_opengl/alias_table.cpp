@@ -0,0 +1,75 @@
+#include "pch.h"
+#include "alias_table.h"
+
+AliasTable::AliasTable( const std::vector<float> & weights )
+{
+	Build( weights );
+}
+
+void AliasTable::Build( const std::vector<float> & weights )
+{
+	const int n = static_cast<int>( weights.size() );
+
+	items_.resize( n );
+	total_weight_ = 0.0;
+
+	for ( const float weight : weights )
+	{
+		assert( weight >= 0.0f );
+		total_weight_ += weight;
+	}
+
+	if ( n == 0 || total_weight_ <= 0.0 )
+	{
+		// degenerate input, fall back to the uniform distribution
+		for ( int i = 0; i < n; ++i ) items_[i] = Item{ 1.0f, i, 1.0f / n };
+		return;
+	}
+
+	// Vose's variant, columns are split into the under- and overfull ones
+	std::vector<double> scaled( n );
+	std::vector<int> small, large;
+
+	for ( int i = 0; i < n; ++i )
+	{
+		items_[i].pmf = float( weights[i] / total_weight_ );
+		scaled[i] = weights[i] / total_weight_ * n;
+		( ( scaled[i] < 1.0 ) ? small : large ).push_back( i );
+	}
+
+	while ( !small.empty() && !large.empty() )
+	{
+		const int s = small.back();
+		small.pop_back();
+		const int l = large.back();
+
+		items_[s].threshold = float( scaled[s] );
+		items_[s].alias = l;
+
+		scaled[l] -= 1.0 - scaled[s];
+
+		if ( scaled[l] < 1.0 )
+		{
+			large.pop_back();
+			small.push_back( l );
+		}
+	}
+
+	// leftovers are full columns up to rounding errors
+	for ( const int i : large ) items_[i] = Item{ 1.0f, i, items_[i].pmf };
+	for ( const int i : small ) items_[i] = Item{ 1.0f, i, items_[i].pmf };
+}
+
+int AliasTable::Sample( const float ksi, float & pmf ) const
+{
+	assert( !items_.empty() );
+
+	const int n = static_cast<int>( items_.size() );
+	const float x = ksi * n;
+	const int column = ( int( x ) < n ) ? int( x ) : n - 1;
+	const int i = ( x - column < items_[column].threshold ) ? column : items_[column].alias;
+
+	pmf = items_[i].pmf;
+
+	return i;
+}
@@ -0,0 +1,55 @@
+#ifndef ALIAS_TABLE_H_
+#define ALIAS_TABLE_H_
+
+/*! \class AliasTable
+\brief Discrete distribution sampled in O(1) by Walker's alias method.
+
+\code{.cpp}
+AliasTable table( powers );
+float pmf = 0.0f;
+const int i = table.Sample( Random(), pmf );
+\endcode
+*/
+class AliasTable
+{
+public:
+	AliasTable() { }
+
+	/* weights must be non-negative with a positive sum */
+	AliasTable( const std::vector<float> & weights );
+
+	void Build( const std::vector<float> & weights );
+
+	/* returns the index of the sampled item and its probability, ksi is in <0, 1) */
+	int Sample( const float ksi, float & pmf ) const;
+
+	/* probability of the i-th item */
+	float pmf( const int i ) const
+	{
+		return items_[i].pmf;
+	}
+
+	int size() const
+	{
+		return static_cast<int>( items_.size() );
+	}
+
+	/* sum of the weights the table was built from */
+	double total_weight() const
+	{
+		return total_weight_;
+	}
+
+private:
+	struct Item
+	{
+		float threshold; // probability of keeping the item in its own column
+		int alias; // item stored in the rest of the column
+		float pmf;
+	};
+
+	std::vector<Item> items_;
+	double total_weight_{ 0.0 };
+};
+
+#endif
@@ -0,0 +1,2972 @@
+#include "pch.h"
+#include "benchmarks.h"
+#include "utils.h"
+#include "rng.h"
+#include "sampler.h"
+#include "mymath.h"
+#include "wavefront.h"
+#include "lights.h"
+#include "environment_light.h"
+#include "denoiser.h"
+#include "radiance_cache.h"
+#include "photon_map.h"
+#include "instancing.h"
+#include "triangle_block.h"
+#include "texture_cache.h"
+#include "compressed_texture.h"
+#include "srgb.h"
+#include "linear_texture.h"
+#include "texture_library.h"
+#include <numeric>
+
+/* wall-clock time of the given function (s) */
+static double Measure( const std::function<void()> & f )
+{
+	const auto t0 = std::chrono::high_resolution_clock::now();
+	f();
+	const auto t1 = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration<double>( t1 - t0 ).count();
+}
+
+static void PrintThroughput( const char * name, const int n, const double t, const double checksum )
+{
+	printf( "%-32s %8s %10.1f M/s (checksum %0.3f)\n", name, TimeToString( t ).c_str(), n / t * 1e-6, checksum );
+}
+
+int benchmark_random( const int n )
+{
+	printf( "Random number generators, %d samples\n", n );
+
+	double sum = 0.0;
+
+	// the former global generator
+	auto legacy_generator = std::bind( std::uniform_real_distribution<float>( 0.0f, 1.0f ), std::mt19937( 1 ) );
+	double t = Measure( [&]() { for ( int i = 0; i < n; ++i ) sum += legacy_generator(); } );
+	PrintThroughput( "mt19937 (global)", n, t, sum );
+
+	sum = 0.0;
+	t = Measure( [&]() { for ( int i = 0; i < n; ++i ) sum += Random(); } );
+	PrintThroughput( "Random (per-thread Pcg32)", n, t, sum );
+
+	sum = 0.0;
+	const RandomStream stream( 0, 0 );
+	t = Measure( [&]() { for ( int i = 0; i < n; ++i ) sum += stream.Get( i ); } );
+	PrintThroughput( "RandomStream::Get", n, t, sum );
+
+	std::vector<float> values( 1024 );
+	sum = 0.0;
+	t = Measure( [&]() {
+		for ( int i = 0; i < n; i += int( values.size() ) )
+		{
+			stream.Fill( values.data(), i, values.size() );
+			sum += values[i % values.size()];
+		}
+	} );
+	PrintThroughput( "RandomStream::Fill (batched)", n, t, sum );
+
+	// parallel throughput with one stream per (pixel, sample)
+	const int width = 1024;
+	const int height = n / width;
+	const int no_dimensions = 16;
+	auto render = [&]( const int no_threads ) {
+		std::vector<float> image( size_t( width ) * size_t( height ) );
+		omp_set_num_threads( no_threads );
+#pragma omp parallel for schedule( dynamic, 4 )
+		for ( int y = 0; y < height; ++y )
+		{
+			float ksi[no_dimensions];
+			for ( int x = 0; x < width; ++x )
+			{
+				RandomStream( y * width + x, 0 ).Fill( ksi, 0, no_dimensions );
+				float value = 0.0f;
+				for ( int d = 0; d < no_dimensions; ++d ) value += ksi[d];
+				image[size_t( x ) + size_t( y ) * width] = value;
+			}
+		}
+		return image;
+	};
+
+	const int no_threads = omp_get_max_threads();
+	std::vector<float> image_1, image_n;
+	t = Measure( [&]() { image_1 = render( 1 ); } );
+	PrintThroughput( "RandomStream, 1 thread", width * height * no_dimensions, t,
+		std::accumulate( image_1.begin(), image_1.end(), 0.0 ) );
+	t = Measure( [&]() { image_n = render( no_threads ); } );
+	PrintThroughput( "RandomStream, all threads", width * height * no_dimensions, t,
+		std::accumulate( image_n.begin(), image_n.end(), 0.0 ) );
+	omp_set_num_threads( no_threads );
+
+	const bool reproducible = memcmp( image_1.data(), image_n.data(), image_1.size() * sizeof( float ) ) == 0;
+	printf( "Results with 1 and %d threads are %s.\n\n", no_threads, ( reproducible ) ? "bit exact" : "DIFFERENT" );
+
+	return ( reproducible ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* reference scene: a disc lit by a square area light and partly shadowed by a round occluder,
+the pixel footprint and the light sample make it a 4D integral with discontinuities */
+static float ReferenceScene( const float x, const float y, const float light_u, const float light_v )
+{
+	const float disc = ( sqr( x - 0.5f ) + sqr( y - 0.5f ) < sqr( 0.35f ) ) ? 1.0f : 0.2f;
+	const float l_x = 0.3f + 0.4f * light_u;
+	const float l_y = 0.3f + 0.4f * light_v;
+	// the occluder halfway between the receiver and the light
+	const float visibility = ( sqr( 0.5f * ( x + l_x ) - 0.45f ) + sqr( 0.5f * ( y + l_y ) - 0.55f ) < sqr( 0.12f ) ) ? 0.0f : 1.0f;
+
+	return disc * visibility * ( 0.5f + 0.5f * x );
+}
+
+int benchmark_samplers( const int width, const int height, const int max_spp )
+{
+	printf( "Sampler convergence, %d x %d px reference scene\n", width, height );
+
+	auto render = [&]( const std::function<float( const unsigned int, const unsigned int, const unsigned int )> & sample,
+		const int spp ) {
+		std::vector<float> image( size_t( width ) * size_t( height ) );
+#pragma omp parallel for
+		for ( int y = 0; y < height; ++y )
+		{
+			for ( int x = 0; x < width; ++x )
+			{
+				const unsigned int pixel = y * width + x;
+				double sum = 0.0;
+				for ( int s = 0; s < spp; ++s )
+				{
+					sum += ReferenceScene( ( x + sample( pixel, s, 0 ) ) / width, ( y + sample( pixel, s, 1 ) ) / height,
+						sample( pixel, s, 2 ), sample( pixel, s, 3 ) );
+				}
+				image[pixel] = float( sum / spp );
+			}
+		}
+		return image;
+	};
+
+	// reference solution with an independent seed
+	const SobolSampler reference_sampler( 0xcafe );
+	const std::vector<float> reference = render( [&]( const unsigned int p, const unsigned int s, const unsigned int d ) {
+		return reference_sampler.Get( p, s, d ); }, 64 * max_spp );
+
+	const RandomSampler random_sampler;
+	const SobolSampler sobol_sampler;
+	const HaltonSampler halton_sampler;
+	const BlueNoiseSampler blue_noise_sampler( sobol_sampler, width );
+	const Sampler * samplers[] = { &random_sampler, &halton_sampler, &sobol_sampler, &blue_noise_sampler };
+
+	printf( "%-16s", "spp" );
+	for ( int spp = 1; spp <= max_spp; spp *= 2 ) printf( "%9d", spp );
+	printf( "\n%-16s", "Random()" );
+
+	// the former way, i.e. plain Random() drawn in sequence (not reproducible across threads)
+	for ( int spp = 1; spp <= max_spp; spp *= 2 )
+	{
+		const std::vector<float> image = render( []( const unsigned int, const unsigned int, const unsigned int ) {
+			return Random(); }, spp );
+		double mse = 0.0;
+		for ( size_t i = 0; i < image.size(); ++i ) mse += sqr( double( image[i] ) - reference[i] );
+		printf( "%9.5f", sqrt( mse / image.size() ) );
+	}
+
+	for ( const Sampler * sampler : samplers )
+	{
+		printf( "\n%-16s", sampler->name() );
+		for ( int spp = 1; spp <= max_spp; spp *= 2 )
+		{
+			const std::vector<float> image = render( [&]( const unsigned int p, const unsigned int s, const unsigned int d ) {
+				return sampler->Get( p, s, d ); }, spp );
+			double mse = 0.0;
+			for ( size_t i = 0; i < image.size(); ++i ) mse += sqr( double( image[i] ) - reference[i] );
+			printf( "%9.5f", sqrt( mse / image.size() ) );
+		}
+	}
+	printf( "\n\n" );
+
+	return EXIT_SUCCESS;
+}
+
+/* two triangles of the quad abcd */
+static void AddQuad( std::vector<Vertex> & vertices, const Vector3 & a, const Vector3 & b, const Vector3 & c,
+	const Vector3 & d )
+{
+	Vector3 normal = ( b - a ).CrossProduct( c - a );
+	normal.Normalize();
+	Coord2f tex_coords[4] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+	const Vector3 color( 0.5f, 0.5f, 0.5f );
+	const int order[6] = { 0, 1, 2, 0, 2, 3 };
+	const Vector3 corners[4] = { a, b, c, d };
+
+	for ( int i = 0; i < 6; ++i )
+	{
+		vertices.push_back( Vertex( corners[order[i]], normal, color, &tex_coords[order[i]] ) );
+	}
+}
+
+/* RMSE over the pixels with non-zero mask, the whole image if the mask is empty */
+static double Rmse( const Texture3f & image, const Texture3f & reference, const std::vector<char> & mask = {} )
+{
+	double mse = 0.0;
+	int n = 0;
+
+	for ( int y = 0; y < image.height(); ++y )
+	{
+		for ( int x = 0; x < image.width(); ++x )
+		{
+			if ( !mask.empty() && !mask[y * image.width() + x] ) continue;
+
+			for ( int i = 0; i < 3; ++i )
+			{
+				mse += sqr( double( image.pixel( x, y ).data[i] ) - reference.pixel( x, y ).data[i] );
+			}
+
+			++n;
+		}
+	}
+
+	return sqrt( mse / ( 3.0 * max( n, 1 ) ) );
+}
+
+int benchmark_lights( const int no_lights, const double seconds )
+{
+	printf( "Light selection, %d emitters, %0.1f s per strategy\n", no_lights, seconds );
+
+	// a large floor lit by many small emitters of very different power
+	std::string floor_name = "floor";
+	std::string light_name = "light";
+	std::vector<Material *> materials;
+	materials.push_back( new Material( floor_name, Color3f(), Color3f( { 0.7f, 0.7f, 0.7f } ), Color3f(), Color3f(),
+		0.0f, 1.0f, 1.0f, Shader::LAMBERT ) );
+
+	std::vector<Surface *> surfaces;
+	std::vector<Vertex> vertices;
+	AddQuad( vertices, Vector3( -20, -20, 0 ), Vector3( 20, -20, 0 ), Vector3( 20, 20, 0 ), Vector3( -20, 20, 0 ) );
+	surfaces.push_back( BuildSurface( floor_name, vertices ) );
+	surfaces.back()->set_material( materials.back() );
+
+	Pcg32 generator( 2020 );
+	const float size = 0.05f;
+
+	for ( int i = 0; i < no_lights; ++i )
+	{
+		const float power = expf( 8.0f * ( generator.NextFloat() - 0.5f ) ); // log-uniform over ~3.5 decades
+		materials.push_back( new Material( light_name, Color3f(), Color3f(), Color3f(),
+			Color3f( { power, power * 0.8f, power * 0.6f } ), 0.0f, 1.0f, 1.0f, Shader::LAMBERT ) );
+
+		const Vector3 center( 40.0f * generator.NextFloat() - 20.0f, 40.0f * generator.NextFloat() - 20.0f,
+			0.1f + 2.0f * generator.NextFloat() );
+		vertices.clear();
+		AddQuad( vertices, center + Vector3( -size, -size, 0 ), center + Vector3( -size, size, 0 ),
+			center + Vector3( size, size, 0 ), center + Vector3( size, -size, 0 ) );
+		surfaces.push_back( BuildSurface( light_name, vertices ) );
+		surfaces.back()->set_material( materials.back() );
+	}
+
+	{
+		const Scene scene( surfaces, materials );
+		const Camera camera( 128, 96, deg2rad( 60.0f ), Vector3( 0, -12, 9 ), Vector3( 0, 0, 0 ) );
+		const SobolSampler sampler;
+		const SobolSampler reference_sampler( 0xcafe );
+		Lights lights( scene );
+
+		WavefrontTracer tracer( scene, camera, sampler );
+		tracer.set_lights( &lights );
+		tracer.set_max_depth( 2 ); // direct illumination only
+
+		// reference with the best strategy and an independent seed
+		WavefrontTracer reference_tracer( scene, camera, reference_sampler );
+		reference_tracer.set_lights( &lights );
+		reference_tracer.set_max_depth( 2 );
+		const Texture3f reference = reference_tracer.Render( 1024 );
+
+		// the emitters are smaller than a pixel and their jittered primary hits would dominate the error of all
+		// strategies alike, hence only the pixels (and their neighbours) that see nothing but the floor are compared
+		const int width = camera.width();
+		const int height = camera.height();
+		std::vector<char> mask( size_t( width ) * size_t( height ), 1 );
+
+		for ( int y = 0; y < height; ++y )
+		{
+			for ( int x = 0; x < width; ++x )
+			{
+				bool floor_only = true;
+
+				for ( int i = 0; i < 64 && floor_only; ++i )
+				{
+					Ray ray = camera.GenerateRay( x + ( i % 8 + 0.5f ) / 8, y + ( i / 8 + 0.5f ) / 8 );
+					RayHit hit;
+					scene.Intersect( ray, hit );
+					floor_only = hit.surface_id <= 0;
+				}
+
+				if ( floor_only ) continue;
+
+				for ( int j = max( 0, y - 1 ); j <= min( height - 1, y + 1 ); ++j )
+				{
+					for ( int k = max( 0, x - 1 ); k <= min( width - 1, x + 1 ); ++k )
+					{
+						mask[j * width + k] = false;
+					}
+				}
+			}
+		}
+
+		const Lights::Strategy strategies[] = { Lights::Strategy::UNIFORM, Lights::Strategy::POWER, Lights::Strategy::TREE };
+		const char * names[] = { "uniform", "power (alias table)", "light tree" };
+		double rmse[3] = { 0.0 };
+		int spps[3] = { 0 };
+
+		for ( int i = 0; i < 3; ++i )
+		{
+			lights.set_strategy( strategies[i] );
+
+			// calibrate the number of samples per pixel that fits the time budget
+			const double t = Measure( [&]() { tracer.Render( 4 ); } ) / 4;
+			spps[i] = max( 1, int( seconds / t ) );
+			rmse[i] = Rmse( tracer.Render( spps[i] ), reference, mask );
+		}
+
+		printf( "\n%0.1f %% of pixels compared\n", 100.0 * std::accumulate( mask.begin(), mask.end(), 0 ) / mask.size() );
+		printf( "%-24s %8s %12s %12s\n", "strategy", "spp", "RMSE", "vs. uniform" );
+
+		for ( int i = 0; i < 3; ++i )
+		{
+			printf( "%-24s %8d %12.5f %11.2fx\n", names[i], spps[i], rmse[i], rmse[0] / rmse[i] );
+		}
+
+		printf( "\n" );
+	}
+
+	SafeDeleteVectorItems<Surface *>( surfaces );
+	SafeDeleteVectorItems<Material *>( materials );
+
+	return EXIT_SUCCESS;
+}
+
+int benchmark_environment( const int width, const int height, const int max_spp )
+{
+	printf( "Environment map sampling, %d x %d px sky with a 0.5 deg sun\n", width, height );
+
+	// procedural HDR sky, the sun is ~5 orders of magnitude brighter than the rest
+	Texture3f sky( width, height );
+	const Vector3 sun_direction = EnvironmentLight::UVToDirection( Coord2f{ 0.3f, 0.28f } );
+	const float sun_cos_radius = cosf( deg2rad( 0.5f ) );
+
+#pragma omp parallel for
+	for ( int y = 0; y < height; ++y )
+	{
+		for ( int x = 0; x < width; ++x )
+		{
+			const Vector3 direction = EnvironmentLight::UVToDirection( Coord2f{ ( x + 0.5f ) / width, ( y + 0.5f ) / height } );
+			Color3f radiance = ( direction.z > 0.0f ) ? Color3f( { 0.4f, 0.6f, 1.0f } ) * ( 0.5f + 0.5f * direction.z ) :
+				Color3f( { 0.1f, 0.1f, 0.1f } );
+			if ( direction.DotProduct( sun_direction ) > sun_cos_radius ) radiance = Color3f( { 5e4f, 4.5e4f, 4e4f } );
+			sky.data()[size_t( y ) * width + x] = radiance;
+		}
+	}
+
+	EnvironmentLight * environment = nullptr;
+	const double t_build = Measure( [&]() { environment = new EnvironmentLight( sky ); } );
+	printf( "Construction incl. copy of the map: %0.2f ms (%d threads)\n\n", t_build * 1e3, omp_get_max_threads() );
+
+	// shading normals and their reference irradiance (red channel) summed over all texels
+	const int no_normals = 256;
+	std::vector<Vector3> normals( no_normals );
+	std::vector<double> reference( no_normals, 0.0 );
+	Pcg32 generator( 2020 );
+
+	for ( int i = 0; i < no_normals; ++i )
+	{
+		float pdf = 0.0f;
+		normals[i] = sample_cosine_hemisphere( generator.NextFloat(), generator.NextFloat(), pdf );
+	}
+
+#pragma omp parallel for
+	for ( int i = 0; i < no_normals; ++i )
+	{
+		for ( int y = 0; y < height; ++y )
+		{
+			const double solid_angle = 2.0 * sqr( M_PI ) * sin( M_PI * ( y + 0.5 ) / height ) / ( double( width ) * height );
+
+			for ( int x = 0; x < width; ++x )
+			{
+				const Vector3 direction = EnvironmentLight::UVToDirection( Coord2f{ ( x + 0.5f ) / width, ( y + 0.5f ) / height } );
+				reference[i] += sky.pixel( x, y ).data[0] * max( 0.0f, direction.DotProduct( normals[i] ) ) * solid_angle;
+			}
+		}
+	}
+
+	// one estimator of E = integral L cos over the hemisphere, ksi are two 2D samples
+	enum Technique { COSINE = 0, ENVIRONMENT = 1, MIS = 2 };
+	const SobolSampler sampler;
+
+	auto estimate = [&]( const Technique technique, const Vector3 & normal, const int i, const int s ) {
+		const Matrix3x3 frame = basis( normal );
+		double value = 0.0;
+
+		if ( technique != ENVIRONMENT )
+		{
+			const Coord2f ksi = sampler.Get2D( i, s, 0 );
+			float pdf_bsdf = 0.0f;
+			const Vector3 direction = frame * sample_cosine_hemisphere( ksi.u, ksi.v, pdf_bsdf );
+			const float pdf_environment = ( technique == MIS ) ? environment->Pdf( direction ) : 0.0f;
+			const float weight = sqr( pdf_bsdf ) / ( sqr( pdf_bsdf ) + sqr( pdf_environment ) );
+			value += environment->Le( direction ).data[0] * float( M_PI ) * weight; // L cos / pdf = L pi
+		}
+
+		if ( technique != COSINE )
+		{
+			Color3f radiance;
+			float pdf_environment = 0.0f;
+			const Vector3 direction = environment->Sample( sampler.Get2D( i, s, 2 ), radiance, pdf_environment );
+			const float cos_theta = direction.DotProduct( normal );
+
+			if ( pdf_environment > 0.0f && cos_theta > 0.0f )
+			{
+				const float pdf_bsdf = ( technique == MIS ) ? cos_theta / float( M_PI ) : 0.0f;
+				const float weight = sqr( pdf_environment ) / ( sqr( pdf_environment ) + sqr( pdf_bsdf ) );
+				value += radiance.data[0] * cos_theta / pdf_environment * weight;
+			}
+		}
+
+		return value;
+	};
+
+	const char * names[] = { "cosine", "environment map", "MIS (power)" };
+
+	printf( "%-16s", "relative RMSE" );
+	for ( int spp = 1; spp <= max_spp; spp *= 4 ) printf( "%10d", spp );
+	printf( "%14s\n", "ns / sample" );
+
+	for ( const Technique technique : { COSINE, ENVIRONMENT, MIS } )
+	{
+		printf( "%-16s", names[technique] );
+
+		double t = 0.0;
+		int no_samples = 0;
+
+		for ( int spp = 1; spp <= max_spp; spp *= 4 )
+		{
+			double mse = 0.0;
+
+			t += Measure( [&]() {
+				for ( int i = 0; i < no_normals; ++i )
+				{
+					double sum = 0.0;
+					for ( int s = 0; s < spp; ++s ) sum += estimate( technique, normals[i], i, s );
+					mse += sqr( ( sum / spp - reference[i] ) / reference[i] );
+				}
+			} );
+			no_samples += no_normals * spp;
+
+			printf( "%10.4f", sqrt( mse / no_normals ) );
+		}
+
+		printf( "%14.1f\n", t / no_samples * 1e9 );
+	}
+
+	printf( "\n" );
+
+	SAFE_DELETE( environment );
+
+	return EXIT_SUCCESS;
+}
+
+/* closed box [-1, 1]^3 with red and green side walls, a ceiling light, a diffuse block and a glass cube */
+static void BuildCornellBox( std::vector<Surface *> & surfaces, std::vector<Material *> & materials )
+{
+	struct Wall
+	{
+		const char * name;
+		Color3f diffuse;
+		Color3f emission;
+		Shader shader;
+	};
+
+	const Wall walls[] = {
+		{ "white", Color3f( { 0.7f, 0.7f, 0.7f } ), Color3f(), Shader::LAMBERT },
+		{ "red", Color3f( { 0.7f, 0.1f, 0.1f } ), Color3f(), Shader::LAMBERT },
+		{ "green", Color3f( { 0.1f, 0.7f, 0.1f } ), Color3f(), Shader::LAMBERT },
+		{ "light", Color3f(), Color3f( { 15.0f, 15.0f, 15.0f } ), Shader::LAMBERT },
+		{ "block", Color3f( { 0.6f, 0.6f, 0.8f } ), Color3f(), Shader::LAMBERT },
+		{ "glass", Color3f(), Color3f(), Shader::GLASS } };
+
+	for ( const Wall & wall : walls )
+	{
+		std::string name = wall.name;
+		materials.push_back( new Material( name, Color3f(), wall.diffuse, Color3f( { 0.9f, 0.9f, 0.9f } ), wall.emission,
+			0.0f, 1.0f, 1.5f, wall.shader ) );
+	}
+
+	auto add_box = [&]( std::vector<Vertex> & vertices, const Vector3 & lower, const Vector3 & upper ) {
+		const float a = lower.x, b = upper.x, c = lower.y, d = upper.y, e = lower.z, f = upper.z;
+		AddQuad( vertices, Vector3( a, c, f ), Vector3( b, c, f ), Vector3( b, d, f ), Vector3( a, d, f ) );
+		AddQuad( vertices, Vector3( a, c, e ), Vector3( a, d, e ), Vector3( b, d, e ), Vector3( b, c, e ) );
+		AddQuad( vertices, Vector3( a, c, e ), Vector3( b, c, e ), Vector3( b, c, f ), Vector3( a, c, f ) );
+		AddQuad( vertices, Vector3( a, d, e ), Vector3( a, d, f ), Vector3( b, d, f ), Vector3( b, d, e ) );
+		AddQuad( vertices, Vector3( a, c, e ), Vector3( a, c, f ), Vector3( a, d, f ), Vector3( a, d, e ) );
+		AddQuad( vertices, Vector3( b, c, e ), Vector3( b, d, e ), Vector3( b, d, f ), Vector3( b, c, f ) );
+	};
+
+	std::vector<Vertex> vertices[6];
+	AddQuad( vertices[0], Vector3( -1, -1, -1 ), Vector3( 1, -1, -1 ), Vector3( 1, 1, -1 ), Vector3( -1, 1, -1 ) );
+	AddQuad( vertices[0], Vector3( -1, -1, 1 ), Vector3( -1, 1, 1 ), Vector3( 1, 1, 1 ), Vector3( 1, -1, 1 ) );
+	AddQuad( vertices[0], Vector3( -1, 1, -1 ), Vector3( 1, 1, -1 ), Vector3( 1, 1, 1 ), Vector3( -1, 1, 1 ) );
+	AddQuad( vertices[1], Vector3( -1, -1, -1 ), Vector3( -1, 1, -1 ), Vector3( -1, 1, 1 ), Vector3( -1, -1, 1 ) );
+	AddQuad( vertices[2], Vector3( 1, -1, -1 ), Vector3( 1, -1, 1 ), Vector3( 1, 1, 1 ), Vector3( 1, 1, -1 ) );
+	AddQuad( vertices[3], Vector3( -0.3f, -0.3f, 0.99f ), Vector3( -0.3f, 0.3f, 0.99f ), Vector3( 0.3f, 0.3f, 0.99f ),
+		Vector3( 0.3f, -0.3f, 0.99f ) );
+	add_box( vertices[4], Vector3( 0.1f, 0.0f, -1.0f ), Vector3( 0.7f, 0.6f, 0.2f ) );
+	add_box( vertices[5], Vector3( -0.7f, -0.5f, -1.0f ), Vector3( -0.1f, 0.1f, -0.4f ) );
+
+	for ( int i = 0; i < 6; ++i )
+	{
+		surfaces.push_back( BuildSurface( walls[i].name, vertices[i] ) );
+		surfaces.back()->set_material( materials[i] );
+	}
+}
+
+int benchmark_denoiser( const int width, const int height, const int reference_spp )
+{
+	printf( "Denoiser, %d x %d px Cornell box, reference %d spp\n", width, height, reference_spp );
+
+	std::vector<Surface *> surfaces;
+	std::vector<Material *> materials;
+	BuildCornellBox( surfaces, materials );
+
+	{
+		const Scene scene( surfaces, materials );
+		const Camera camera( width, height, deg2rad( 45.0f ), Vector3( 0, -3.4f, 0 ), Vector3( 0, 0, 0 ) );
+		const SobolSampler sampler;
+		const SobolSampler reference_sampler( 0xcafe );
+		Lights lights( scene );
+
+		WavefrontTracer reference_tracer( scene, camera, reference_sampler );
+		reference_tracer.set_lights( &lights );
+		const Texture3f reference = reference_tracer.Render( reference_spp );
+
+		WavefrontTracer tracer( scene, camera, sampler );
+		tracer.set_lights( &lights );
+
+		Texture3f albedo( width, height ), normal( width, height ), depth( width, height );
+		Denoiser denoiser;
+
+		std::vector<double> rmse[2];
+		const int spps[] = { 4, 8, 16 };
+
+		for ( const int spp : spps )
+		{
+			const Texture3f noisy = tracer.Render( spp );
+			tracer.RenderFeatures( spp, albedo, normal, depth );
+			const Texture3f denoised = denoiser.Denoise( noisy, albedo, normal, depth );
+
+			rmse[0].push_back( Rmse( noisy, reference ) );
+			rmse[1].push_back( Rmse( denoised, reference ) );
+		}
+
+		// the error of the plain estimate falls as 1 / sqrt( spp )
+		printf( "\n%-8s %12s %12s %16s\n", "spp", "RMSE noisy", "denoised", "equivalent spp" );
+
+		for ( int i = 0; i < 3; ++i )
+		{
+			printf( "%-8d %12.5f %12.5f %16.0f\n", spps[i], rmse[0][i], rmse[1][i],
+				spps[i] * sqr( rmse[0][i] / rmse[1][i] ) );
+		}
+
+		printf( "\n" );
+	}
+
+	SafeDeleteVectorItems<Surface *>( surfaces );
+	SafeDeleteVectorItems<Material *>( materials );
+
+	// speed on a Full HD frame of noise
+	const int hd_width = 1920;
+	const int hd_height = 1080;
+	Texture3f color( hd_width, hd_height ), albedo( hd_width, hd_height ), normal( hd_width, hd_height ),
+		depth( hd_width, hd_height );
+	Pcg32 generator( 2020 );
+
+	for ( int i = 0; i < hd_width * hd_height; ++i )
+	{
+		color.data()[i] = Color3f( { generator.NextFloat(), generator.NextFloat(), generator.NextFloat() } );
+		albedo.data()[i] = Color3f( { 0.5f, 0.5f, 0.5f } );
+		normal.data()[i] = Color3f( { 0.0f, 0.0f, 1.0f } );
+		depth.data()[i] = Color3f( { 1.0f, 1.0f, 1.0f } );
+	}
+
+	Denoiser denoiser;
+	const double t = Measure( [&]() { denoiser.Denoise( color, albedo, normal, depth ); } );
+	printf( "Full HD: %0.1f ms/MPix with %d threads, %s\n\n", t * 1e3 / ( hd_width * hd_height * 1e-6 ),
+		omp_get_max_threads(),
+#if defined( __AVX2__ )
+		"AVX2" );
+#else
+		"scalar" );
+#endif
+
+	return EXIT_SUCCESS;
+}
+
+int benchmark_radiance_cache( const int width, const int height, const int reference_spp )
+{
+	printf( "Radiance cache, %d x %d px Cornell box, reference %d spp\n", width, height, reference_spp );
+
+	std::vector<Surface *> surfaces;
+	std::vector<Material *> materials;
+	BuildCornellBox( surfaces, materials );
+
+	{
+		const Scene scene( surfaces, materials );
+		const Camera camera( width, height, deg2rad( 45.0f ), Vector3( 0, -3.4f, 0 ), Vector3( 0, 0, 0 ) );
+		const SobolSampler sampler;
+		const SobolSampler reference_sampler( 0xcafe );
+		Lights lights( scene );
+
+		WavefrontTracer reference_tracer( scene, camera, reference_sampler );
+		reference_tracer.set_lights( &lights );
+		const Texture3f reference = reference_tracer.Render( reference_spp );
+
+		WavefrontTracer tracer( scene, camera, sampler );
+		tracer.set_lights( &lights );
+
+		RadianceCache cache( 1 << 18, 0.05f );
+		std::vector<double> times[2], rmse[2];
+		std::vector<int> spps;
+
+		for ( int spp = 1; spp <= 32; spp *= 2 )
+		{
+			spps.push_back( spp );
+
+			for ( int i = 0; i < 2; ++i )
+			{
+				// every measurement starts with an empty cache
+				cache.Clear();
+				tracer.set_radiance_cache( ( i == 1 ) ? &cache : nullptr );
+
+				Texture3f image( width, height );
+				times[i].push_back( Measure( [&]() { image = tracer.Render( spp ); } ) );
+				rmse[i].push_back( Rmse( image, reference ) );
+			}
+		}
+
+		cache.Print();
+
+		printf( "\n%-8s %12s %12s %12s %12s\n", "spp", "time", "RMSE", "time cache", "RMSE cache" );
+
+		for ( size_t i = 0; i < spps.size(); ++i )
+		{
+			printf( "%-8d %12s %12.5f %12s %12.5f\n", spps[i], TimeToString( times[0][i] ).c_str(), rmse[0][i],
+				TimeToString( times[1][i] ).c_str(), rmse[1][i] );
+		}
+
+		printf( "\n" );
+	}
+
+	SafeDeleteVectorItems<Surface *>( surfaces );
+	SafeDeleteVectorItems<Material *>( materials );
+
+	return EXIT_SUCCESS;
+}
+
+int benchmark_photon_map( const int width, const int height, const int reference_spp, const int no_photons )
+{
+	printf( "Photon map, %d x %d px Cornell box, reference %d spp, %d photons\n", width, height, reference_spp, no_photons );
+
+	std::vector<Surface *> surfaces;
+	std::vector<Material *> materials;
+	BuildCornellBox( surfaces, materials );
+
+	{
+		const Scene scene( surfaces, materials );
+		const Camera camera( width, height, deg2rad( 45.0f ), Vector3( 0, -3.4f, 0 ), Vector3( 0, 0, 0 ) );
+		const SobolSampler sampler;
+		const SobolSampler reference_sampler( 0xcafe );
+		Lights lights( scene );
+
+		WavefrontTracer reference_tracer( scene, camera, reference_sampler );
+		reference_tracer.set_lights( &lights );
+		const Texture3f reference = reference_tracer.Render( reference_spp );
+
+		PhotonMap photon_map( scene, lights, 0 );
+		const double t_emit = Measure( [&]() { photon_map.Emit( no_photons ); } );
+
+		// queries around the stored photons themselves, i.e. where the caustics are
+		const int no_queries = 1 << 18;
+		std::vector<Vector3> positions( no_queries );
+		Pcg32 rng( 7 );
+
+		for ( Vector3 & position : positions )
+		{
+			const Photon & photon = photon_map.photon( int( rng.NextUInt() % max( 1, photon_map.no_photons() ) ) );
+			position = photon.position + Vector3( rng.NextFloat() - 0.5f, rng.NextFloat() - 0.5f, rng.NextFloat() - 0.5f ) * 0.1f;
+		}
+
+		long long no_found[2] = { 0, 0 };
+
+		const double t_nearest = Measure( [&]() {
+			long long found = 0;
+
+#pragma omp parallel for reduction( + : found )
+			for ( int i = 0; i < no_queries; ++i )
+			{
+				int indices[PhotonMap::kMaxNearest];
+				float sqr_radius = 0.0f;
+				found += photon_map.FindNearest( positions[i], 64, 0.05f, indices, sqr_radius );
+			}
+
+			no_found[0] = found; } );
+
+		const double t_radius = Measure( [&]() {
+			long long found = 0;
+
+#pragma omp parallel
+			{
+				std::vector<int> indices;
+
+#pragma omp for reduction( + : found )
+				for ( int i = 0; i < no_queries; ++i )
+				{
+					indices.clear();
+					found += photon_map.FindInRadius( positions[i], 0.02f, indices );
+				}
+			}
+
+			no_found[1] = found; } );
+
+		printf( "Emission and kd-tree %s, %0.2f Mphotons emitted/s\n", TimeToString( t_emit ).c_str(), no_photons / t_emit * 1e-6 );
+		printf( "64 nearest within 0.05: %0.2f Mqueries/s, %0.1f photons per query\n", no_queries / t_nearest * 1e-6,
+			double( no_found[0] ) / no_queries );
+		printf( "Radius 0.02: %0.2f Mqueries/s, %0.1f photons per query\n", no_queries / t_radius * 1e-6,
+			double( no_found[1] ) / no_queries );
+
+		WavefrontTracer tracer( scene, camera, sampler );
+		tracer.set_lights( &lights );
+
+		std::vector<double> times[2], rmse[2];
+		std::vector<int> spps;
+
+		for ( int spp = 1; spp <= 32; spp *= 2 )
+		{
+			spps.push_back( spp );
+
+			for ( int i = 0; i < 2; ++i )
+			{
+				tracer.set_photon_map( ( i == 1 ) ? &photon_map : nullptr );
+
+				Texture3f image( width, height );
+				times[i].push_back( Measure( [&]() { image = tracer.Render( spp ); } ) );
+				rmse[i].push_back( Rmse( image, reference ) );
+			}
+		}
+
+		printf( "\n%-8s %12s %12s %12s %12s %12s\n", "spp", "time", "RMSE", "time photons", "RMSE photons", "equal error" );
+
+		for ( size_t i = 0; i < spps.size(); ++i )
+		{
+			// time the path tracing alone needs for the error of the photon map render, interpolated between the
+			// sample counts around it with the error as a power of the time, "-" outside the measured range
+			char speedup[32] = "-";
+
+			for ( size_t j = 0; j + 1 < spps.size(); ++j )
+			{
+				if ( rmse[0][j] >= rmse[1][i] && rmse[1][i] >= rmse[0][j + 1] && rmse[0][j] > rmse[0][j + 1] )
+				{
+					const double exponent = log( times[0][j + 1] / times[0][j] ) / log( rmse[0][j + 1] / rmse[0][j] );
+					sprintf( speedup, "%0.2fx", times[0][j] * pow( rmse[1][i] / rmse[0][j], exponent ) / times[1][i] );
+					break;
+				}
+			}
+
+			printf( "%-8d %12s %12.5f %12s %12.5f %12s\n", spps[i], TimeToString( times[0][i] ).c_str(), rmse[0][i],
+				TimeToString( times[1][i] ).c_str(), rmse[1][i], speedup );
+		}
+
+		printf( "\nequal error: time of the path tracing alone to the error of the photon map render / time with photons\n" );
+
+		printf( "\n" );
+	}
+
+	SafeDeleteVectorItems<Surface *>( surfaces );
+	SafeDeleteVectorItems<Material *>( materials );
+
+	return EXIT_SUCCESS;
+}
+
+/* a spruce of three stacked cones on a square trunk, 6 * segments + 8 triangles */
+static Surface * BuildTree( const int segments )
+{
+	std::vector<Vertex> vertices;
+	Coord2f tex_coord = { 0, 0 };
+	const Vector3 color( 0.5f, 0.5f, 0.5f );
+
+	AddQuad( vertices, Vector3( -0.1f, -0.1f, 0 ), Vector3( 0.1f, -0.1f, 0 ), Vector3( 0.1f, -0.1f, 0.5f ), Vector3( -0.1f, -0.1f, 0.5f ) );
+	AddQuad( vertices, Vector3( 0.1f, -0.1f, 0 ), Vector3( 0.1f, 0.1f, 0 ), Vector3( 0.1f, 0.1f, 0.5f ), Vector3( 0.1f, -0.1f, 0.5f ) );
+	AddQuad( vertices, Vector3( 0.1f, 0.1f, 0 ), Vector3( -0.1f, 0.1f, 0 ), Vector3( -0.1f, 0.1f, 0.5f ), Vector3( 0.1f, 0.1f, 0.5f ) );
+	AddQuad( vertices, Vector3( -0.1f, 0.1f, 0 ), Vector3( -0.1f, -0.1f, 0 ), Vector3( -0.1f, -0.1f, 0.5f ), Vector3( -0.1f, 0.1f, 0.5f ) );
+
+	for ( int k = 0; k < 3; ++k )
+	{
+		const float base = 0.4f + 0.5f * k;
+		const float radius = 0.8f - 0.2f * k;
+		const Vector3 apex( 0, 0, base + 1.0f );
+
+		for ( int i = 0; i < segments; ++i )
+		{
+			const float phi_0 = 2.0f * float( M_PI ) * i / segments;
+			const float phi_1 = 2.0f * float( M_PI ) * ( i + 1 ) / segments;
+			const Vector3 p0( radius * cosf( phi_0 ), radius * sinf( phi_0 ), base );
+			const Vector3 p1( radius * cosf( phi_1 ), radius * sinf( phi_1 ), base );
+
+			// smooth normals of the mantle, flat bottom
+			Vector3 n0( cosf( phi_0 ), sinf( phi_0 ), radius );
+			Vector3 n1( cosf( phi_1 ), sinf( phi_1 ), radius );
+			Vector3 na = n0 + n1;
+			n0.Normalize();
+			n1.Normalize();
+			na.Normalize();
+
+			vertices.push_back( Vertex( p0, n0, color, &tex_coord ) );
+			vertices.push_back( Vertex( p1, n1, color, &tex_coord ) );
+			vertices.push_back( Vertex( apex, na, color, &tex_coord ) );
+
+			vertices.push_back( Vertex( Vector3( 0, 0, base ), Vector3( 0, 0, -1 ), color, &tex_coord ) );
+			vertices.push_back( Vertex( p1, Vector3( 0, 0, -1 ), color, &tex_coord ) );
+			vertices.push_back( Vertex( p0, Vector3( 0, 0, -1 ), color, &tex_coord ) );
+		}
+	}
+
+	return BuildSurface( "tree", vertices );
+}
+
+/* copy of the surface with the vertices transformed to the world space */
+static Surface * PlaceCopy( Surface * surface, const Matrix3x4 & transform )
+{
+	const Matrix3x4 inverse = transform.Inverse();
+	std::vector<Vertex> vertices;
+
+	for ( int t = 0; t < surface->no_triangles(); ++t )
+	{
+		for ( int j = 0; j < 3; ++j )
+		{
+			Vertex vertex = surface->get_triangle( t ).vertex( j );
+			vertex.position = transform.TransformPoint( vertex.position );
+			vertex.normal = inverse.TransformNormal( vertex.normal );
+			vertex.normal.Normalize();
+			vertices.push_back( vertex );
+		}
+	}
+
+	Surface * copy = BuildSurface( "copy", vertices );
+	copy->set_material( surface->get_material() );
+
+	return copy;
+}
+
+/* distances of the primary hits (FLT_MAX for misses) and the time of the ray casting */
+static double CastPrimaryRays( const Scene & scene, const Camera & camera, std::vector<float> & distances )
+{
+	const int no_pixels = camera.width() * camera.height();
+	distances.resize( no_pixels );
+
+	return Measure( [&]() {
+#pragma omp parallel for schedule( dynamic, 64 )
+		for ( int i = 0; i < no_pixels; ++i )
+		{
+			Ray ray = camera.GenerateRay( i % camera.width() + 0.5f, i / camera.width() + 0.5f );
+			RayHit hit;
+			scene.Intersect( ray, hit );
+			distances[i] = hit.t;
+		} } );
+}
+
+int benchmark_instancing( const int no_instances, const int width, const int height )
+{
+	printf( "Instancing, %d trees, %d x %d px\n", no_instances, width, height );
+
+	std::vector<Surface *> surfaces;
+	std::vector<Material *> materials;
+	std::string name = "tree";
+	materials.push_back( new Material( name, Color3f(), Color3f( { 0.2f, 0.5f, 0.2f } ), Color3f(), Color3f(),
+		0.0f, 1.0f, 1.5f, Shader::LAMBERT ) );
+	surfaces.push_back( BuildTree( 32 ) );
+	surfaces.back()->set_material( materials[0] );
+
+	// random rotations, scales and positions on a square of the density about one tree per 4 m^2
+	const float side = 2.0f * sqrtf( float( no_instances ) );
+	std::vector<Instance> instances( no_instances );
+	Pcg32 rng( 11 );
+
+	for ( Instance & instance : instances )
+	{
+		const Vector3 position( ( rng.NextFloat() - 0.5f ) * side, ( rng.NextFloat() - 0.5f ) * side, 0.0f );
+		const float scale = 0.8f + 0.6f * rng.NextFloat();
+
+		instance.surface_id = 0;
+		instance.transform = Matrix3x4::Translation( position ) *
+			Matrix3x4::Rotation( Vector3( 0, 0, 1 ), 2.0f * float( M_PI ) * rng.NextFloat() ) *
+			Matrix3x4::Scaling( Vector3( scale, scale, scale ) );
+	}
+
+	const Camera camera( width, height, deg2rad( 60.0f ), Vector3( 0, -0.5f * side, 4.0f ), Vector3( 0, 0, 0 ) );
+	std::vector<float> distances[2];
+
+	{
+		Scene * scene = nullptr;
+		const double t_build = Measure( [&]() { scene = new Scene( surfaces, materials, instances ); } );
+		const double t_cast = CastPrimaryRays( *scene, camera, distances[0] );
+
+		printf( "Instanced: build %s, %0.1f MB, %0.2f Mrays/s\n", TimeToString( t_build ).c_str(),
+			scene->memory() / ( 1024.0 * 1024.0 ), width * height / t_cast * 1e-6 );
+
+		SAFE_DELETE( scene );
+	}
+
+	// the same forest with each tree copied into the world space, limited to keep the memory reasonable
+	const int no_flattened = min( no_instances, 4096 );
+	std::vector<Surface *> copies;
+
+	for ( int i = 0; i < no_flattened; ++i )
+	{
+		copies.push_back( PlaceCopy( surfaces[0], instances[i].transform ) );
+	}
+
+	{
+		const std::vector<Instance> subset( instances.begin(), instances.begin() + no_flattened );
+		Scene * instanced = nullptr;
+		Scene * flattened = nullptr;
+		const double t_build_instanced = Measure( [&]() { instanced = new Scene( surfaces, materials, subset ); } );
+		const double t_build_flattened = Measure( [&]() { flattened = new Scene( copies, materials ); } );
+		const double t_instanced = CastPrimaryRays( *instanced, camera, distances[0] );
+		const double t_flattened = CastPrimaryRays( *flattened, camera, distances[1] );
+
+		// both hierarchies must see the same forest
+		int no_mismatches = 0;
+		float max_difference = 0.0f;
+
+		for ( size_t i = 0; i < distances[0].size(); ++i )
+		{
+			if ( ( distances[0][i] == FLT_MAX ) != ( distances[1][i] == FLT_MAX ) )
+			{
+				++no_mismatches;
+			}
+			else if ( distances[0][i] != FLT_MAX )
+			{
+				max_difference = max( max_difference, fabsf( distances[0][i] - distances[1][i] ) / distances[1][i] );
+			}
+		}
+
+		printf( "\n%d trees %18s %12s %12s\n", no_flattened, "build", "memory", "Mrays/s" );
+		printf( "%-16s %12s %9.1f MB %12.2f\n", "instanced", TimeToString( t_build_instanced ).c_str(),
+			instanced->memory() / ( 1024.0 * 1024.0 ), width * height / t_instanced * 1e-6 );
+		printf( "%-16s %12s %9.1f MB %12.2f\n", "flattened", TimeToString( t_build_flattened ).c_str(),
+			flattened->memory() / ( 1024.0 * 1024.0 ), width * height / t_flattened * 1e-6 );
+		printf( "%d of %d pixels hit differently, max. relative distance difference %g\n\n", no_mismatches,
+			width * height, max_difference );
+
+		SAFE_DELETE( instanced );
+		SAFE_DELETE( flattened );
+	}
+
+	SafeDeleteVectorItems<Surface *>( copies );
+	SafeDeleteVectorItems<Surface *>( surfaces );
+	SafeDeleteVectorItems<Material *>( materials );
+
+	return EXIT_SUCCESS;
+}
+
+/* a chair of six boxes (seat, back and four legs) as a single surface */
+static Surface * BuildChair()
+{
+	std::vector<Vertex> vertices;
+
+	auto add_box = [&]( const Vector3 & lower, const Vector3 & upper ) {
+		const float a = lower.x, b = upper.x, c = lower.y, d = upper.y, e = lower.z, f = upper.z;
+		AddQuad( vertices, Vector3( a, c, f ), Vector3( b, c, f ), Vector3( b, d, f ), Vector3( a, d, f ) );
+		AddQuad( vertices, Vector3( a, c, e ), Vector3( a, d, e ), Vector3( b, d, e ), Vector3( b, c, e ) );
+		AddQuad( vertices, Vector3( a, c, e ), Vector3( b, c, e ), Vector3( b, c, f ), Vector3( a, c, f ) );
+		AddQuad( vertices, Vector3( a, d, e ), Vector3( a, d, f ), Vector3( b, d, f ), Vector3( b, d, e ) );
+		AddQuad( vertices, Vector3( a, c, e ), Vector3( a, c, f ), Vector3( a, d, f ), Vector3( a, d, e ) );
+		AddQuad( vertices, Vector3( b, c, e ), Vector3( b, d, e ), Vector3( b, d, f ), Vector3( b, c, f ) );
+	};
+
+	add_box( Vector3( -0.22f, -0.22f, 0.42f ), Vector3( 0.22f, 0.22f, 0.46f ) );
+	add_box( Vector3( -0.22f, 0.18f, 0.46f ), Vector3( 0.22f, 0.22f, 0.9f ) );
+	add_box( Vector3( -0.22f, -0.22f, 0.0f ), Vector3( -0.18f, -0.18f, 0.42f ) );
+	add_box( Vector3( 0.18f, -0.22f, 0.0f ), Vector3( 0.22f, -0.18f, 0.42f ) );
+	add_box( Vector3( -0.22f, 0.18f, 0.0f ), Vector3( -0.18f, 0.22f, 0.42f ) );
+	add_box( Vector3( 0.18f, 0.18f, 0.0f ), Vector3( 0.22f, 0.22f, 0.42f ) );
+
+	return BuildSurface( "chair", vertices );
+}
+
+int benchmark_instance_detection( const int no_copies, const int width, const int height )
+{
+	printf( "Instance detection, %d chairs, %d x %d px\n", no_copies, width, height );
+
+	std::vector<Material *> materials;
+	std::string name = "wood";
+	materials.push_back( new Material( name, Color3f(), Color3f( { 0.5f, 0.3f, 0.2f } ), Color3f(), Color3f(), 0.0f, 1.0f,
+		1.5f, Shader::LAMBERT ) );
+
+	// copies in the world space rounded to 5 decimals as an exporter writes them, every 16th one is stretched by 1 %
+	// and must not be detected
+	Surface * chair = BuildChair();
+	std::vector<Surface *> surfaces;
+	const float side = 1.5f * sqrtf( float( no_copies ) );
+	Pcg32 rng( 5 );
+	int no_distorted = 0;
+
+	for ( int i = 0; i < no_copies; ++i )
+	{
+		const float stretch = ( i % 16 == 15 ) ? 1.01f : 1.0f;
+		const Matrix3x4 transform = Matrix3x4::Translation( Vector3( ( rng.NextFloat() - 0.5f ) * side,
+			( rng.NextFloat() - 0.5f ) * side, 0.0f ) ) * Matrix3x4::Rotation( Vector3( 0, 0, 1 ),
+			2.0f * float( M_PI ) * rng.NextFloat() ) * Matrix3x4::Scaling( Vector3( stretch, 1.0f, 1.0f ) );
+		const Matrix3x4 inverse = transform.Inverse();
+		std::vector<Vertex> vertices;
+
+		no_distorted += ( stretch != 1.0f );
+
+		for ( int t = 0; t < chair->no_triangles(); ++t )
+		{
+			for ( int j = 0; j < 3; ++j )
+			{
+				Vertex vertex = chair->get_triangle( t ).vertex( j );
+				vertex.position = transform.TransformPoint( vertex.position );
+				vertex.normal = inverse.TransformNormal( vertex.normal );
+				vertex.normal.Normalize();
+
+				for ( int k = 0; k < 3; ++k )
+				{
+					vertex.position.data[k] = roundf( vertex.position.data[k] * 1e5f ) * 1e-5f;
+					vertex.normal.data[k] = roundf( vertex.normal.data[k] * 1e5f ) * 1e-5f;
+				}
+
+				vertices.push_back( vertex );
+			}
+		}
+
+		surfaces.push_back( BuildSurface( "chair", vertices ) );
+		surfaces.back()->set_material( materials[0] );
+	}
+
+	SAFE_DELETE( chair );
+
+	const Camera camera( width, height, deg2rad( 60.0f ), Vector3( 0, -0.6f * side, 3.0f ), Vector3( 0, 0, 0 ) );
+	std::vector<float> distances[2];
+	double t_cast[2] = { 0.0, 0.0 };
+	size_t bytes[2] = { 0, 0 };
+
+	{
+		const Scene scene( surfaces, materials );
+		t_cast[0] = CastPrimaryRays( scene, camera, distances[0] );
+		bytes[0] = scene.memory();
+	}
+
+	std::vector<Instance> instances;
+	const size_t saved = DetectInstances( surfaces, instances );
+
+	{
+		const Scene scene( surfaces, materials, instances );
+		t_cast[1] = CastPrimaryRays( scene, camera, distances[1] );
+		bytes[1] = scene.memory();
+	}
+
+	int no_mismatches = 0;
+
+	for ( size_t i = 0; i < distances[0].size(); ++i )
+	{
+		no_mismatches += ( distances[0][i] == FLT_MAX ) != ( distances[1][i] == FLT_MAX );
+	}
+
+	printf( "\n%d copies (%d stretched) -> %I64u meshes, %0.1f MB of triangles saved\n", no_copies, no_distorted,
+		surfaces.size(), saved / ( 1024.0 * 1024.0 ) );
+	printf( "%-16s %12s %12s\n", "", "BVH memory", "Mrays/s" );
+	printf( "%-16s %9.2f MB %12.2f\n", "flat", bytes[0] / ( 1024.0 * 1024.0 ), width * height / t_cast[0] * 1e-6 );
+	printf( "%-16s %9.2f MB %12.2f\n", "instanced", bytes[1] / ( 1024.0 * 1024.0 ), width * height / t_cast[1] * 1e-6 );
+	printf( "%d of %d pixels hit differently\n\n", no_mismatches, width * height );
+
+	SafeDeleteVectorItems<Surface *>( surfaces );
+	SafeDeleteVectorItems<Material *>( materials );
+
+	return EXIT_SUCCESS;
+}
+
+/* grid_size^2 quads in the unit square displaced by a wave of the given amplitude and phase */
+static void DeformGrid( Surface * grid, const int grid_size, const float amplitude, const float phase )
+{
+	auto position = [&]( const int i, const int j ) {
+		const float x = float( i ) / grid_size;
+		const float y = float( j ) / grid_size;
+		return Vector3( x, y, amplitude * sinf( 4.0f * float( M_PI ) * ( x + 0.5f * y ) + phase ) ); };
+
+#pragma omp parallel for
+	for ( int q = 0; q < grid_size * grid_size; ++q )
+	{
+		const int i = q % grid_size;
+		const int j = q / grid_size;
+		const Vector3 p[4] = { position( i, j ), position( i + 1, j ), position( i + 1, j + 1 ), position( i, j + 1 ) };
+
+		for ( int k = 0; k < 2; ++k )
+		{
+			Triangle & triangle = grid->get_triangle( 2 * q + k );
+			Vertex v[3] = { triangle.vertex( 0 ), triangle.vertex( 1 ), triangle.vertex( 2 ) };
+
+			v[0].position = p[0];
+			v[1].position = p[1 + k];
+			v[2].position = p[2 + k];
+			triangle = Triangle( v[0], v[1], v[2], grid );
+		}
+	}
+}
+
+/* fraction of pixels whose primary hit distances differ */
+static float CompareDistances( const std::vector<float> & a, const std::vector<float> & b )
+{
+	int no_mismatches = 0;
+
+	for ( size_t i = 0; i < a.size(); ++i )
+	{
+		if ( fabsf( a[i] - b[i] ) > 1e-4f * max( 1.0f, fabsf( b[i] ) ) ) ++no_mismatches;
+	}
+
+	return float( no_mismatches ) / max<size_t>( 1, a.size() );
+}
+
+int benchmark_dynamic( const int grid_size, const int no_instances, const int width, const int height )
+{
+	printf( "Dynamic scenes, %d x %d grid, %d instances, %d x %d px\n", grid_size, grid_size, no_instances, width, height );
+
+	std::vector<Material *> materials;
+	std::string name = "grey";
+	materials.push_back( new Material( name, Color3f(), Color3f( { 0.5f, 0.5f, 0.5f } ), Color3f(), Color3f(),
+		0.0f, 1.0f, 1.5f, Shader::LAMBERT ) );
+
+	// deforming mesh, the refitted hierarchy without the rebuild monitor, with it and rebuilt every frame
+	{
+		std::vector<Vertex> triangles;
+
+		for ( int q = 0; q < grid_size * grid_size; ++q )
+		{
+			const float x = float( q % grid_size ), y = float( q / grid_size );
+			AddQuad( triangles, Vector3( x, y, 0 ), Vector3( x + 1, y, 0 ), Vector3( x + 1, y + 1, 0 ), Vector3( x, y + 1, 0 ) );
+		}
+
+		std::vector<Surface *> surfaces;
+		surfaces.push_back( BuildSurface( "grid", triangles ) );
+		surfaces.back()->set_material( materials[0] );
+		DeformGrid( surfaces[0], grid_size, 0.01f, 0.0f );
+
+		Scene refitted( surfaces, materials );
+		Scene monitored( surfaces, materials );
+		refitted.set_rebuild_threshold( FLT_MAX );
+
+		const Camera camera( width, height, deg2rad( 45.0f ), Vector3( 0.5f, -1.0f, 1.0f ), Vector3( 0.5f, 0.5f, 0.0f ) );
+		std::vector<float> distances[2];
+
+		printf( "\n%2s %9s %12s %12s %10s %10s %10s %10s %10s\n", "", "amplitude", "refit", "rebuild", "SAH refit",
+			"SAH built", "Mrays/s", "Mrays/s", "rebuilds" );
+
+		for ( int frame = 0; frame < 8; ++frame )
+		{
+			const float amplitude = 0.01f * float( 1 << frame );
+			DeformGrid( surfaces[0], grid_size, amplitude, 0.7f * frame );
+
+			const double t_refit = Measure( [&]() { refitted.Refit( { 0 } ); } );
+			monitored.Refit( { 0 } );
+
+			Scene * rebuilt = nullptr;
+			const double t_rebuild = Measure( [&]() { rebuilt = new Scene( surfaces, materials ); } );
+
+			const double t_refitted = CastPrimaryRays( refitted, camera, distances[0] );
+			const double t_rebuilt = CastPrimaryRays( *rebuilt, camera, distances[1] );
+
+			printf( "%2d %9.2f %12s %12s %10.2f %10.2f %10.2f %10.2f %10d (%0.2f %% pixels differ)\n", frame, amplitude,
+				TimeToString( t_refit ).c_str(), TimeToString( t_rebuild ).c_str(), refitted.bvh().SahCost(),
+				rebuilt->bvh().SahCost(), width * height / t_refitted * 1e-6, width * height / t_rebuilt * 1e-6,
+				monitored.no_rebuilds(), 100.0f * CompareDistances( distances[0], distances[1] ) );
+
+			SAFE_DELETE( rebuilt );
+		}
+
+		SafeDeleteVectorItems<Surface *>( surfaces );
+	}
+
+	// forest of moving instances, every frame 10 % of the trees move and a few are added and removed
+	{
+		std::vector<Surface *> surfaces;
+		surfaces.push_back( BuildTree( 16 ) );
+		surfaces.back()->set_material( materials[0] );
+
+		const float side = 2.0f * sqrtf( float( no_instances ) );
+		Pcg32 rng( 5 );
+
+		auto random_placement = [&]() {
+			Instance instance;
+			instance.surface_id = 0;
+			instance.transform = Matrix3x4::Translation( Vector3( ( rng.NextFloat() - 0.5f ) * side,
+				( rng.NextFloat() - 0.5f ) * side, 0.0f ) ) * Matrix3x4::Rotation( Vector3( 0, 0, 1 ), 2.0f * float( M_PI ) * rng.NextFloat() );
+			return instance; };
+
+		std::vector<Instance> instances( no_instances );
+		std::generate( instances.begin(), instances.end(), random_placement );
+
+		Scene scene( surfaces, materials, instances );
+		const Camera camera( width, height, deg2rad( 60.0f ), Vector3( 0, -0.5f * side, 4.0f ), Vector3( 0, 0, 0 ) );
+		std::vector<float> distances[2];
+
+		printf( "\n%2s %12s %12s %10s %10s %10s %10s\n", "", "move+commit", "add+remove", "SAH", "SAH built", "Mrays/s",
+			"rebuilds" );
+
+		for ( int frame = 0; frame < 8; ++frame )
+		{
+			// moves of increasing length, the later ones scatter the trees over the whole forest
+			const float step = 0.05f * side * float( 1 << frame ) / 128.0f;
+
+			for ( int i = 0; i < no_instances / 10; ++i )
+			{
+				const int id = rng.NextUInt() % scene.instances().size();
+
+				if ( scene.instances()[id].surface_id < 0 ) continue;
+
+				const Vector3 offset( ( rng.NextFloat() - 0.5f ) * step, ( rng.NextFloat() - 0.5f ) * step, 0.0f );
+				scene.SetTransform( id, Matrix3x4::Translation( offset ) * scene.instances()[id].transform );
+			}
+
+			const double t_refit = Measure( [&]() { scene.Commit(); } );
+			const float refit_sah = scene.bvh().SahCost();
+
+			for ( int i = 0; i < 16; ++i )
+			{
+				scene.AddInstance( random_placement() );
+				scene.RemoveInstance( rng.NextUInt() % scene.instances().size() );
+			}
+
+			const double t_rebuild = Measure( [&]() { scene.Commit(); } );
+
+			// the reference built from scratch over the active instances
+			std::vector<Instance> active;
+			std::copy_if( scene.instances().begin(), scene.instances().end(), std::back_inserter( active ),
+				[]( const Instance & instance ) { return instance.surface_id >= 0; } );
+			Scene reference( surfaces, materials, active );
+
+			const double t_cast = CastPrimaryRays( scene, camera, distances[0] );
+			CastPrimaryRays( reference, camera, distances[1] );
+
+			printf( "%2d %12s %12s %10.2f %10.2f %10.2f %10d (%0.2f %% pixels differ)\n", frame, TimeToString( t_refit ).c_str(),
+				TimeToString( t_rebuild ).c_str(), refit_sah, reference.bvh().SahCost(), width * height / t_cast * 1e-6,
+				scene.no_rebuilds(), 100.0f * CompareDistances( distances[0], distances[1] ) );
+		}
+
+		SafeDeleteVectorItems<Surface *>( surfaces );
+	}
+
+	SafeDeleteVectorItems<Material *>( materials );
+
+	return EXIT_SUCCESS;
+}
+
+int benchmark_compressed_bvh( const int no_trees, const int width, const int height )
+{
+	printf( "Compressed BVH, %d flattened trees, %d x %d px\n", no_trees, width, height );
+
+	std::vector<Material *> materials;
+	std::string name = "tree";
+	materials.push_back( new Material( name, Color3f(), Color3f( { 0.2f, 0.5f, 0.2f } ), Color3f(), Color3f(),
+		0.0f, 1.0f, 1.5f, Shader::LAMBERT ) );
+
+	Surface * tree = BuildTree( 32 );
+	tree->set_material( materials[0] );
+
+	const float side = 2.0f * sqrtf( float( no_trees ) );
+	std::vector<Surface *> surfaces;
+	Pcg32 rng( 13 );
+
+	for ( int i = 0; i < no_trees; ++i )
+	{
+		const Vector3 position( ( rng.NextFloat() - 0.5f ) * side, ( rng.NextFloat() - 0.5f ) * side, 0.0f );
+		surfaces.push_back( PlaceCopy( tree, Matrix3x4::Translation( position ) *
+			Matrix3x4::Rotation( Vector3( 0, 0, 1 ), 2.0f * float( M_PI ) * rng.NextFloat() ) ) );
+	}
+
+	SAFE_DELETE( tree );
+
+	Scene plain( surfaces, materials );
+	Scene compressed( surfaces, materials );
+	const size_t no_triangles = plain.bvh().indices().size();
+	const size_t float_bytes = plain.bvh().nodes().size() * sizeof( BvhNode ) + no_triangles * sizeof( int );
+	const double t_compress = Measure( [&]() { compressed.Compress(); } );
+	const size_t quantized_bytes = compressed.memory() - ( plain.memory() - float_bytes ); // the rest is the same
+
+	const Camera camera( width, height, deg2rad( 60.0f ), Vector3( 0, -0.5f * side, 4.0f ), Vector3( 0, 0, 0 ) );
+	const Vector3 light( 0.3f * side, -0.2f * side, 0.5f * side );
+	const Scene * scenes[2] = { &plain, &compressed };
+	std::vector<float> distances[2];
+	double t_primary[2], t_shadow[2];
+	int no_occluded[2];
+
+	for ( int k = 0; k < 2; ++k )
+	{
+		t_primary[k] = CastPrimaryRays( *scenes[k], camera, distances[k] );
+
+		// shadow rays from the primary hits to a distant point light
+		int occluded = 0;
+		t_shadow[k] = Measure( [&]() {
+#pragma omp parallel for schedule( dynamic, 64 ) reduction( + : occluded )
+			for ( int i = 0; i < width * height; ++i )
+			{
+				if ( distances[k][i] == FLT_MAX ) continue;
+
+				const Ray primary = camera.GenerateRay( i % width + 0.5f, i / width + 0.5f );
+				const Vector3 p = primary.origin + primary.direction * distances[k][i];
+				Vector3 direction = light - p;
+				const float distance = direction.Normalize();
+
+				if ( scenes[k]->Occluded( Ray( p, direction, 1e-3f, distance ) ) ) ++occluded;
+			} } );
+		no_occluded[k] = occluded;
+	}
+
+	int no_mismatches = 0;
+
+	for ( size_t i = 0; i < distances[0].size(); ++i )
+	{
+		if ( distances[0][i] != distances[1][i] ) ++no_mismatches;
+	}
+
+	printf( "\n%I64u triangles, compressed in %s\n", no_triangles, TimeToString( t_compress ).c_str() );
+	printf( "%-10s %12s %12s %12s %12s\n", "nodes", "MB", "B/triangle", "primary", "shadow" );
+	printf( "%-10s %12.1f %12.2f %7.2f Mrays/s %7.2f Mrays/s\n", "float", float_bytes / ( 1024.0 * 1024.0 ),
+		double( float_bytes ) / no_triangles, width * height / t_primary[0] * 1e-6, width * height / t_shadow[0] * 1e-6 );
+	printf( "%-10s %12.1f %12.2f %7.2f Mrays/s %7.2f Mrays/s\n", "quantized", quantized_bytes / ( 1024.0 * 1024.0 ),
+		double( quantized_bytes ) / no_triangles,
+		width * height / t_primary[1] * 1e-6, width * height / t_shadow[1] * 1e-6 );
+	printf( "%d of %d primary hits differ, %d vs. %d shadow rays occluded\n\n", no_mismatches, width * height,
+		no_occluded[0], no_occluded[1] );
+
+	SafeDeleteVectorItems<Surface *>( surfaces );
+	SafeDeleteVectorItems<Material *>( materials );
+
+	return EXIT_SUCCESS;
+}
+
+int benchmark_spatial_splits( const int no_beams, const int width, const int height )
+{
+	printf( "Spatial splits, %d beams, %d x %d px\n", no_beams, width, height );
+
+	std::vector<Material *> materials;
+	std::string name = "white";
+	materials.push_back( new Material( name, Color3f(), Color3f( { 0.7f, 0.7f, 0.7f } ), Color3f(), Color3f(),
+		0.0f, 1.0f, 1.5f, Shader::LAMBERT ) );
+
+	// a 20 x 20 x 5 m hall, the walls and the floor are single quads
+	const float size = 20.0f;
+	const float height_m = 5.0f;
+	std::vector<Vertex> vertices;
+	AddQuad( vertices, Vector3( 0, 0, 0 ), Vector3( size, 0, 0 ), Vector3( size, size, 0 ), Vector3( 0, size, 0 ) );
+	AddQuad( vertices, Vector3( 0, size, 0 ), Vector3( size, size, 0 ), Vector3( size, size, height_m ), Vector3( 0, size, height_m ) );
+	AddQuad( vertices, Vector3( 0, 0, 0 ), Vector3( 0, size, 0 ), Vector3( 0, size, height_m ), Vector3( 0, 0, height_m ) );
+	AddQuad( vertices, Vector3( size, size, 0 ), Vector3( size, 0, 0 ), Vector3( size, 0, height_m ), Vector3( size, size, height_m ) );
+
+	// diagonal beams across the hall, each a thin cross of two long triangles, and chairs on the floor
+	Pcg32 rng( 17 );
+	Coord2f tex_coord = { 0, 0 };
+	const Vector3 color( 0.5f, 0.5f, 0.5f );
+
+	for ( int i = 0; i < no_beams; ++i )
+	{
+		const Vector3 a( rng.NextFloat() * size, 0.0f, rng.NextFloat() * height_m );
+		const Vector3 b( rng.NextFloat() * size, size, rng.NextFloat() * height_m );
+		const Vector3 offsets[2] = { Vector3( 0.02f, 0, 0 ), Vector3( 0, 0, 0.02f ) };
+
+		for ( const Vector3 & offset : offsets )
+		{
+			Vector3 normal = ( b - a ).CrossProduct( offset );
+			normal.Normalize();
+			vertices.push_back( Vertex( a - offset, normal, color, &tex_coord ) );
+			vertices.push_back( Vertex( b, normal, color, &tex_coord ) );
+			vertices.push_back( Vertex( a + offset, normal, color, &tex_coord ) );
+		}
+	}
+
+	std::vector<Surface *> surfaces;
+	surfaces.push_back( BuildSurface( "hall", vertices ) );
+	surfaces.back()->set_material( materials[0] );
+
+	Surface * chair = BuildChair();
+	chair->set_material( materials[0] );
+
+	for ( int i = 0; i < 400; ++i )
+	{
+		surfaces.push_back( PlaceCopy( chair, Matrix3x4::Translation( Vector3( 0.5f + ( i % 20 ) * 0.95f,
+			0.5f + ( i / 20 ) * 0.95f, 0.0f ) ) * Matrix3x4::Rotation( Vector3( 0, 0, 1 ), 2.0f * float( M_PI ) * rng.NextFloat() ) ) );
+	}
+
+	SAFE_DELETE( chair );
+
+	const Camera camera( width, height, deg2rad( 70.0f ), Vector3( 1.0f, 1.0f, 1.7f ), Vector3( size, size, 0.5f ) );
+	std::vector<float> distances[2];
+
+	Scene scene( surfaces, materials );
+	const double t_object = Measure( [&]() { scene.UseSpatialSplits( 0.0f ); } );
+	const double t_cast_object = CastPrimaryRays( scene, camera, distances[0] );
+
+	printf( "\n%-14s %12s %12s %10s %12s %10s\n", "builder", "build", "references", "SAH", "Mrays/s", "differ" );
+	printf( "%-14s %12s %12d %10.2f %12.2f %10s\n", "object", TimeToString( t_object ).c_str(), static_cast<int>( scene.bvh().indices().size() ),
+		scene.bvh().SahCost(), width * height / t_cast_object * 1e-6, "-" );
+
+	const float budgets[] = { 0.1f, 0.3f, 1.0f };
+
+	for ( const float budget : budgets )
+	{
+		const double t_build = Measure( [&]() { scene.UseSpatialSplits( budget ); } );
+		const double t_cast = CastPrimaryRays( scene, camera, distances[1] );
+
+		int no_mismatches = 0;
+
+		for ( size_t i = 0; i < distances[0].size(); ++i )
+		{
+			if ( distances[0][i] != distances[1][i] ) ++no_mismatches;
+		}
+
+		char label[32];
+		sprintf( label, "spatial %0.0f %%", 100.0f * budget );
+		printf( "%-14s %12s %12d %10.2f %12.2f %10d\n", label, TimeToString( t_build ).c_str(),
+			static_cast<int>( scene.bvh().indices().size() ), scene.bvh().SahCost(), width * height / t_cast * 1e-6, no_mismatches );
+	}
+
+	// the budget holds even if nearly every triangle straddles every splitting plane, long slivers across the hall
+	std::vector<Vector3> slivers;
+
+	for ( int i = 0; i < 4 * no_beams; ++i )
+	{
+		const Vector3 a( rng.NextFloat() * size, rng.NextFloat() * size, 0.0f );
+		const Vector3 b( size - a.x, size - a.y, height_m );
+		slivers.push_back( a );
+		slivers.push_back( b );
+		slivers.push_back( a + Vector3( 0.01f, 0.01f, 0.0f ) );
+	}
+
+	const size_t no_slivers = slivers.size() / 3;
+	printf( "\n%-14s %12s %12s\n", "slivers", "references", "budget" );
+
+	for ( const float budget : budgets )
+	{
+		Bvh bvh;
+		bvh.BuildSpatial( slivers, 4, budget );
+
+		const size_t no_references = bvh.indices().size();
+		const size_t max_references = size_t( no_slivers * ( 1.0 + budget ) );
+
+		char label[32];
+		sprintf( label, "spatial %0.0f %%", 100.0f * budget );
+		printf( "%-14s %12d %12d%s\n", label, static_cast<int>( no_references ), static_cast<int>( max_references ),
+			( no_references <= max_references ) ? "" : " exceeded" );
+		assert( no_references <= max_references );
+	}
+
+	printf( "\n" );
+
+	SafeDeleteVectorItems<Surface *>( surfaces );
+	SafeDeleteVectorItems<Material *>( materials );
+
+	return EXIT_SUCCESS;
+}
+
+int benchmark_treelets( const int no_trees, const int width, const int height )
+{
+	printf( "Treelet restructuring, %d flattened trees, %d x %d px\n", no_trees, width, height );
+
+	Surface * tree = BuildTree( 32 );
+	const float side = 2.0f * sqrtf( float( no_trees ) );
+	std::vector<Vector3> vertices;
+	std::vector<Aabb> bounds;
+	Pcg32 rng( 19 );
+
+	for ( int i = 0; i < no_trees; ++i )
+	{
+		const Matrix3x4 transform = Matrix3x4::Translation( Vector3( ( rng.NextFloat() - 0.5f ) * side,
+			( rng.NextFloat() - 0.5f ) * side, 0.0f ) ) * Matrix3x4::Rotation( Vector3( 0, 0, 1 ), 2.0f * float( M_PI ) * rng.NextFloat() );
+
+		for ( int t = 0; t < tree->no_triangles(); ++t )
+		{
+			Aabb box;
+
+			for ( int j = 0; j < 3; ++j )
+			{
+				vertices.push_back( transform.TransformPoint( tree->get_triangle( t ).vertex( j ).position ) );
+				box.Grow( vertices.back() );
+			}
+
+			bounds.push_back( box );
+		}
+	}
+
+	SAFE_DELETE( tree );
+
+	const Camera camera( width, height, deg2rad( 60.0f ), Vector3( 0, -0.5f * side, 4.0f ), Vector3( 0, 0, 0 ) );
+	const int no_pixels = width * height;
+	std::vector<float> reference;
+
+	// closest hits through the hierarchy, the triangles are looked up by indices() as they are not reordered here
+	auto cast = [&]( const Bvh & bvh, std::vector<float> & distances ) {
+		distances.resize( no_pixels );
+
+		return Measure( [&]() {
+#pragma omp parallel for schedule( dynamic, 64 )
+			for ( int i = 0; i < no_pixels; ++i )
+			{
+				Ray ray = camera.GenerateRay( i % width + 0.5f, i / width + 0.5f );
+				float closest = FLT_MAX;
+
+				bvh.Traverse( ray, [&]( const int first, const int count ) {
+					for ( int j = first; j < first + count; ++j )
+					{
+						const Vector3 * v = &vertices[3 * bvh.indices()[j]];
+						float t, u, w;
+
+						if ( Triangle::Intersect( v[0], v[1], v[2], ray, t, u, w ) )
+						{
+							ray.t_max = t;
+							closest = t;
+						}
+					}
+
+					return false; } );
+
+				distances[i] = closest;
+			} } ); };
+
+	printf( "\n%I64u triangles\n", bounds.size() );
+	printf( "%-10s %12s %12s %10s %10s %10s %10s %8s\n", "builder", "build", "optimize", "SAH", "SAH opt.", "Mrays/s",
+		"Mrays/s", "differ" );
+
+	for ( int builder = 0; builder < 2; ++builder )
+	{
+		Bvh bvh;
+		const double t_build = Measure( [&]() {
+			if ( builder == 0 ) bvh.Build( bounds ); else bvh.BuildMorton( bounds ); } );
+
+		std::vector<float> distances;
+		const float sah_before = bvh.SahCost();
+		const double t_before = cast( bvh, distances );
+
+		if ( builder == 0 ) reference = distances;
+
+		const double t_optimize = Measure( [&]() { bvh.Optimize(); } );
+		const float sah_after = bvh.SahCost();
+		const double t_after = cast( bvh, distances );
+
+		int no_mismatches = 0;
+
+		for ( int i = 0; i < no_pixels; ++i )
+		{
+			if ( distances[i] != reference[i] ) ++no_mismatches;
+		}
+
+		printf( "%-10s %12s %12s %10.2f %10.2f %10.2f %10.2f %8d\n", ( builder == 0 ) ? "SAH" : "Morton",
+			TimeToString( t_build ).c_str(), TimeToString( t_optimize ).c_str(), sah_before, sah_after,
+			no_pixels / t_before * 1e-6, no_pixels / t_after * 1e-6, no_mismatches );
+	}
+
+	printf( "\n" );
+
+	return EXIT_SUCCESS;
+}
+
+/* unit sphere by the subdivision of an icosahedron with the shared vertices jittered, indices of its triangles */
+static void BuildIcosphere( const int no_subdivisions, std::vector<Vector3> & vertices, std::vector<int> & indices )
+{
+	const float g = ( 1.0f + sqrtf( 5.0f ) ) * 0.5f;
+	vertices = { Vector3( -1, g, 0 ), Vector3( 1, g, 0 ), Vector3( -1, -g, 0 ), Vector3( 1, -g, 0 ),
+		Vector3( 0, -1, g ), Vector3( 0, 1, g ), Vector3( 0, -1, -g ), Vector3( 0, 1, -g ),
+		Vector3( g, 0, -1 ), Vector3( g, 0, 1 ), Vector3( -g, 0, -1 ), Vector3( -g, 0, 1 ) };
+	indices = { 0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11, 1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+		3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9, 4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1 };
+
+	for ( int level = 0; level < no_subdivisions; ++level )
+	{
+		std::map<std::pair<int, int>, int> midpoints;
+		std::vector<int> subdivided;
+
+		auto midpoint = [&]( const int a, const int b ) {
+			const auto key = std::make_pair( min( a, b ), max( a, b ) );
+			const auto found = midpoints.find( key );
+			if ( found != midpoints.end() ) return found->second;
+			vertices.push_back( ( vertices[a] + vertices[b] ) * 0.5f );
+			return midpoints[key] = static_cast<int>( vertices.size() ) - 1; };
+
+		for ( size_t i = 0; i < indices.size(); i += 3 )
+		{
+			const int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+			const int ab = midpoint( a, b ), bc = midpoint( b, c ), ca = midpoint( c, a );
+			subdivided.insert( subdivided.end(), { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca } );
+		}
+
+		indices.swap( subdivided );
+	}
+
+	Pcg32 rng( 23 );
+
+	for ( Vector3 & vertex : vertices )
+	{
+		vertex.Normalize();
+		vertex *= 1.0f + 0.01f * ( rng.NextFloat() - 0.5f ); // arbitrary float coordinates
+	}
+}
+
+int benchmark_triangle_kernels( const int no_rays, const int no_triangles )
+{
+	printf( "Ray-triangle kernels, %d-wide blocks\n", kTriangleBlockWidth );
+
+	// crack test, rays from the inside of a closed mesh through its vertices and edges must all hit it
+	{
+		std::vector<Vector3> vertices;
+		std::vector<int> indices;
+		BuildIcosphere( 3, vertices, indices );
+
+		const int n = static_cast<int>( indices.size() / 3 );
+		std::vector<TriangleBlock> blocks( ( n + kTriangleBlockWidth - 1 ) / kTriangleBlockWidth );
+
+		for ( int i = 0; i < n; ++i )
+		{
+			blocks[i / kTriangleBlockWidth].set( i % kTriangleBlockWidth, vertices[indices[3 * i]], vertices[indices[3 * i + 1]],
+				vertices[indices[3 * i + 2]] );
+		}
+
+		// targets are the vertices and points on the shared edges
+		std::vector<Vector3> targets = vertices;
+		Pcg32 rng( 29 );
+
+		for ( int i = 0; i < n; ++i )
+		{
+			for ( int j = 0; j < 3; ++j )
+			{
+				const Vector3 & a = vertices[indices[3 * i + j]];
+				const Vector3 & b = vertices[indices[3 * i + ( j + 1 ) % 3]];
+				targets.push_back( a + ( b - a ) * rng.NextFloat() );
+			}
+		}
+
+		int leaks[3] = { 0, 0, 0 };
+		int no_tests = 0;
+
+		for ( int k = 0; k < 16; ++k )
+		{
+			const Vector3 origin( 0.3f * ( rng.NextFloat() - 0.5f ), 0.3f * ( rng.NextFloat() - 0.5f ), 0.3f * ( rng.NextFloat() - 0.5f ) );
+
+			for ( const Vector3 & target : targets )
+			{
+				Vector3 direction = target - origin;
+				direction.Normalize();
+				const Ray ray( origin, direction );
+				const WatertightRay sheared( ray );
+				bool hit[3] = { false, false, false };
+				float t, u, v;
+
+				for ( int i = 0; i < n; ++i )
+				{
+					const Vector3 & a = vertices[indices[3 * i]];
+					const Vector3 & b = vertices[indices[3 * i + 1]];
+					const Vector3 & c = vertices[indices[3 * i + 2]];
+					hit[0] = hit[0] || Triangle::Intersect( a, b, c, ray, t, u, v );
+					hit[1] = hit[1] || Triangle::IntersectWatertight( a, b, c, ray, t, u, v );
+				}
+
+				for ( const TriangleBlock & block : blocks )
+				{
+					hit[2] = hit[2] || IntersectBlock( block, sheared, 0, kTriangleBlockWidth, ray.t_min, ray.t_max, t, u, v ) >= 0;
+				}
+
+				for ( int m = 0; m < 3; ++m )
+				{
+					if ( !hit[m] ) ++leaks[m];
+				}
+
+				++no_tests;
+			}
+		}
+
+		printf( "\nClosed mesh of %d triangles, %d rays through its vertices and edges\n", n, no_tests );
+		printf( "%-24s %8d leaks\n", "Moller-Trumbore", leaks[0] );
+		printf( "%-24s %8d leaks\n", "watertight", leaks[1] );
+		printf( "%-24s %8d leaks\n", "watertight block", leaks[2] );
+	}
+
+	// throughput on random triangles and rays within a unit cube
+	{
+		Pcg32 rng( 31 );
+		auto random_point = [&]() { return Vector3( rng.NextFloat(), rng.NextFloat(), rng.NextFloat() ); };
+
+		std::vector<Vector3> vertices( 3 * no_triangles );
+		std::generate( vertices.begin(), vertices.end(), [&]() {
+			return Vector3( 0.5f, 0.5f, 0.5f ) + ( random_point() - Vector3( 0.5f, 0.5f, 0.5f ) ) * 0.5f; } );
+
+		std::vector<TriangleBlock> blocks( ( no_triangles + kTriangleBlockWidth - 1 ) / kTriangleBlockWidth );
+
+		for ( int i = 0; i < no_triangles; ++i )
+		{
+			blocks[i / kTriangleBlockWidth].set( i % kTriangleBlockWidth, vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2] );
+		}
+
+		const int no_batch = max( 1, no_rays / no_triangles );
+		std::vector<Ray> rays( no_batch );
+
+		for ( Ray & ray : rays )
+		{
+			Vector3 direction = random_point() - random_point();
+			direction.Normalize();
+			ray = Ray( random_point(), direction );
+		}
+
+		const double no_tests = double( no_batch ) * no_triangles;
+		std::vector<float> closest[3];
+		double t_kernel[3];
+
+		for ( int m = 0; m < 3; ++m )
+		{
+			closest[m].assign( no_batch, FLT_MAX );
+
+			t_kernel[m] = Measure( [&]() {
+#pragma omp parallel for schedule( dynamic, 256 )
+				for ( int r = 0; r < no_batch; ++r )
+				{
+					Ray ray = rays[r];
+					float t, u, v;
+
+					if ( m == 2 )
+					{
+						const WatertightRay sheared( ray );
+
+						for ( const TriangleBlock & block : blocks )
+						{
+							if ( IntersectBlock( block, sheared, 0, kTriangleBlockWidth, ray.t_min, ray.t_max, t, u, v ) >= 0 ) ray.t_max = t;
+						}
+					}
+					else
+					{
+						for ( int i = 0; i < no_triangles; ++i )
+						{
+							const bool hit = ( m == 0 ) ? Triangle::Intersect( vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2], ray, t, u, v ) :
+								Triangle::IntersectWatertight( vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2], ray, t, u, v );
+
+							if ( hit ) ray.t_max = t;
+						}
+					}
+
+					closest[m][r] = ray.t_max;
+				} } );
+		}
+
+		int disagreements = 0;
+
+		for ( int r = 0; r < no_batch; ++r )
+		{
+			if ( fabsf( closest[0][r] - closest[2][r] ) > 1e-4f * max( 1.0f, closest[0][r] ) ) ++disagreements;
+		}
+
+		const char * names[3] = { "Moller-Trumbore", "watertight", "watertight block" };
+		printf( "\n%d rays x %d triangles\n", no_batch, no_triangles );
+
+		for ( int m = 0; m < 3; ++m )
+		{
+			printf( "%-24s %8s %10.1f M tests/s\n", names[m], TimeToString( t_kernel[m] ).c_str(), no_tests / t_kernel[m] * 1e-6 );
+		}
+
+		printf( "%d of %d closest hits differ between Moller-Trumbore and the blocks\n\n", disagreements, no_batch );
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/* runs all filters and wrap modes over the coordinates, scalar and batched sampling must agree */
+template<class T, FREE_IMAGE_TYPE F>
+static void SampleTexture( const char * name, Texture<T, F> & texture, const std::vector<float> & u,
+	const std::vector<float> & v )
+{
+	const int n = static_cast<int>( u.size() );
+	const int kBatch = 256;
+	const char * filters[] = { "nearest", "bilinear" };
+	const char * wraps[] = { "repeat", "clamp", "mirror" };
+	std::vector<T> scalar( n ), batched( n );
+
+	for ( int f = 0; f < 2; ++f )
+	{
+		for ( int w = 0; w < 3; ++w )
+		{
+			texture.set_filter( static_cast<TextureFilter>( f ) );
+			texture.set_wrap( static_cast<TextureWrap>( w ) );
+
+			const double t_scalar = Measure( [&]() {
+#pragma omp parallel for schedule( static, 4096 )
+				for ( int i = 0; i < n; ++i )
+				{
+					scalar[i] = texture.texel( u[i], v[i] );
+				} } );
+
+			const double t_batched = Measure( [&]() {
+#pragma omp parallel for schedule( static, 16 )
+				for ( int first = 0; first < n; first += kBatch )
+				{
+					texture.texel( &u[first], &v[first], min( kBatch, n - first ), &batched[first] );
+				} } );
+
+			int differ = 0;
+			double checksum = 0.0;
+
+			for ( int i = 0; i < n; ++i )
+			{
+				if ( scalar[i].data != batched[i].data ) ++differ;
+				checksum += double( scalar[i].data[0] );
+			}
+
+			printf( "%-10s %-10s %-8s %10.1f %10.1f %8d %12.1f\n", name, filters[f], wraps[w], n / t_scalar * 1e-6,
+				n / t_batched * 1e-6, differ, checksum / n );
+		}
+	}
+}
+
+int benchmark_texture_sampling( const int size, const int no_samples )
+{
+	Pcg32 rng( 37 );
+
+	// smooth content with some noise, the same values in both textures
+	Texture3u texture_u( size, size );
+	Texture3f texture_f( size, size );
+
+	for ( int y = 0; y < size; ++y )
+	{
+		for ( int x = 0; x < size; ++x )
+		{
+			const size_t i = size_t( x ) + size_t( y ) * size_t( size );
+
+			for ( int c = 0; c < 3; ++c )
+			{
+				const float value = 0.5f + 0.4f * sinf( 0.05f * ( x + 2 * c ) ) * cosf( 0.03f * y ) + 0.1f * ( rng.NextFloat() - 0.5f );
+				texture_u.data()[i].data[c] = static_cast<unsigned char>( min( 255.0f, max( 0.0f, value * 255.0f + 0.5f ) ) );
+				texture_f.data()[i].data[c] = texture_u.data()[i].data[c] / 255.0f;
+			}
+		}
+	}
+
+	// coordinates of the hits of nearby rays are coherent, a random walk over the texture spanning several tiles
+	std::vector<float> u( no_samples ), v( no_samples );
+	float walk_u = 0.5f, walk_v = 0.5f;
+
+	for ( int i = 0; i < no_samples; ++i )
+	{
+		walk_u += 2.0f * ( rng.NextFloat() - 0.5f ) / size;
+		walk_v += 2.0f * ( rng.NextFloat() - 0.5f ) / size;
+		if ( i % 1024 == 0 ) { walk_u = 4.0f * rng.NextFloat() - 2.0f; walk_v = 4.0f * rng.NextFloat() - 2.0f; }
+		u[i] = walk_u;
+		v[i] = walk_v;
+	}
+
+	printf( "Texture sampling, %d x %d px, %d samples\n\n", size, size, no_samples );
+	printf( "%-10s %-10s %-8s %10s %10s %8s %12s\n", "texture", "filter", "wrap", "scalar", "batched", "differ", "mean" );
+	printf( "%-10s %-10s %-8s %10s %10s\n", "", "", "", "M/s", "M/s" );
+
+	SampleTexture( "Texture3u", texture_u, u, v );
+	SampleTexture( "Texture3f", texture_f, u, v );
+
+	// the fixed-point filter against the float one on the same texels
+	texture_u.set_filter( TextureFilter::BILINEAR );
+	texture_f.set_filter( TextureFilter::BILINEAR );
+	float max_error = 0.0f;
+
+	for ( int i = 0; i < no_samples; ++i )
+	{
+		const Color3u a = texture_u.texel( u[i], v[i] );
+		const Color3f b = texture_f.texel( u[i], v[i] );
+
+		for ( int c = 0; c < 3; ++c )
+		{
+			max_error = max( max_error, fabsf( a.data[c] - b.data[c] * 255.0f ) );
+		}
+	}
+
+	printf( "\nmax. difference of the fixed-point and float bilinear filters %0.2f / 255\n\n", max_error );
+
+	return EXIT_SUCCESS;
+}
+
+int benchmark_texture_lod( const int texture_size, const int width, const int height, const int reference_spp )
+{
+	printf( "Texture LOD, %d x %d px texture on a floor, %d x %d px\n\n", texture_size, texture_size, width, height );
+
+	// checkerboard of 2 x 2 texel squares with noise, the worst case for aliasing
+	Texture3u texture( texture_size, texture_size );
+	texture.set_filter( TextureFilter::BILINEAR );
+	Pcg32 rng( 41 );
+
+	for ( int y = 0; y < texture_size; ++y )
+	{
+		for ( int x = 0; x < texture_size; ++x )
+		{
+			const float value = ( ( ( x / 2 ) + ( y / 2 ) ) % 2 ) ? 0.9f : 0.1f;
+
+			for ( int c = 0; c < 3; ++c )
+			{
+				texture.data()[size_t( x ) + size_t( y ) * size_t( texture_size )].data[c] =
+					static_cast<unsigned char>( 255.0f * min( 1.0f, max( 0.0f, value + 0.1f * ( rng.NextFloat() - 0.5f ) ) ) );
+			}
+		}
+	}
+
+	const double t_mipmaps = Measure( [&]() { texture.BuildMipmaps(); } );
+	printf( "%d levels built in %s\n\n", texture.no_levels(), TimeToString( t_mipmaps ).c_str() );
+
+	// a 1 km floor with the texture repeated 200 times, the camera looks over it towards the horizon
+	const float size = 1000.0f;
+	const float repeats = 200.0f;
+	const Vector3 corners[4] = { Vector3( -size, -size, 0 ), Vector3( size, -size, 0 ), Vector3( size, size, 0 ), Vector3( -size, size, 0 ) };
+	Coord2f tex_coords[4] = { { 0, 0 }, { repeats, 0 }, { repeats, repeats }, { 0, repeats } };
+	const int order[6] = { 0, 1, 2, 0, 2, 3 };
+	std::vector<Vertex> vertices;
+
+	for ( int i = 0; i < 6; ++i )
+	{
+		vertices.push_back( Vertex( corners[order[i]], Vector3( 0, 0, 1 ), Vector3( 0.5f, 0.5f, 0.5f ), &tex_coords[order[i]] ) );
+	}
+
+	std::vector<Material *> materials;
+	std::string name = "floor";
+	materials.push_back( new Material( name, Color3f(), Color3f( { 0.7f, 0.7f, 0.7f } ), Color3f(), Color3f(),
+		0.0f, 1.0f, 1.5f, Shader::LAMBERT ) );
+
+	std::vector<Surface *> surfaces;
+	surfaces.push_back( BuildSurface( "floor", vertices ) );
+	surfaces.back()->set_material( materials[0] );
+
+	const Scene scene( surfaces, materials );
+	const Camera camera( width, height, deg2rad( 60.0f ), Vector3( 0, 0, 2.0f ), Vector3( 100.0f, 70.0f, 0 ) );
+
+	// texture coordinates and their derivatives at the pixel centres, misses are marked by a negative lod
+	const int no_pixels = width * height;
+	std::vector<Coord2f> tex_coords_px( no_pixels );
+	std::vector<float> lods( no_pixels, -1.0f );
+
+#pragma omp parallel for schedule( dynamic, 16 )
+	for ( int pixel = 0; pixel < no_pixels; ++pixel )
+	{
+		Ray ray = camera.GenerateRay( pixel % width + 0.5f, pixel / width + 0.5f );
+		RayHit hit;
+		scene.Intersect( ray, hit );
+
+		if ( !hit.is_valid() ) continue;
+
+		Vector3 position, shading_normal, geometric_normal, d_dx, d_dy;
+		Coord2f duv_dx, duv_dy;
+		scene.Interpolate( hit, position, shading_normal, geometric_normal, tex_coords_px[pixel] );
+		camera.RayDifferentials( ray.direction, d_dx, d_dy );
+		scene.TexCoordDifferentials( hit, ray, d_dx, d_dy, duv_dx, duv_dy );
+		lods[pixel] = max( 0.0f, texture.lod( duv_dx.u, duv_dx.v, duv_dy.u, duv_dy.v ) );
+	}
+
+	// box filtered reference from the finest level, reference_spp^2 stratified samples per pixel
+	Texture3f reference( width, height );
+
+#pragma omp parallel for schedule( dynamic, 16 )
+	for ( int pixel = 0; pixel < no_pixels; ++pixel )
+	{
+		Color3f sum;
+
+		for ( int s = 0; s < reference_spp * reference_spp; ++s )
+		{
+			Ray ray = camera.GenerateRay( pixel % width + ( s % reference_spp + 0.5f ) / reference_spp,
+				pixel / width + ( s / reference_spp + 0.5f ) / reference_spp );
+			RayHit hit;
+			scene.Intersect( ray, hit );
+
+			if ( !hit.is_valid() ) continue;
+
+			Vector3 position, shading_normal, geometric_normal;
+			Coord2f tex_coord;
+			scene.Interpolate( hit, position, shading_normal, geometric_normal, tex_coord );
+			sum += Color3f( texture.texel( tex_coord.u, tex_coord.v ) );
+		}
+
+		reference.data()[pixel] = sum * ( 1.0f / ( reference_spp * reference_spp ) );
+	}
+
+	printf( "%-24s %10s %10s %10s %14s\n", "sampling", "time", "M/s", "RMSE", "mean level" );
+
+	const char * modes[] = { "bilinear, level 0", "trilinear, differentials" };
+	const int kRepeats = 8;
+
+	for ( int mode = 0; mode < 2; ++mode )
+	{
+		Texture3f image( width, height );
+		double checksum = 0.0;
+		double level_sum = 0.0;
+		int no_hits = 0;
+
+		const double t = Measure( [&]() {
+			for ( int r = 0; r < kRepeats; ++r )
+			{
+#pragma omp parallel for schedule( static, 256 )
+				for ( int pixel = 0; pixel < no_pixels; ++pixel )
+				{
+					if ( lods[pixel] < 0.0f ) continue;
+
+					const Coord2f & uv = tex_coords_px[pixel];
+					const Color3u value = ( mode == 0 ) ? texture.texel( uv.u, uv.v ) : texture.texel( uv.u, uv.v, lods[pixel] );
+					image.data()[pixel] = Color3f( value );
+				}
+			} } );
+
+		for ( int pixel = 0; pixel < no_pixels; ++pixel )
+		{
+			if ( lods[pixel] < 0.0f ) continue;
+
+			checksum += image.data()[pixel].data[0];
+			level_sum += ( mode == 0 ) ? 0.0f : min( lods[pixel], float( texture.no_levels() - 1 ) );
+			++no_hits;
+		}
+
+		printf( "%-24s %10s %10.1f %10.4f %14.2f\n", modes[mode], TimeToString( t / kRepeats ).c_str(),
+			double( no_hits ) * kRepeats / t * 1e-6, Rmse( image, reference ), level_sum / max( 1, no_hits ) );
+	}
+
+	printf( "\n" );
+
+	SafeDeleteVectorItems<Surface *>( surfaces );
+	SafeDeleteVectorItems<Material *>( materials );
+
+	return EXIT_SUCCESS;
+}
+
+/*! \class CacheModel
+\brief Set associative cache with LRU replacement counting the misses of a stream of byte addresses.
+*/
+class CacheModel
+{
+public:
+	CacheModel( const int size, const int ways, const int line_size = 64 ) : ways_( ways ), line_size_( line_size )
+	{
+		no_sets_ = size / ( ways * line_size );
+		tags_.assign( size_t( no_sets_ ) * ways, ~size_t( 0 ) );
+		stamps_.assign( tags_.size(), 0 );
+	}
+
+	/* true on a hit */
+	bool Access( const size_t address )
+	{
+		const size_t line = address / line_size_;
+		const size_t first = ( line % no_sets_ ) * ways_;
+		size_t victim = first;
+		++clock_;
+
+		for ( size_t i = first; i < first + ways_; ++i )
+		{
+			if ( tags_[i] == line )
+			{
+				stamps_[i] = clock_;
+
+				return true;
+			}
+
+			if ( stamps_[i] < stamps_[victim] ) victim = i;
+		}
+
+		tags_[victim] = line;
+		stamps_[victim] = clock_;
+		++misses_;
+
+		return false;
+	}
+
+	long long misses() const
+	{
+		return misses_;
+	}
+
+private:
+	int ways_;
+	int line_size_;
+	int no_sets_;
+	std::vector<size_t> tags_;
+	std::vector<long long> stamps_;
+	long long clock_{ 0 };
+	long long misses_{ 0 };
+};
+
+template <class L>
+static void ProfileLayout( const char * name, const Texture3u & source, const std::vector<std::vector<Coord2f>> & patterns )
+{
+	Texture<Color3u, FIT_BITMAP, L> texture( source );
+	texture.set_filter( TextureFilter::BILINEAR );
+
+	for ( const std::vector<Coord2f> & pattern : patterns )
+	{
+		const int n = static_cast<int>( pattern.size() );
+
+		// 32 KB 8-way L1 and 1 MB 16-way L2, the texels spanning two lines touch both
+		CacheModel l1( 32 * 1024, 8 );
+		CacheModel l2( 1024 * 1024, 16 );
+		size_t taps[4];
+
+		for ( const Coord2f & uv : pattern )
+		{
+			texture.taps( uv.u, uv.v, 0, taps );
+
+			for ( const size_t tap : taps )
+			{
+				const size_t addresses[2] = { tap * sizeof( Color3u ), ( tap + 1 ) * sizeof( Color3u ) - 1 };
+
+				for ( int i = 0; i < ( ( addresses[0] / 64 != addresses[1] / 64 ) ? 2 : 1 ); ++i )
+				{
+					if ( !l1.Access( addresses[i] ) ) l2.Access( addresses[i] );
+				}
+			}
+		}
+
+		int checksum = 0;
+		const double t = Measure( [&]() {
+			for ( const Coord2f & uv : pattern )
+			{
+				checksum += texture.texel( uv.u, uv.v ).data[0];
+			} } );
+
+		printf( "%-12s %10.3f %10.3f %10.1f %10d\n", name, double( l1.misses() ) / n, double( l2.misses() ) / n,
+			n / t * 1e-6, checksum );
+		name = "";
+	}
+}
+
+int benchmark_texture_layouts( const int size, const int no_samples )
+{
+	Texture3u texture( size, size );
+	Pcg32 rng( 43 );
+
+	for ( int i = 0; i < size * size; ++i )
+	{
+		texture.data()[i] = Color3u( { static_cast<unsigned char>( rng.NextUInt() ), static_cast<unsigned char>( i ),
+			static_cast<unsigned char>( i >> 8 ) } );
+	}
+
+	// walks of a minified footprint, 1.5 texels per step, along the rows and along the columns, and random samples
+	std::vector<std::vector<Coord2f>> patterns( 3, std::vector<Coord2f>( no_samples ) );
+	const char * pattern_names[] = { "walk along u", "walk along v", "incoherent" };
+	const float step = 1.5f / size;
+	const int run = 256;
+
+	for ( int i = 0; i < no_samples; ++i )
+	{
+		const Coord2f start = { float( i / run ) * 0.618034f, float( i / run ) * 0.414214f };
+		patterns[0][i] = Coord2f{ start.u + ( i % run ) * step, start.v };
+		patterns[1][i] = Coord2f{ start.u, start.v + ( i % run ) * step };
+		patterns[2][i] = Coord2f{ rng.NextFloat(), rng.NextFloat() };
+	}
+
+	printf( "Texture layouts, %d x %d px Texture3u, %d bilinear samples per pattern\n\n", size, size, no_samples );
+	printf( "patterns: %s, %s, %s\n\n", pattern_names[0], pattern_names[1], pattern_names[2] );
+	printf( "%-12s %10s %10s %10s %10s\n", "layout", "L1 misses", "L2 misses", "M/s", "checksum" );
+	printf( "%-12s %10s %10s\n", "", "/sample", "/sample" );
+
+	ProfileLayout<LinearLayout>( "row-major", texture, patterns );
+	ProfileLayout<TiledLayout<4>>( "tiled 4x4", texture, patterns );
+	ProfileLayout<TiledLayout<8>>( "tiled 8x8", texture, patterns );
+	ProfileLayout<MortonLayout<8>>( "Morton 8x8", texture, patterns );
+
+	printf( "\n" );
+
+	return EXIT_SUCCESS;
+}
+
+/* procedural 8-bit texture standing in for an image file, different for every seed */
+static Texture3u * GenerateTexture( const int size, const int seed )
+{
+	Texture3u * texture = new Texture3u( size, size );
+
+#pragma omp parallel for
+	for ( int y = 0; y < size; ++y )
+	{
+		for ( int x = 0; x < size; ++x )
+		{
+			const unsigned int h = ( unsigned( x ) * 73856093u ) ^ ( unsigned( y ) * 19349663u ) ^ ( unsigned( seed ) * 83492791u );
+			texture->data()[texture->index( x, y )] = Color3u( { static_cast<unsigned char>( ( x >> 3 ) ^ ( y >> 3 ) ^ seed ),
+				static_cast<unsigned char>( h >> 13 ), static_cast<unsigned char>( ( x + y ) >> 4 ) } );
+		}
+	}
+
+	texture->set_filter( TextureFilter::BILINEAR );
+	texture->BuildMipmaps();
+
+	return texture;
+}
+
+int benchmark_texture_cache( const int no_textures, const int size, const int no_samples )
+{
+	assert( no_textures >= 2 );
+
+	// the last texture is registered but never sampled and so never opened
+	std::vector<Texture3u *> textures( no_textures );
+	size_t full_bytes = 0;
+
+	for ( int i = 0; i < no_textures; ++i )
+	{
+		textures[i] = GenerateTexture( size, i );
+		const int tiles = ( size + TextureCache::kTileSize - 1 ) / TextureCache::kTileSize;
+		full_bytes += size_t( tiles ) * tiles * TextureCache::kTileSize * TextureCache::kTileSize * sizeof( Color3u ) * 4 / 3;
+	}
+
+	// runs of 64 coherent samples at a random level of detail (mostly the fine ones) in one of the textures
+	const int run = 64;
+	const int no_runs = no_samples / run;
+	struct Lookup { int texture; float u, v, lod; };
+	std::vector<Lookup> lookups( size_t( no_runs ) * run );
+	Pcg32 rng( 44 );
+
+	for ( int r = 0; r < no_runs; ++r )
+	{
+		const int texture = static_cast<int>( rng.NextUInt() % unsigned( no_textures - 1 ) );
+		const float lod = 6.0f * sqr( rng.NextFloat() );
+		const float u = rng.NextFloat();
+		const float v = rng.NextFloat();
+		const float step = exp2f( lod ) / size;
+
+		for ( int i = 0; i < run; ++i )
+		{
+			lookups[size_t( r ) * run + i] = Lookup{ texture, u + i * step, v + 0.3f * i * step, lod };
+		}
+	}
+
+	const int n = static_cast<int>( lookups.size() );
+	std::vector<Color3u> reference( n ), values( n );
+
+	const double t_in_core = Measure( [&]() {
+#pragma omp parallel for schedule( dynamic, 64 )
+		for ( int i = 0; i < n; ++i )
+		{
+			reference[i] = textures[lookups[i].texture]->texel( lookups[i].u, lookups[i].v, lookups[i].lod );
+		} } );
+
+	printf( "Texture cache, %d textures of %d x %d px (%0.1f MB with mips, %d sampled), %d trilinear samples, %d threads\n\n",
+		no_textures, size, size, full_bytes / ( 1024.0f * 1024.0f ), no_textures - 1, n, omp_get_max_threads() );
+	printf( "%-12s %10s %10s %10s %10s %10s %10s %10s\n", "budget", "hit rate", "resident", "peak", "read", "cold", "warm", "differ" );
+	printf( "%-12s %10s %10s %10s %10s %10s %10s\n", "(MB)", "(%)", "(MB)", "(MB)", "(MB)", "(M/s)", "(M/s)" );
+	printf( "%-12s %10s %10.1f %10.1f %10s %10s %10.1f\n", "in core", "-", full_bytes / ( 1024.0f * 1024.0f ),
+		full_bytes / ( 1024.0f * 1024.0f ), "-", "-", n / t_in_core * 1e-6 );
+
+	for ( const int fraction : { 64, 16, 4, 1 } )
+	{
+		const size_t budget = full_bytes / fraction;
+		TextureCache cache( budget );
+
+		for ( int i = 0; i < no_textures; ++i )
+		{
+			cache.Register( "generated_" + std::to_string( i ), [&, i]( const std::string & ) { return GenerateTexture( size, i ); } );
+		}
+
+		int differ = 0;
+		double t[2];
+
+		// the cold pass opens the textures and fills the cache, the warm one runs in the steady state
+		for ( int pass = 0; pass < 2; ++pass )
+		{
+			t[pass] = Measure( [&]() {
+#pragma omp parallel for schedule( dynamic, 64 )
+				for ( int i = 0; i < n; ++i )
+				{
+					cache.texel( lookups[i].texture, lookups[i].u, lookups[i].v, lookups[i].lod, values[i] );
+				} } );
+		}
+
+		for ( int i = 0; i < n; ++i )
+		{
+			if ( memcmp( &values[i], &reference[i], sizeof( Color3u ) ) != 0 ) ++differ;
+		}
+
+		const TextureCacheStatistics statistics = cache.statistics();
+		char name[32];
+		sprintf( name, "%0.1f", budget / ( 1024.0f * 1024.0f ) );
+
+		printf( "%-12s %10.2f %10.1f %10.1f %10.1f %10.2f %10.2f %10d\n", name, 100.0f * statistics.hit_rate(),
+			statistics.resident_bytes / ( 1024.0f * 1024.0f ), statistics.peak_resident_bytes / ( 1024.0f * 1024.0f ),
+			statistics.bytes_read / ( 1024.0f * 1024.0f ), n / t[0] * 1e-6, n / t[1] * 1e-6, differ );
+
+		if ( fraction == 1 ) cache.Print();
+	}
+
+	printf( "\n" );
+
+	SafeDeleteVectorItems( textures );
+
+	return EXIT_SUCCESS;
+}
+
+/* 8-bit display value of a linear HDR value, Reinhard tone mapping and sRGB */
+static int DisplayValue( const float c )
+{
+	return int( Color3f::c_srgb( c / ( 1.0f + c ) ) * 255.0f + 0.5f );
+}
+
+template <class T, FREE_IMAGE_TYPE F>
+static void ProfileHdrFormat( const char * name, const Texture3f & reference, const std::vector<float> & u,
+	const std::vector<float> & v )
+{
+	Texture<T, F> texture( 1, 1 );
+	const double t_encode = Measure( [&]() { texture = Texture<T, F>( reference ); } );
+	texture.set_filter( TextureFilter::BILINEAR );
+
+	// errors relative to the largest channel of the texel, the shared exponent formats cannot do better
+	double sum_error = 0.0;
+	float max_error = 0.0f;
+	int max_display_error = 0;
+
+	for ( int y = 0; y < reference.height(); ++y )
+	{
+		for ( int x = 0; x < reference.width(); ++x )
+		{
+			const Color3f a = reference.pixel( x, y );
+			const Color3f b = TexelFormat<T>::Decode( texture.pixel( x, y ) );
+			const float scale = a.max_value();
+
+			for ( int i = 0; i < 3; ++i )
+			{
+				const float error = fabsf( a.data[i] - b.data[i] ) / scale;
+				sum_error += error;
+				max_error = max( max_error, error );
+				max_display_error = max( max_display_error, abs( DisplayValue( a.data[i] ) - DisplayValue( b.data[i] ) ) );
+			}
+		}
+	}
+
+	const int n = static_cast<int>( u.size() );
+	std::vector<Color3f> values( n );
+
+	const double t_sample = Measure( [&]() {
+#pragma omp parallel for schedule( static, 4096 )
+		for ( int i = 0; i < n; ++i )
+		{
+			values[i] = texture.texel( u[i], v[i] );
+		} } );
+
+	double checksum = 0.0;
+	for ( const Color3f & value : values ) checksum += value.data[0] + value.data[1] + value.data[2];
+
+	printf( "%-10s %8d %10.1f %10.2e %10.2e %10d %10.1f %10.1f %14.1f\n", name, int( sizeof( T ) ),
+		reference.width() * reference.height() * sizeof( T ) / ( 1024.0f * 1024.0f ),
+		sum_error / ( 3.0 * reference.width() * reference.height() ), max_error, max_display_error, t_encode * 1e3,
+		n / t_sample * 1e-6, checksum / n );
+}
+
+int benchmark_hdr_textures( const int size, const int no_samples )
+{
+	// a sky of smooth noise over five orders of magnitude with a sun of 50000 and dark patches near 1e-3
+	Texture3f sky( size, size );
+
+#pragma omp parallel for
+	for ( int y = 0; y < size; ++y )
+	{
+		for ( int x = 0; x < size; ++x )
+		{
+			const float s = x * 2.0f * float( M_PI ) / size;
+			const float t = y * 2.0f * float( M_PI ) / size;
+			const float noise = 0.5f + 0.25f * sinf( 3.0f * s + cosf( 2.0f * t ) ) + 0.25f * sinf( 7.0f * t + 2.0f * cosf( 5.0f * s ) );
+			const float luminance = exp2f( 16.0f * noise - 10.0f );
+			const float sun = ( sqr( x - size * 0.7f ) + sqr( y - size * 0.3f ) < sqr( size * 0.01f ) ) ? 50000.0f : 0.0f;
+
+			sky.data()[sky.index( x, y )] = Color3f( { luminance * ( 0.6f + 0.4f * noise ) + sun,
+				luminance * 0.8f + sun, luminance * ( 1.0f - 0.5f * noise ) + 0.9f * sun } );
+		}
+	}
+
+	Pcg32 rng( 45 );
+	std::vector<float> u( no_samples ), v( no_samples );
+
+	for ( int i = 0; i < no_samples; ++i )
+	{
+		u[i] = rng.NextFloat();
+		v[i] = rng.NextFloat();
+	}
+
+	printf( "HDR texel formats, %d x %d px sky <%0.1e, %0.1e>, %d bilinear samples\n\n", size, size, 1e-3, 5e4, no_samples );
+	printf( "%-10s %8s %10s %10s %10s %10s %10s %10s %14s\n", "format", "bytes", "MB", "mean rel.", "max rel.",
+		"display", "encode", "M/s", "mean value" );
+	printf( "%-10s %8s %10s %10s %10s %10s %10s\n", "", "/texel", "", "error", "error", "error", "(ms)" );
+
+	ProfileHdrFormat<Color3f, FIT_RGBF>( "float", sky, u, v );
+	ProfileHdrFormat<Color3h, FIT_RGBF>( "half", sky, u, v );
+	ProfileHdrFormat<Rgb9e5, FIT_RGBF>( "RGB9E5", sky, u, v );
+	ProfileHdrFormat<Rgbe, FIT_RGBF>( "RGBE", sky, u, v );
+
+	printf( "\ndisplay error: the largest difference of 8-bit sRGB values after Reinhard tone mapping\n" );
+
+	// values beyond the range of RGBE saturate instead of wrapping the exponent to black
+	const float huge_values[] = { 1e30f, ldexpf( 1.0f, 127 ), FLT_MAX, INFINITY };
+	int no_wrapped = 0;
+
+	for ( const float huge : huge_values )
+	{
+		const Color3f decoded = TexelFormat<Rgbe>::Decode( TexelFormat<Rgbe>::Encode( Color3f( { huge, 1.0f, 0.0f } ) ) );
+
+		if ( !( decoded.data[0] >= ( std::min )( huge, ldexpf( 255.0f / 256.0f, 127 ) ) * 0.99f ) ||
+			!std::isfinite( decoded.data[0] ) ) ++no_wrapped;
+	}
+
+	printf( "RGBE saturation: %d of %d huge values decoded wrong\n\n", no_wrapped, int( sizeof( huge_values ) / sizeof( float ) ) );
+	assert( no_wrapped == 0 );
+
+	return EXIT_SUCCESS;
+}
+
+static double Psnr( const double mse )
+{
+	return ( mse > 0.0 ) ? 10.0 * log10( sqr( 255.0 ) / mse ) : INFINITY;
+}
+
+static void ProfileBlockFormat( const char * name, Texture3u & source, const BlockFormat format, const std::vector<float> & u,
+	const std::vector<float> & v )
+{
+	CompressedTexture * compressed = nullptr;
+	const double t_encode = Measure( [&]() { compressed = new CompressedTexture( source, format ); } );
+
+	// colour error over the channels the format keeps, the normal maps by the angle of the decoded normals
+	const int channels = ( format == BlockFormat::BC4 ) ? 1 : ( format == BlockFormat::BC5 ) ? 2 : 3;
+	double sum_error = 0.0;
+	double sum_angle = 0.0;
+	double max_angle = 0.0;
+
+	for ( int y = 0; y < source.height(); ++y )
+	{
+		for ( int x = 0; x < source.width(); ++x )
+		{
+			const Color3u a = source.pixel( x, y );
+			const Color3u b = compressed->pixel( x, y );
+
+			for ( int c = 0; c < channels; ++c ) sum_error += sqr( a.data[c] - b.data[c] );
+
+			if ( format == BlockFormat::BC5 )
+			{
+				Vector3 na( a.data[0] / 127.5f - 1.0f, a.data[1] / 127.5f - 1.0f, a.data[2] / 127.5f - 1.0f );
+				Vector3 nb( b.data[0] / 127.5f - 1.0f, b.data[1] / 127.5f - 1.0f, b.data[2] / 127.5f - 1.0f );
+				na.Normalize();
+				nb.Normalize();
+				const double angle = acos( min( 1.0f, na.DotProduct( nb ) ) ) * 180.0 / M_PI;
+				sum_angle += angle;
+				max_angle = max( max_angle, angle );
+			}
+		}
+	}
+
+	size_t uncompressed = 0;
+
+	for ( int level = 0; level < source.no_levels(); ++level )
+	{
+		uncompressed += size_t( max( 1, source.width() >> level ) ) * size_t( max( 1, source.height() >> level ) ) * sizeof( Color3u );
+	}
+
+	const int n = static_cast<int>( u.size() );
+	std::vector<Color3u> values( n );
+
+	const double t_sample = Measure( [&]() {
+#pragma omp parallel for schedule( static, 4096 )
+		for ( int i = 0; i < n; ++i )
+		{
+			values[i] = compressed->texel( u[i], v[i] );
+		} } );
+
+	double checksum = 0.0;
+	for ( const Color3u & value : values ) checksum += value.data[0];
+
+	// the blocks must survive the round trip through the cache file
+	const std::string file_name = std::string( "benchmark_" ) + name + ".bc";
+	const bool saved = compressed->Save( file_name ) && CompressedTexture( file_name ).blocks() == compressed->blocks();
+	remove( file_name.c_str() );
+
+	char angles[32] = "-";
+	if ( format == BlockFormat::BC5 ) sprintf( angles, "%0.2f / %0.2f", sum_angle / ( double( source.width() ) * source.height() ), max_angle );
+
+	printf( "%-10s %8.2f %8.1f %8.1f %14s %10.1f %10.1f %10.1f %6s\n", name, float( compressed->memory() ) / ( double( source.width() ) * source.height() * 4 / 3 ),
+		double( uncompressed ) / compressed->memory(), Psnr( sum_error / ( double( source.width() ) * source.height() * channels ) ),
+		angles, t_encode * 1e3, n / t_sample * 1e-6, checksum / n, ( saved ) ? "yes" : "no" );
+
+	SAFE_DELETE( compressed );
+}
+
+int benchmark_block_compression( const int size, const int no_samples )
+{
+	// a colour map with gradients, hard edges and grain, a roughness map and a normal map of a bumpy height field
+	Texture3u colour( size, size ), roughness( size, size ), normals( size, size );
+	Pcg32 rng( 46 );
+
+	for ( int y = 0; y < size; ++y )
+	{
+		for ( int x = 0; x < size; ++x )
+		{
+			const float s = float( x ) / size;
+			const float t = float( y ) / size;
+			const bool tile = ( ( x / 64 ) + ( y / 64 ) ) & 1;
+			const float grain = 12.0f * ( rng.NextFloat() - 0.5f );
+			const float r = ( tile ? 200.0f * s : 60.0f + 120.0f * t ) + grain;
+			const float g = ( tile ? 90.0f + 100.0f * t : 220.0f * s * t ) + grain;
+			const float b = ( tile ? 40.0f : 180.0f - 100.0f * s ) + grain;
+			colour.data()[colour.index( x, y )] = Color3u( { static_cast<unsigned char>( min( 255.0f, max( 0.0f, r ) ) ),
+				static_cast<unsigned char>( min( 255.0f, max( 0.0f, g ) ) ), static_cast<unsigned char>( min( 255.0f, max( 0.0f, b ) ) ) } );
+
+			const unsigned char rough = static_cast<unsigned char>( 128.0f + 100.0f * sinf( 40.0f * s ) * cosf( 25.0f * t ) + grain );
+			roughness.data()[roughness.index( x, y )] = Color3u( { rough, rough, rough } );
+
+			// gradient of the height h = 0.02 sin( 30 pi s ) sin( 20 pi t )
+			Vector3 n( -0.02f * 30.0f * float( M_PI ) * cosf( 30.0f * float( M_PI ) * s ) * sinf( 20.0f * float( M_PI ) * t ),
+				-0.02f * 20.0f * float( M_PI ) * sinf( 30.0f * float( M_PI ) * s ) * cosf( 20.0f * float( M_PI ) * t ), 1.0f );
+			n.Normalize();
+			normals.data()[normals.index( x, y )] = Color3u( { static_cast<unsigned char>( ( n.x * 0.5f + 0.5f ) * 255.0f + 0.5f ),
+				static_cast<unsigned char>( ( n.y * 0.5f + 0.5f ) * 255.0f + 0.5f ), static_cast<unsigned char>( ( n.z * 0.5f + 0.5f ) * 255.0f + 0.5f ) } );
+		}
+	}
+
+	colour.BuildMipmaps();
+	roughness.BuildMipmaps();
+	normals.BuildMipmaps();
+
+	std::vector<float> u( no_samples ), v( no_samples );
+
+	for ( int i = 0; i < no_samples; ++i )
+	{
+		u[i] = rng.NextFloat();
+		v[i] = rng.NextFloat();
+	}
+
+	colour.set_filter( TextureFilter::BILINEAR );
+	std::vector<Color3u> values( no_samples );
+	const double t_sample = Measure( [&]() {
+#pragma omp parallel for schedule( static, 4096 )
+		for ( int i = 0; i < no_samples; ++i )
+		{
+			values[i] = colour.texel( u[i], v[i] );
+		} } );
+
+	printf( "Block compression, %d x %d px maps with mips, %d bilinear samples, Texture3u %0.1f M/s\n\n", size, size,
+		no_samples, no_samples / t_sample * 1e-6 );
+	printf( "%-10s %8s %8s %8s %14s %10s %10s %10s %6s\n", "map", "bytes", "ratio", "PSNR", "angle (deg)", "encode", "M/s",
+		"mean", "file" );
+	printf( "%-10s %8s %8s %8s %14s %10s\n", "", "/texel", "", "(dB)", "mean / max", "(ms)" );
+
+	ProfileBlockFormat( "colour BC1", colour, BlockFormat::BC1, u, v );
+	ProfileBlockFormat( "colour BC7", colour, BlockFormat::BC7, u, v );
+	ProfileBlockFormat( "rough BC4", roughness, BlockFormat::BC4, u, v );
+	ProfileBlockFormat( "normal BC1", normals, BlockFormat::BC1, u, v );
+	ProfileBlockFormat( "normal BC5", normals, BlockFormat::BC5, u, v );
+
+	printf( "\n" );
+
+	return EXIT_SUCCESS;
+}
+
+/* the pixels of a bitmap converted by the former scalar per-pixel loops of Custom_FreeImage_ConvertToRGB(A)F */
+static void ScalarConversion( FIBITMAP * src, const int channels, std::vector<float> & values )
+{
+	const FREE_IMAGE_TYPE type = FreeImage_GetImageType( src );
+	const int width = int( FreeImage_GetWidth( src ) );
+	const int height = int( FreeImage_GetHeight( src ) );
+	const unsigned bytespp = FreeImage_GetLine( src ) / FreeImage_GetWidth( src );
+
+	values.resize( size_t( width ) * height * channels );
+	float * value = values.data();
+
+	for ( int y = 0; y < height; ++y )
+	{
+		const BYTE * row = FreeImage_GetBits( src ) + size_t( y ) * FreeImage_GetPitch( src );
+
+		for ( int x = 0; x < width; ++x, value += channels )
+		{
+			float rgba[4] = { 0.0F, 0.0F, 0.0F, 1.0F };
+			const WORD * words = ( const WORD * )row;
+			const float * floats = ( const float * )row;
+
+			switch ( type ) {
+			case FIT_BITMAP:
+				rgba[0] = ( float )( row[x * bytespp + FI_RGBA_RED] ) / 255.0F;
+				rgba[1] = ( float )( row[x * bytespp + FI_RGBA_GREEN] ) / 255.0F;
+				rgba[2] = ( float )( row[x * bytespp + FI_RGBA_BLUE] ) / 255.0F;
+				if ( bytespp == 4 ) rgba[3] = ( float )( row[x * bytespp + FI_RGBA_ALPHA] ) / 255.0F;
+				break;
+			case FIT_UINT16:
+				rgba[0] = rgba[1] = rgba[2] = ( float )words[x] / 65535.0F;
+				break;
+			case FIT_RGB16:
+			case FIT_RGBA16:
+				for ( int c = 0; c < ( ( type == FIT_RGB16 ) ? 3 : 4 ); ++c )
+				{
+					rgba[c] = ( float )( words[x * ( ( type == FIT_RGB16 ) ? 3 : 4 ) + c] ) / 65535.0F;
+				}
+				break;
+			case FIT_FLOAT:
+				rgba[0] = rgba[1] = rgba[2] = floats[x];
+				break;
+			case FIT_RGBF:
+			case FIT_RGBAF:
+				memcpy( rgba, floats + x * ( ( type == FIT_RGBF ) ? 3 : 4 ), ( ( type == FIT_RGBF ) ? 3 : 4 ) * sizeof( float ) );
+				break;
+			default:
+				break;
+			}
+
+			memcpy( value, rgba, channels * sizeof( float ) );
+		}
+	}
+}
+
+static void ProfileConversion( const char * name, const FREE_IMAGE_TYPE type, const int bpp, const int width,
+	const int height, Pcg32 & rng )
+{
+	FIBITMAP * src = FreeImage_AllocateT( type, width, height, bpp );
+
+	// random bytes, the float images get random values of <-1, 1000>
+	for ( int y = 0; y < height; ++y )
+	{
+		BYTE * row = FreeImage_GetBits( src ) + size_t( y ) * FreeImage_GetPitch( src );
+
+		if ( type == FIT_FLOAT || type == FIT_RGBF || type == FIT_RGBAF )
+		{
+			for ( unsigned i = 0; i < FreeImage_GetLine( src ) / sizeof( float ); ++i )
+			{
+				( ( float * )row )[i] = rng.NextFloat() * 1001.0f - 1.0f;
+			}
+		}
+		else
+		{
+			for ( unsigned i = 0; i < FreeImage_GetLine( src ); ++i ) row[i] = BYTE( rng.NextUInt() );
+		}
+	}
+
+	for ( int channels = 3; channels <= 4; ++channels )
+	{
+		// the float images of the same type are cloned
+		if ( ( channels == 3 && type == FIT_RGBF ) || ( channels == 4 && type == FIT_RGBAF ) ) continue;
+
+		std::vector<float> reference;
+		FIBITMAP * dst = nullptr;
+		const double t_scalar = Measure( [&]() { ScalarConversion( src, channels, reference ); } );
+		const double t_parallel = Measure( [&]() {
+			dst = ( channels == 3 ) ? Custom_FreeImage_ConvertToRGBF( src ) : Custom_FreeImage_ConvertToRGBAF( src ); } );
+
+		// the values must be identical
+		long long no_differences = 0;
+
+		for ( int y = 0; y < height; ++y )
+		{
+			const float * row = ( const float * )( FreeImage_GetBits( dst ) + size_t( y ) * FreeImage_GetPitch( dst ) );
+			const float * expected = reference.data() + size_t( y ) * width * channels;
+
+			for ( int i = 0; i < width * channels; ++i )
+			{
+				no_differences += ( memcmp( row + i, expected + i, sizeof( float ) ) != 0 );
+			}
+		}
+
+		printf( "%-8s %-6s %10.1f %10.1f %10.1f %8.2fx %12.0f\n", name, ( channels == 3 ) ? "RGBF" : "RGBAF",
+			t_scalar * 1e3, t_parallel * 1e3, width * double( height ) / t_parallel * 1e-6, t_scalar / t_parallel,
+			double( no_differences ) );
+
+		FreeImage_Unload( dst );
+	}
+
+	FreeImage_Unload( src );
+}
+
+template <class V>
+static void ProfileRange( const char * name, const std::vector<V> & rows )
+{
+	double expected[] = { ( std::numeric_limits<double>::max )( ), std::numeric_limits<double>::lowest() };
+	double range[2];
+
+	const double t_scalar = Measure( [&]() {
+		for ( const auto & pixel : rows )
+		{
+			expected[0] = ( std::min )( expected[0], double( pixel.min_value() ) );
+			expected[1] = ( std::max )( expected[1], double( pixel.max_value() ) );
+		}
+	} );
+	const double t_parallel = Measure( [&]() { ChannelRange( rows.front().data.data(), rows.size(), V::channels, range ); } );
+
+	printf( "%-8s %-6s %10.1f %10.1f %10.1f %8.2fx %12s\n", name, "range", t_scalar * 1e3, t_parallel * 1e3,
+		rows.size() / t_parallel * 1e-6, t_scalar / t_parallel,
+		( range[0] == expected[0] && range[1] == expected[1] ) ? "0" : "range" );
+}
+
+int benchmark_image_conversion( const int width, const int height )
+{
+	Pcg32 rng( 47 );
+
+	printf( "Conversion of %d x %d px bitmaps to floats, %d threads\n\n", width, height, omp_get_max_threads() );
+	printf( "%-8s %-6s %10s %10s %10s %9s %12s\n", "source", "target", "scalar", "parallel", "Mpx/s", "speedup", "differences" );
+	printf( "%-8s %-6s %10s %10s\n", "", "", "(ms)", "(ms)" );
+
+	ProfileConversion( "RGB8", FIT_BITMAP, 24, width, height, rng );
+	ProfileConversion( "RGBA8", FIT_BITMAP, 32, width, height, rng );
+	ProfileConversion( "UINT16", FIT_UINT16, 16, width, height, rng );
+	ProfileConversion( "RGB16", FIT_RGB16, 48, width, height, rng );
+	ProfileConversion( "RGBA16", FIT_RGBA16, 64, width, height, rng );
+	ProfileConversion( "FLOAT", FIT_FLOAT, 32, width, height, rng );
+	ProfileConversion( "RGBF", FIT_RGBF, 96, width, height, rng );
+	ProfileConversion( "RGBAF", FIT_RGBAF, 128, width, height, rng );
+
+	// the range scan of the loaded texels, the alpha values lie on both sides of the colour range
+	std::vector<Color3u> rows3u( size_t( width ) * height );
+	std::vector<Color4u> rows4u( rows3u.size() );
+	std::vector<Color3f> rows3f( rows3u.size() );
+	std::vector<Color4f> rows4f( rows3u.size() );
+
+	for ( size_t i = 0; i < rows3u.size(); ++i )
+	{
+		for ( int c = 0; c < 4; ++c )
+		{
+			const float value = rng.NextFloat();
+			if ( c < 3 ) rows3u[i].data[c] = static_cast<unsigned char>( 1 + value * 250.0f );
+			rows4u[i].data[c] = static_cast<unsigned char>( ( c < 3 ) ? 1 + value * 250.0f : 255.0f * value );
+			if ( c < 3 ) rows3f[i].data[c] = value * 100.0f - 1.0f;
+			rows4f[i].data[c] = ( c < 3 ) ? value * 100.0f - 1.0f : value * 200.0f - 50.0f;
+		}
+	}
+
+	printf( "\n" );
+	ProfileRange( "RGB8", rows3u );
+	ProfileRange( "RGBA8", rows4u );
+	ProfileRange( "RGBF", rows3f );
+	ProfileRange( "RGBAF", rows4f );
+
+	printf( "\nscalar: the former per-pixel loops of one thread, differences: values not bitwise identical to them\n\n" );
+
+	return EXIT_SUCCESS;
+}
+
+int benchmark_srgb( const int n, const int float_step )
+{
+	printf( "sRGB <-> linear conversions, %d values, %d threads\n\n", n, omp_get_max_threads() );
+
+	// the table against c_linear
+	int table_differences = 0;
+
+	for ( int i = 0; i < 256; ++i )
+	{
+		table_differences += ( SrgbToLinear( static_cast<unsigned char>( i ) ) != Color3f::c_linear( float( i ) * ( 1.0f / 255.0f ) ) );
+	}
+
+	// the fit against c_srgb rounded to the nearest value (the former Texture::FromLinear) and against the exact curve
+	long long no_values = 0;
+	long long no_differences = 0;
+	long long no_truncated_differences = 0;
+	double max_error = 0.0;
+
+	for ( unsigned int bits = 0; bits <= 0x3f800000u; bits += float_step )
+	{
+		float c;
+		memcpy( &c, &bits, sizeof( c ) );
+
+		const int value = LinearToSrgb( c );
+		const double exact = 255.0 * ( ( c <= 0.0031308 ) ? 12.92 * c : 1.055 * pow( double( c ), 1.0 / 2.4 ) - 0.055 );
+
+		no_differences += ( value != int( Color3f::c_srgb( c ) * 255.0f + 0.5f ) );
+		no_truncated_differences += ( value != int( Color3f::c_srgb( c ) * 255.0f ) );
+		max_error = max( max_error, fabs( value - exact ) );
+		++no_values;
+	}
+
+	printf( "table: %d of 256 values differ from c_linear\n", table_differences );
+	printf( "fit: %0.4f%% of %0.0f floats in <0, 1> differ from the rounded c_srgb (%0.2f%% from the truncated one of the "
+		"former cast), max. error %0.3f of a step\n\n", 100.0 * no_differences / no_values, double( no_values ),
+		100.0 * no_truncated_differences / no_values, max_error );
+
+	// throughput
+	Pcg32 rng( 48 );
+	std::vector<unsigned char> srgb( n );
+	std::vector<float> linear( n );
+
+	for ( int i = 0; i < n; ++i )
+	{
+		srgb[i] = static_cast<unsigned char>( rng.NextUInt() );
+		linear[i] = rng.NextFloat();
+	}
+
+	std::vector<float> decoded( n );
+	std::vector<unsigned char> encoded( n );
+	double t;
+
+	t = Measure( [&]() { for ( int i = 0; i < n; ++i ) decoded[i] = Color3f::c_linear( float( srgb[i] ) * ( 1.0f / 255.0f ) ); } );
+	PrintThroughput( "sRGB -> linear, powf", n, t, std::accumulate( decoded.begin(), decoded.end(), 0.0 ) );
+	t = Measure( [&]() { for ( int i = 0; i < n; ++i ) decoded[i] = SrgbToLinear( srgb[i] ); } );
+	PrintThroughput( "sRGB -> linear, table", n, t, std::accumulate( decoded.begin(), decoded.end(), 0.0 ) );
+	t = Measure( [&]() { SrgbToLinear( srgb.data(), decoded.data(), n ); } );
+	PrintThroughput( "sRGB -> linear, bulk", n, t, std::accumulate( decoded.begin(), decoded.end(), 0.0 ) );
+
+	t = Measure( [&]() { for ( int i = 0; i < n; ++i ) encoded[i] = static_cast<unsigned char>( Color3f::c_srgb( linear[i] ) * 255.0f + 0.5f ); } );
+	PrintThroughput( "linear -> sRGB, powf", n, t, std::accumulate( encoded.begin(), encoded.end(), 0.0 ) );
+	t = Measure( [&]() { for ( int i = 0; i < n; ++i ) encoded[i] = LinearToSrgb( linear[i] ); } );
+	PrintThroughput( "linear -> sRGB, fit", n, t, std::accumulate( encoded.begin(), encoded.end(), 0.0 ) );
+	t = Measure( [&]() { LinearToSrgb( linear.data(), encoded.data(), n ); } );
+	PrintThroughput( "linear -> sRGB, bulk", n, t, std::accumulate( encoded.begin(), encoded.end(), 0.0 ) );
+
+	// the casts of Color as done per texture lookup
+	std::vector<Color3u> colors( n / 3 );
+	memcpy( colors.data(), srgb.data(), colors.size() * sizeof( Color3u ) );
+	Color3f sum;
+	t = Measure( [&]() { for ( const Color3u & c : colors ) sum += Color3f( c ); } );
+	PrintThroughput( "Color3u -> Color3f cast", int( colors.size() ), t, sum.data[0] + sum.data[1] + sum.data[2] );
+
+	printf( "\n" );
+
+	return EXIT_SUCCESS;
+}
+
+int benchmark_linear_color_maps( const int size, const int no_samples )
+{
+	std::shared_ptr<Texture3u> texture( GenerateTexture( size, 49 ) );
+	Material material;
+	material.set_texture( Material::kDiffuseMapSlot, texture );
+	std::vector<Material *> materials{ &material };
+
+	// the pixels of a 2000 px wide image of a plane under the camera in the scanline order, the footprints grow
+	// from magnification near the camera to 1/16 of the texture size at the horizon, as the shading samples
+	// of a render would come
+	std::vector<Coord2f> tex_coords( no_samples ), duv_dxs( no_samples ), duv_dys( no_samples );
+	const int image_width = 2000;
+
+	for ( int i = 0; i < no_samples; ++i )
+	{
+		const float x = float( i % image_width ) / image_width - 0.5f;
+		const float y = float( i / image_width ) / ( no_samples / image_width );
+		const float footprint = exp2f( 5.0f * y - 1.0f ) / size;
+		tex_coords[i] = Coord2f{ x * footprint * image_width, y * y * 4.0f };
+		duv_dxs[i] = Coord2f{ footprint, 0.0f };
+		duv_dys[i] = Coord2f{ 0.0f, footprint };
+	}
+
+	printf( "Diffuse lookups of a %d x %d px colour map, %d samples, %d threads\n\n", size, size, no_samples,
+		omp_get_max_threads() );
+	printf( "%-10s %8s %10s %10s %12s %12s %12s %12s\n", "storage", "MB", "convert", "bilinear", "trilinear",
+		"speedup", "mean diff.", "max diff." );
+	printf( "%-10s %8s %10s %10s %12s %12s\n", "", "", "(ms)", "(M/s)", "(M/s)", "(trilinear)" );
+
+	std::vector<Color3f> reference;
+	double t_reference = 0.0;
+	const ColorMapStorage storages[] = { ColorMapStorage::SRGB8, ColorMapStorage::LINEAR16, ColorMapStorage::HALF,
+		ColorMapStorage::FLOAT };
+
+	for ( const ColorMapStorage storage : storages )
+	{
+		material.set_texture( Material::kDiffuseMapSlot, std::shared_ptr<const LinearTexture>() );
+		material.set_texture( Material::kDiffuseMapSlot, texture );
+		const double t_convert = Measure( [&]() { LinearizeColorMaps( materials, storage ); } );
+
+		std::vector<Color3f> values( no_samples );
+		const double t_bilinear = Measure( [&]() {
+#pragma omp parallel for
+			for ( int i = 0; i < no_samples; ++i ) values[i] = material.diffuse( &tex_coords[i] );
+		} );
+		const double t_trilinear = Measure( [&]() {
+#pragma omp parallel for
+			for ( int i = 0; i < no_samples; ++i ) values[i] = material.diffuse( &tex_coords[i], duv_dxs[i], duv_dys[i] );
+		} );
+
+		if ( storage == ColorMapStorage::SRGB8 )
+		{
+			reference = values;
+			t_reference = t_trilinear;
+		}
+
+		// the linear storages filter the linear values, the reference filters the sRGB ones
+		double sum_difference = 0.0;
+		double max_difference = 0.0;
+
+		for ( int i = 0; i < no_samples; ++i )
+		{
+			for ( int c = 0; c < 3; ++c )
+			{
+				const double difference = fabs( values[i].data[c] - reference[i].data[c] );
+				sum_difference += difference;
+				max_difference = max( max_difference, difference );
+			}
+		}
+
+		const LinearTexture * linear = material.linear_texture( Material::kDiffuseMapSlot );
+
+		printf( "%-10s %8.1f %10.1f %10.1f %12.1f %11.2fx %12.5f %12.5f\n", ToString( storage ),
+			( ( linear ) ? linear->memory() : texture->memory() ) / ( 1024.0f * 1024.0f ), t_convert * 1e3,
+			no_samples / t_bilinear * 1e-6, no_samples / t_trilinear * 1e-6, t_reference / t_trilinear,
+			sum_difference / ( 3.0 * no_samples ), max_difference );
+	}
+
+	const size_t no_texels = texture->memory() / sizeof( Color3u );
+	printf( "\nAUTO for budgets of 16, 8, 4 and 2 bytes per texel: %s, %s, %s, %s\n\n",
+		ToString( SelectColorMapStorage( no_texels, no_texels * 16 ) ), ToString( SelectColorMapStorage( no_texels, no_texels * 8 ) ),
+		ToString( SelectColorMapStorage( no_texels, no_texels * 4 ) ), ToString( SelectColorMapStorage( no_texels, no_texels * 2 ) ) );
+
+	return EXIT_SUCCESS;
+}
+
+int benchmark_texture_library( const int no_images, const int no_copies, const int size, const int no_materials )
+{
+	// every image is exported under no_copies file names, a file is decoded by generating its image
+	std::vector<std::string> file_names;
+
+	for ( int i = 0; i < no_images; ++i )
+	{
+		for ( int j = 0; j < no_copies; ++j ) file_names.push_back( "image_" + std::to_string( i ) + "_copy_" + std::to_string( j ) + ".png" );
+	}
+
+	const TextureLoader loader = [size]( const std::string & file_name ) {
+		return GenerateTexture( size, atoi( file_name.c_str() + 6 ) );
+	};
+
+	// the former loading, one texture per file name
+	std::vector<std::shared_ptr<Texture3u>> by_name( file_names.size() );
+	const double t_by_name = Measure( [&]() {
+		for ( size_t i = 0; i < file_names.size(); ++i ) by_name[i].reset( loader( file_names[i] ) );
+	} );
+	size_t by_name_bytes = 0;
+	for ( const auto & texture : by_name ) by_name_bytes += texture->memory();
+	by_name.clear();
+
+	std::vector<Material *> materials( no_materials );
+	std::vector<std::weak_ptr<Texture3u>> loaded;
+	Pcg32 rng( 50 );
+	double t_library = 0.0;
+
+	{
+		TextureLibrary library( loader );
+
+		t_library = Measure( [&]() {
+			for ( const std::string & file_name : file_names ) loaded.push_back( library.Load( file_name ) );
+		} );
+
+		for ( Material *& material : materials )
+		{
+			material = new Material();
+			material->set_texture( Material::kDiffuseMapSlot, library.Load( file_names[rng.NextUInt() % file_names.size()] ) );
+			material->set_texture( Material::kSpecularMapSlot, library.Load( file_names[rng.NextUInt() % file_names.size()] ) );
+		}
+
+		printf( "%d images under %d file names, %d x %d px, %d materials\n\n", no_images, int( file_names.size() ),
+			size, size, no_materials );
+		library.Print();
+		printf( "Memory by file name %0.1f MB, shared %0.1f MB\n", by_name_bytes / ( 1024.0f * 1024.0f ),
+			( by_name_bytes - library.bytes_saved() ) / ( 1024.0f * 1024.0f ) );
+		printf( "Loading by file name %s, shared %s (hashing and comparing included)\n\n", TimeToString( t_by_name ).c_str(),
+			TimeToString( t_library ).c_str() );
+	}
+
+	// the materials own the textures now, deleting some of them must leave the textures of the others intact
+	const Coord2f tex_coord{ 0.3f, 0.7f };
+	std::vector<Color3f> expected( no_materials );
+	for ( int i = 0; i < no_materials; ++i ) expected[i] = materials[i]->diffuse( &tex_coord );
+
+	for ( int i = 0; i < no_materials; i += 2 ) SAFE_DELETE( materials[i] );
+
+	int no_changed = 0;
+	for ( int i = 1; i < no_materials; i += 2 )
+	{
+		const Color3f value = materials[i]->diffuse( &tex_coord );
+		no_changed += ( memcmp( &value, &expected[i], sizeof( value ) ) != 0 );
+	}
+
+	for ( Material *& material : materials ) SAFE_DELETE( material );
+
+	int no_alive = 0;
+	for ( const auto & texture : loaded ) no_alive += !texture.expired();
+
+	printf( "Half of the materials deleted: %d lookups of the others changed\n", no_changed );
+	printf( "All materials deleted: %d of %d file textures still in memory\n\n", no_alive, int( loaded.size() ) );
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+#ifndef BENCHMARKS_H_
+#define BENCHMARKS_H_
+
+/* compare the per-thread generators against the former global mt19937 and check reproducibility */
+int benchmark_random( const int n = 10000000 );
+
+/* RMSE vs. samples per pixel of the low-discrepancy samplers and Random() on an analytic reference scene */
+int benchmark_samplers( const int width = 64, const int height = 64, const int max_spp = 256 );
+
+/* equal-time RMSE of next event estimation with uniform, power and light tree selection among many emitters */
+int benchmark_lights( const int no_lights = 4096, const double seconds = 4.0 );
+
+/* irradiance error of cosine, environment map importance and MIS sampling of an HDR sky with a small sun */
+int benchmark_environment( const int width = 1024, const int height = 512, const int max_spp = 256 );
+
+/* RMSE of noisy and denoised renders of a Cornell box vs. a reference and the denoiser speed on a Full HD image */
+int benchmark_denoiser( const int width = 128, const int height = 128, const int reference_spp = 1024 );
+
+/* RMSE vs. render time of a Cornell box with and without the hash-grid radiance cache */
+int benchmark_radiance_cache( const int width = 128, const int height = 128, const int reference_spp = 1024 );
+
+/* photon emission, kd-tree build and query speed, RMSE of a Cornell box with a glass cube with and without caustic photons */
+int benchmark_photon_map( const int width = 128, const int height = 128, const int reference_spp = 1024,
+	const int no_photons = 1 << 20 );
+
+/* build time, memory and primary ray throughput of a forest of instanced trees, instanced vs. flattened copies */
+int benchmark_instancing( const int no_instances = 100000, const int width = 512, const int height = 512 );
+
+/* detection of rigidly transformed copies of chairs exported as separate surfaces, memory saved and hit agreement */
+int benchmark_instance_detection( const int no_copies = 500, const int width = 256, const int height = 256 );
+
+/* refit vs. rebuild of a deforming grid and of a forest of moving, added and removed instances, SAH and Mrays/s */
+int benchmark_dynamic( const int grid_size = 256, const int no_instances = 10000, const int width = 256,
+	const int height = 256 );
+
+/* memory per triangle and primary and shadow ray throughput of a flattened forest, float vs. quantized BVH nodes */
+int benchmark_compressed_bvh( const int no_trees = 4096, const int width = 512, const int height = 512 );
+
+/* SAH cost, references and ray throughput of a room with long thin diagonal beams, object vs. spatial splits */
+int benchmark_spatial_splits( const int no_beams = 2000, const int width = 512, const int height = 512 );
+
+/* SAH cost and ray throughput of the binned SAH and Morton BVHs of a flattened forest before and after Bvh::Optimize */
+int benchmark_treelets( const int no_trees = 1024, const int width = 512, const int height = 512 );
+
+/* leaks through the shared edges and vertices of a closed mesh and throughput of the scalar Moller-Trumbore,
+scalar watertight and SIMD block ray-triangle tests */
+int benchmark_triangle_kernels( const int no_rays = 1000000, const int no_triangles = 256 );
+
+/* samples per second of Texture3u and Texture3f with both filters and all wrap modes, scalar and batched */
+int benchmark_texture_sampling( const int size = 1024, const int no_samples = 4000000 );
+
+/* aliasing (RMSE against a supersampled reference) and sampling time of a heavily minified floor texture with and
+without the mip chain selected by the ray differentials of the camera */
+int benchmark_texture_lod( const int texture_size = 4096, const int width = 1024, const int height = 512,
+	const int reference_spp = 4 );
+
+/* simulated L1/L2 misses and sampling rate of bilinear lookups into a texture stored in the row-major, tiled and
+Morton layouts, for coherent walks along both axes and for incoherent samples */
+int benchmark_texture_layouts( const int size = 4096, const int no_samples = 2000000 );
+
+/* hit rate, resident memory and sampling rate of textures paged through a TextureCache under budgets from 1/64 of
+their size up to all of it, compared with the same textures kept in memory */
+int benchmark_texture_cache( const int no_textures = 8, const int size = 2048, const int no_samples = 4000000 );
+
+/* memory, encoding errors and bilinear sampling rate of an HDR sky stored in floats, half floats, RGB9E5 and RGBE */
+int benchmark_hdr_textures( const int size = 2048, const int no_samples = 4000000 );
+
+/* memory, quality (PSNR, angular error of normals), encoding time and sampling rate of colour, roughness and
+normal maps in the BC1, BC4, BC5 and BC7 block formats */
+int benchmark_block_compression( const int size = 1024, const int no_samples = 4000000 );
+
+/* time of the row-parallel SSE/AVX conversions of 8-bit, 16-bit and float bitmaps to RGBF and RGBAF and of the
+parallel range scan of the loaded texels, compared with the former scalar loops */
+int benchmark_image_conversion( const int width = 8192, const int height = 4096 );
+
+/* differences of the sRGB table and of the linear to sRGB fit from the powf conversions of Color (every float_step-th
+float of <0, 1>) and throughput of the scalar and bulk conversions */
+int benchmark_srgb( const int n = 1 << 24, const int float_step = 16 );
+
+/* memory, conversion time and throughput of the diffuse lookups of a material with its colour map in sRGB bytes and
+pre-converted to 16-bit linear, half and float texels, with the differences of the values from the sRGB ones */
+int benchmark_linear_color_maps( const int size = 2048, const int no_samples = 4000000 );
+
+/* memory and loading time of textures exported under several file names when shared by content rather than by name,
+and the textures left to the other materials and in memory as the materials sharing them are deleted */
+int benchmark_texture_library( const int no_images = 16, const int no_copies = 4, const int size = 1024,
+	const int no_materials = 256 );
+
+#endif
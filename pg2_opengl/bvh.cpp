@@ -0,0 +1,871 @@
+#include "pch.h"
+#include "bvh.h"
+
+static const int kNoBins = 16;
+static const int kMaxDepth = 60; // the traversal stack holds 64 entries
+static const float kMinSpatialOverlap = 1e-5f; // overlap of the object split children relative to the root area
+
+/* the best binned SAH object split of count primitives given by their bounds and centroids, returns its cost
+(FLT_MAX if there is none), the axis, the last bin of the left child and the bounds of both children */
+template<class B, class C> static float FindObjectSplit( const int count, B && box, C && centroid,
+	const Aabb & centroid_bounds, int & best_axis, int & best_bin, Aabb & best_left, Aabb & best_right )
+{
+	float best_cost = FLT_MAX;
+	best_axis = -1;
+	best_bin = 0;
+
+	const Vector3 centroid_extent = centroid_bounds.extent();
+
+	for ( int axis = 0; axis < 3; ++axis )
+	{
+		if ( centroid_extent.data[axis] <= 0.0f ) continue;
+
+		Aabb bin_bounds[kNoBins];
+		int bin_counts[kNoBins] = { 0 };
+		const float scale = kNoBins / centroid_extent.data[axis];
+
+		for ( int i = 0; i < count; ++i )
+		{
+			const int bin = min( kNoBins - 1, int( ( centroid( i ).data[axis] - centroid_bounds.lower.data[axis] ) * scale ) );
+			bin_bounds[bin].Grow( box( i ) );
+			++bin_counts[bin];
+		}
+
+		// sweep from the right to get the bounds and counts of all right partitions
+		Aabb right_bounds[kNoBins];
+		int right_counts[kNoBins];
+		int right_count = 0;
+
+		for ( int b = kNoBins - 1; b > 0; --b )
+		{
+			if ( b < kNoBins - 1 ) right_bounds[b] = right_bounds[b + 1];
+			right_bounds[b].Grow( bin_bounds[b] );
+			right_count += bin_counts[b];
+			right_counts[b] = right_count;
+		}
+
+		Aabb left_bounds;
+		int left_count = 0;
+
+		for ( int b = 0; b < kNoBins - 1; ++b )
+		{
+			left_bounds.Grow( bin_bounds[b] );
+			left_count += bin_counts[b];
+
+			if ( left_count == 0 || right_counts[b + 1] == 0 ) continue;
+
+			const float cost = left_bounds.half_area() * left_count + right_bounds[b + 1].half_area() * right_counts[b + 1];
+
+			if ( cost < best_cost )
+			{
+				best_cost = cost;
+				best_axis = axis;
+				best_bin = b;
+				best_left = left_bounds;
+				best_right = right_bounds[b + 1];
+			}
+		}
+	}
+
+	return best_cost;
+}
+
+void Bvh::Build( const std::vector<Aabb> & bounds, const int max_leaf_size )
+{
+	assert( max_leaf_size > 0 );
+
+	max_leaf_size_ = max_leaf_size;
+
+	const int n = static_cast<int>( bounds.size() );
+	no_primitives_ = n;
+
+	nodes_.clear();
+	level_nodes_.clear();
+	level_offsets_.clear();
+	indices_.resize( n );
+
+	if ( n == 0 ) return;
+
+	std::vector<Vector3> centroids( n );
+
+	for ( int i = 0; i < n; ++i )
+	{
+		indices_[i] = i;
+		centroids[i] = bounds[i].centroid();
+	}
+
+	nodes_.reserve( 2 * size_t( n ) );
+	nodes_.resize( 1 );
+	nodes_[0].left_first = 0;
+	nodes_[0].count = n;
+
+	Subdivide( 0, 0, bounds, centroids );
+
+	nodes_.shrink_to_fit();
+
+	BuildLevels();
+}
+
+/* bounds of the parts of the triangle within the box on both sides of the plane axis = position */
+static void SplitTriangle( const Vector3 * vertices, const Aabb & box, const int axis, const float position,
+	Aabb & left, Aabb & right )
+{
+	left = Aabb();
+	right = Aabb();
+
+	for ( int i = 0; i < 3; ++i )
+	{
+		const Vector3 & a = vertices[i];
+		const Vector3 & b = vertices[( i + 1 ) % 3];
+		const float pa = a.data[axis];
+		const float pb = b.data[axis];
+
+		if ( pa <= position ) left.Grow( a );
+		if ( pa >= position ) right.Grow( a );
+
+		// the edge crosses the plane
+		if ( ( pa < position && pb > position ) || ( pa > position && pb < position ) )
+		{
+			Vector3 p = a + ( b - a ) * ( ( position - pa ) / ( pb - pa ) );
+			p.data[axis] = position;
+			left.Grow( p );
+			right.Grow( p );
+		}
+	}
+
+	left.Clip( box );
+	right.Clip( box );
+}
+
+struct Bvh::SpatialBuild
+{
+	const std::vector<Vector3> & vertices;
+	float root_area;
+	size_t no_references;
+	size_t max_references;
+};
+
+void Bvh::BuildSpatial( const std::vector<Vector3> & vertices, const int max_leaf_size, const float max_duplication )
+{
+	assert( max_leaf_size > 0 && max_duplication >= 0.0f && vertices.size() % 3 == 0 );
+
+	max_leaf_size_ = max_leaf_size;
+
+	const int n = static_cast<int>( vertices.size() / 3 );
+	no_primitives_ = n;
+
+	nodes_.clear();
+	indices_.clear();
+	level_nodes_.clear();
+	level_offsets_.clear();
+
+	if ( n == 0 ) return;
+
+	std::vector<Reference> references( n );
+	Aabb root_bounds;
+
+	for ( int i = 0; i < n; ++i )
+	{
+		references[i].index = i;
+
+		for ( int j = 0; j < 3; ++j )
+		{
+			references[i].bounds.Grow( vertices[3 * i + j] );
+		}
+
+		root_bounds.Grow( references[i].bounds );
+	}
+
+	SpatialBuild build{ vertices, root_bounds.half_area(), size_t( n ), size_t( n * ( 1.0 + max_duplication ) ) };
+
+	nodes_.reserve( 2 * build.max_references );
+	indices_.reserve( build.max_references );
+	nodes_.resize( 1 );
+
+	SubdivideSpatial( 0, 0, references, build );
+
+	nodes_.shrink_to_fit();
+	indices_.shrink_to_fit();
+
+	BuildLevels();
+}
+
+void Bvh::SubdivideSpatial( const int node_index, const int depth, std::vector<Reference> & references,
+	SpatialBuild & build )
+{
+	const int count = static_cast<int>( references.size() );
+
+	Aabb node_bounds;
+	Aabb centroid_bounds;
+
+	for ( const Reference & reference : references )
+	{
+		node_bounds.Grow( reference.bounds );
+		centroid_bounds.Grow( reference.bounds.centroid() );
+	}
+
+	nodes_[node_index].bounds = node_bounds;
+
+	// the leaves take their references in the depth first order
+	auto make_leaf = [&]() {
+		nodes_[node_index].left_first = static_cast<int>( indices_.size() );
+		nodes_[node_index].count = count;
+
+		for ( const Reference & reference : references )
+		{
+			indices_.push_back( reference.index );
+		}
+	};
+
+	if ( count <= 1 || depth >= kMaxDepth )
+	{
+		make_leaf();
+
+		return;
+	}
+
+	int object_axis, object_bin;
+	Aabb object_left, object_right;
+	const float object_cost = FindObjectSplit( count, [&]( const int i ) -> const Aabb & { return references[i].bounds; },
+		[&]( const int i ) { return references[i].bounds.centroid(); }, centroid_bounds, object_axis, object_bin,
+		object_left, object_right );
+
+	// spatial splits where the object split children overlap and the budget allows
+	int spatial_axis = -1;
+	float spatial_position = 0.0f;
+	float spatial_cost = FLT_MAX;
+	Aabb spatial_left, spatial_right;
+	int spatial_left_count = 0, spatial_right_count = 0;
+
+	Aabb overlap = object_left;
+	overlap.Clip( object_right );
+
+	if ( build.no_references < build.max_references &&
+		( object_axis < 0 || overlap.half_area() > kMinSpatialOverlap * build.root_area ) )
+	{
+		const Vector3 extent = node_bounds.extent();
+
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			if ( extent.data[axis] <= 0.0f ) continue;
+
+			Aabb bin_bounds[kNoBins];
+			int entries[kNoBins] = { 0 };
+			int exits[kNoBins] = { 0 };
+			const float lower = node_bounds.lower.data[axis];
+			const float width = extent.data[axis] / kNoBins;
+
+			auto bin_of = [&]( const float x ) { return max( 0, min( kNoBins - 1, int( ( x - lower ) / width ) ) ); };
+
+			// chop every reference along the bin planes
+			for ( const Reference & reference : references )
+			{
+				const int first_bin = bin_of( reference.bounds.lower.data[axis] );
+				const int last_bin = max( first_bin, bin_of( reference.bounds.upper.data[axis] ) );
+				Aabb piece = reference.bounds;
+
+				for ( int b = first_bin; b < last_bin; ++b )
+				{
+					Aabb left, right;
+					SplitTriangle( &build.vertices[3 * reference.index], piece, axis, lower + ( b + 1 ) * width, left, right );
+					bin_bounds[b].Grow( left );
+					piece = right;
+				}
+
+				bin_bounds[last_bin].Grow( piece );
+				++entries[first_bin];
+				++exits[last_bin];
+			}
+
+			Aabb right_bounds[kNoBins];
+			int right_counts[kNoBins];
+			int right_count = 0;
+
+			for ( int b = kNoBins - 1; b > 0; --b )
+			{
+				if ( b < kNoBins - 1 ) right_bounds[b] = right_bounds[b + 1];
+				right_bounds[b].Grow( bin_bounds[b] );
+				right_count += exits[b];
+				right_counts[b] = right_count;
+			}
+
+			Aabb left_bounds;
+			int left_count = 0;
+
+			for ( int b = 0; b < kNoBins - 1; ++b )
+			{
+				left_bounds.Grow( bin_bounds[b] );
+				left_count += entries[b];
+
+				if ( left_count == 0 || right_counts[b + 1] == 0 ) continue;
+
+				const float cost = left_bounds.half_area() * left_count + right_bounds[b + 1].half_area() * right_counts[b + 1];
+
+				if ( cost < spatial_cost )
+				{
+					spatial_cost = cost;
+					spatial_axis = axis;
+					spatial_position = lower + ( b + 1 ) * width;
+					spatial_left = left_bounds;
+					spatial_right = right_bounds[b + 1];
+					spatial_left_count = left_count;
+					spatial_right_count = right_counts[b + 1];
+				}
+			}
+		}
+	}
+
+	const float best_cost = min( object_cost, spatial_cost );
+	const float parent_area = node_bounds.half_area();
+	const float split_cost = 1.0f + ( ( parent_area > 0.0f ) ? best_cost / parent_area : float( count ) );
+
+	if ( count <= max_leaf_size_ && ( best_cost == FLT_MAX || split_cost >= float( count ) ) )
+	{
+		make_leaf();
+
+		return;
+	}
+
+	std::vector<Reference> left;
+	std::vector<Reference> right;
+
+	if ( spatial_cost < object_cost )
+	{
+		const float left_area = spatial_left.half_area();
+		const float right_area = spatial_right.half_area();
+		const float split = left_area * spatial_left_count + right_area * spatial_right_count;
+
+		for ( const Reference & reference : references )
+		{
+			if ( reference.bounds.upper.data[spatial_axis] <= spatial_position )
+			{
+				left.push_back( reference );
+			}
+			else if ( reference.bounds.lower.data[spatial_axis] >= spatial_position )
+			{
+				right.push_back( reference );
+			}
+			else
+			{
+				// unsplitting, a straddling reference goes whole to one side if that is cheaper than clipping it
+				Aabb grown_left = spatial_left;
+				Aabb grown_right = spatial_right;
+				grown_left.Grow( reference.bounds );
+				grown_right.Grow( reference.bounds );
+
+				const float to_left = grown_left.half_area() * spatial_left_count + right_area * ( spatial_right_count - 1 );
+				const float to_right = left_area * ( spatial_left_count - 1 ) + grown_right.half_area() * spatial_right_count;
+
+				// once the budget is used up, the remaining straddlers are not clipped either
+				const bool exhausted = build.no_references >= build.max_references;
+
+				if ( ( exhausted || to_left < split ) && to_left <= to_right )
+				{
+					left.push_back( reference );
+				}
+				else if ( exhausted || to_right < split )
+				{
+					right.push_back( reference );
+				}
+				else
+				{
+					Reference left_part{ reference.index, Aabb() };
+					Reference right_part{ reference.index, Aabb() };
+					SplitTriangle( &build.vertices[3 * reference.index], reference.bounds, spatial_axis, spatial_position,
+						left_part.bounds, right_part.bounds );
+
+					if ( !left_part.bounds.is_empty() ) left.push_back( left_part );
+					if ( !right_part.bounds.is_empty() ) right.push_back( right_part );
+					if ( !left_part.bounds.is_empty() && !right_part.bounds.is_empty() ) ++build.no_references;
+				}
+			}
+		}
+	}
+	else if ( object_axis >= 0 )
+	{
+		const float scale = kNoBins / centroid_bounds.extent().data[object_axis];
+
+		for ( const Reference & reference : references )
+		{
+			const int bin = min( kNoBins - 1, int( ( reference.bounds.centroid().data[object_axis] -
+				centroid_bounds.lower.data[object_axis] ) * scale ) );
+			( ( bin <= object_bin ) ? left : right ).push_back( reference );
+		}
+	}
+
+	if ( left.empty() || right.empty() )
+	{
+		// no usable split, halve the references
+		left.assign( references.begin(), references.begin() + count / 2 );
+		right.assign( references.begin() + count / 2, references.end() );
+	}
+
+	// the parent references are not needed any more
+	std::vector<Reference>().swap( references );
+
+	const int left_index = static_cast<int>( nodes_.size() );
+	nodes_.resize( nodes_.size() + 2 );
+
+	nodes_[node_index].left_first = left_index;
+	nodes_[node_index].count = 0;
+
+	SubdivideSpatial( left_index, depth + 1, left, build );
+	SubdivideSpatial( left_index + 1, depth + 1, right, build );
+}
+
+/* spreads the lowest 10 bits to every third bit */
+static unsigned int ExpandBits( unsigned int v )
+{
+	v = ( v * 0x00010001u ) & 0xff0000ffu;
+	v = ( v * 0x00000101u ) & 0x0f00f00fu;
+	v = ( v * 0x00000011u ) & 0xc30c30c3u;
+	v = ( v * 0x00000005u ) & 0x49249249u;
+
+	return v;
+}
+
+void Bvh::BuildMorton( const std::vector<Aabb> & bounds, const int max_leaf_size )
+{
+	assert( max_leaf_size > 0 );
+
+	max_leaf_size_ = max_leaf_size;
+
+	const int n = static_cast<int>( bounds.size() );
+	no_primitives_ = n;
+
+	nodes_.clear();
+	level_nodes_.clear();
+	level_offsets_.clear();
+	indices_.resize( n );
+
+	if ( n == 0 ) return;
+
+	Aabb centroid_bounds;
+
+	for ( const Aabb & box : bounds )
+	{
+		centroid_bounds.Grow( box.centroid() );
+	}
+
+	// 30-bit codes on the 1024^3 grid over the centroids
+	const Vector3 extent = centroid_bounds.extent();
+	std::vector<unsigned int> codes( n );
+
+#pragma omp parallel for
+	for ( int i = 0; i < n; ++i )
+	{
+		const Vector3 c = bounds[i].centroid();
+		unsigned int code = 0;
+
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			const float t = ( extent.data[axis] > 0.0f ) ? ( c.data[axis] - centroid_bounds.lower.data[axis] ) / extent.data[axis] : 0.0f;
+			code |= ExpandBits( static_cast<unsigned int>( min( 1023.0f, t * 1024.0f ) ) ) << ( 2 - axis );
+		}
+
+		codes[i] = code;
+		indices_[i] = i;
+	}
+
+	std::sort( indices_.begin(), indices_.end(), [&]( const int a, const int b ) { return codes[a] < codes[b]; } );
+
+	std::vector<unsigned int> sorted_codes( n );
+
+	for ( int i = 0; i < n; ++i )
+	{
+		sorted_codes[i] = codes[indices_[i]];
+	}
+
+	nodes_.reserve( 2 * size_t( n ) );
+	nodes_.resize( 1 );
+
+	SubdivideMorton( 0, 0, n, sorted_codes, bounds );
+
+	nodes_.shrink_to_fit();
+
+	BuildLevels();
+}
+
+void Bvh::SubdivideMorton( const int node_index, const int first, const int count, const std::vector<unsigned int> & codes,
+	const std::vector<Aabb> & bounds )
+{
+	if ( count <= max_leaf_size_ )
+	{
+		Aabb box;
+
+		for ( int i = first; i < first + count; ++i )
+		{
+			box.Grow( bounds[indices_[i]] );
+		}
+
+		nodes_[node_index].bounds = box;
+		nodes_[node_index].left_first = first;
+		nodes_[node_index].count = count;
+
+		return;
+	}
+
+	const unsigned int difference = codes[first] ^ codes[first + count - 1];
+	int middle = first + count / 2; // equal codes are split in halves
+
+	if ( difference != 0 )
+	{
+		// the codes share the bits above the highest differing one, the split is where it becomes set
+		int bit = 31;
+		while ( ( ( difference >> bit ) & 1 ) == 0 ) --bit;
+
+		middle = int( std::partition_point( codes.begin() + first, codes.begin() + first + count,
+			[&]( const unsigned int code ) { return ( ( code >> bit ) & 1 ) == 0; } ) - codes.begin() );
+	}
+
+	const int left_index = static_cast<int>( nodes_.size() );
+	nodes_.resize( nodes_.size() + 2 );
+
+	nodes_[node_index].left_first = left_index;
+	nodes_[node_index].count = 0;
+
+	SubdivideMorton( left_index, first, middle - first, codes, bounds );
+	SubdivideMorton( left_index + 1, middle, first + count - middle, codes, bounds );
+
+	Aabb box = nodes_[left_index].bounds;
+	box.Grow( nodes_[left_index + 1].bounds );
+	nodes_[node_index].bounds = box;
+}
+
+void Bvh::Optimize( const int iterations )
+{
+	if ( nodes_.empty() ) return;
+
+	std::vector<float> costs( nodes_.size() );
+
+	for ( int iteration = 0; iteration < iterations; ++iteration )
+	{
+		const std::vector<BvhNode> backup = nodes_;
+		const int no_levels = static_cast<int>( level_offsets_.size() ) - 1;
+
+		for ( int level = no_levels - 1; level >= 0; --level )
+		{
+			const int begin = level_offsets_[level];
+			const int end = level_offsets_[level + 1];
+
+#pragma omp parallel for schedule( dynamic, 64 ) if ( end - begin > 256 )
+			for ( int i = begin; i < end; ++i )
+			{
+				const int node_index = level_nodes_[i];
+				const BvhNode & node = nodes_[node_index];
+
+				if ( node.is_leaf() )
+				{
+					costs[node_index] = node.bounds.half_area() * node.count;
+				}
+				else
+				{
+					costs[node_index] = node.bounds.half_area() + costs[node.left_first] + costs[node.left_first + 1];
+					RestructureTreelet( node_index, costs );
+				}
+			}
+		}
+
+		BuildLevels();
+
+		// the traversal stack limits the depth
+		if ( static_cast<int>( level_offsets_.size() ) - 1 > kMaxDepth )
+		{
+			nodes_ = backup;
+			BuildLevels();
+
+			return;
+		}
+	}
+}
+
+void Bvh::RestructureTreelet( const int root, std::vector<float> & costs )
+{
+	static const int kMaxTreeletLeaves = 7;
+
+	// grow the treelet by expanding its largest interior leaf
+	int leaves[kMaxTreeletLeaves] = { nodes_[root].left_first, nodes_[root].left_first + 1 };
+	int pairs[kMaxTreeletLeaves - 1] = { nodes_[root].left_first }; // the child slots of the treelet nodes
+	int no_leaves = 2;
+	int no_pairs = 1;
+
+	while ( no_leaves < kMaxTreeletLeaves )
+	{
+		int largest = -1;
+		float largest_area = -1.0f;
+
+		for ( int i = 0; i < no_leaves; ++i )
+		{
+			const BvhNode & node = nodes_[leaves[i]];
+
+			if ( !node.is_leaf() && node.bounds.half_area() > largest_area )
+			{
+				largest = i;
+				largest_area = node.bounds.half_area();
+			}
+		}
+
+		if ( largest < 0 ) break;
+
+		const int first = nodes_[leaves[largest]].left_first;
+		pairs[no_pairs++] = first;
+		leaves[largest] = first;
+		leaves[no_leaves++] = first + 1;
+	}
+
+	if ( no_leaves < 3 ) return;
+
+	// minimal cost of every subset of the leaves, the proper subsets of a set precede it numerically
+	const int no_subsets = 1 << no_leaves;
+	Aabb boxes[1 << kMaxTreeletLeaves];
+	float subset_costs[1 << kMaxTreeletLeaves];
+	int partitions[1 << kMaxTreeletLeaves];
+
+	for ( int subset = 1; subset < no_subsets; ++subset )
+	{
+		const int lowest = subset & -subset;
+		int leaf = 0;
+		while ( ( 1 << leaf ) != lowest ) ++leaf;
+
+		boxes[subset] = boxes[subset ^ lowest];
+		boxes[subset].Grow( nodes_[leaves[leaf]].bounds );
+
+		if ( subset == lowest )
+		{
+			subset_costs[subset] = costs[leaves[leaf]];
+
+			continue;
+		}
+
+		// the part with the lowest leaf on the left, each partition is visited once
+		float best = FLT_MAX;
+
+		for ( int part = ( subset - 1 ) & subset; part > 0; part = ( part - 1 ) & subset )
+		{
+			if ( !( part & lowest ) ) continue;
+
+			const float cost = subset_costs[part] + subset_costs[subset ^ part];
+
+			if ( cost < best )
+			{
+				best = cost;
+				partitions[subset] = part;
+			}
+		}
+
+		subset_costs[subset] = boxes[subset].half_area() + best;
+	}
+
+	const int all = no_subsets - 1;
+
+	if ( subset_costs[all] >= costs[root] * ( 1.0f - 1e-6f ) ) return;
+
+	// rewrite the treelet, its leaves move to the reused child slots
+	BvhNode leaf_nodes[kMaxTreeletLeaves];
+	float leaf_costs[kMaxTreeletLeaves];
+
+	for ( int i = 0; i < no_leaves; ++i )
+	{
+		leaf_nodes[i] = nodes_[leaves[i]];
+		leaf_costs[i] = costs[leaves[i]];
+	}
+
+	struct Task { int subset; int node_index; };
+	Task tasks[2 * kMaxTreeletLeaves];
+	int no_tasks = 0;
+	int next_pair = 0;
+	tasks[no_tasks++] = Task{ all, root };
+
+	while ( no_tasks > 0 )
+	{
+		const Task task = tasks[--no_tasks];
+		BvhNode & node = nodes_[task.node_index];
+
+		if ( ( task.subset & ( task.subset - 1 ) ) == 0 )
+		{
+			int leaf = 0;
+			while ( ( 1 << leaf ) != task.subset ) ++leaf;
+
+			node = leaf_nodes[leaf];
+			costs[task.node_index] = leaf_costs[leaf];
+
+			continue;
+		}
+
+		const int pair = pairs[next_pair++];
+		node.bounds = boxes[task.subset];
+		node.left_first = pair;
+		node.count = 0;
+		costs[task.node_index] = subset_costs[task.subset];
+
+		tasks[no_tasks++] = Task{ partitions[task.subset], pair };
+		tasks[no_tasks++] = Task{ task.subset ^ partitions[task.subset], pair + 1 };
+	}
+}
+
+void Bvh::BuildLevels()
+{
+	level_nodes_.assign( 1, 0 );
+	level_offsets_.assign( 1, 0 );
+
+	// breadth first, the children of a level form the next one
+	for ( size_t begin = 0; begin < level_nodes_.size(); )
+	{
+		const size_t end = level_nodes_.size();
+
+		for ( size_t i = begin; i < end; ++i )
+		{
+			const BvhNode & node = nodes_[level_nodes_[i]];
+
+			if ( !node.is_leaf() )
+			{
+				level_nodes_.push_back( node.left_first );
+				level_nodes_.push_back( node.left_first + 1 );
+			}
+		}
+
+		level_offsets_.push_back( static_cast<int>( end ) );
+		begin = end;
+	}
+}
+
+void Bvh::Refit( const std::vector<Aabb> & bounds )
+{
+	assert( static_cast<int>( bounds.size() ) == no_primitives_ );
+
+	const int no_levels = static_cast<int>( level_offsets_.size() ) - 1;
+
+	for ( int level = no_levels - 1; level >= 0; --level )
+	{
+		const int begin = level_offsets_[level];
+		const int end = level_offsets_[level + 1];
+
+		// the levels near the root are too small to be worth the threads
+#pragma omp parallel for if ( end - begin > 1024 )
+		for ( int i = begin; i < end; ++i )
+		{
+			BvhNode & node = nodes_[level_nodes_[i]];
+			Aabb box;
+
+			if ( node.is_leaf() )
+			{
+				for ( int j = node.left_first; j < node.left_first + node.count; ++j )
+				{
+					box.Grow( bounds[indices_[j]] );
+				}
+			}
+			else
+			{
+				box = nodes_[node.left_first].bounds;
+				box.Grow( nodes_[node.left_first + 1].bounds );
+			}
+
+			node.bounds = box;
+		}
+	}
+}
+
+void Bvh::Subdivide( const int node_index, const int depth, const std::vector<Aabb> & bounds,
+	const std::vector<Vector3> & centroids )
+{
+	const int first = nodes_[node_index].left_first;
+	const int count = nodes_[node_index].count;
+
+	Aabb node_bounds;
+	Aabb centroid_bounds;
+
+	for ( int i = first; i < first + count; ++i )
+	{
+		node_bounds.Grow( bounds[indices_[i]] );
+		centroid_bounds.Grow( centroids[indices_[i]] );
+	}
+
+	nodes_[node_index].bounds = node_bounds;
+
+	if ( count <= 1 || depth >= kMaxDepth ) return;
+
+	// find the best binned SAH split over all three axes
+	int best_axis, best_bin;
+	Aabb left_bounds, right_bounds;
+	const float best_cost = FindObjectSplit( count, [&]( const int i ) -> const Aabb & { return bounds[indices_[first + i]]; },
+		[&]( const int i ) -> const Vector3 & { return centroids[indices_[first + i]]; }, centroid_bounds, best_axis,
+		best_bin, left_bounds, right_bounds );
+
+	const Vector3 centroid_extent = centroid_bounds.extent();
+	const float parent_area = node_bounds.half_area();
+	const float leaf_cost = float( count );
+	const float split_cost = 1.0f + ( ( parent_area > 0.0f ) ? best_cost / parent_area : float( count ) );
+
+	if ( count <= max_leaf_size_ && ( best_axis < 0 || split_cost >= leaf_cost ) ) return;
+
+	int middle = first;
+
+	if ( best_axis >= 0 )
+	{
+		const float scale = kNoBins / centroid_extent.data[best_axis];
+		int * begin = indices_.data() + first;
+		int * end = begin + count;
+
+		middle = int( std::partition( begin, end, [&]( const int i ) {
+			const int bin = min( kNoBins - 1, int( ( centroids[i].data[best_axis] - centroid_bounds.lower.data[best_axis] ) * scale ) );
+			return bin <= best_bin;
+		} ) - indices_.data() );
+	}
+
+	if ( middle == first || middle == first + count )
+	{
+		// all centroids coincide, split the primitives in halves
+		middle = first + count / 2;
+	}
+
+	const int left_index = static_cast<int>( nodes_.size() );
+	nodes_.resize( nodes_.size() + 2 );
+
+	nodes_[left_index].left_first = first;
+	nodes_[left_index].count = middle - first;
+	nodes_[left_index + 1].left_first = middle;
+	nodes_[left_index + 1].count = first + count - middle;
+
+	nodes_[node_index].left_first = left_index;
+	nodes_[node_index].count = 0;
+
+	Subdivide( left_index, depth + 1, bounds, centroids );
+	Subdivide( left_index + 1, depth + 1, bounds, centroids );
+}
+
+float Bvh::SahCost( const float intersection_cost ) const
+{
+	if ( nodes_.empty() ) return 0.0f;
+
+	const float root_area = nodes_[0].bounds.half_area();
+
+	if ( root_area <= 0.0f ) return 0.0f;
+
+	double cost = 0.0;
+
+	for ( const BvhNode & node : nodes_ )
+	{
+		cost += node.bounds.half_area() * ( ( node.is_leaf() ) ? intersection_cost * node.count : 1.0f );
+	}
+
+	return float( cost / root_area );
+}
+
+void Bvh::Print() const
+{
+	int no_leaves = 0;
+	int max_leaf = 0;
+
+	for ( const BvhNode & node : nodes_ )
+	{
+		if ( node.is_leaf() )
+		{
+			++no_leaves;
+			max_leaf = max( max_leaf, node.count );
+		}
+	}
+
+	printf( "BVH: %d primitives, %I64u references, %I64u nodes, %d leaves (max %d primitives), SAH cost %0.2f, %0.1f MB\n",
+		no_primitives_, indices_.size(), nodes_.size(), no_leaves, max_leaf, SahCost(),
+		( nodes_.size() * sizeof( BvhNode ) + indices_.size() * sizeof( int ) ) / ( 1024.0f * 1024.0f ) );
+}
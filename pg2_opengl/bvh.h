@@ -0,0 +1,196 @@
+#ifndef BVH_H_
+#define BVH_H_
+
+#include "aabb.h"
+
+/*! \struct BvhNode
+\brief A node of the bounding volume hierarchy (32 bytes).
+
+Children of an interior node are stored next to each other, the right child follows the left one.
+*/
+struct BvhNode
+{
+	Aabb bounds; /*!< Bounds of all primitives in the subtree. */
+	int left_first{ 0 }; /*!< Index of the left child (interior node) or of the first primitive index (leaf). */
+	int count{ 0 }; /*!< Number of primitives in the leaf, zero for interior nodes. */
+
+	bool is_leaf() const
+	{
+		return count > 0;
+	}
+};
+
+/*! \class Bvh
+\brief Bounding volume hierarchy over an arbitrary set of primitives given by their bounds.
+
+The hierarchy is built by the binned SAH and knows nothing about the primitives, the leaves refer to the
+primitives through indices(). The caller supplies the primitive test to Traverse.
+
+When the primitives move but stay the same, Refit recomputes the node bounds bottom-up in O(n) keeping the
+topology. The nodes are processed level by level from the deepest one, all nodes of a level in parallel. The
+quality of a refitted hierarchy degrades with the motion, compare SahCost with its value after the Build.
+
+BuildSpatial builds a split BVH (Stich et al. 2009) over triangles. Besides the object splits it considers
+spatial splits, which clip the triangles straddling the splitting plane into both children, so a long thin
+triangle is referenced by several leaves with tight bounds instead of one leaf whose box overlaps everything.
+A spatial split is tried only where the children of the best object split overlap, and the total number of
+references is bounded by ( 1 + max_duplication ) times the number of triangles. indices() may then contain
+a triangle several times. Refit keeps working but grows the leaves by the whole triangles.
+
+BuildMorton is a fast LBVH-style builder, the primitives are sorted by the Morton codes of their centroids and
+split at the highest differing bit. Its trees are noticeably worse than the binned SAH ones. Optimize improves
+any built hierarchy by treelet restructuring (Karras and Aila 2013): a treelet of up to seven leaves is grown
+below each node by expanding its largest leaves and rearranged to the topology of the minimal SAH cost found by
+dynamic programming over all subsets of its leaves. The nodes are processed bottom-up level by level, the treelets
+rooted at one level are disjoint and are optimized in parallel. The leaves and indices() stay the same.
+
+\code{.cpp}
+Bvh bvh;
+bvh.Build( triangle_bounds );
+bvh.Traverse( ray, [&]( const int first, const int count ) {
+	for ( int i = first; i < first + count; ++i ) intersect( bvh.indices()[i], ray ); // shortens ray.t_max
+	return false; // continue the traversal
+} );
+\endcode
+*/
+class Bvh
+{
+public:
+	/* builds the hierarchy, leaves hold at most max_leaf_size primitives */
+	void Build( const std::vector<Aabb> & bounds, const int max_leaf_size = 4 );
+
+	/* split BVH over the triangles given by three vertices each, with at most max_duplication * n extra references */
+	void BuildSpatial( const std::vector<Vector3> & vertices, const int max_leaf_size = 4,
+		const float max_duplication = 0.3f );
+
+	/* LBVH-style build by the Morton codes of the centroids, fast but of a lower quality */
+	void BuildMorton( const std::vector<Aabb> & bounds, const int max_leaf_size = 4 );
+
+	/* treelet restructuring of the built hierarchy in the given number of bottom-up passes */
+	void Optimize( const int iterations = 3 );
+
+	/* updates the bounds of all nodes for the new bounds of the same primitives */
+	void Refit( const std::vector<Aabb> & bounds );
+
+	/* visits all leaves whose bounds are hit within <ray.t_min, ray.t_max> in front-to-back order;
+	the leaf callback bool( first, count ) may shorten ray.t_max and returns true to stop the traversal */
+	template<class F> void Traverse( Ray & ray, F && leaf ) const;
+
+	/* SAH cost of the hierarchy normalized by the area of the root (traversal step cost 1) */
+	float SahCost( const float intersection_cost = 1.0f ) const;
+
+	const std::vector<BvhNode> & nodes() const
+	{
+		return nodes_;
+	}
+
+	/* number of primitives the hierarchy was built over */
+	int no_primitives() const
+	{
+		return no_primitives_;
+	}
+
+	/* primitive indices referenced by the leaves, a primitive may occur more than once after BuildSpatial */
+	const std::vector<int> & indices() const
+	{
+		return indices_;
+	}
+
+	Aabb bounds() const
+	{
+		return ( nodes_.empty() ) ? Aabb() : nodes_[0].bounds;
+	}
+
+	void Print() const;
+
+private:
+	void Subdivide( const int node_index, const int depth, const std::vector<Aabb> & bounds,
+		const std::vector<Vector3> & centroids );
+
+	struct Reference
+	{
+		int index;
+		Aabb bounds; // part of the primitive within the node
+	};
+
+	struct SpatialBuild;
+
+	void SubdivideSpatial( const int node_index, const int depth, std::vector<Reference> & references,
+		SpatialBuild & build );
+
+	/* subtree of the sorted codes and primitives in [first, first + count) */
+	void SubdivideMorton( const int node_index, const int first, const int count, const std::vector<unsigned int> & codes,
+		const std::vector<Aabb> & bounds );
+
+	/* rearranges the treelet rooted at the node if that lowers the SAH cost, costs hold the costs of all subtrees */
+	void RestructureTreelet( const int root, std::vector<float> & costs );
+
+	/* groups the nodes by their depth for Refit and Optimize */
+	void BuildLevels();
+
+	std::vector<BvhNode> nodes_;
+	std::vector<int> indices_;
+
+	std::vector<int> level_nodes_; // node indices ordered by depth
+	std::vector<int> level_offsets_; // start of each level in level_nodes_ and the total count
+
+	int max_leaf_size_{ 4 };
+	int no_primitives_{ 0 };
+};
+
+template<class F> void Bvh::Traverse( Ray & ray, F && leaf ) const
+{
+	if ( nodes_.empty() ) return;
+
+	const Vector3 inv_direction( 1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z );
+
+	struct Entry { int node_index; float t; };
+	Entry stack[64];
+	int stack_size = 0;
+	int node_index = 0;
+
+	if ( nodes_[0].bounds.Intersect( ray.origin, inv_direction, ray.t_min, ray.t_max ) == FLT_MAX ) return;
+
+	while ( true )
+	{
+		const BvhNode & node = nodes_[node_index];
+
+		if ( node.is_leaf() )
+		{
+			if ( leaf( node.left_first, node.count ) ) return;
+		}
+		else
+		{
+			// visit the closer child first, push the other one
+			const float t_left = nodes_[node.left_first].bounds.Intersect( ray.origin, inv_direction, ray.t_min, ray.t_max );
+			const float t_right = nodes_[node.left_first + 1].bounds.Intersect( ray.origin, inv_direction, ray.t_min, ray.t_max );
+
+			if ( t_left != FLT_MAX || t_right != FLT_MAX )
+			{
+				if ( t_left <= t_right )
+				{
+					if ( t_right != FLT_MAX ) stack[stack_size++] = Entry{ node.left_first + 1, t_right };
+					node_index = node.left_first;
+				}
+				else
+				{
+					if ( t_left != FLT_MAX ) stack[stack_size++] = Entry{ node.left_first, t_left };
+					node_index = node.left_first + 1;
+				}
+
+				continue;
+			}
+		}
+
+		// skip the postponed nodes that lie behind the closest hit found so far
+		do
+		{
+			if ( stack_size == 0 ) return;
+			--stack_size;
+		} while ( stack[stack_size].t > ray.t_max );
+
+		node_index = stack[stack_size].node_index;
+	}
+}
+
+#endif
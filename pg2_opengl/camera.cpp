@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "camera.h"
+#include "mymath.h"
 
 Camera::Camera( const int width, const int height, const float fov_y,
 	const Vector3 view_from, const Vector3 view_at )
@@ -33,6 +34,38 @@ float Camera::focal_length() const
 	return f_y_;
 }
 
+int Camera::width() const
+{
+	return width_;
+}
+
+int Camera::height() const
+{
+	return height_;
+}
+
+Ray Camera::GenerateRay( const float x, const float y ) const
+{
+	// the camera looks along -z_c with y_c pointing up
+	Vector3 direction = M_c_w_ * Vector3( x - width_ * 0.5f, height_ * 0.5f - y, -f_y_ );
+	direction.Normalize();
+
+	return Ray( view_from_, direction );
+}
+
+void Camera::RayDifferentials( const Vector3 & direction, Vector3 & d_dx, Vector3 & d_dy ) const
+{
+	// the unnormalized direction q reaches the image plane at the distance of the focal length along -z_c
+	const Vector3 x_c = M_c_w_ * Vector3( 1, 0, 0 );
+	const Vector3 y_c = M_c_w_ * Vector3( 0, 1, 0 );
+	const Vector3 z_c = M_c_w_ * Vector3( 0, 0, 1 );
+	const float q_norm = f_y_ / max( -direction.DotProduct( z_c ), 1e-6f );
+
+	// d( q / |q| ) = ( dq - d ( d . dq ) ) / |q| with dq / dx = x_c and dq / dy = -y_c
+	d_dx = ( x_c - direction * direction.DotProduct( x_c ) ) / q_norm;
+	d_dy = ( direction * direction.DotProduct( y_c ) - y_c ) / q_norm;
+}
+
 void Camera::set_fov_y( const float fov_y )
 {
 	assert( fov_y > 0.0 );
@@ -3,6 +3,7 @@
 
 #include "vector3.h"
 #include "matrix3x3.h"
+#include "ray.h"
 
 /*! \class Camera
 \brief A simple pin-hole camera.
@@ -22,6 +23,14 @@ public:
 	Vector3 view_from() const;
 	Matrix3x3 M_c_w() const;
 	float focal_length() const;
+	int width() const;
+	int height() const;
+
+	/* primary ray through the point (x, y) of the image plane given in pixels, (0, 0) is the top left corner */
+	Ray GenerateRay( const float x, const float y ) const;
+
+	/* derivatives of the unit direction of a primary ray with respect to the pixel coordinates x and y */
+	void RayDifferentials( const Vector3 & direction, Vector3 & d_dx, Vector3 & d_dy ) const;
 
 	void set_fov_y( const float fov_y );
 
@@ -3,6 +3,7 @@
 
 #include <assert.h>
 #include <array>
+#include "srgb.h"
 
 /*! \class Color
 \brief A simple templated representation of color.
@@ -115,7 +116,7 @@ public:
 		return lhs;
 	}
 
-	// explicit type casting operator uchar -> float, i.e. sRGB -> linear
+	// explicit type casting operator uchar -> float, i.e. sRGB -> linear (by the table of c_linear)
 	//template<class T2>
 	explicit operator Color<N, float>() const
 	{
@@ -123,20 +124,20 @@ public:
 
 		for ( int i = 0; i < N; ++i )
 		{
-			lhs.data[i] = c_linear( float( data[i] ) * ( 1.0f / 255.0f ) );
+			lhs.data[i] = SrgbToLinear( static_cast<unsigned char>( data[i] ) );
 		}
 
 		return lhs;
 	}
 
-	// explicit type casting operator float -> uchar, i.e. linear -> sRGB
+	// explicit type casting operator float -> uchar, i.e. linear -> sRGB (rounded, see LinearToSrgb)
 	explicit operator Color<N, unsigned char>() const
 	{
 		Color<N, unsigned char> lhs;
 
 		for ( int i = 0; i < N; ++i )
 		{
-			lhs.data[i] = ( unsigned char )( std::max( T( 0 ), std::min( T( 255 ), c_srgb( data[i] ) * T( 255 ) ) ) );
+			lhs.data[i] = LinearToSrgb( float( data[i] ) );
 		}
 
 		return lhs;
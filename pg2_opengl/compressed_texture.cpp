@@ -0,0 +1,744 @@
+#include "pch.h"
+#include "compressed_texture.h"
+#include "mymath.h"
+#include "utils.h"
+#include <climits>
+
+// not part of the core profile
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+
+/* the mean of the points and the direction of their largest variance (power iteration on the covariance) */
+static void PrincipalAxis( const float ( *p )[3], const int n, float * mean, float * axis )
+{
+	mean[0] = mean[1] = mean[2] = 0.0f;
+
+	for ( int i = 0; i < n; ++i )
+	{
+		for ( int c = 0; c < 3; ++c ) mean[c] += p[i][c] / n;
+	}
+
+	float covariance[3][3] = {};
+
+	for ( int i = 0; i < n; ++i )
+	{
+		for ( int a = 0; a < 3; ++a )
+		{
+			for ( int b = 0; b < 3; ++b ) covariance[a][b] += ( p[i][a] - mean[a] ) * ( p[i][b] - mean[b] );
+		}
+	}
+
+	axis[0] = axis[1] = axis[2] = 1.0f;
+
+	for ( int iteration = 0; iteration < 8; ++iteration )
+	{
+		float next[3];
+
+		for ( int a = 0; a < 3; ++a )
+		{
+			next[a] = covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2];
+		}
+
+		const float length = sqrtf( sqr( next[0] ) + sqr( next[1] ) + sqr( next[2] ) );
+
+		if ( length < 1e-6f ) break; // flat block, any axis does
+
+		for ( int a = 0; a < 3; ++a ) axis[a] = next[a] / length;
+	}
+}
+
+/* extremes of the points along the axis */
+static void Extremes( const float ( *p )[3], const int n, const float * mean, const float * axis, float * e0, float * e1 )
+{
+	float t_min = FLT_MAX;
+	float t_max = -FLT_MAX;
+
+	for ( int i = 0; i < n; ++i )
+	{
+		const float t = ( p[i][0] - mean[0] ) * axis[0] + ( p[i][1] - mean[1] ) * axis[1] + ( p[i][2] - mean[2] ) * axis[2];
+		t_min = min( t_min, t );
+		t_max = max( t_max, t );
+	}
+
+	for ( int c = 0; c < 3; ++c )
+	{
+		e0[c] = mean[c] + t_min * axis[c];
+		e1[c] = mean[c] + t_max * axis[c];
+	}
+}
+
+/* endpoints minimizing the squared error of the points given as ( 1 - w ) e0 + w e1, false if singular */
+static bool FitEndpoints( const float ( *p )[3], const float * weights, const int n, float * e0, float * e1 )
+{
+	float a00 = 0.0f, a01 = 0.0f, a11 = 0.0f;
+	float b0[3] = {}, b1[3] = {};
+
+	for ( int i = 0; i < n; ++i )
+	{
+		const float w = weights[i];
+		a00 += sqr( 1.0f - w );
+		a01 += ( 1.0f - w ) * w;
+		a11 += sqr( w );
+
+		for ( int c = 0; c < 3; ++c )
+		{
+			b0[c] += ( 1.0f - w ) * p[i][c];
+			b1[c] += w * p[i][c];
+		}
+	}
+
+	const float det = a00 * a11 - a01 * a01;
+
+	if ( fabsf( det ) < 1e-6f ) return false;
+
+	for ( int c = 0; c < 3; ++c )
+	{
+		e0[c] = min( 255.0f, max( 0.0f, ( a11 * b0[c] - a01 * b1[c] ) / det ) );
+		e1[c] = min( 255.0f, max( 0.0f, ( a00 * b1[c] - a01 * b0[c] ) / det ) );
+	}
+
+	return true;
+}
+
+static int SquaredError( const Color3u & a, const Color3u & b )
+{
+	return sqr( a.data[0] - b.data[0] ) + sqr( a.data[1] - b.data[1] ) + sqr( a.data[2] - b.data[2] );
+}
+
+/* --- BC1 --- */
+
+static Color3u Expand565( const int c )
+{
+	const int r = ( c >> 11 ) & 31;
+	const int g = ( c >> 5 ) & 63;
+	const int b = c & 31;
+
+	return Color3u( { static_cast<unsigned char>( ( r << 3 ) | ( r >> 2 ) ), static_cast<unsigned char>( ( g << 2 ) | ( g >> 4 ) ),
+		static_cast<unsigned char>( ( b << 3 ) | ( b >> 2 ) ) } );
+}
+
+static int Quantize565( const float * c )
+{
+	const int r = max( 0, min( 31, int( c[0] * ( 31.0f / 255.0f ) + 0.5f ) ) );
+	const int g = max( 0, min( 63, int( c[1] * ( 63.0f / 255.0f ) + 0.5f ) ) );
+	const int b = max( 0, min( 31, int( c[2] * ( 31.0f / 255.0f ) + 0.5f ) ) );
+
+	return ( r << 11 ) | ( g << 5 ) | b;
+}
+
+static Color3u Bc1Colour( const int c0, const int c1, const int index )
+{
+	const Color3u a = Expand565( c0 );
+	const Color3u b = Expand565( c1 );
+
+	switch ( index )
+	{
+	case 0: return a;
+	case 1: return b;
+	}
+
+	Color3u value;
+
+	for ( int c = 0; c < 3; ++c )
+	{
+		if ( c0 > c1 )
+		{
+			value.data[c] = static_cast<unsigned char>( ( index == 2 ) ? ( 2 * a.data[c] + b.data[c] ) / 3 : ( a.data[c] + 2 * b.data[c] ) / 3 );
+		}
+		else
+		{
+			value.data[c] = static_cast<unsigned char>( ( index == 2 ) ? ( a.data[c] + b.data[c] ) / 2 : 0 );
+		}
+	}
+
+	return value;
+}
+
+Color3u DecodeBc1( const unsigned char * block, const int i )
+{
+	const int c0 = block[0] | ( block[1] << 8 );
+	const int c1 = block[2] | ( block[3] << 8 );
+
+	return Bc1Colour( c0, c1, ( block[4 + ( i >> 2 )] >> ( 2 * ( i & 3 ) ) ) & 3 );
+}
+
+void EncodeBc1( const Color3u * texels, unsigned char * block )
+{
+	float p[16][3];
+
+	for ( int i = 0; i < 16; ++i )
+	{
+		for ( int c = 0; c < 3; ++c ) p[i][c] = texels[i].data[c];
+	}
+
+	float mean[3], axis[3], a[3], b[3];
+	PrincipalAxis( p, 16, mean, axis );
+	Extremes( p, 16, mean, axis, a, b );
+
+	static const float kWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	int best_error = INT_MAX;
+
+	// the endpoints along the principal axis refined twice by least squares over the chosen indices
+	for ( int iteration = 0; iteration < 3; ++iteration )
+	{
+		int c0 = Quantize565( a );
+		int c1 = Quantize565( b );
+
+		// the four colour mode
+		if ( c0 < c1 )
+		{
+			std::swap( c0, c1 );
+			for ( int c = 0; c < 3; ++c ) std::swap( a[c], b[c] );
+		}
+
+		Color3u palette[4];
+		for ( int j = 0; j < 4; ++j ) palette[j] = Bc1Colour( c0, c1, j );
+
+		int indices[16];
+		float weights[16];
+		int error = 0;
+
+		for ( int i = 0; i < 16; ++i )
+		{
+			int best = 0;
+
+			for ( int j = 1; j < 4; ++j )
+			{
+				if ( SquaredError( texels[i], palette[j] ) < SquaredError( texels[i], palette[best] ) ) best = j;
+			}
+
+			indices[i] = best;
+			weights[i] = kWeights[best];
+			error += SquaredError( texels[i], palette[best] );
+		}
+
+		if ( error < best_error )
+		{
+			best_error = error;
+			block[0] = static_cast<unsigned char>( c0 & 255 );
+			block[1] = static_cast<unsigned char>( c0 >> 8 );
+			block[2] = static_cast<unsigned char>( c1 & 255 );
+			block[3] = static_cast<unsigned char>( c1 >> 8 );
+
+			for ( int row = 0; row < 4; ++row )
+			{
+				block[4 + row] = static_cast<unsigned char>( indices[4 * row] | ( indices[4 * row + 1] << 2 ) |
+					( indices[4 * row + 2] << 4 ) | ( indices[4 * row + 3] << 6 ) );
+			}
+		}
+
+		if ( error == 0 || c0 == c1 || !FitEndpoints( p, weights, 16, a, b ) ) break;
+	}
+}
+
+/* --- BC4 --- */
+
+unsigned char DecodeBc4( const unsigned char * block, const int i )
+{
+	const int e0 = block[0];
+	const int e1 = block[1];
+	const int bit = 16 + 3 * i;
+	const int index = ( ( block[bit >> 3] | ( block[( bit >> 3 ) + 1] << 8 ) ) >> ( bit & 7 ) ) & 7;
+
+	switch ( index )
+	{
+	case 0: return static_cast<unsigned char>( e0 );
+	case 1: return static_cast<unsigned char>( e1 );
+	}
+
+	if ( e0 > e1 ) return static_cast<unsigned char>( ( ( 8 - index ) * e0 + ( index - 1 ) * e1 ) / 7 );
+	if ( index == 6 ) return 0;
+	if ( index == 7 ) return 255;
+
+	return static_cast<unsigned char>( ( ( 6 - index ) * e0 + ( index - 1 ) * e1 ) / 5 );
+}
+
+void EncodeBc4( const unsigned char * values, unsigned char * block )
+{
+	int lower = 255;
+	int upper = 0;
+
+	for ( int i = 0; i < 16; ++i )
+	{
+		lower = min( lower, int( values[i] ) );
+		upper = max( upper, int( values[i] ) );
+	}
+
+	// the eight value mode spans exactly the range of the block
+	memset( block, 0, 8 );
+	block[0] = static_cast<unsigned char>( upper );
+	block[1] = static_cast<unsigned char>( lower );
+
+	if ( upper == lower ) return;
+
+	unsigned char palette[8];
+
+	for ( int j = 0; j < 8; ++j )
+	{
+		palette[j] = static_cast<unsigned char>( ( j == 0 ) ? upper : ( j == 1 ) ? lower : ( ( 8 - j ) * upper + ( j - 1 ) * lower ) / 7 );
+	}
+
+	unsigned long long bits = 0;
+
+	for ( int i = 0; i < 16; ++i )
+	{
+		int best = 0;
+
+		for ( int j = 1; j < 8; ++j )
+		{
+			if ( abs( values[i] - palette[j] ) < abs( values[i] - palette[best] ) ) best = j;
+		}
+
+		bits |= static_cast<unsigned long long>( best ) << ( 3 * i );
+	}
+
+	for ( int k = 0; k < 6; ++k ) block[2 + k] = static_cast<unsigned char>( bits >> ( 8 * k ) );
+}
+
+/* --- BC7 (mode 6) --- */
+
+static const int kBc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+/* count bits from the position of the 128-bit little-endian block */
+static unsigned int Bits( const unsigned char * block, const int position, const int count )
+{
+	unsigned long long half[2];
+	memcpy( half, block, sizeof( half ) );
+
+	const int i = position >> 6;
+	const int shift = position & 63;
+	unsigned long long value = half[i] >> shift;
+
+	if ( shift + count > 64 ) value |= half[1] << ( 64 - shift );
+
+	return static_cast<unsigned int>( value & ( ( 1ull << count ) - 1 ) );
+}
+
+static void WriteBits( unsigned char * block, int & position, const unsigned int value, const int count )
+{
+	for ( int k = 0; k < count; ++k, ++position )
+	{
+		if ( value & ( 1u << k ) ) block[position >> 3] |= static_cast<unsigned char>( 1 << ( position & 7 ) );
+	}
+}
+
+Color3u DecodeBc7( const unsigned char * block, const int i )
+{
+	assert( ( block[0] & 127 ) == 64 ); // mode 6 only
+
+	// 7 mode bits, R0 R1 G0 G1 B0 B1 A0 A1 (7 bits each), P0 P1, 3-bit anchor index and 4-bit indices
+	const int w = kBc7Weights[( i == 0 ) ? Bits( block, 65, 3 ) : Bits( block, 64 + 4 * i, 4 )];
+	const unsigned int p0 = Bits( block, 63, 1 );
+	const unsigned int p1 = Bits( block, 64, 1 );
+	Color3u value;
+
+	for ( int c = 0; c < 3; ++c )
+	{
+		const int e0 = int( ( Bits( block, 7 + 14 * c, 7 ) << 1 ) | p0 );
+		const int e1 = int( ( Bits( block, 14 + 14 * c, 7 ) << 1 ) | p1 );
+		value.data[c] = static_cast<unsigned char>( ( ( 64 - w ) * e0 + w * e1 + 32 ) >> 6 );
+	}
+
+	return value;
+}
+
+/* 7-bit endpoint and the shared bit closest to the 8-bit colour */
+static void QuantizeEndpoint( const float * e, int * q, int & p )
+{
+	float best_error = FLT_MAX;
+
+	for ( int bit = 0; bit < 2; ++bit )
+	{
+		int candidate[3];
+		float error = 0.0f;
+
+		for ( int c = 0; c < 3; ++c )
+		{
+			candidate[c] = max( 0, min( 127, int( ( e[c] - bit ) * 0.5f + 0.5f ) ) );
+			error += sqr( e[c] - ( ( candidate[c] << 1 ) | bit ) );
+		}
+
+		if ( error < best_error )
+		{
+			best_error = error;
+			p = bit;
+			for ( int c = 0; c < 3; ++c ) q[c] = candidate[c];
+		}
+	}
+}
+
+void EncodeBc7( const Color3u * texels, unsigned char * block )
+{
+	float p[16][3];
+
+	for ( int i = 0; i < 16; ++i )
+	{
+		for ( int c = 0; c < 3; ++c ) p[i][c] = texels[i].data[c];
+	}
+
+	float mean[3], axis[3], e0[3], e1[3];
+	PrincipalAxis( p, 16, mean, axis );
+	Extremes( p, 16, mean, axis, e0, e1 );
+
+	int best_error = INT_MAX;
+	int best_q[2][3], best_p[2], best_indices[16];
+
+	for ( int iteration = 0; iteration < 3; ++iteration )
+	{
+		int q[2][3], bits[2];
+		QuantizeEndpoint( e0, q[0], bits[0] );
+		QuantizeEndpoint( e1, q[1], bits[1] );
+
+		Color3u palette[16];
+
+		for ( int j = 0; j < 16; ++j )
+		{
+			for ( int c = 0; c < 3; ++c )
+			{
+				const int a = ( q[0][c] << 1 ) | bits[0];
+				const int b = ( q[1][c] << 1 ) | bits[1];
+				palette[j].data[c] = static_cast<unsigned char>( ( ( 64 - kBc7Weights[j] ) * a + kBc7Weights[j] * b + 32 ) >> 6 );
+			}
+		}
+
+		int indices[16];
+		float weights[16];
+		int error = 0;
+
+		for ( int i = 0; i < 16; ++i )
+		{
+			int best = 0;
+			int best_texel_error = SquaredError( texels[i], palette[0] );
+
+			for ( int j = 1; j < 16; ++j )
+			{
+				const int texel_error = SquaredError( texels[i], palette[j] );
+
+				if ( texel_error < best_texel_error )
+				{
+					best = j;
+					best_texel_error = texel_error;
+				}
+			}
+
+			indices[i] = best;
+			weights[i] = kBc7Weights[best] / 64.0f;
+			error += best_texel_error;
+		}
+
+		if ( error < best_error )
+		{
+			best_error = error;
+			memcpy( best_q, q, sizeof( q ) );
+			memcpy( best_p, bits, sizeof( bits ) );
+			memcpy( best_indices, indices, sizeof( indices ) );
+		}
+
+		if ( error == 0 || !FitEndpoints( p, weights, 16, e0, e1 ) ) break;
+	}
+
+	// the most significant bit of the first index is implicitly zero
+	if ( best_indices[0] & 8 )
+	{
+		for ( int c = 0; c < 3; ++c ) std::swap( best_q[0][c], best_q[1][c] );
+		std::swap( best_p[0], best_p[1] );
+		for ( int i = 0; i < 16; ++i ) best_indices[i] = 15 - best_indices[i];
+	}
+
+	memset( block, 0, 16 );
+	int position = 0;
+	WriteBits( block, position, 64, 7 ); // mode 6
+
+	for ( int c = 0; c < 3; ++c )
+	{
+		WriteBits( block, position, best_q[0][c], 7 );
+		WriteBits( block, position, best_q[1][c], 7 );
+	}
+
+	// alpha endpoints 127, with the shared bits they decode as 254 or 255, Upload reads the alpha as one
+	WriteBits( block, position, 127, 7 );
+	WriteBits( block, position, 127, 7 );
+	WriteBits( block, position, best_p[0], 1 );
+	WriteBits( block, position, best_p[1], 1 );
+
+	for ( int i = 0; i < 16; ++i ) WriteBits( block, position, best_indices[i], ( i == 0 ) ? 3 : 4 );
+}
+
+/* --- CompressedTexture --- */
+
+CompressedTexture::CompressedTexture( const Texture3u & texture, const BlockFormat format ) : format_( format )
+{
+	const int block_bytes = block_size( format );
+
+	for ( int level = 0; level < texture.no_levels(); ++level )
+	{
+		AddLevel( max( 1, texture.width() >> level ), max( 1, texture.height() >> level ) );
+
+		const Level & mip = levels_.back();
+		const int no_blocks_y = ( mip.height + 3 ) / 4;
+
+#pragma omp parallel for schedule( dynamic, 4 )
+		for ( int block_y = 0; block_y < no_blocks_y; ++block_y )
+		{
+			for ( int block_x = 0; block_x < mip.no_blocks_x; ++block_x )
+			{
+				// texels beyond the edge of a level smaller than the block repeat the last row and column
+				Color3u texels[16];
+				unsigned char values[2][16];
+
+				for ( int i = 0; i < 16; ++i )
+				{
+					const int x = min( block_x * 4 + ( i & 3 ), mip.width - 1 );
+					const int y = min( block_y * 4 + ( i >> 2 ), mip.height - 1 );
+					texels[i] = texture.data()[texture.index( x, y, level )];
+					values[0][i] = texels[i].data[0];
+					values[1][i] = texels[i].data[1];
+				}
+
+				unsigned char * block = &blocks_[mip.offset + size_t( block_x + block_y * mip.no_blocks_x ) * block_bytes];
+
+				switch ( format )
+				{
+				case BlockFormat::BC1: EncodeBc1( texels, block ); break;
+				case BlockFormat::BC4: EncodeBc4( values[0], block ); break;
+				case BlockFormat::BC5: EncodeBc4( values[0], block ); EncodeBc4( values[1], block + 8 ); break;
+				case BlockFormat::BC7: EncodeBc7( texels, block ); break;
+				}
+			}
+		}
+	}
+}
+
+void CompressedTexture::AddLevel( const int width, const int height )
+{
+	const Level level{ blocks_.size(), width, height, ( width + 3 ) / 4 };
+	blocks_.resize( blocks_.size() + size_t( level.no_blocks_x ) * size_t( ( height + 3 ) / 4 ) * block_size( format_ ) );
+	levels_.push_back( level );
+}
+
+// header of the saved blocks, the levels follow from the size of the first one, the size and modification time of
+// the source image tell whether the blocks are still up to date
+struct CompressedTextureHeader
+{
+	char magic[4];
+	int format;
+	long long source_size;
+	long long source_time;
+	int width;
+	int height;
+	int no_levels;
+};
+
+/* number of levels of the full mip chain */
+static int MaxLevels( const int width, const int height )
+{
+	int no_levels = 1;
+	while ( ( max( width, height ) >> no_levels ) > 0 ) ++no_levels;
+
+	return no_levels;
+}
+
+CompressedTexture::CompressedTexture( const std::string & file_name )
+{
+	FILE * file = fopen( file_name.c_str(), "rb" );
+
+	if ( !file ) return;
+
+	CompressedTextureHeader header;
+
+	// a damaged header must neither index the tables of the formats nor allocate more blocks than the file holds
+	if ( fread( &header, sizeof( header ), 1, file ) == 1 && memcmp( header.magic, "BCT2", 4 ) == 0 &&
+		header.format >= 0 && header.format <= static_cast<int>( BlockFormat::BC7 ) &&
+		header.width > 0 && header.height > 0 && header.no_levels > 0 &&
+		header.no_levels <= MaxLevels( header.width, header.height ) &&
+		( ( header.width + 3LL ) / 4 ) * ( ( header.height + 3LL ) / 4 ) * block_size( static_cast<BlockFormat>( header.format ) ) <=
+		GetFileSize64( file_name.c_str() ) )
+	{
+		format_ = static_cast<BlockFormat>( header.format );
+		source_size_ = header.source_size;
+		source_time_ = header.source_time;
+
+		for ( int level = 0; level < header.no_levels; ++level )
+		{
+			AddLevel( max( 1, header.width >> level ), max( 1, header.height >> level ) );
+		}
+
+		if ( fread( blocks_.data(), 1, blocks_.size(), file ) != blocks_.size() )
+		{
+			blocks_.clear();
+			levels_.clear();
+		}
+	}
+
+	fclose( file );
+}
+
+bool CompressedTexture::Save( const std::string & file_name ) const
+{
+	FILE * file = fopen( file_name.c_str(), "wb" );
+
+	if ( !file ) return false;
+
+	CompressedTextureHeader header;
+	memset( &header, 0, sizeof( header ) ); // no padding bytes left undefined in the file
+	memcpy( header.magic, "BCT2", 4 );
+	header.format = static_cast<int>( format_ );
+	header.source_size = source_size_;
+	header.source_time = source_time_;
+	header.width = width();
+	header.height = height();
+	header.no_levels = no_levels();
+
+	const bool saved = fwrite( &header, sizeof( header ), 1, file ) == 1 &&
+		fwrite( blocks_.data(), 1, blocks_.size(), file ) == blocks_.size();
+
+	fclose( file );
+
+	return saved;
+}
+
+std::shared_ptr<const CompressedTexture> CompressedTexture::FromFile( const std::string & file_name, const BlockFormat format )
+{
+	static const char * extensions[] = { ".bc1", ".bc4", ".bc5", ".bc7" };
+	const std::string cache_name = file_name + extensions[static_cast<int>( format )];
+
+	const long long source_size = GetFileSize64( file_name.c_str() );
+	const long long source_time = GetFileTime64( file_name.c_str() );
+
+	std::shared_ptr<CompressedTexture> texture = std::make_shared<CompressedTexture>( cache_name );
+
+	// blocks of an image edited since are encoded again, the blocks shipped without their image are used as they are
+	if ( texture->valid() && texture->format() == format && ( source_time == 0 ||
+		( texture->source_size_ == source_size && texture->source_time_ == source_time ) ) )
+	{
+		printf( "Texture '%s' (%d x %d px, %d levels, %0.1f MB) loaded.\n", cache_name.c_str(), texture->width(),
+			texture->height(), texture->no_levels(), texture->memory() / ( 1024.0f * 1024.0f ) );
+
+		return texture;
+	}
+
+	Texture3u image( file_name );
+
+	if ( image.width() < 1 || image.height() < 1 ) return nullptr;
+
+	image.BuildMipmaps();
+	texture = std::make_shared<CompressedTexture>( image, format );
+	texture->source_size_ = source_size;
+	texture->source_time_ = source_time;
+
+	if ( !texture->Save( cache_name ) ) printf( "Texture '%s' not saved.\n", cache_name.c_str() );
+
+	return texture;
+}
+
+Color3u CompressedTexture::pixel( const int x, const int y, const int level ) const
+{
+	const Level & mip = levels_[level];
+	assert( x >= 0 && x < mip.width && y >= 0 && y < mip.height );
+
+	const unsigned char * block = &blocks_[mip.offset + size_t( ( x >> 2 ) + ( y >> 2 ) * mip.no_blocks_x ) * block_size( format_ )];
+	const int i = ( x & 3 ) + 4 * ( y & 3 );
+
+	switch ( format_ )
+	{
+	case BlockFormat::BC1:
+		return DecodeBc1( block, i );
+
+	case BlockFormat::BC4:
+		{
+			const unsigned char value = DecodeBc4( block, i );
+			return Color3u( { value, value, value } );
+		}
+
+	case BlockFormat::BC5:
+		{
+			// unit normal from its x and y
+			const unsigned char x = DecodeBc4( block, i );
+			const unsigned char y = DecodeBc4( block + 8, i );
+			const float nx = x * ( 2.0f / 255.0f ) - 1.0f;
+			const float ny = y * ( 2.0f / 255.0f ) - 1.0f;
+			const float nz = sqrtf( max( 0.0f, 1.0f - nx * nx - ny * ny ) );
+
+			return Color3u( { x, y, static_cast<unsigned char>( ( nz * 0.5f + 0.5f ) * 255.0f + 0.5f ) } );
+		}
+
+	default:
+		return DecodeBc7( block, i );
+	}
+}
+
+Color3u CompressedTexture::Bilinear( const int level, const float u, const float v ) const
+{
+	const Level & mip = levels_[level];
+
+	// the same addressing and 8-bit weights as Texture::texel with TextureWrap::REPEAT
+	const float x = ( u - floorf( u ) ) * mip.width - 0.5f;
+	const float y = ( v - floorf( v ) ) * mip.height - 0.5f;
+	const float x_floor = floorf( x );
+	const float y_floor = floorf( y );
+	const int x0 = ( int( x_floor ) + mip.width ) % mip.width;
+	const int x1 = ( int( x_floor ) + 1 ) % mip.width;
+	const int y0 = ( int( y_floor ) + mip.height ) % mip.height;
+	const int y1 = ( int( y_floor ) + 1 ) % mip.height;
+
+	const Color3u c[4] = { pixel( x0, y0, level ), pixel( x1, y0, level ), pixel( x0, y1, level ), pixel( x1, y1, level ) };
+
+	return Bilerp( c, x - x_floor, y - y_floor );
+}
+
+Color3u CompressedTexture::texel( const float u, const float v ) const
+{
+	return Bilinear( 0, u, v );
+}
+
+Color3u CompressedTexture::texel( const float u, const float v, const float lod ) const
+{
+	const float level = min( max( lod, 0.0f ), float( no_levels() - 1 ) );
+	const int level0 = int( level );
+	const float blend = level - level0;
+	const Color3u value = Bilinear( level0, u, v );
+
+	return ( blend > 0.0f ) ? Lerp( value, Bilinear( level0 + 1, u, v ), blend ) : value;
+}
+
+float CompressedTexture::lod( const float du_dx, const float dv_dx, const float du_dy, const float dv_dy ) const
+{
+	const float sqr_x = sqr( du_dx * width() ) + sqr( dv_dx * height() );
+	const float sqr_y = sqr( du_dy * width() ) + sqr( dv_dy * height() );
+
+	return 0.5f * log2f( max( sqr_x, sqr_y ) );
+}
+
+GLuint CompressedTexture::Upload( const bool srgb ) const
+{
+	static const GLenum formats[2][4] = {
+		{ GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_RED_RGTC1, GL_COMPRESSED_RG_RGTC2, GL_COMPRESSED_RGBA_BPTC_UNORM },
+		{ GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, GL_COMPRESSED_RED_RGTC1, GL_COMPRESSED_RG_RGTC2, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM } };
+	const GLenum internal_format = formats[( srgb ) ? 1 : 0][static_cast<int>( format_ )];
+
+	GLuint id = 0;
+	glGenTextures( 1, &id );
+	glBindTexture( GL_TEXTURE_2D, id );
+
+	for ( int level = 0; level < no_levels(); ++level )
+	{
+		const Level & mip = levels_[level];
+		const size_t size = ( ( level + 1 < no_levels() ) ? levels_[level + 1].offset : blocks_.size() ) - mip.offset;
+
+		glCompressedTexImage2D( GL_TEXTURE_2D, level, internal_format, mip.width, mip.height, 0, GLsizei( size ),
+			&blocks_[mip.offset] );
+	}
+
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, no_levels() - 1 );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, ( no_levels() > 1 ) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	// BC7 carries only RGB, the alpha of the blocks depends on the shared bits chosen for the colour
+	if ( format_ == BlockFormat::BC7 ) glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ONE );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	return id;
+}
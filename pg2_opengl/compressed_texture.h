@@ -0,0 +1,134 @@
+#ifndef COMPRESSED_TEXTURE_H_
+#define COMPRESSED_TEXTURE_H_
+
+#include <memory>
+#include "texture.h"
+
+/* block compression formats of 4 x 4 texels */
+enum class BlockFormat : char
+{
+	BC1 = 0, // RGB 5:6:5 endpoints and 2-bit indices, 8 bytes (colour maps)
+	BC4 = 1, // single channel, 8-bit endpoints and 3-bit indices, 8 bytes (roughness, metallicness, opacity)
+	BC5 = 2, // two BC4 channels, 16 bytes (normal maps, z is reconstructed)
+	BC7 = 3 // RGB(A) with 7-bit endpoints, a shared bit and 4-bit indices (mode 6), 16 bytes (high quality colour)
+};
+
+/* single blocks, the texels go in the row-major order */
+void EncodeBc1( const Color3u * texels, unsigned char * block );
+void EncodeBc4( const unsigned char * values, unsigned char * block );
+void EncodeBc7( const Color3u * texels, unsigned char * block );
+
+/* the i-th texel of a block, the alpha of BC7 is not decoded */
+Color3u DecodeBc1( const unsigned char * block, const int i );
+unsigned char DecodeBc4( const unsigned char * block, const int i );
+Color3u DecodeBc7( const unsigned char * block, const int i );
+
+/*! \class CompressedTexture
+\brief Read-only 8-bit texture stored in 4 x 4 blocks of one of the GPU block compression formats.
+
+The blocks are encoded from a Texture3u (all its mip levels) and decoded texel by texel when sampled, so a
+texture takes 1/6 (BC1, BC4) or 1/3 (BC5, BC7) of the memory of the Texture3u. The same blocks are uploaded as
+a compressed OpenGL texture and can be saved to a file, so the encoding (the slow part) runs once per image.
+
+BC4 returns the value in all three channels, BC5 returns the normal ( x, y ) in the red and green channels with
+z reconstructed in the blue one, BC7 uses only the single subset mode 6 of the format. Its alpha is 254 or 255
+depending on the shared bits of the colour endpoints, so the uploaded BC7 texture reads the alpha as one.
+
+\code{.cpp}
+std::shared_ptr<const CompressedTexture> texture = CompressedTexture::FromFile( "wood.png", BlockFormat::BC1 ); // wood.png.bc1 next time
+const Color3u c = texture->texel( u, v, texture->lod( du_dx, dv_dx, du_dy, dv_dy ) );
+const GLuint id = texture->Upload( true );
+\endcode
+*/
+class CompressedTexture
+{
+public:
+	CompressedTexture( const Texture3u & texture, const BlockFormat format );
+
+	/* blocks saved by Save, check valid() */
+	explicit CompressedTexture( const std::string & file_name );
+
+	/* the blocks from the cache file next to the image if it exists and the image has not changed since (its size
+	and modification time), otherwise the image is loaded, compressed with a mip chain and the cache file written,
+	nullptr if the image cannot be loaded */
+	static std::shared_ptr<const CompressedTexture> FromFile( const std::string & file_name, const BlockFormat format );
+
+	bool Save( const std::string & file_name ) const;
+
+	Color3u pixel( const int x, const int y, const int level = 0 ) const;
+
+	/* bilinear sample of the first level, the coordinates repeat */
+	Color3u texel( const float u, const float v ) const;
+
+	/* trilinear sample (see Texture::texel) */
+	Color3u texel( const float u, const float v, const float lod ) const;
+
+	/* see Texture::lod */
+	float lod( const float du_dx, const float dv_dx, const float du_dy, const float dv_dy ) const;
+
+	/* new texture object with all levels, colour maps are uploaded in one of the sRGB formats */
+	GLuint Upload( const bool srgb ) const;
+
+	bool valid() const
+	{
+		return !levels_.empty();
+	}
+
+	int width() const
+	{
+		return ( valid() ) ? levels_[0].width : 0;
+	}
+
+	int height() const
+	{
+		return ( valid() ) ? levels_[0].height : 0;
+	}
+
+	int no_levels() const
+	{
+		return static_cast<int>( levels_.size() );
+	}
+
+	BlockFormat format() const
+	{
+		return format_;
+	}
+
+	const std::vector<unsigned char> & blocks() const
+	{
+		return blocks_;
+	}
+
+	size_t memory() const
+	{
+		return blocks_.size();
+	}
+
+	static int block_size( const BlockFormat format )
+	{
+		return ( format == BlockFormat::BC1 || format == BlockFormat::BC4 ) ? 8 : 16;
+	}
+
+private:
+	/* a level of the mip chain stored in blocks_ from the offset on */
+	struct Level
+	{
+		size_t offset;
+		int width;
+		int height;
+		int no_blocks_x;
+	};
+
+	void AddLevel( const int width, const int height );
+	Color3u Bilinear( const int level, const float u, const float v ) const;
+
+	std::vector<unsigned char> blocks_;
+	std::vector<Level> levels_;
+
+	BlockFormat format_{ BlockFormat::BC1 };
+
+	long long source_size_{ 0 }; // size and modification time of the image file the blocks were encoded from
+	long long source_time_{ 0 };
+};
+
+#endif
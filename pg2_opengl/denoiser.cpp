@@ -0,0 +1,360 @@
+#include "pch.h"
+#include "denoiser.h"
+#include "mymath.h"
+#include "utils.h"
+
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#endif
+
+static const float kKernel[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f }; // B3 spline
+static const float kAlbedoEpsilon = 1e-2f; // the smallest albedo the radiance is divided by
+static const float kBackgroundInvDepth = 1e4f; // pixels without depth only blend with each other
+
+static inline float Luminance( const float r, const float g, const float b )
+{
+	return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+/* exp( x ) for x <= 0 as 2^i * p( f ), p is a minimax cubic of 2^f on <0, 1), relative error < 4e-4 */
+static inline float FastExp( const float x )
+{
+	const float t = max( x * 1.442695041f, -126.0f );
+	const float i = floorf( t );
+	const float f = t - i;
+	const float p = 1.0f + f * ( 0.695976f + f * ( 0.226411f + f * 0.0781107f ) );
+	const int bits = ( int( i ) + 127 ) << 23;
+	float scale;
+	memcpy( &scale, &bits, sizeof( scale ) );
+
+	return p * scale;
+}
+
+#if defined( __AVX2__ )
+/* eight lanes of FastExp */
+static inline __m256 FastExp8( const __m256 x )
+{
+	const __m256 t = _mm256_max_ps( _mm256_mul_ps( x, _mm256_set1_ps( 1.442695041f ) ), _mm256_set1_ps( -126.0f ) );
+	const __m256 i = _mm256_floor_ps( t );
+	const __m256 f = _mm256_sub_ps( t, i );
+	__m256 p = _mm256_add_ps( _mm256_mul_ps( f, _mm256_set1_ps( 0.0781107f ) ), _mm256_set1_ps( 0.226411f ) );
+	p = _mm256_add_ps( _mm256_mul_ps( f, p ), _mm256_set1_ps( 0.695976f ) );
+	p = _mm256_add_ps( _mm256_mul_ps( f, p ), _mm256_set1_ps( 1.0f ) );
+	const __m256i bits = _mm256_slli_epi32( _mm256_add_epi32( _mm256_cvtps_epi32( i ), _mm256_set1_epi32( 127 ) ), 23 );
+
+	return _mm256_mul_ps( p, _mm256_castsi256_ps( bits ) );
+}
+
+static inline __m256 SqrDiff8( const float * a, const size_t q, const __m256 p )
+{
+	const __m256 d = _mm256_sub_ps( _mm256_loadu_ps( a + q ), p );
+
+	return _mm256_mul_ps( d, d );
+}
+#endif
+
+Denoiser::Denoiser( const Settings & settings )
+{
+	set_settings( settings );
+}
+
+const Denoiser::Settings & Denoiser::settings() const
+{
+	return settings_;
+}
+
+void Denoiser::set_settings( const Settings & settings )
+{
+	assert( settings.iterations >= 0 && settings.tile_size > 0 );
+
+	settings_ = settings;
+}
+
+Texture3f Denoiser::Denoise( const Texture3f & color, const Texture3f & albedo, const Texture3f & normal,
+	const Texture3f & depth )
+{
+	width_ = color.width();
+	height_ = color.height();
+
+	assert( albedo.width() == width_ && normal.width() == width_ && depth.width() == width_ );
+	assert( albedo.height() == height_ && normal.height() == height_ && depth.height() == height_ );
+
+	const int n = width_ * height_;
+
+	for ( int c = 0; c < 3; ++c )
+	{
+		albedo_[c].resize( n );
+		normal_[c].resize( n );
+		tone_[c].resize( n );
+		src_[c].resize( n );
+		dst_[c].resize( n );
+	}
+
+	depth_.resize( n );
+	inv_depth_.resize( n );
+
+	const auto t0 = std::chrono::high_resolution_clock::now();
+
+	// AoS to planar, radiance is demodulated by the albedo
+#pragma omp parallel for
+	for ( int y = 0; y < height_; ++y )
+	{
+		for ( int x = 0; x < width_; ++x )
+		{
+			const int p = y * width_ + x;
+			const Color3f c = color.pixel( x, y );
+			const Color3f a = albedo.pixel( x, y );
+			const Color3f nn = normal.pixel( x, y );
+			const float d = depth.pixel( x, y ).data[0];
+
+			for ( int i = 0; i < 3; ++i )
+			{
+				albedo_[i][p] = max( a.data[i], kAlbedoEpsilon );
+				normal_[i][p] = nn.data[i];
+				src_[i][p] = c.data[i] / albedo_[i][p];
+			}
+
+			depth_[p] = d;
+			inv_depth_[p] = ( d > 0.0f ) ? 1.0f / d : kBackgroundInvDepth;
+		}
+	}
+
+	if ( settings_.clamp_fireflies ) ClampFireflies();
+
+	for ( int i = 0; i < settings_.iterations; ++i )
+	{
+		Iterate( 1 << i, settings_.sigma_color / ( 1 << i ) );
+	}
+
+	// remodulation
+	Texture3f output( width_, height_ );
+
+#pragma omp parallel for
+	for ( int p = 0; p < n; ++p )
+	{
+		Color3f & c = output.data()[p];
+
+		for ( int i = 0; i < 3; ++i )
+		{
+			c.data[i] = src_[i][p] * albedo_[i][p];
+		}
+	}
+
+	const double t = std::chrono::duration<double>( std::chrono::high_resolution_clock::now() - t0 ).count();
+	printf( "Denoised %d x %d px in %s (%0.1f ms/MPix).\n", width_, height_, TimeToString( t ).c_str(),
+		t * 1e3 / ( n * 1e-6 ) );
+
+	return output;
+}
+
+void Denoiser::ClampFireflies()
+{
+#pragma omp parallel for
+	for ( int y = 0; y < height_; ++y )
+	{
+		for ( int x = 0; x < width_; ++x )
+		{
+			const int p = y * width_ + x;
+			float max_luminance = 0.0f;
+
+			for ( int j = max( y - 1, 0 ); j <= min( y + 1, height_ - 1 ); ++j )
+			{
+				for ( int i = max( x - 1, 0 ); i <= min( x + 1, width_ - 1 ); ++i )
+				{
+					const int q = j * width_ + i;
+					if ( q != p ) max_luminance = max( max_luminance, Luminance( src_[0][q], src_[1][q], src_[2][q] ) );
+				}
+			}
+
+			const float luminance = Luminance( src_[0][p], src_[1][p], src_[2][p] );
+			const float scale = ( luminance > max_luminance ) ? max_luminance / luminance : 1.0f;
+
+			for ( int c = 0; c < 3; ++c )
+			{
+				dst_[c][p] = src_[c][p] * scale;
+			}
+		}
+	}
+
+	for ( int c = 0; c < 3; ++c )
+	{
+		src_[c].swap( dst_[c] );
+	}
+}
+
+void Denoiser::Iterate( const int step, const float sigma_color )
+{
+	const int n = width_ * height_;
+
+	// the colour similarity is evaluated on the tone mapped values to be robust to fireflies
+#pragma omp parallel for
+	for ( int p = 0; p < n; ++p )
+	{
+		for ( int i = 0; i < 3; ++i )
+		{
+			tone_[i][p] = src_[i][p] / ( 1.0f + src_[i][p] );
+		}
+	}
+
+	const float inv_sqr_sigma_color = 1.0f / sqr( sigma_color );
+	const int tile_size = settings_.tile_size;
+	const int no_tiles_x = ( width_ + tile_size - 1 ) / tile_size;
+	const int no_tiles_y = ( height_ + tile_size - 1 ) / tile_size;
+
+	// pixels whose taps never leave the image along x may be processed eight at a time
+	const int interior_begin = 2 * step;
+	const int interior_end = width_ - 2 * step;
+
+#pragma omp parallel for schedule( dynamic, 1 )
+	for ( int tile = 0; tile < no_tiles_x * no_tiles_y; ++tile )
+	{
+		const int x0 = ( tile % no_tiles_x ) * tile_size;
+		const int y0 = ( tile / no_tiles_x ) * tile_size;
+		const int x1 = min( x0 + tile_size, width_ );
+		const int y1 = min( y0 + tile_size, height_ );
+
+		for ( int y = y0; y < y1; ++y )
+		{
+			const int begin = min( max( x0, interior_begin ), x1 );
+			const int end = max( min( x1, interior_end ), begin );
+
+			FilterScalar( y, x0, begin, step, inv_sqr_sigma_color );
+			const int rest = FilterVector( y, begin, end, step, inv_sqr_sigma_color );
+			FilterScalar( y, rest, x1, step, inv_sqr_sigma_color );
+		}
+	}
+
+	for ( int i = 0; i < 3; ++i )
+	{
+		src_[i].swap( dst_[i] );
+	}
+}
+
+void Denoiser::FilterScalar( const int y, const int x0, const int x1, const int step, const float inv_sqr_sigma_color )
+{
+	const float inv_sqr_sigma_normal = 1.0f / sqr( settings_.sigma_normal );
+	const float inv_sqr_sigma_depth = 1.0f / sqr( settings_.sigma_depth );
+	const float inv_sqr_sigma_albedo = 1.0f / sqr( settings_.sigma_albedo );
+
+	for ( int x = x0; x < x1; ++x )
+	{
+		const int p = y * width_ + x;
+		float sum[3] = { 0.0f, 0.0f, 0.0f };
+		float sum_weights = 0.0f;
+
+		for ( int j = 0; j < 5; ++j )
+		{
+			const int qy = min( max( y + ( j - 2 ) * step, 0 ), height_ - 1 );
+
+			for ( int i = 0; i < 5; ++i )
+			{
+				const int qx = min( max( x + ( i - 2 ) * step, 0 ), width_ - 1 );
+				const int q = qy * width_ + qx;
+
+				float e_color = 0.0f;
+				float e_normal = 0.0f;
+				float e_albedo = 0.0f;
+
+				for ( int c = 0; c < 3; ++c )
+				{
+					e_color += sqr( tone_[c][q] - tone_[c][p] );
+					e_normal += sqr( normal_[c][q] - normal_[c][p] );
+					e_albedo += sqr( albedo_[c][q] - albedo_[c][p] );
+				}
+
+				const float e_depth = sqr( ( depth_[q] - depth_[p] ) * inv_depth_[p] );
+				const float weight = kKernel[i] * kKernel[j] * FastExp( -( e_color * inv_sqr_sigma_color +
+					e_normal * inv_sqr_sigma_normal + e_depth * inv_sqr_sigma_depth + e_albedo * inv_sqr_sigma_albedo ) );
+
+				for ( int c = 0; c < 3; ++c )
+				{
+					sum[c] += weight * src_[c][q];
+				}
+
+				sum_weights += weight;
+			}
+		}
+
+		// the central tap always has a positive weight
+		for ( int c = 0; c < 3; ++c )
+		{
+			dst_[c][p] = sum[c] / sum_weights;
+		}
+	}
+}
+
+int Denoiser::FilterVector( const int y, const int x0, const int x1, const int step, const float inv_sqr_sigma_color )
+{
+	int x = x0;
+
+#if defined( __AVX2__ )
+	const __m256 inv_sqr_sigma[4] = { _mm256_set1_ps( inv_sqr_sigma_color ),
+		_mm256_set1_ps( 1.0f / sqr( settings_.sigma_normal ) ), _mm256_set1_ps( 1.0f / sqr( settings_.sigma_depth ) ),
+		_mm256_set1_ps( 1.0f / sqr( settings_.sigma_albedo ) ) };
+
+	for ( ; x + 8 <= x1; x += 8 )
+	{
+		const size_t p = size_t( y ) * width_ + x;
+		__m256 tone[3], normal[3], albedo[3], sum[3];
+
+		for ( int c = 0; c < 3; ++c )
+		{
+			tone[c] = _mm256_loadu_ps( &tone_[c][p] );
+			normal[c] = _mm256_loadu_ps( &normal_[c][p] );
+			albedo[c] = _mm256_loadu_ps( &albedo_[c][p] );
+			sum[c] = _mm256_setzero_ps();
+		}
+
+		const __m256 depth = _mm256_loadu_ps( &depth_[p] );
+		const __m256 inv_depth = _mm256_loadu_ps( &inv_depth_[p] );
+		__m256 sum_weights = _mm256_setzero_ps();
+
+		for ( int j = 0; j < 5; ++j )
+		{
+			const int qy = min( max( y + ( j - 2 ) * step, 0 ), height_ - 1 );
+
+			for ( int i = 0; i < 5; ++i )
+			{
+				// eight consecutive pixels, all within the row
+				const size_t q = size_t( qy ) * width_ + x + ( i - 2 ) * step;
+
+				__m256 e_color = SqrDiff8( tone_[0].data(), q, tone[0] );
+				__m256 e_normal = SqrDiff8( normal_[0].data(), q, normal[0] );
+				__m256 e_albedo = SqrDiff8( albedo_[0].data(), q, albedo[0] );
+
+				for ( int c = 1; c < 3; ++c )
+				{
+					e_color = _mm256_add_ps( e_color, SqrDiff8( tone_[c].data(), q, tone[c] ) );
+					e_normal = _mm256_add_ps( e_normal, SqrDiff8( normal_[c].data(), q, normal[c] ) );
+					e_albedo = _mm256_add_ps( e_albedo, SqrDiff8( albedo_[c].data(), q, albedo[c] ) );
+				}
+
+				__m256 e_depth = _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( &depth_[q] ), depth ), inv_depth );
+				e_depth = _mm256_mul_ps( e_depth, e_depth );
+
+				__m256 e = _mm256_mul_ps( e_color, inv_sqr_sigma[0] );
+				e = _mm256_add_ps( _mm256_mul_ps( e_normal, inv_sqr_sigma[1] ), e );
+				e = _mm256_add_ps( _mm256_mul_ps( e_depth, inv_sqr_sigma[2] ), e );
+				e = _mm256_add_ps( _mm256_mul_ps( e_albedo, inv_sqr_sigma[3] ), e );
+
+				const __m256 weight = _mm256_mul_ps( _mm256_set1_ps( kKernel[i] * kKernel[j] ),
+					FastExp8( _mm256_sub_ps( _mm256_setzero_ps(), e ) ) );
+
+				for ( int c = 0; c < 3; ++c )
+				{
+					sum[c] = _mm256_add_ps( _mm256_mul_ps( weight, _mm256_loadu_ps( &src_[c][q] ) ), sum[c] );
+				}
+
+				sum_weights = _mm256_add_ps( sum_weights, weight );
+			}
+		}
+
+		for ( int c = 0; c < 3; ++c )
+		{
+			_mm256_storeu_ps( &dst_[c][p], _mm256_div_ps( sum[c], sum_weights ) );
+		}
+	}
+#endif
+
+	return x;
+}
@@ -0,0 +1,76 @@
+#ifndef DENOISER_H_
+#define DENOISER_H_
+
+#include "texture.h"
+
+/*! \class Denoiser
+\brief Edge-avoiding a-trous wavelet filter guided by albedo, normal and depth buffers (Dammertz et al. 2010).
+
+Isolated fireflies are clamped to the brightest of their eight neighbours first, as no edge-stopping filter can
+spread a single outlier without leaving a blotch. The noisy radiance is divided by the albedo, so that texture detail is not blurred, then filtered by
+a sequence of 5x5 B3-spline kernels with taps spread by 1, 2, 4, ... pixels. Every tap is weighted by the
+similarity of the (tone mapped) colour, normal, relative depth and albedo of the two pixels. The colour sigma
+halves with every iteration as the noise decreases. Finally the albedo is multiplied back.
+
+The image is processed in tiles in parallel, rows of eight pixels are filtered at once with AVX2 if available.
+
+\code{.cpp}
+Texture3f albedo( width, height ), normal( width, height ), depth( width, height );
+tracer.RenderFeatures( 4, albedo, normal, depth );
+Denoiser denoiser;
+const Texture3f output = denoiser.Denoise( tracer.Render( 16 ), albedo, normal, depth );
+\endcode
+*/
+class Denoiser
+{
+public:
+	struct Settings
+	{
+		int iterations{ 5 }; /*!< Number of a-trous passes, the kernel covers 4 * 2^iterations pixels. */
+		float sigma_color{ 0.5f }; /*!< Colour tolerance of the first pass in the tone mapped space c / ( 1 + c ). */
+		float sigma_normal{ 0.25f }; /*!< Tolerance of the distance of unit normals. */
+		float sigma_depth{ 0.05f }; /*!< Tolerance of the relative depth difference. */
+		float sigma_albedo{ 0.1f }; /*!< Tolerance of the albedo difference. */
+		int tile_size{ 64 }; /*!< Size of square tiles processed by individual threads (px). */
+		bool clamp_fireflies{ true }; /*!< Limit the luminance of each pixel by the maximum of its neighbours. */
+	};
+
+	Denoiser() { }
+
+	Denoiser( const Settings & settings );
+
+	/* all buffers must have the same size, depth is taken from the first channel and 0 marks the background */
+	Texture3f Denoise( const Texture3f & color, const Texture3f & albedo, const Texture3f & normal,
+		const Texture3f & depth );
+
+	const Settings & settings() const;
+
+	void set_settings( const Settings & settings );
+
+private:
+	/* src_ to dst_ with every pixel no brighter than its brightest neighbour */
+	void ClampFireflies();
+
+	/* one a-trous pass from src_ to dst_ */
+	void Iterate( const int step, const float sigma_color );
+
+	/* filters pixels <x0, x1) of the row y, the vector version returns the first pixel it did not process */
+	void FilterScalar( const int y, const int x0, const int x1, const int step, const float inv_sqr_sigma_color );
+	int FilterVector( const int y, const int x0, const int x1, const int step, const float inv_sqr_sigma_color );
+
+	Settings settings_;
+
+	int width_{ 0 };
+	int height_{ 0 };
+
+	// planar buffers
+	std::vector<float> albedo_[3];
+	std::vector<float> normal_[3];
+	std::vector<float> depth_;
+	std::vector<float> inv_depth_;
+	std::vector<float> tone_[3]; // c / ( 1 + c ) of src_
+	std::vector<float> src_[3];
+	std::vector<float> dst_[3];
+};
+
+#endif
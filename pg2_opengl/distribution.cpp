@@ -0,0 +1,102 @@
+#include "pch.h"
+#include "distribution.h"
+#include "mymath.h"
+
+/* cdf of n cells of the given values normalized to <0, 1>, uniform if all values are zero, returns the mean value */
+static float BuildCdf( const float * values, const int n, float * cdf )
+{
+	cdf[0] = 0.0f;
+
+	double sum = 0.0;
+
+	for ( int i = 0; i < n; ++i )
+	{
+		assert( values[i] >= 0.0f );
+		sum += values[i];
+		cdf[i + 1] = float( sum );
+	}
+
+	for ( int i = 1; i <= n; ++i )
+	{
+		cdf[i] = ( sum > 0.0 ) ? float( cdf[i] / sum ) : float( i ) / n;
+	}
+
+	cdf[n] = 1.0f;
+
+	return float( sum / n );
+}
+
+Distribution2D::Distribution2D( const std::vector<float> & values, const int width, const int height )
+{
+	Build( values, width, height );
+}
+
+void Distribution2D::Build( const std::vector<float> & values, const int width, const int height )
+{
+	assert( width > 0 && height > 0 && values.size() == size_t( width ) * size_t( height ) );
+
+	width_ = width;
+	height_ = height;
+	values_ = values;
+	conditional_cdf_.resize( size_t( width + 1 ) * size_t( height ) );
+	row_integrals_.resize( height );
+	marginal_cdf_.resize( height + 1 );
+
+	// rows are independent
+#pragma omp parallel for schedule( dynamic, 16 )
+	for ( int y = 0; y < height; ++y )
+	{
+		row_integrals_[y] = BuildCdf( &values_[size_t( y ) * width], width, &conditional_cdf_[size_t( y ) * ( width + 1 )] );
+	}
+
+	integral_ = BuildCdf( row_integrals_.data(), height, marginal_cdf_.data() );
+}
+
+float Distribution2D::SampleContinuous( const float * cdf, const int n, const float ksi, int & cell )
+{
+	// the last cell whose cdf is not greater than ksi, empty cells are skipped
+	cell = min( max( int( std::upper_bound( cdf, cdf + n + 1, ksi ) - cdf ) - 1, 0 ), n - 1 );
+
+	const float width = cdf[cell + 1] - cdf[cell];
+	const float offset = ( width > 0.0f ) ? ( ksi - cdf[cell] ) / width : 0.5f;
+
+	return cell + min( offset, 1.0f - FLT_EPSILON );
+}
+
+Coord2f Distribution2D::Sample( const Coord2f & ksi, float & pdf ) const
+{
+	int x = 0;
+	int y = 0;
+
+	const float v = SampleContinuous( marginal_cdf_.data(), height_, ksi.v, y ) / height_;
+	const float u = SampleContinuous( &conditional_cdf_[size_t( y ) * ( width_ + 1 )], width_, ksi.u, x ) / width_;
+
+	pdf = ( integral_ > 0.0f ) ? values_[size_t( y ) * width_ + x] / integral_ : 1.0f;
+
+	return Coord2f{ u, v };
+}
+
+float Distribution2D::Pdf( const Coord2f & uv ) const
+{
+	if ( integral_ <= 0.0f ) return 1.0f;
+
+	const int x = min( max( int( uv.u * width_ ), 0 ), width_ - 1 );
+	const int y = min( max( int( uv.v * height_ ), 0 ), height_ - 1 );
+
+	return values_[size_t( y ) * width_ + x] / integral_;
+}
+
+int Distribution2D::width() const
+{
+	return width_;
+}
+
+int Distribution2D::height() const
+{
+	return height_;
+}
+
+float Distribution2D::integral() const
+{
+	return integral_;
+}
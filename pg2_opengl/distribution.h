@@ -0,0 +1,55 @@
+#ifndef DISTRIBUTION_H_
+#define DISTRIBUTION_H_
+
+#include "structs.h"
+
+/*! \class Distribution2D
+\brief Piecewise-constant 2D distribution on the unit square sampled by inversion of the marginal and conditional CDFs.
+
+The function is given by a width x height grid of non-negative cell values. Sampling is continuous inside
+the cells, so that stratified and low-discrepancy samples remain well distributed after the warp (unlike
+alias tables which scramble neighbouring sample values).
+
+\code{.cpp}
+Distribution2D distribution( weights, width, height );
+float pdf = 0.0f;
+const Coord2f uv = distribution.Sample( ksi, pdf );
+\endcode
+*/
+class Distribution2D
+{
+public:
+	Distribution2D() { }
+
+	/* row-major grid of non-negative values, rows are processed in parallel */
+	Distribution2D( const std::vector<float> & values, const int width, const int height );
+
+	void Build( const std::vector<float> & values, const int width, const int height );
+
+	/* returns the sampled point in <0, 1)^2 and its density w.r.t. the area of the unit square */
+	Coord2f Sample( const Coord2f & ksi, float & pdf ) const;
+
+	/* density of the given point of the unit square */
+	float Pdf( const Coord2f & uv ) const;
+
+	int width() const;
+	int height() const;
+
+	/* integral of the piecewise-constant function over the unit square */
+	float integral() const;
+
+private:
+	/* inverts the piecewise-linear cdf of n cells, returns the continuous offset in <0, n) and the cell */
+	static float SampleContinuous( const float * cdf, const int n, const float ksi, int & cell );
+
+	int width_{ 0 };
+	int height_{ 0 };
+
+	std::vector<float> values_; // width x height
+	std::vector<float> conditional_cdf_; // ( width + 1 ) x height, normalized per row
+	std::vector<float> row_integrals_; // height
+	std::vector<float> marginal_cdf_; // height + 1
+	float integral_{ 0.0f };
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "pch.h"
+#include "environment_light.h"
+#include "mymath.h"
+#include "utils.h"
+
+static float Luminance( const Color3f & color )
+{
+	return 0.2126f * color.data[0] + 0.7152f * color.data[1] + 0.0722f * color.data[2];
+}
+
+EnvironmentLight::EnvironmentLight( const Texture3f & texture ) : texture_( texture )
+{
+	Build();
+}
+
+EnvironmentLight::EnvironmentLight( const std::string & file_name ) : texture_( file_name )
+{
+	Build();
+}
+
+void EnvironmentLight::Build()
+{
+	const int width = texture_.width();
+	const int height = texture_.height();
+
+	if ( width <= 0 || height <= 0 )
+	{
+		printf( "Environment map is empty, no light will be emitted.\n" );
+
+		return;
+	}
+
+	const auto t0 = std::chrono::high_resolution_clock::now();
+
+	std::vector<float> weights( size_t( width ) * size_t( height ) );
+
+#pragma omp parallel for schedule( dynamic, 16 )
+	for ( int y = 0; y < height; ++y )
+	{
+		const float sin_theta = sinf( float( M_PI ) * ( y + 0.5f ) / height );
+
+		for ( int x = 0; x < width; ++x )
+		{
+			weights[size_t( y ) * width + x] = max( 0.0f, Luminance( texture_.pixel( x, y ) ) ) * sin_theta;
+		}
+	}
+
+	distribution_.Build( weights, width, height );
+
+	const double t = std::chrono::duration<double>( std::chrono::high_resolution_clock::now() - t0 ).count();
+	printf( "Environment map (%d x %d px) sampling distribution built in %s.\n", width, height,
+		TimeToString( t ).c_str() );
+}
+
+Coord2f EnvironmentLight::DirectionToUV( const Vector3 & direction )
+{
+	float phi = atan2f( direction.y, direction.x );
+	if ( phi < 0.0f ) phi += 2.0f * float( M_PI );
+	const float theta = acosf( clamp( direction.z, -1.0f, 1.0f ) );
+
+	return Coord2f{ phi * float( 0.5 * M_1_PI ), theta * float( M_1_PI ) };
+}
+
+Vector3 EnvironmentLight::UVToDirection( const Coord2f & uv )
+{
+	const float phi = 2.0f * float( M_PI ) * uv.u;
+	const float theta = float( M_PI ) * uv.v;
+	const float sin_theta = sinf( theta );
+
+	return Vector3( sin_theta * cosf( phi ), sin_theta * sinf( phi ), cosf( theta ) );
+}
+
+Color3f EnvironmentLight::Le( const Vector3 & direction ) const
+{
+	if ( texture_.width() <= 0 ) return Color3f();
+
+	const Coord2f uv = DirectionToUV( direction );
+	const int x = min( int( uv.u * texture_.width() ), texture_.width() - 1 );
+	const int y = min( int( uv.v * texture_.height() ), texture_.height() - 1 );
+
+	return texture_.pixel( x, y );
+}
+
+Vector3 EnvironmentLight::Sample( const Coord2f & ksi, Color3f & radiance, float & pdf ) const
+{
+	pdf = 0.0f;
+
+	if ( distribution_.integral() <= 0.0f ) return Vector3( 0, 0, 1 );
+
+	float pdf_uv = 0.0f;
+	const Coord2f uv = distribution_.Sample( ksi, pdf_uv );
+	const Vector3 direction = UVToDirection( uv );
+	const float sin_theta = sinf( float( M_PI ) * uv.v );
+
+	if ( sin_theta <= 0.0f ) return direction;
+
+	// dw = 2 pi^2 sin( theta ) du dv
+	pdf = pdf_uv / ( 2.0f * sqr( float( M_PI ) ) * sin_theta );
+	radiance = Le( direction );
+
+	return direction;
+}
+
+float EnvironmentLight::Pdf( const Vector3 & direction ) const
+{
+	if ( distribution_.integral() <= 0.0f ) return 0.0f;
+
+	const float sin_theta = sqrtf( max( 0.0f, 1.0f - sqr( direction.z ) ) );
+
+	if ( sin_theta <= 0.0f ) return 0.0f;
+
+	return distribution_.Pdf( DirectionToUV( direction ) ) / ( 2.0f * sqr( float( M_PI ) ) * sin_theta );
+}
+
+float EnvironmentLight::total_radiance() const
+{
+	// integral of luminance * sin( theta ) over the unit square times the Jacobian 2 pi^2
+	return 2.0f * sqr( float( M_PI ) ) * distribution_.integral();
+}
+
+const Texture3f & EnvironmentLight::texture() const
+{
+	return texture_;
+}
@@ -0,0 +1,54 @@
+#ifndef ENVIRONMENT_LIGHT_H_
+#define ENVIRONMENT_LIGHT_H_
+
+#include "texture.h"
+#include "distribution.h"
+#include "vector3.h"
+
+/*! \class EnvironmentLight
+\brief Distant light given by an HDR environment map in the equirectangular (latitude-longitude) projection.
+
+The top row of the map (v = 0) corresponds to +z, u runs over the azimuth measured from +x towards +y. Directions
+are importance sampled from a piecewise-constant distribution proportional to luminance * sin( theta ) of the
+texels, the sin( theta ) term compensates the area distortion of the projection near the poles. A small sun
+thus receives most of the samples instead of the 1e-5 fraction it would get by uniform sampling.
+
+\code{.cpp}
+EnvironmentLight environment( "../../../data/environment.exr" );
+Color3f radiance;
+float pdf = 0.0f;
+const Vector3 direction = environment.Sample( ksi, radiance, pdf );
+\endcode
+*/
+class EnvironmentLight
+{
+public:
+	EnvironmentLight( const Texture3f & texture );
+
+	EnvironmentLight( const std::string & file_name );
+
+	/* radiance arriving from the given unit direction */
+	Color3f Le( const Vector3 & direction ) const;
+
+	/* samples a unit direction towards the environment, pdf is w.r.t. solid angle, 0 if the map is black */
+	Vector3 Sample( const Coord2f & ksi, Color3f & radiance, float & pdf ) const;
+
+	/* solid angle density of sampling the given unit direction, for MIS */
+	float Pdf( const Vector3 & direction ) const;
+
+	/* integral of the luminance of Le over the whole sphere of directions */
+	float total_radiance() const;
+
+	const Texture3f & texture() const;
+
+	static Coord2f DirectionToUV( const Vector3 & direction );
+	static Vector3 UVToDirection( const Coord2f & uv );
+
+private:
+	void Build();
+
+	Texture3f texture_;
+	Distribution2D distribution_;
+};
+
+#endif
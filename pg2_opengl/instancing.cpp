@@ -0,0 +1,284 @@
+#include "pch.h"
+#include "instancing.h"
+#include "mymath.h"
+#include "utils.h"
+#include <numeric>
+#include <unordered_map>
+
+/* rigid invariants and the hash of the topology of a surface */
+struct SurfaceSignature
+{
+	unsigned long long key;
+	Vector3 centroid;
+	float radius; // RMS distance of the vertices from the centroid
+	float area;
+};
+
+/* three vertices spanning a frame and the frame itself, the slot of the i-th vertex of the t-th triangle is 3 t + i */
+struct SurfaceFrame
+{
+	int a{ -1 }, b{ -1 }, c{ -1 };
+	Matrix3x3 basis;
+};
+
+static Vector3 Position( Surface * surface, const int slot )
+{
+	return surface->get_triangle( slot / 3 ).vertex( slot % 3 ).position;
+}
+
+static SurfaceSignature Sign( Surface * surface )
+{
+	const int no_triangles = surface->no_triangles();
+	std::vector<BYTE> topology;
+
+	auto append = [&]( const void * data, const size_t size ) {
+		topology.insert( topology.end(), static_cast<const BYTE *>( data ), static_cast<const BYTE *>( data ) + size ); };
+
+	const Material * material = surface->get_material();
+	append( &no_triangles, sizeof( no_triangles ) );
+	append( &material, sizeof( material ) );
+
+	SurfaceSignature signature;
+	Vector3 sum( 0, 0, 0 );
+	signature.area = 0.0f;
+
+	for ( int t = 0; t < no_triangles; ++t )
+	{
+		Triangle & triangle = surface->get_triangle( t );
+
+		for ( int i = 0; i < 3; ++i )
+		{
+			const Vertex vertex = triangle.vertex( i );
+			append( &vertex.texture_coords[0], sizeof( Coord2f ) );
+			sum += vertex.position;
+		}
+
+		const Vector3 p0 = triangle.vertex( 0 ).position;
+		signature.area += 0.5f * ( triangle.vertex( 1 ).position - p0 ).CrossProduct( triangle.vertex( 2 ).position - p0 ).L2Norm();
+	}
+
+	signature.key = QuickHash( topology.data(), topology.size() );
+	signature.centroid = sum / float( max( 1, 3 * no_triangles ) );
+
+	double sqr_sum = 0.0;
+
+	for ( int slot = 0; slot < 3 * no_triangles; ++slot )
+	{
+		sqr_sum += ( Position( surface, slot ) - signature.centroid ).SqrL2Norm();
+	}
+
+	signature.radius = float( sqrt( sqr_sum / max( 1, 3 * no_triangles ) ) );
+
+	return signature;
+}
+
+/* orthonormal frame of the given vertices, false if they are (nearly) collinear */
+static bool Frame( Surface * surface, const int a, const int b, const int c, Matrix3x3 & basis )
+{
+	const Vector3 pa = Position( surface, a );
+	Vector3 u = Position( surface, b ) - pa;
+	Vector3 w = u.CrossProduct( Position( surface, c ) - pa );
+
+	if ( u.Normalize() == 0.0f || w.Normalize() == 0.0f ) return false;
+
+	basis = Matrix3x3( u, w.CrossProduct( u ), w );
+
+	return true;
+}
+
+/* picks the most spread vertices of the mesh, the first one, the farthest from it and the farthest from their line */
+static SurfaceFrame PickFrame( Surface * surface )
+{
+	SurfaceFrame frame;
+	const int no_slots = 3 * surface->no_triangles();
+	const Vector3 pa = Position( surface, 0 );
+	float best = 0.0f;
+
+	frame.a = 0;
+
+	for ( int slot = 1; slot < no_slots; ++slot )
+	{
+		const float d = ( Position( surface, slot ) - pa ).SqrL2Norm();
+		if ( d > best ) { best = d; frame.b = slot; }
+	}
+
+	if ( frame.b < 0 ) return SurfaceFrame();
+
+	Vector3 u = Position( surface, frame.b ) - pa;
+	u.Normalize();
+	best = 0.0f;
+
+	for ( int slot = 1; slot < no_slots; ++slot )
+	{
+		const float d = ( Position( surface, slot ) - pa ).CrossProduct( u ).SqrL2Norm();
+		if ( d > best ) { best = d; frame.c = slot; }
+	}
+
+	if ( frame.c < 0 || !Frame( surface, frame.a, frame.b, frame.c, frame.basis ) ) return SurfaceFrame();
+
+	return frame;
+}
+
+/* rigid transformation of the mesh onto the copy if there is one within the tolerance */
+static bool Match( Surface * mesh, const SurfaceFrame & frame, const float max_deviation, Surface * copy,
+	Matrix3x4 & transform )
+{
+	Matrix3x3 copy_basis;
+
+	if ( !Frame( copy, frame.a, frame.b, frame.c, copy_basis ) ) return false;
+
+	const Matrix3x3 rotation = copy_basis * frame.basis.Transpose();
+	transform = Matrix3x4( rotation, Position( copy, frame.a ) - rotation * Position( mesh, frame.a ) );
+
+	const float max_sqr_deviation = sqr( max_deviation );
+
+	for ( int t = 0; t < mesh->no_triangles(); ++t )
+	{
+		Triangle & mesh_triangle = mesh->get_triangle( t );
+		Triangle & copy_triangle = copy->get_triangle( t );
+
+		for ( int i = 0; i < 3; ++i )
+		{
+			const Vertex p = mesh_triangle.vertex( i );
+			const Vertex q = copy_triangle.vertex( i );
+
+			if ( ( transform.TransformPoint( p.position ) - q.position ).SqrL2Norm() > max_sqr_deviation ) return false;
+
+			if ( p.texture_coords[0].u != q.texture_coords[0].u || p.texture_coords[0].v != q.texture_coords[0].v ) return false;
+
+			// unit normals are rotated as vectors, missing (zero) normals match only missing ones
+			if ( ( rotation * p.normal ).DotProduct( q.normal ) < 0.999f * p.normal.L2Norm() * q.normal.L2Norm() ) return false;
+		}
+	}
+
+	return true;
+}
+
+size_t DetectInstances( std::vector<Surface *> & surfaces, std::vector<Instance> & instances, const float tolerance )
+{
+	const auto t0 = std::chrono::high_resolution_clock::now();
+	const int no_surfaces = static_cast<int>( surfaces.size() );
+
+	instances.clear();
+
+	std::vector<SurfaceSignature> signatures( no_surfaces );
+
+#pragma omp parallel for schedule( dynamic, 16 )
+	for ( int s = 0; s < no_surfaces; ++s )
+	{
+		signatures[s] = Sign( surfaces[s] );
+	}
+
+	// buckets of equal topology in the order of their first surface
+	std::unordered_map<unsigned long long, int> bucket_ids;
+	std::vector<std::vector<int>> buckets;
+
+	for ( int s = 0; s < no_surfaces; ++s )
+	{
+		if ( surfaces[s]->no_triangles() == 0 ) continue;
+
+		auto bucket = bucket_ids.emplace( signatures[s].key, static_cast<int>( buckets.size() ) );
+		if ( bucket.second ) buckets.emplace_back();
+		buckets[bucket.first->second].push_back( s );
+	}
+
+	std::vector<int> meshes( no_surfaces ); // index of the surface whose geometry is placed
+	std::vector<Matrix3x4> transforms( no_surfaces );
+	std::iota( meshes.begin(), meshes.end(), 0 );
+
+	const int no_buckets = static_cast<int>( buckets.size() );
+
+#pragma omp parallel for schedule( dynamic, 1 )
+	for ( int b = 0; b < no_buckets; ++b )
+	{
+		std::vector<int> & bucket = buckets[b];
+
+		if ( bucket.size() < 2 ) continue;
+
+		std::stable_sort( bucket.begin(), bucket.end(), [&]( const int i, const int j ) {
+			return signatures[i].radius < signatures[j].radius; } );
+
+		// distinct meshes of the bucket found so far, sorted by radius as the surfaces are
+		std::vector<int> distinct;
+		std::vector<SurfaceFrame> frames;
+
+		for ( const int s : bucket )
+		{
+			const SurfaceSignature & signature = signatures[s];
+			const float max_deviation = tolerance * signature.radius;
+			bool found = false;
+
+			for ( int k = static_cast<int>( distinct.size() ) - 1; k >= 0 && !found; --k )
+			{
+				const SurfaceSignature & other = signatures[distinct[k]];
+
+				if ( other.radius < signature.radius - 2.0f * max_deviation ) break;
+				if ( fabsf( other.area - signature.area ) > 2.0f * tolerance * signature.area ) continue;
+				if ( frames[k].a < 0 ) continue;
+
+				if ( Match( surfaces[distinct[k]], frames[k], max_deviation, surfaces[s], transforms[s] ) )
+				{
+					meshes[s] = distinct[k];
+					found = true;
+				}
+			}
+
+			if ( !found )
+			{
+				transforms[s] = Matrix3x4(); // a failed match may have left a candidate there
+				distinct.push_back( s );
+				frames.push_back( PickFrame( surfaces[s] ) );
+			}
+		}
+	}
+
+	// keep the distinct meshes in their original order, place every original surface
+	std::vector<int> new_ids( no_surfaces, -1 );
+	std::vector<Surface *> kept;
+	size_t no_triangles_before = 0;
+	size_t no_triangles_after = 0;
+
+	for ( int s = 0; s < no_surfaces; ++s )
+	{
+		no_triangles_before += surfaces[s]->no_triangles();
+
+		if ( meshes[s] == s )
+		{
+			new_ids[s] = static_cast<int>( kept.size() );
+			kept.push_back( surfaces[s] );
+			no_triangles_after += surfaces[s]->no_triangles();
+		}
+	}
+
+	const int no_duplicates = no_surfaces - static_cast<int>( kept.size() );
+
+	if ( no_duplicates == 0 )
+	{
+		printf( "No instances found among %d surfaces.\n", no_surfaces );
+
+		return 0;
+	}
+
+	instances.resize( no_surfaces );
+
+	for ( int s = 0; s < no_surfaces; ++s )
+	{
+		instances[s].surface_id = new_ids[meshes[s]];
+		instances[s].transform = transforms[s]; // identity for the meshes themselves
+
+		if ( meshes[s] != s ) SAFE_DELETE( surfaces[s] );
+	}
+
+	surfaces = kept;
+
+	const size_t bytes_before = no_triangles_before * sizeof( Triangle );
+	const size_t bytes_after = no_triangles_after * sizeof( Triangle ) + instances.size() * sizeof( Instance );
+	const size_t saved = ( bytes_before > bytes_after ) ? bytes_before - bytes_after : 0;
+
+	const double t = std::chrono::duration<double>( std::chrono::high_resolution_clock::now() - t0 ).count();
+	printf( "%d surfaces collapsed into %I64u meshes and %I64u instances in %s, %I64u -> %I64u triangles, %0.1f MB -> %0.1f MB\n",
+		no_surfaces, surfaces.size(), instances.size(), TimeToString( t ).c_str(), no_triangles_before,
+		no_triangles_after, bytes_before / ( 1024.0 * 1024.0 ), bytes_after / ( 1024.0 * 1024.0 ) );
+
+	return saved;
+}
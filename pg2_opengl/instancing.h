@@ -0,0 +1,39 @@
+#ifndef INSTANCING_H_
+#define INSTANCING_H_
+
+#include "scene.h"
+
+/*! \fn size_t DetectInstances( std::vector<Surface *> & surfaces, std::vector<Instance> & instances, const float tolerance )
+\brief Collapses surfaces that are rigid transformations (rotation and translation) of one another into instances.
+
+Exported OBJ files flatten instancing, every copy of an object is a separate group with transformed vertices.
+Surfaces are bucketed by QuickHash of their topology (number of triangles, material and texture coordinates,
+which rigid transformations do not change). Within a bucket the surfaces are sorted by two continuous rigid
+invariants of their geometry (RMS distance of the vertices from their centroid and the total area) and compared
+only with the earlier distinct meshes of similar invariants. Quantized geometry is deliberately not hashed, as
+two copies differing by rounding would fall into different buckets near a quantization boundary.
+
+A candidate is matched by the rotation aligning the frames spanned by the same three well spread vertices of both
+surfaces, the transformation is accepted if it maps every vertex of the mesh within tolerance * RMS radius
+of the corresponding vertex of the copy and the normals agree. Mirrored copies are not detected.
+
+On return surfaces holds the distinct meshes only (the duplicates are deleted) and instances places every
+original surface, in the original order, by a transformation of its mesh (identity for the meshes themselves).
+If no duplicates were found, instances is left empty so that the Scene keeps the single-level BVH.
+
+\code{.cpp}
+LoadOBJ( file_name, surfaces, materials );
+std::vector<Instance> instances;
+DetectInstances( surfaces, instances );
+Scene scene( surfaces, materials, instances );
+\endcode
+
+\param surfaces loaded surfaces, modified in place.
+\param instances output placements of the surfaces.
+\param tolerance maximal vertex deviation relative to the size of the surface.
+\return Number of bytes of triangle data saved.
+*/
+size_t DetectInstances( std::vector<Surface *> & surfaces, std::vector<Instance> & instances,
+	const float tolerance = 1e-3f );
+
+#endif
@@ -0,0 +1,390 @@
+#include "pch.h"
+#include "lights.h"
+#include "utils.h"
+
+/* union of two cones of lines, i.e. ( axis, -axis ) are the same cone (Conty Estevez & Kulla 2018) */
+static void ConeUnion( Vector3 axis_1, float theta_1, Vector3 axis_2, float theta_2, Vector3 & axis, float & theta )
+{
+	const float half_pi = float( M_PI ) * 0.5f;
+
+	if ( axis_1.DotProduct( axis_2 ) < 0.0f ) axis_2 = -axis_2;
+
+	if ( theta_1 < theta_2 )
+	{
+		utils::swap( axis_1, axis_2 );
+		utils::swap( theta_1, theta_2 );
+	}
+
+	const float theta_d = acosf( clamp( axis_1.DotProduct( axis_2 ), -1.0f, 1.0f ) );
+
+	axis = axis_1;
+	theta = theta_1;
+
+	if ( theta_d + theta_2 <= theta_1 ) return; // the first cone contains the second one
+
+	const float theta_o = 0.5f * ( theta_1 + theta_d + theta_2 );
+
+	if ( theta_o >= half_pi )
+	{
+		theta = half_pi;
+		return;
+	}
+
+	theta = theta_o;
+
+	if ( theta_d < 1e-6f ) return;
+
+	// rotate the first axis towards the second one
+	const float theta_r = theta_o - theta_1;
+	const Vector3 ortho = ( axis_2 - axis_1 * cosf( theta_d ) ) / sinf( theta_d );
+	axis = axis_1 * cosf( theta_r ) + ortho * sinf( theta_r );
+	axis.Normalize();
+}
+
+Lights::Lights( const Scene & scene, const Strategy strategy )
+{
+	strategy_ = strategy;
+
+	// every placement of an emissive surface contributes its own world space triangles
+	const std::vector<Surface *> & surfaces = scene.surfaces();
+	const std::vector<Instance> & instances = scene.instances();
+	const int no_placements = static_cast<int>( ( instances.empty() ) ? surfaces.size() : instances.size() );
+	first_light_.assign( no_placements, -1 );
+
+	std::vector<float> powers;
+
+	for ( int p = 0; p < no_placements; ++p )
+	{
+		const int s = ( instances.empty() ) ? p : instances[p].surface_id;
+
+		if ( s < 0 ) continue; // removed instance
+		const Color3f emission = scene.material( scene.surface_material_id( s ) )->emission();
+
+		if ( emission.max_value() <= 0.0f ) continue;
+
+		first_light_[p] = no_lights();
+
+		for ( int t = 0; t < surfaces[s]->no_triangles(); ++t )
+		{
+			Triangle & triangle = surfaces[s]->get_triangle( t );
+			EmissiveTriangle light;
+
+			light.p0 = triangle.vertex( 0 ).position;
+			light.p1 = triangle.vertex( 1 ).position;
+			light.p2 = triangle.vertex( 2 ).position;
+
+			if ( !instances.empty() )
+			{
+				light.p0 = instances[p].transform.TransformPoint( light.p0 );
+				light.p1 = instances[p].transform.TransformPoint( light.p1 );
+				light.p2 = instances[p].transform.TransformPoint( light.p2 );
+			}
+
+			light.normal = ( light.p1 - light.p0 ).CrossProduct( light.p2 - light.p0 );
+			light.area = 0.5f * light.normal.Normalize();
+			light.emission = emission;
+			light.power = 2.0f * float( M_PI ) * light.area *
+				( emission.data[0] + emission.data[1] + emission.data[2] ) / 3.0f;
+
+			lights_.push_back( light ); // degenerate triangles stay with zero power to keep the indices
+			powers.push_back( light.power );
+		}
+	}
+
+	if ( lights_.empty() )
+	{
+		printf( "No emissive triangles found.\n" );
+
+		return;
+	}
+
+	power_distribution_.Build( powers );
+
+	// light tree, the leaves hold single emitters
+	std::vector<Aabb> bounds( lights_.size() );
+
+	for ( int i = 0; i < no_lights(); ++i )
+	{
+		bounds[i].Grow( lights_[i].p0 );
+		bounds[i].Grow( lights_[i].p1 );
+		bounds[i].Grow( lights_[i].p2 );
+	}
+
+	tree_bvh_.Build( bounds, 1 );
+
+	const std::vector<BvhNode> & nodes = tree_bvh_.nodes();
+	tree_nodes_.resize( nodes.size() );
+	light_leaves_.resize( lights_.size() );
+	tree_nodes_[0].parent = -1;
+
+	// children are always stored after their parents
+	for ( int i = static_cast<int>( nodes.size() ) - 1; i >= 0; --i )
+	{
+		LightNode & node = tree_nodes_[i];
+		node.bounds = nodes[i].bounds;
+
+		if ( nodes[i].is_leaf() )
+		{
+			Vector3 axis = lights_[tree_bvh_.indices()[nodes[i].left_first]].normal;
+			float theta = 0.0f;
+			node.power = 0.0f;
+
+			for ( int j = nodes[i].left_first; j < nodes[i].left_first + nodes[i].count; ++j )
+			{
+				const EmissiveTriangle & light = lights_[tree_bvh_.indices()[j]];
+				ConeUnion( axis, theta, light.normal, 0.0f, axis, theta );
+				node.power += light.power;
+				light_leaves_[tree_bvh_.indices()[j]] = i;
+			}
+
+			node.axis = axis;
+			node.cos_theta_o = cosf( theta );
+		}
+		else
+		{
+			const LightNode & left = tree_nodes_[nodes[i].left_first];
+			const LightNode & right = tree_nodes_[nodes[i].left_first + 1];
+			float theta = 0.0f;
+
+			ConeUnion( left.axis, acosf( left.cos_theta_o ), right.axis, acosf( right.cos_theta_o ), node.axis, theta );
+			node.cos_theta_o = cosf( theta );
+			node.power = left.power + right.power;
+
+			tree_nodes_[nodes[i].left_first].parent = i;
+			tree_nodes_[nodes[i].left_first + 1].parent = i;
+		}
+	}
+
+	printf( "%d emissive triangles, total power %0.1f W, light tree with %I64u nodes.\n",
+		no_lights(), total_power(), tree_nodes_.size() );
+}
+
+float Lights::Importance( const LightNode & node, const Vector3 & position, const Vector3 & normal ) const
+{
+	if ( node.power <= 0.0f ) return 0.0f;
+
+	const Vector3 center = node.bounds.centroid();
+	const float radius = 0.5f * node.bounds.extent().L2Norm();
+	Vector3 direction = center - position;
+	const float sqr_distance = direction.SqrL2Norm();
+
+	if ( sqr_distance <= sqr( radius ) )
+	{
+		return node.power / max( sqr( radius ), 1e-12f ); // inside the bounds, no angular bounds apply
+	}
+
+	const float distance = sqrtf( sqr_distance );
+	direction /= distance;
+
+	// half-angle subtended by the bounding sphere
+	const float sin_theta_u = radius / distance;
+	const float cos_theta_u = sqrtf( 1.0f - sqr( sin_theta_u ) );
+
+	// cosine of the smallest possible angle between the emitter normals and the direction towards the shading
+	// point, i.e. cos( max( 0, theta - theta_o - theta_u ) ) expanded without inverse trigonometric functions
+	const float cos_theta = min( 1.0f, fabsf( node.axis.DotProduct( direction ) ) );
+	float cos_theta_e = 1.0f;
+
+	if ( cos_theta < node.cos_theta_o )
+	{
+		const float sin_theta = sqrtf( 1.0f - sqr( cos_theta ) );
+		const float sin_theta_o = sqrtf( max( 0.0f, 1.0f - sqr( node.cos_theta_o ) ) );
+		const float cos_theta_a = cos_theta * node.cos_theta_o + sin_theta * sin_theta_o; // theta - theta_o
+
+		if ( cos_theta_a < cos_theta_u )
+		{
+			const float sin_theta_a = sin_theta * node.cos_theta_o - cos_theta * sin_theta_o;
+			cos_theta_e = cos_theta_a * cos_theta_u + sin_theta_a * sin_theta_u;
+		}
+	}
+
+	if ( cos_theta_e <= 0.0f ) return 0.0f;
+
+	// cosine of the smallest possible angle of incidence at the shading point
+	const float cos_theta_i = clamp( normal.DotProduct( direction ), -1.0f, 1.0f );
+	float cos_theta_r = 1.0f;
+
+	if ( cos_theta_i < cos_theta_u )
+	{
+		cos_theta_r = cos_theta_i * cos_theta_u + sqrtf( 1.0f - sqr( cos_theta_i ) ) * sin_theta_u;
+	}
+
+	if ( cos_theta_r <= 0.0f ) return 0.0f;
+
+	return node.power * cos_theta_e * cos_theta_r / sqr_distance;
+}
+
+float Lights::LeftProbability( const int node_index, const Vector3 & position, const Vector3 & normal ) const
+{
+	const int left = tree_bvh_.nodes()[node_index].left_first;
+	const float importance_left = Importance( tree_nodes_[left], position, normal );
+	const float importance_right = Importance( tree_nodes_[left + 1], position, normal );
+
+	if ( importance_left + importance_right > 0.0f )
+	{
+		return importance_left / ( importance_left + importance_right );
+	}
+
+	// nothing is expected to contribute, keep every emitter reachable anyway
+	const float power = tree_nodes_[left].power + tree_nodes_[left + 1].power;
+
+	return ( power > 0.0f ) ? tree_nodes_[left].power / power : 0.5f;
+}
+
+int Lights::Pick( const Vector3 & position, const Vector3 & normal, float ksi, float & pmf ) const
+{
+	const int n = no_lights();
+
+	switch ( strategy_ )
+	{
+	case Strategy::UNIFORM:
+		pmf = 1.0f / n;
+		return min( int( ksi * n ), n - 1 );
+
+	case Strategy::POWER:
+		return power_distribution_.Sample( ksi, pmf );
+
+	default:
+		break;
+	}
+
+	// descend the light tree reusing the random number
+	const std::vector<BvhNode> & nodes = tree_bvh_.nodes();
+	int node_index = 0;
+	pmf = 1.0f;
+
+	while ( !nodes[node_index].is_leaf() )
+	{
+		const float p_left = LeftProbability( node_index, position, normal );
+
+		if ( ksi < p_left )
+		{
+			ksi /= p_left;
+			pmf *= p_left;
+			node_index = nodes[node_index].left_first;
+		}
+		else
+		{
+			ksi = min( ( ksi - p_left ) / ( 1.0f - p_left ), 1.0f - FLT_EPSILON );
+			pmf *= 1.0f - p_left;
+			node_index = nodes[node_index].left_first + 1;
+		}
+	}
+
+	// multiple emitters in a leaf are picked by power
+	const BvhNode & leaf = nodes[node_index];
+	const float leaf_power = tree_nodes_[node_index].power;
+	float cdf = 0.0f;
+
+	for ( int j = leaf.left_first; j < leaf.left_first + leaf.count; ++j )
+	{
+		const int light = tree_bvh_.indices()[j];
+		const float p = ( leaf_power > 0.0f ) ? lights_[light].power / leaf_power : 1.0f / leaf.count;
+		cdf += p;
+
+		if ( ksi < cdf || j == leaf.left_first + leaf.count - 1 )
+		{
+			pmf *= p;
+			return light;
+		}
+	}
+
+	return -1;
+}
+
+float Lights::Pmf( const Vector3 & position, const Vector3 & normal, const int light ) const
+{
+	switch ( strategy_ )
+	{
+	case Strategy::UNIFORM: return 1.0f / no_lights();
+	case Strategy::POWER: return power_distribution_.pmf( light );
+	default: break;
+	}
+
+	int node_index = light_leaves_[light];
+	const BvhNode & leaf = tree_bvh_.nodes()[node_index];
+	const float leaf_power = tree_nodes_[node_index].power;
+	float pmf = ( leaf_power > 0.0f ) ? lights_[light].power / leaf_power : 1.0f / leaf.count;
+
+	// walk up to the root multiplying the probabilities of the choices made on the way down
+	while ( tree_nodes_[node_index].parent >= 0 )
+	{
+		const int parent = tree_nodes_[node_index].parent;
+		const float p_left = LeftProbability( parent, position, normal );
+		pmf *= ( tree_bvh_.nodes()[parent].left_first == node_index ) ? p_left : 1.0f - p_left;
+		node_index = parent;
+	}
+
+	return pmf;
+}
+
+bool Lights::Sample( const Vector3 & position, const Vector3 & normal, const float ksi_select, const Coord2f & ksi_point,
+	LightSample & sample ) const
+{
+	if ( lights_.empty() ) return false;
+
+	float pmf = 0.0f;
+	const int light = Pick( position, normal, ksi_select, pmf );
+
+	if ( light < 0 || pmf <= 0.0f || lights_[light].area <= 0.0f ) return false;
+
+	// uniform point on the triangle
+	const EmissiveTriangle & triangle = lights_[light];
+	const float su = sqrtf( ksi_point.u );
+	const float b0 = 1.0f - su;
+	const float b1 = ksi_point.v * su;
+
+	sample.position = triangle.p0 * b0 + triangle.p1 * b1 + triangle.p2 * ( 1.0f - b0 - b1 );
+	sample.normal = triangle.normal;
+	sample.emission = triangle.emission;
+	sample.pdf = pmf / triangle.area;
+	sample.light = light;
+
+	return true;
+}
+
+float Lights::Pdf( const Vector3 & position, const Vector3 & normal, const RayHit & hit ) const
+{
+	const int light = light_id( hit );
+
+	if ( light < 0 || lights_[light].area <= 0.0f ) return 0.0f;
+
+	return Pmf( position, normal, light ) / lights_[light].area;
+}
+
+int Lights::light_id( const RayHit & hit ) const
+{
+	const int first_light = first_light_[( hit.instance_id >= 0 ) ? hit.instance_id : hit.surface_id];
+
+	return ( first_light >= 0 ) ? first_light + hit.triangle_id : -1;
+}
+
+int Lights::SampleByPower( const float ksi, float & pmf ) const
+{
+	return power_distribution_.Sample( ksi, pmf );
+}
+
+const EmissiveTriangle & Lights::light( const int i ) const
+{
+	return lights_[i];
+}
+
+int Lights::no_lights() const
+{
+	return static_cast<int>( lights_.size() );
+}
+
+float Lights::total_power() const
+{
+	return float( power_distribution_.total_weight() );
+}
+
+Lights::Strategy Lights::strategy() const
+{
+	return strategy_;
+}
+
+void Lights::set_strategy( const Strategy strategy )
+{
+	strategy_ = strategy;
+}
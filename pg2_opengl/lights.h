@@ -0,0 +1,103 @@
+#ifndef LIGHTS_H_
+#define LIGHTS_H_
+
+#include "scene.h"
+#include "alias_table.h"
+
+/*! \struct EmissiveTriangle
+\brief A triangle of a surface whose material has non-zero emission. Emission is two-sided.
+*/
+struct EmissiveTriangle
+{
+	Vector3 p0, p1, p2; /*!< Vertices. */
+	Vector3 normal; /*!< Unit geometric normal. */
+	float area; /*!< Area of the triangle. */
+	float power; /*!< Emitted flux of both sides, 2 * pi * area * average radiance. */
+	Color3f emission; /*!< Emitted radiance. */
+};
+
+/*! \struct LightSample
+\brief A point sampled on an emitter.
+*/
+struct LightSample
+{
+	Vector3 position; /*!< Sampled point. */
+	Vector3 normal; /*!< Unit normal of the emitter. */
+	Color3f emission; /*!< Emitted radiance. */
+	float pdf; /*!< Probability density of the point w.r.t. area including the choice of the emitter. */
+	int light; /*!< Index of the emitter. */
+};
+
+/*! \class Lights
+\brief All emissive triangles of the scene and the strategies to pick one of them for a shading point.
+
+UNIFORM - every emitter has the same probability
+POWER - probability proportional to the emitted power, O(1) sampling from an alias table
+TREE - light BVH (Conty Estevez & Kulla 2018), each interior node stores the total power, bounds and a cone
+of emitter normals; the traversal chooses a child proportionally to an upper estimate of its contribution
+to the shading point, so that nearby and facing emitters are preferred even among 100k+ emitters.
+
+\code{.cpp}
+Lights lights( scene, Lights::Strategy::TREE );
+LightSample sample;
+if ( lights.Sample( position, normal, ksi_0, ksi_12, sample ) ) { ... }
+\endcode
+*/
+class Lights
+{
+public:
+	enum class Strategy : char { UNIFORM = 0, POWER = 1, TREE = 2 };
+
+	Lights( const Scene & scene, const Strategy strategy = Strategy::TREE );
+
+	/* picks an emitter for the shading point (position, normal) by ksi_select and a point on it by ksi_point */
+	bool Sample( const Vector3 & position, const Vector3 & normal, const float ksi_select, const Coord2f & ksi_point,
+		LightSample & sample ) const;
+
+	/* area density of sampling the hit point on an emitter from the shading point (position, normal), for MIS */
+	float Pdf( const Vector3 & position, const Vector3 & normal, const RayHit & hit ) const;
+
+	/* index of the emitter corresponding to the hit or -1 */
+	int light_id( const RayHit & hit ) const;
+
+	/* picks an emitter proportionally to its power regardless of any shading point */
+	int SampleByPower( const float ksi, float & pmf ) const;
+
+	const EmissiveTriangle & light( const int i ) const;
+
+	int no_lights() const;
+
+	float total_power() const;
+
+	Strategy strategy() const;
+
+	void set_strategy( const Strategy strategy );
+
+private:
+	struct LightNode
+	{
+		Aabb bounds;
+		Vector3 axis; // axis of the cone of normals (as lines, i.e. sign does not matter)
+		float cos_theta_o; // cosine of the cone spread
+		float power;
+		int parent;
+	};
+
+	int Pick( const Vector3 & position, const Vector3 & normal, float ksi, float & pmf ) const;
+	float Pmf( const Vector3 & position, const Vector3 & normal, const int light ) const;
+	float Importance( const LightNode & node, const Vector3 & position, const Vector3 & normal ) const;
+	float LeftProbability( const int node_index, const Vector3 & position, const Vector3 & normal ) const;
+
+	std::vector<EmissiveTriangle> lights_;
+	std::vector<int> first_light_; // index of the first emitter of each surface (or instance) or -1
+	AliasTable power_distribution_;
+
+	// light tree over the emitters, topology shared with tree_bvh_
+	Bvh tree_bvh_;
+	std::vector<LightNode> tree_nodes_;
+	std::vector<int> light_leaves_; // leaf node of each emitter
+
+	Strategy strategy_{ Strategy::TREE };
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "pch.h"
+#include "linear_texture.h"
+#include "material.h"
+
+/*! \class LinearTextureOf
+\brief LinearTexture kept in a Texture of the given texel type.
+*/
+template <class T>
+class LinearTextureOf : public LinearTexture
+{
+public:
+	LinearTextureOf( const Texture3u & texture, const ColorMapStorage storage ) : texture_( texture ), storage_( storage )
+	{
+	}
+
+	using LinearTexture::texel;
+
+	bool texel( const float u, const float v, const float lod, Color3f & value ) const override
+	{
+		value = texture_.texel( u, v, lod );
+
+		return true;
+	}
+
+	float lod( const float du_dx, const float dv_dx, const float du_dy, const float dv_dy ) const override
+	{
+		return texture_.lod( du_dx, dv_dx, du_dy, dv_dy );
+	}
+
+	size_t memory() const override
+	{
+		return texture_.memory();
+	}
+
+	ColorMapStorage storage() const override
+	{
+		return storage_;
+	}
+
+private:
+	Texture<T, FIT_RGBF> texture_;
+	ColorMapStorage storage_;
+};
+
+bool LinearTexture::texel( const float u, const float v, const float lod, Color3u & value ) const
+{
+	Color3f linear;
+	texel( u, v, lod, linear );
+	value = Color3u( linear );
+
+	return true;
+}
+
+LinearTexture * LinearTexture::Create( const Texture3u & texture, const ColorMapStorage storage )
+{
+	switch ( storage )
+	{
+	case ColorMapStorage::LINEAR16: return new LinearTextureOf<Color3us>( texture, storage );
+	case ColorMapStorage::HALF: return new LinearTextureOf<Color3h>( texture, storage );
+	case ColorMapStorage::FLOAT: return new LinearTextureOf<Color3f>( texture, storage );
+	default: return nullptr;
+	}
+}
+
+int TexelSize( const ColorMapStorage storage )
+{
+	switch ( storage )
+	{
+	case ColorMapStorage::LINEAR16: return int( sizeof( Color3us ) );
+	case ColorMapStorage::HALF: return int( sizeof( Color3h ) );
+	case ColorMapStorage::FLOAT: return int( sizeof( Color3f ) );
+	default: return int( sizeof( Color3u ) );
+	}
+}
+
+const char * ToString( const ColorMapStorage storage )
+{
+	switch ( storage )
+	{
+	case ColorMapStorage::SRGB8: return "sRGB8";
+	case ColorMapStorage::LINEAR16: return "linear16";
+	case ColorMapStorage::HALF: return "half";
+	case ColorMapStorage::FLOAT: return "float";
+	default: return "auto";
+	}
+}
+
+ColorMapStorage SelectColorMapStorage( const size_t no_texels, const size_t budget )
+{
+	// from the fastest lookups to the slowest ones, 16-bit values are also half the size of floats
+	const ColorMapStorage storages[] = { ColorMapStorage::LINEAR16, ColorMapStorage::FLOAT, ColorMapStorage::HALF };
+
+	for ( const ColorMapStorage storage : storages )
+	{
+		if ( no_texels * TexelSize( storage ) <= budget ) return storage;
+	}
+
+	return ColorMapStorage::SRGB8;
+}
+
+ColorMapStorage LinearizeColorMaps( std::vector<Material *> & materials, ColorMapStorage storage, const size_t budget )
+{
+	const char slots[] = { Material::kDiffuseMapSlot, Material::kSpecularMapSlot };
+
+	std::map<const Texture3u *, std::shared_ptr<const LinearTexture>> linear_textures;
+	size_t no_texels = 0;
+
+	for ( const Material * material : materials )
+	{
+		for ( const char slot : slots )
+		{
+			const Texture3u * texture = material->texture( slot );
+
+			if ( texture && linear_textures.find( texture ) == linear_textures.end() )
+			{
+				linear_textures[texture] = nullptr;
+				no_texels += texture->memory() / sizeof( Color3u );
+			}
+		}
+	}
+
+	if ( storage == ColorMapStorage::AUTO ) storage = SelectColorMapStorage( no_texels, budget );
+
+	if ( storage == ColorMapStorage::SRGB8 || linear_textures.empty() ) return storage;
+
+	for ( auto & linear_texture : linear_textures )
+	{
+		linear_texture.second.reset( LinearTexture::Create( *linear_texture.first, storage ) );
+	}
+
+	// the linear copy replaces the sRGB texture of the slot, the sRGB textures are released with the last material
+	// using them, so only the linear copies stay in memory
+	for ( Material * material : materials )
+	{
+		for ( const char slot : slots )
+		{
+			const Texture3u * texture = material->texture( slot );
+
+			if ( texture ) material->set_texture( slot, linear_textures[texture] );
+		}
+	}
+
+	printf( "Color maps: %d textures stored as %s (%0.1f MB instead of %0.1f MB).\n", int( linear_textures.size() ),
+		ToString( storage ), no_texels * TexelSize( storage ) / ( 1024.0f * 1024.0f ),
+		no_texels * sizeof( Color3u ) / ( 1024.0f * 1024.0f ) );
+
+	return storage;
+}
@@ -0,0 +1,63 @@
+#ifndef LINEAR_TEXTURE_H_
+#define LINEAR_TEXTURE_H_
+
+#include <memory>
+#include "texture_sampler.h"
+
+class Material;
+
+/* storage of the colour maps (diffuse and specular) of materials */
+enum class ColorMapStorage : char
+{
+	SRGB8 = 0, // 3 bytes per texel, sRGB bytes converted to linear by every lookup (as loaded)
+	LINEAR16 = 1, // 6 bytes per texel, 16-bit normalized linear values
+	HALF = 2, // 6 bytes per texel, linear half floats
+	FLOAT = 3, // 12 bytes per texel, linear floats
+	AUTO = 4 // the fastest of the linear storages fitting the memory budget, SRGB8 if none does
+};
+
+/*! \class LinearTexture
+\brief Colour map converted from sRGB to linear values once, so that the lookups return them as they are.
+
+The texels are filtered in the linear values, not in the sRGB ones as Texture3u lookups converted afterwards do,
+which is the correct order (the results differ slightly in the high contrast areas).
+
+\code{.cpp}
+LinearizeColorMaps( materials, ColorMapStorage::AUTO, 512 << 20 ); // up to 512 MB of linear colour maps
+const Color3f albedo = material->diffuse( &tex_coord, duv_dx, duv_dy ); // no sRGB conversion
+\endcode
+*/
+class LinearTexture : public TextureSampler
+{
+public:
+	/* the linear values converted back to sRGB */
+	bool texel( const float u, const float v, const float lod, Color3u & value ) const override;
+
+	/* the linear values as they are stored */
+	bool texel( const float u, const float v, const float lod, Color3f & value ) const override = 0;
+
+	/* bytes of the texels of all levels */
+	virtual size_t memory() const = 0;
+
+	virtual ColorMapStorage storage() const = 0;
+
+	/* linear copy of the sRGB texture in one of the linear storages, its mip chain is rebuilt in linear values if
+	the texture has one, nullptr for SRGB8 */
+	static LinearTexture * Create( const Texture3u & texture, const ColorMapStorage storage );
+};
+
+/* bytes per texel of the storage (of the first level) */
+int TexelSize( const ColorMapStorage storage );
+
+const char * ToString( const ColorMapStorage storage );
+
+/* the linear storage of the given number of texels (of all levels) within the budget in bytes */
+ColorMapStorage SelectColorMapStorage( const size_t no_texels, const size_t budget );
+
+/* converts the diffuse and specular maps of the materials to the storage (AUTO selects it by the texels of all the
+maps and the budget in bytes), a map shared by more materials is converted once and the sRGB textures are removed
+from the materials, returns the storage used */
+ColorMapStorage LinearizeColorMaps( std::vector<Material *> & materials, const ColorMapStorage storage,
+	const size_t budget = 0 );
+
+#endif
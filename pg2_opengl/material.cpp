@@ -1,5 +1,8 @@
 #include "pch.h"
 #include "material.h"
+#include "compressed_texture.h"
+#include "linear_texture.h"
+#include "texture_sampler.h"
 
 const char Material::kDiffuseMapSlot = 0;
 const char Material::kSpecularMapSlot = 1;
@@ -24,8 +27,6 @@ Material::Material()
 
 	ior = -1.0f;
 
-	memset( textures_, 0, sizeof( *textures_ ) * NO_TEXTURES );
-
 	name_ = "default";
 	shader_ = Shader::PHONG;
 }
@@ -47,22 +48,25 @@ Material::Material( std::string & name, const Color3f & ambient, const Color3f &
 
 	this->ior = ior;
 
-	if ( textures )
+	roughness_ = 1.0f;
+	metallicness = 0.0f;
+
+	shader_ = shader;
+
+	// the material takes the textures over, a texture given in more slots is shared by them
+	for ( int i = 0; textures && i < no_textures; ++i )
 	{
-		memcpy( textures_, textures, sizeof( textures ) * no_textures );
+		if ( !textures[i] ) continue;
+
+		int j = 0;
+		while ( j < i && textures[j] != textures[i] ) ++j;
+		set_texture( i, ( j < i ) ? textures_[j] : std::shared_ptr<Texture3u>( textures[i] ) );
 	}
 }
 
 Material::~Material()
 {
-	for ( int i = 0; i < NO_TEXTURES; ++i )
-	{
-		if ( textures_[i] )
-		{
-			delete[] textures_[i];
-			textures_[i] = nullptr;
-		};
-	}
+	// the textures are released with the last material sharing them
 }
 
 void Material::set_name( const char * name )
@@ -75,14 +79,49 @@ std::string Material::name() const
 	return name_;
 }
 
-void Material::set_texture( const int slot, Texture3u * texture )
+void Material::set_texture( const int slot, std::shared_ptr<Texture3u> texture )
 {
 	textures_[slot] = texture;
+	samplers_[slot] = ( texture ) ? std::make_shared<TextureSamplerOf<Texture3u>>( texture ) : nullptr;
 }
 
 Texture3u * Material::texture( const int slot ) const
 {
-	return textures_[slot];
+	return textures_[slot].get();
+}
+
+void Material::set_texture( const int slot, TextureCache * texture_cache, const int handle )
+{
+	set_texture( slot, std::make_shared<CachedTextureSampler>( texture_cache, handle ) );
+}
+
+void Material::set_texture( const int slot, std::shared_ptr<const CompressedTexture> texture )
+{
+	set_texture( slot, ( texture ) ? std::make_shared<TextureSamplerOf<CompressedTexture>>( texture ) : nullptr );
+}
+
+void Material::set_texture( const int slot, std::shared_ptr<const TextureSampler> sampler )
+{
+	textures_[slot] = nullptr;
+	samplers_[slot] = sampler;
+}
+
+const LinearTexture * Material::linear_texture( const int slot ) const
+{
+	return dynamic_cast<const LinearTexture *>( samplers_[slot].get() );
+}
+
+template <class T>
+bool Material::Texel( const int slot, const Coord2f * tex_coord, const Coord2f * duv_dx, const Coord2f * duv_dy,
+	T & value ) const
+{
+	const TextureSampler * sampler = samplers_[slot].get();
+
+	if ( !tex_coord || !sampler ) return false;
+
+	const float lod = ( duv_dx && duv_dy ) ? sampler->lod( duv_dx->u, duv_dx->v, duv_dy->u, duv_dy->v ) : 0.0f;
+
+	return sampler->texel( tex_coord->u, tex_coord->v, lod, value );
 }
 
 Shader Material::shader() const
@@ -102,63 +141,44 @@ Color3f Material::ambient( const Coord2f * tex_coord ) const
 
 Color3f Material::diffuse( const Coord2f * tex_coord ) const
 {
-	if ( tex_coord )
-	{
-		Texture3u * texture = textures_[kDiffuseMapSlot];
+	Color3f value;
 
-		if ( texture )
-		{
-			return Color3f( texture->texel( tex_coord->u, tex_coord->v ) );
-		}
-	}
-	
-	return diffuse_;
+	return ( Texel( kDiffuseMapSlot, tex_coord, nullptr, nullptr, value ) ) ? value : diffuse_;
 }
 
 Color3f Material::specular( const Coord2f * tex_coord ) const
 {
-	if ( tex_coord )
-	{
-		Texture3u * texture = textures_[kSpecularMapSlot];
+	Color3f value;
 
-		if ( texture )
-		{
-			return Color3f( texture->texel( tex_coord->u, tex_coord->v ) );
-		}
-	}
+	return ( Texel( kSpecularMapSlot, tex_coord, nullptr, nullptr, value ) ) ? value : specular_;
+}
+
+Color3f Material::diffuse( const Coord2f * tex_coord, const Coord2f & duv_dx, const Coord2f & duv_dy ) const
+{
+	Color3f value;
 
-	return specular_;
+	return ( Texel( kDiffuseMapSlot, tex_coord, &duv_dx, &duv_dy, value ) ) ? value : diffuse_;
+}
+
+Color3f Material::specular( const Coord2f * tex_coord, const Coord2f & duv_dx, const Coord2f & duv_dy ) const
+{
+	Color3f value;
+
+	return ( Texel( kSpecularMapSlot, tex_coord, &duv_dx, &duv_dy, value ) ) ? value : specular_;
 }
 
 Color3f Material::bump( const Coord2f * tex_coord ) const
 {	
-	if ( tex_coord )
-	{
-		Texture3u * texture = textures_[kNormalMapSlot];
+	Color3f value;
 
-		if ( texture )
-		{
-			return Color3f( texture->texel( tex_coord->u, tex_coord->v ) );
-		}
-	}
-
-	return Color3f({ 0.5f, 0.5f, 1.0f }); // n = ( 0, 0, 1 )	
+	return ( Texel( kNormalMapSlot, tex_coord, nullptr, nullptr, value ) ) ? value : Color3f({ 0.5f, 0.5f, 1.0f }); // n = ( 0, 0, 1 )
 }
 
 float Material::roughness( const Coord2f * tex_coord ) const
 {
+	Color3u value;
 
-	if ( tex_coord )
-	{
-		Texture3u * texture = textures_[kRoughnessMapSlot];
-
-		if ( texture )
-		{
-			return texture->texel( tex_coord->u, tex_coord->v ).data[0] / 255.0f;
-		}
-	}
-
-	return roughness_;
+	return ( Texel( kRoughnessMapSlot, tex_coord, nullptr, nullptr, value ) ) ? value.data[0] / 255.0f : roughness_;
 }
 
 Color3f Material::emission( const Coord2f * tex_coord ) const
@@ -1,10 +1,16 @@
 #ifndef MATERIAL_H_
 #define MATERIAL_H_
 
+#include <memory>
 #include "vector3.h"
 #include "texture.h"
 #include "structs.h"
 
+class TextureCache;
+class CompressedTexture;
+class LinearTexture;
+class TextureSampler;
+
 /*! \def NO_TEXTURES
 \brief Maximln poet textur piazench materilu.
 */
@@ -56,7 +62,7 @@ public:
 	\param shininess lesklost.
 	\param ior index lomu.
 	\param shader shader to be used.
-	\param textures pole ukazatel na textury.
+	\param textures pole ukazatel na textury, materil je pevezme.
 	\param no_textures dlka pole \a textures. Maximln \a NO_TEXTURES - 1.
 	*/
 	Material( std::string & name, const Color3f & ambient, const Color3f & diffuse,
@@ -87,9 +93,9 @@ public:
 	//! Nastav texturu.
 	/*!	
 	\param slot slo slotu, do kterho bude textura piazena. Maximln \a NO_TEXTURES - 1.
-	\param texture ukazatel na texturu.
+	\param texture ukazatel na texturu, sdlen s ostatnmi materily, kter ji pouvaj.
 	*/
-	void set_texture( const int slot, Texture3u * texture );
+	void set_texture( const int slot, std::shared_ptr<Texture3u> texture );
 
 	//! Vrt texturu.
 	/*!	
@@ -98,6 +104,21 @@ public:
 	*/
 	Texture3u * texture( const int slot ) const;
 
+	/* every set_texture replaces the source of the texels of the slot, texture( slot ) is the Texture3u only while
+	it is the source */
+
+	/* the texture of the slot is sampled from the cache, the cache must outlive the material */
+	void set_texture( const int slot, TextureCache * texture_cache, const int handle );
+
+	/* the texture of the slot is sampled from the blocks */
+	void set_texture( const int slot, std::shared_ptr<const CompressedTexture> texture );
+
+	/* the slot is sampled from any other source, e.g. a colour map in linear values whose lookups need no
+	conversion (see LinearizeColorMaps) */
+	void set_texture( const int slot, std::shared_ptr<const TextureSampler> sampler );
+
+	const LinearTexture * linear_texture( const int slot ) const;
+
 	Shader shader() const;
 
 	void set_shader( Shader shader );
@@ -108,6 +129,10 @@ public:
 	Color3f bump( const Coord2f * tex_coord = nullptr ) const;
 	float roughness( const Coord2f * tex_coord = nullptr ) const;
 
+	/* the textures filtered over the footprint given by the derivatives of the texture coordinates along the image axes */
+	Color3f diffuse( const Coord2f * tex_coord, const Coord2f & duv_dx, const Coord2f & duv_dy ) const;
+	Color3f specular( const Coord2f * tex_coord, const Coord2f & duv_dx, const Coord2f & duv_dy ) const;
+
 	Color3f emission( const Coord2f * tex_coord = nullptr ) const;
 
 public:
@@ -131,7 +156,7 @@ public:
 	static const char kMetallicnessMapSlot; /*!< slo slotu textury kovovosti. */
 
 private:
-	Texture3u * textures_[NO_TEXTURES]; /*!< Pole ukazatel na textury. */
+	std::shared_ptr<Texture3u> textures_[NO_TEXTURES]; /*!< Pole ukazatel na textury. */
 	/*
 	slot 0 - diffuse map + alpha
 	slot 1 - specular map + opaque alpha
@@ -139,6 +164,14 @@ private:
 	slot 3 - transparency map
 	*/
 	
+	/* texel of the slot at the level of detail of the footprint (the first level without one), false if the slot
+	has no texture or its texels cannot be read */
+	template <class T>
+	bool Texel( const int slot, const Coord2f * tex_coord, const Coord2f * duv_dx, const Coord2f * duv_dy,
+		T & value ) const;
+
+	std::shared_ptr<const TextureSampler> samplers_[NO_TEXTURES]; /*!< Sources of the texels of the slots. */
+
 	std::string name_; /*!< Material name. */
 
 	Shader shader_{ Shader::NORMAL }; /*!< Type of used shader. */
@@ -0,0 +1,127 @@
+#include "pch.h"
+#include "matrix3x4.h"
+
+Matrix3x4::Matrix3x4()
+{
+	for ( int r = 0; r < 3; ++r )
+	{
+		for ( int c = 0; c < 4; ++c )
+		{
+			data_[c + r * 4] = ( ( r == c ) ? 1.0f : 0.0f );
+		}
+	}
+}
+
+Matrix3x4::Matrix3x4( const Matrix3x3 & linear, const Vector3 & translation )
+{
+	for ( int r = 0; r < 3; ++r )
+	{
+		for ( int c = 0; c < 3; ++c )
+		{
+			data_[c + r * 4] = linear.get( r, c );
+		}
+
+		data_[3 + r * 4] = translation.data[r];
+	}
+}
+
+Matrix3x4 Matrix3x4::Inverse() const
+{
+	const float a = get( 0, 0 ), b = get( 0, 1 ), c = get( 0, 2 );
+	const float d = get( 1, 0 ), e = get( 1, 1 ), f = get( 1, 2 );
+	const float g = get( 2, 0 ), h = get( 2, 1 ), i = get( 2, 2 );
+
+	// adjugate divided by the determinant
+	const float A = e * i - f * h;
+	const float B = f * g - d * i;
+	const float C = d * h - e * g;
+	const float det = a * A + b * B + c * C;
+
+	assert( det != 0.0f );
+
+	const float inv_det = 1.0f / det;
+	const Matrix3x3 inverse_linear( A * inv_det, ( c * h - b * i ) * inv_det, ( b * f - c * e ) * inv_det,
+		B * inv_det, ( a * i - c * g ) * inv_det, ( c * d - a * f ) * inv_det,
+		C * inv_det, ( b * g - a * h ) * inv_det, ( a * e - b * d ) * inv_det );
+
+	// p = L^-1 ( q - t ) = L^-1 q - L^-1 t
+	return Matrix3x4( inverse_linear, -( inverse_linear * translation() ) );
+}
+
+float Matrix3x4::Determinant() const
+{
+	return fabsf( get( 0, 0 ) * ( get( 1, 1 ) * get( 2, 2 ) - get( 1, 2 ) * get( 2, 1 ) ) -
+		get( 0, 1 ) * ( get( 1, 0 ) * get( 2, 2 ) - get( 1, 2 ) * get( 2, 0 ) ) +
+		get( 0, 2 ) * ( get( 1, 0 ) * get( 2, 1 ) - get( 1, 1 ) * get( 2, 0 ) ) );
+}
+
+Matrix3x3 Matrix3x4::linear() const
+{
+	return Matrix3x3( get( 0, 0 ), get( 0, 1 ), get( 0, 2 ),
+		get( 1, 0 ), get( 1, 1 ), get( 1, 2 ),
+		get( 2, 0 ), get( 2, 1 ), get( 2, 2 ) );
+}
+
+Vector3 Matrix3x4::translation() const
+{
+	return Vector3( get( 0, 3 ), get( 1, 3 ), get( 2, 3 ) );
+}
+
+float Matrix3x4::get( const int row, const int column ) const
+{
+	assert( row >= 0 && row < 3 && column >= 0 && column < 4 );
+
+	return data_[column + row * 4];
+}
+
+void Matrix3x4::set( const int row, const int column, const float value )
+{
+	assert( row >= 0 && row < 3 && column >= 0 && column < 4 );
+
+	data_[column + row * 4] = value;
+}
+
+Matrix3x4 Matrix3x4::Translation( const Vector3 & offset )
+{
+	return Matrix3x4( Matrix3x3(), offset );
+}
+
+Matrix3x4 Matrix3x4::Scaling( const Vector3 & scale )
+{
+	return Matrix3x4( Matrix3x3( scale.x, 0, 0, 0, scale.y, 0, 0, 0, scale.z ), Vector3( 0, 0, 0 ) );
+}
+
+Matrix3x4 Matrix3x4::Rotation( const Vector3 & axis, const float angle )
+{
+	// Rodrigues' formula
+	const float c = cosf( angle );
+	const float s = sinf( angle );
+	const float t = 1.0f - c;
+	const float x = axis.x, y = axis.y, z = axis.z;
+
+	return Matrix3x4( Matrix3x3( t * x * x + c, t * x * y - s * z, t * x * z + s * y,
+		t * x * y + s * z, t * y * y + c, t * y * z - s * x,
+		t * x * z - s * y, t * y * z + s * x, t * z * z + c ), Vector3( 0, 0, 0 ) );
+}
+
+Matrix3x4 operator*( const Matrix3x4 & a, const Matrix3x4 & b )
+{
+	Matrix3x4 result;
+
+	for ( int r = 0; r < 3; ++r )
+	{
+		for ( int c = 0; c < 4; ++c )
+		{
+			float sum = ( c == 3 ) ? a.data_[3 + r * 4] : 0.0f;
+
+			for ( int k = 0; k < 3; ++k )
+			{
+				sum += a.data_[k + r * 4] * b.data_[c + k * 4];
+			}
+
+			result.data_[c + r * 4] = sum;
+		}
+	}
+
+	return result;
+}
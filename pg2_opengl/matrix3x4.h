@@ -0,0 +1,78 @@
+#ifndef MATRIX_3X4_H_
+#define MATRIX_3X4_H_
+
+#include "matrix3x3.h"
+
+/*! \class Matrix3x4
+\brief Affine transformation stored as a row-major 3x4 matrix, i.e. a linear part and a translation in the last column.
+
+The implicit last row is ( 0, 0, 0, 1 ). Points are transformed including the translation, direction vectors
+without it and normals by the transposed inverse, see TransformNormal.
+
+\code{.cpp}
+const Matrix3x4 transform = Matrix3x4::Translation( Vector3( 1, 0, 0 ) ) * Matrix3x4::Rotation( Vector3( 0, 0, 1 ), phi );
+const Matrix3x4 inverse = transform.Inverse();
+const Vector3 p = transform.TransformPoint( q );
+const Vector3 n = inverse.TransformNormal( m );
+\endcode
+*/
+class Matrix3x4
+{
+public:
+	/* identity */
+	Matrix3x4();
+
+	Matrix3x4( const Matrix3x3 & linear, const Vector3 & translation );
+
+	Vector3 TransformPoint( const Vector3 & p ) const
+	{
+		return Vector3( data_[0] * p.x + data_[1] * p.y + data_[2] * p.z + data_[3],
+			data_[4] * p.x + data_[5] * p.y + data_[6] * p.z + data_[7],
+			data_[8] * p.x + data_[9] * p.y + data_[10] * p.z + data_[11] );
+	}
+
+	Vector3 TransformVector( const Vector3 & v ) const
+	{
+		return Vector3( data_[0] * v.x + data_[1] * v.y + data_[2] * v.z,
+			data_[4] * v.x + data_[5] * v.y + data_[6] * v.z,
+			data_[8] * v.x + data_[9] * v.y + data_[10] * v.z );
+	}
+
+	/* multiplies by the transposed linear part, called on the inverse of a transformation it maps the normals
+	of that transformation (the result is not normalized) */
+	Vector3 TransformNormal( const Vector3 & n ) const
+	{
+		return Vector3( data_[0] * n.x + data_[4] * n.y + data_[8] * n.z,
+			data_[1] * n.x + data_[5] * n.y + data_[9] * n.z,
+			data_[2] * n.x + data_[6] * n.y + data_[10] * n.z );
+	}
+
+	/* inverse of a regular transformation */
+	Matrix3x4 Inverse() const;
+
+	/* absolute value of the determinant of the linear part, i.e. the scaling of volumes */
+	float Determinant() const;
+
+	Matrix3x3 linear() const;
+
+	Vector3 translation() const;
+
+	float get( const int row, const int column ) const;
+
+	void set( const int row, const int column, const float value );
+
+	static Matrix3x4 Translation( const Vector3 & offset );
+
+	static Matrix3x4 Scaling( const Vector3 & scale );
+
+	/* rotation by the angle (rad) around the unit axis, counter-clockwise when looking against the axis */
+	static Matrix3x4 Rotation( const Vector3 & axis, const float angle );
+
+	/* a * b applies b first */
+	friend Matrix3x4 operator*( const Matrix3x4 & a, const Matrix3x4 & b );
+
+private:
+	float data_[3 * 4];
+};
+
+#endif
@@ -52,6 +52,46 @@ inline Vector3 reflect( const Vector3 & v, const Vector3 & n )
 	return ( 2.0f*( v.DotProduct( n ) ) )*n - v;
 }
 
+/* orthonormal basis whose third column is the unit vector n (Duff et al. 2017) */
+inline Matrix3x3 basis( const Vector3 & n )
+{
+	const float sign = copysignf( 1.0f, n.z );
+	const float a = -1.0f / ( sign + n.z );
+	const float b = n.x * n.y * a;
+
+	return Matrix3x3( Vector3( 1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x ),
+		Vector3( b, sign + n.y * n.y * a, -n.y ), n );
+}
+
+/* cosine weighted direction in the hemisphere around the local z axis, pdf = cos( theta ) / pi */
+inline Vector3 sample_cosine_hemisphere( const float ksi_1, const float ksi_2, float & pdf )
+{
+	const float r = sqrtf( ksi_1 );
+	const float phi = 2.0f * float( M_PI ) * ksi_2;
+	const float cos_theta = sqrtf( max( 0.0f, 1.0f - ksi_1 ) );
+
+	pdf = cos_theta * float( M_1_PI );
+
+	return Vector3( r * cosf( phi ), r * sinf( phi ), cos_theta );
+}
+
+/* Fresnel reflectance of unpolarized light at a dielectric interface, eta = n1 / n2, cos_i is the cosine of the
+incident direction, cos_t is set to the cosine of the refracted one, returns 1 for total internal reflection */
+inline float fresnel_dielectric( const float cos_i, const float eta, float & cos_t )
+{
+	const float sin2_t = sqr( eta ) * max( 0.0f, 1.0f - sqr( cos_i ) );
+
+	cos_t = 0.0f;
+
+	if ( sin2_t >= 1.0f ) return 1.0f;
+
+	cos_t = sqrtf( 1.0f - sin2_t );
+	const float r_s = ( eta * cos_i - cos_t ) / ( eta * cos_i + cos_t );
+	const float r_p = ( cos_i - eta * cos_t ) / ( cos_i + eta * cos_t );
+
+	return 0.5f * ( sqr( r_s ) + sqr( r_p ) );
+}
+
 unsigned long long QuickHash( const BYTE * data, const size_t length, unsigned long long mix = 0 );
 
 #endif
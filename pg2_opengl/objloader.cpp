@@ -8,6 +8,8 @@ http://en.wikipedia.org/wiki/Wavefront_.obj_file
 #include "utils.h"
 #include "surface.h"
 #include "mymath.h"
+#include "texture_cache.h"
+#include "texture_library.h"
 
 int MaterialIndex( std::vector<Material *> & materials, const char * material_name )
 {
@@ -26,22 +28,19 @@ int MaterialIndex( std::vector<Material *> & materials, const char * material_na
 	return -1;
 }
 
-Texture3u * TextureProxy(const std::string & full_name, std::map<std::string, Texture3u*> & already_loaded_textures,
-	const int flip = -1, const bool single_channel = false )
+/* the texture is registered in the cache if there is one, otherwise it is loaded right away and shared with the
+materials using the same image */
+static void SetTexture( Material * material, const char slot, const std::string & full_name,
+	TextureLibrary & texture_library, TextureCache * texture_cache )
 {
-	std::map<std::string, Texture3u*>::iterator already_loaded_texture = already_loaded_textures.find(full_name);
-	Texture3u * texture = NULL;
-	if (already_loaded_texture != already_loaded_textures.end())
+	if ( texture_cache )
 	{
-		texture = already_loaded_texture->second;
+		material->set_texture( slot, texture_cache, texture_cache->Register( full_name ) );
 	}
 	else
 	{
-		texture = new Texture3u( full_name.c_str() );// , flip, single_channel);
-		already_loaded_textures[full_name] = texture;
+		material->set_texture( slot, texture_library.Load( full_name ) );
 	}
-
-	return texture;
 }
 
 /*! \fn LoadMTL( const char * file_name, const char * path, std::vector<Material *> & materials )
@@ -50,8 +49,11 @@ Soubor \a file_name se mus
 \param file_name nzev MTL souboru vetn ppony.
 \param path cesta k zadanmu souboru.
 \param materials pole materil, do kterho se budou ukldat naten materily.
+\param texture_cache cache of the textures loaded on demand, nullptr loads them right away.
+\param texture_library textures loaded so far, shared by the materials of all libraries of a scene.
 */
-int LoadMTL( const char * file_name, const char * path, std::vector<Material *> & materials )
+int LoadMTL( const char * file_name, const char * path, std::vector<Material *> & materials, TextureCache * texture_cache,
+	TextureLibrary & texture_library )
 {
 	// oteven soouboru
 	FILE * file = fopen( file_name, "rt" );
@@ -99,8 +101,6 @@ int LoadMTL( const char * file_name, const char * path, std::vector<Material *>
 	const char delim[] = "\n";
 	char * line = strtok( buffer, delim );
 
-	std::map<std::string, Texture3u*> already_loaded_textures;
-
 	Material * material = NULL;
 
 	// --- natn vech materil ---
@@ -157,37 +157,37 @@ int LoadMTL( const char * file_name, const char * path, std::vector<Material *>
 				{					
 					sscanf( tmp, "%*s %s", image_file_name );
 					std::string full_name = std::string( path ).append( image_file_name );
-					material->set_texture( Material::kDiffuseMapSlot, TextureProxy( full_name, already_loaded_textures ) );
+					SetTexture( material, Material::kDiffuseMapSlot, full_name, texture_library, texture_cache );
 				}
 				else if ( strstr( tmp, "map_Ks" ) == tmp ) // specular map
 				{					
 					sscanf( tmp, "%*s %s", image_file_name );
 					std::string full_name = std::string( path ).append( image_file_name );
-					material->set_texture( Material::kSpecularMapSlot, TextureProxy( full_name, already_loaded_textures ) );
+					SetTexture( material, Material::kSpecularMapSlot, full_name, texture_library, texture_cache );
 				}
 				else if ( strstr( tmp, "map_bump" ) == tmp ) // normal map
 				{					
 					sscanf( tmp, "%*s %s", image_file_name );
 					std::string full_name = std::string(path).append(image_file_name);
-					material->set_texture( Material::kNormalMapSlot, TextureProxy( full_name, already_loaded_textures ) );
+					SetTexture( material, Material::kNormalMapSlot, full_name, texture_library, texture_cache );
 				}
 				else if ( strstr( tmp, "map_D" ) == tmp ) // opacity map
 				{					
 					sscanf( tmp, "%*s %s", image_file_name );
 					std::string full_name = std::string(path).append(image_file_name);
-					material->set_texture( Material::kOpacityMapSlot, TextureProxy( full_name, already_loaded_textures, -1, true ) );
+					SetTexture( material, Material::kOpacityMapSlot, full_name, texture_library, texture_cache );
 				}
 				else if ( strstr( tmp, "map_Pr" ) == tmp ) // roughness map
 				{
 					sscanf( tmp, "%*s %s", image_file_name );
 					std::string full_name = std::string( path ).append( image_file_name );
-					material->set_texture( Material::kRoughnessMapSlot, TextureProxy( full_name, already_loaded_textures, -1, true ) );
+					SetTexture( material, Material::kRoughnessMapSlot, full_name, texture_library, texture_cache );
 				}
 				else if ( strstr( tmp, "map_Pm" ) == tmp ) // metallicness map
 				{
 					sscanf( tmp, "%*s %s", image_file_name );
 					std::string full_name = std::string( path ).append( image_file_name );
-					material->set_texture( Material::kMetallicnessMapSlot, TextureProxy( full_name, already_loaded_textures, -1, true ) );
+					SetTexture( material, Material::kMetallicnessMapSlot, full_name, texture_library, texture_cache );
 				}
 				else if ( strstr( tmp, "shader" ) == tmp ) // used shader
 				{
@@ -231,7 +231,7 @@ int LoadMTL( const char * file_name, const char * path, std::vector<Material *>
 }
 
 int LoadOBJ( const char * file_name, std::vector<Surface *> & surfaces, std::vector<Material *> & materials,
-	const bool flip_yz , const Vector3 default_color )
+	const bool flip_yz , const Vector3 default_color, TextureCache * texture_cache )
 {
 	// oteven soouboru
 	FILE * file = fopen( file_name, "rt" );
@@ -307,11 +307,15 @@ int LoadOBJ( const char * file_name, std::vector<Surface *> & surfaces, std::vec
 
 	memcpy( buffer, buffer_backup, file_size + 1 ); // obnoven bufferu po innosti strtok
 
+	TextureLibrary texture_library;
+
 	for ( int i = 0; i < static_cast<int>( material_libraries.size() ); ++i )
 	{		
-		LoadMTL( material_libraries[i].c_str(), path, materials );
+		LoadMTL( material_libraries[i].c_str(), path, materials, texture_cache, texture_library );
 	}
 
+	if ( texture_library.no_files() > 0 ) texture_library.Print();
+
 	std::vector<Vector3> vertices; // cel jeden soubor
 	std::vector<Vector3> per_vertex_normals;
 	std::vector<Coord2f> texture_coords;	
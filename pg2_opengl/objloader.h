@@ -4,6 +4,8 @@
 #include "vector3.h"
 #include "surface.h"
 
+class TextureCache;
+
 int MaterialIndex( std::vector<Material *> & materials, const char * material_name );
 
 /*! \fn int LoadOBJ( const char * file_name, Vector3 & default_color, std::vector<Surface *> & surfaces, std::vector<Material *> & materials )
@@ -12,8 +14,10 @@ int MaterialIndex( std::vector<Material *> & materials, const char * material_na
 \param surfaces pole ploch, do kterho se budou ukldat naten plochy.
 \param materials pole materil, do kterho se budou ukldat naten materily.
 \param default_color vchoz barva vertexu.
+\param texture_cache cache of the textures loaded on demand, nullptr loads them right away.
 */
 int LoadOBJ( const char * file_name, std::vector<Surface *> & surfaces, std::vector<Material *> & materials,
-	const bool flip_yz = false, const Vector3 default_color = Vector3( 0.5f, 0.5f, 0.5f ) );
+	const bool flip_yz = false, const Vector3 default_color = Vector3( 0.5f, 0.5f, 0.5f ),
+	TextureCache * texture_cache = nullptr );
 
 #endif
@@ -15,6 +15,12 @@
 #include <math.h>
 #include <assert.h>
 #include <functional>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+// OpenMP - shared-memory multiprocessing
+#include <omp.h>
 
 // Glad - multi-Language GL/GLES/EGL/GLX/WGL loader-generator based on the official specs
 #include <glad/glad.h>
@@ -0,0 +1,416 @@
+#include "pch.h"
+#include "photon_map.h"
+#include "rng.h"
+#include "mymath.h"
+#include "utils.h"
+
+static const float kEpsilon = 1e-4f; // offset of secondary ray origins
+static const int kBlockSize = 4096; // photons traced by a single task
+static const int kStackSize = 64;
+
+/* number of nodes in the left subtree of a left-balanced tree with n nodes */
+static int LeftSize( const int n )
+{
+	int full = 1; // nodes of the largest complete tree not larger than n
+
+	while ( 2 * full + 1 <= n ) full = 2 * full + 1;
+
+	return ( full - 1 ) / 2 + min( n - full, ( full + 1 ) / 2 );
+}
+
+PhotonMap::PhotonMap( const Scene & scene, const Lights & lights, const int no_emitted, const int max_depth ) :
+	scene_( scene ), lights_( lights ), max_depth_( max_depth )
+{
+	Emit( no_emitted );
+}
+
+void PhotonMap::Emit( const int no_emitted, const unsigned int seed )
+{
+	photons_.clear();
+	no_emitted_ = max( 0, no_emitted );
+
+	if ( lights_.no_lights() == 0 || no_emitted_ == 0 ) return;
+
+	const auto t0 = std::chrono::high_resolution_clock::now();
+
+	// stored photons of every block are concatenated in the order of the blocks
+	const int no_blocks = ( no_emitted_ + kBlockSize - 1 ) / kBlockSize;
+	std::vector<std::vector<Photon>> blocks( no_blocks );
+
+#pragma omp parallel for schedule( dynamic, 1 )
+	for ( int b = 0; b < no_blocks; ++b )
+	{
+		const int end = min( ( b + 1 ) * kBlockSize, no_emitted_ );
+		Photon photon;
+
+		for ( int i = b * kBlockSize; i < end; ++i )
+		{
+			if ( Trace( i, seed, photon ) ) blocks[b].push_back( photon );
+		}
+	}
+
+	size_t no_stored = 0;
+
+	for ( const std::vector<Photon> & block : blocks )
+	{
+		no_stored += block.size();
+	}
+
+	photons_.reserve( no_stored );
+
+	for ( const std::vector<Photon> & block : blocks )
+	{
+		photons_.insert( photons_.end(), block.begin(), block.end() );
+	}
+
+	const auto t1 = std::chrono::high_resolution_clock::now();
+
+	Build();
+
+	const auto t2 = std::chrono::high_resolution_clock::now();
+
+	printf( "Photon map: %d photons stored of %d emitted, tracing %s, kd-tree %s, %0.1f MB\n", no_photons(),
+		no_emitted_, TimeToString( std::chrono::duration<double>( t1 - t0 ).count() ).c_str(),
+		TimeToString( std::chrono::duration<double>( t2 - t1 ).count() ).c_str(),
+		photons_.size() * sizeof( Photon ) / ( 1024.0 * 1024.0 ) );
+}
+
+bool PhotonMap::Trace( const int index, const unsigned int seed, Photon & photon ) const
+{
+	const RandomStream stream( index, 0, seed );
+
+	float pmf = 0.0f;
+	const int light = lights_.SampleByPower( stream.Get( 0 ), pmf );
+
+	if ( light < 0 || pmf <= 0.0f ) return false;
+
+	const EmissiveTriangle & triangle = lights_.light( light );
+
+	if ( triangle.area <= 0.0f ) return false;
+
+	// uniform point on the triangle, either side, cosine weighted direction
+	const float su = sqrtf( stream.Get( 1 ) );
+	const float b0 = 1.0f - su;
+	const float b1 = stream.Get( 2 ) * su;
+	const Vector3 origin = triangle.p0 * b0 + triangle.p1 * b1 + triangle.p2 * ( 1.0f - b0 - b1 );
+	const Vector3 normal = ( stream.Get( 3 ) < 0.5f ) ? triangle.normal : -triangle.normal;
+	float pdf = 0.0f;
+	const Vector3 direction = basis( normal ) * sample_cosine_hemisphere( stream.Get( 4 ), stream.Get( 5 ), pdf );
+
+	// Le * cos / ( pmf / area * 1 / 2 * cos / pi ) / no_emitted
+	Color3f power = triangle.emission * ( 2.0f * float( M_PI ) * triangle.area / ( pmf * no_emitted_ ) );
+	Ray ray( origin + normal * kEpsilon, direction );
+	bool specular = false;
+
+	for ( int depth = 0; depth < max_depth_; ++depth )
+	{
+		RayHit hit;
+		scene_.Intersect( ray, hit );
+
+		if ( !hit.is_valid() ) return false;
+
+		Vector3 position, shading_normal, geometric_normal;
+		Coord2f tex_coord;
+		scene_.Interpolate( hit, position, shading_normal, geometric_normal, tex_coord );
+
+		const Vector3 wo = -ray.direction;
+		const bool front_face = geometric_normal.DotProduct( wo ) >= 0.0f;
+
+		if ( !front_face )
+		{
+			geometric_normal = -geometric_normal;
+			shading_normal = -shading_normal;
+		}
+
+		const Material * material = scene_.material( scene_.material_id( hit ) );
+
+		switch ( material->shader() )
+		{
+		case Shader::NORMAL:
+		case Shader::PHONG:
+			return false;
+
+		case Shader::MIRROR:
+			power *= material->specular( &tex_coord );
+			ray = Ray( position + geometric_normal * kEpsilon, reflect( wo, shading_normal ) );
+			break;
+
+		case Shader::GLASS:
+		{
+			const float ior = ( material->ior > 0.0f ) ? material->ior : IOR_GLASS;
+			const float eta = ( front_face ) ? IOR_AIR / ior : ior / IOR_AIR;
+			const float cos_i = min( 1.0f, wo.DotProduct( shading_normal ) );
+			float cos_t = 0.0f;
+
+			if ( stream.Get( 6 + depth ) < fresnel_dielectric( cos_i, eta, cos_t ) )
+			{
+				ray = Ray( position + geometric_normal * kEpsilon, reflect( wo, shading_normal ) );
+			}
+			else
+			{
+				Vector3 refracted = -wo * eta + shading_normal * ( eta * cos_i - cos_t );
+				refracted.Normalize();
+				ray = Ray( position - geometric_normal * kEpsilon, refracted );
+			}
+
+			break;
+		}
+
+		default:
+			// only photons that passed through a specular bounce form caustics
+			if ( !specular ) return false;
+
+			photon.position = position;
+			photon.power = power;
+			photon.direction = wo;
+			photon.axis = 0;
+
+			return true;
+		}
+
+		specular = true;
+
+		if ( power.is_zero() ) return false;
+	}
+
+	return false;
+}
+
+void PhotonMap::Build()
+{
+	struct Range
+	{
+		int node;
+		int begin;
+		int end;
+	};
+
+	const int n = no_photons();
+	std::vector<Photon> tree( n );
+	std::vector<Range> level, next;
+
+	if ( n > 0 ) level.push_back( Range{ 0, 0, n } );
+
+	// all nodes of a level cover disjoint ranges of photons_ and can be split independently
+	while ( !level.empty() )
+	{
+		const int no_ranges = static_cast<int>( level.size() );
+		next.resize( 2 * no_ranges );
+
+#pragma omp parallel for schedule( dynamic, 1 )
+		for ( int i = 0; i < no_ranges; ++i )
+		{
+			const Range & range = level[i];
+			int axis = 0;
+
+			if ( range.end - range.begin > 1 )
+			{
+				Vector3 lower( FLT_MAX, FLT_MAX, FLT_MAX );
+				Vector3 upper( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+
+				for ( int j = range.begin; j < range.end; ++j )
+				{
+					for ( int k = 0; k < 3; ++k )
+					{
+						lower.data[k] = min( lower.data[k], photons_[j].position.data[k] );
+						upper.data[k] = max( upper.data[k], photons_[j].position.data[k] );
+					}
+				}
+
+				const Vector3 extent = upper - lower;
+				axis = ( extent.x > extent.y ) ? ( ( extent.x > extent.z ) ? 0 : 2 ) : ( ( extent.y > extent.z ) ? 1 : 2 );
+			}
+
+			const int median = range.begin + LeftSize( range.end - range.begin );
+
+			std::nth_element( photons_.begin() + range.begin, photons_.begin() + median, photons_.begin() + range.end,
+				[axis]( const Photon & a, const Photon & b ) { return a.position.data[axis] < b.position.data[axis]; } );
+
+			tree[range.node] = photons_[median];
+			tree[range.node].axis = axis;
+
+			next[2 * i] = Range{ 2 * range.node + 1, range.begin, median };
+			next[2 * i + 1] = Range{ 2 * range.node + 2, median + 1, range.end };
+		}
+
+		level.clear();
+
+		for ( const Range & range : next )
+		{
+			if ( range.begin < range.end ) level.push_back( range );
+		}
+	}
+
+	photons_.swap( tree );
+}
+
+int PhotonMap::FindNearest( const Vector3 & position, const int k, const float max_radius, int * indices,
+	float & sqr_radius ) const
+{
+	struct Neighbour
+	{
+		float sqr_distance;
+		int index;
+
+		bool operator<( const Neighbour & other ) const
+		{
+			return sqr_distance < other.sqr_distance;
+		}
+	};
+
+	const int n = no_photons();
+	const int no_nearest = min( k, kMaxNearest );
+	Neighbour heap[kMaxNearest]; // max-heap of the distances
+	int found = 0;
+	float sqr_limit = sqr( max_radius );
+
+	sqr_radius = 0.0f;
+
+	if ( n == 0 || no_nearest <= 0 ) return 0;
+
+	// far children waiting for a visit with the squared distance to their splitting plane
+	int stack_nodes[kStackSize];
+	float stack_distances[kStackSize];
+	int stack_size = 0;
+	int node = 0;
+
+	while ( true )
+	{
+		while ( node < n )
+		{
+			const Photon & photon = photons_[node];
+			const float d = position.data[photon.axis] - photon.position.data[photon.axis];
+			const int near_child = 2 * node + ( ( d > 0.0f ) ? 2 : 1 );
+			const int far_child = 2 * node + ( ( d > 0.0f ) ? 1 : 2 );
+
+			if ( far_child < n && sqr( d ) < sqr_limit )
+			{
+				stack_nodes[stack_size] = far_child;
+				stack_distances[stack_size++] = sqr( d );
+			}
+
+			const float sqr_distance = ( photon.position - position ).SqrL2Norm();
+
+			if ( sqr_distance < sqr_limit )
+			{
+				if ( found < no_nearest )
+				{
+					heap[found++] = Neighbour{ sqr_distance, node };
+					std::push_heap( heap, heap + found );
+				}
+				else
+				{
+					std::pop_heap( heap, heap + found );
+					heap[found - 1] = Neighbour{ sqr_distance, node };
+					std::push_heap( heap, heap + found );
+				}
+
+				// once the heap is full only closer photons than the farthest one matter
+				if ( found == no_nearest ) sqr_limit = heap[0].sqr_distance;
+			}
+
+			node = near_child;
+		}
+
+		// the limit may have shrunk since the far child was pushed
+		while ( stack_size > 0 && stack_distances[stack_size - 1] >= sqr_limit ) --stack_size;
+
+		if ( stack_size == 0 ) break;
+
+		node = stack_nodes[--stack_size];
+	}
+
+	for ( int i = 0; i < found; ++i )
+	{
+		indices[i] = heap[i].index;
+	}
+
+	sqr_radius = ( found > 0 ) ? heap[0].sqr_distance : 0.0f;
+
+	return found;
+}
+
+int PhotonMap::FindInRadius( const Vector3 & position, const float radius, std::vector<int> & indices ) const
+{
+	const int n = no_photons();
+	const float sqr_limit = sqr( radius );
+	const size_t first = indices.size();
+
+	int stack[kStackSize];
+	int stack_size = 0;
+
+	if ( n > 0 ) stack[stack_size++] = 0;
+
+	while ( stack_size > 0 )
+	{
+		const int node = stack[--stack_size];
+		const Photon & photon = photons_[node];
+		const float d = position.data[photon.axis] - photon.position.data[photon.axis];
+
+		if ( ( photon.position - position ).SqrL2Norm() < sqr_limit ) indices.push_back( node );
+
+		// the side containing the query point always, the other one if the sphere crosses the plane
+		const int near_child = 2 * node + ( ( d > 0.0f ) ? 2 : 1 );
+		const int far_child = 2 * node + ( ( d > 0.0f ) ? 1 : 2 );
+
+		if ( far_child < n && sqr( d ) < sqr_limit ) stack[stack_size++] = far_child;
+		if ( near_child < n ) stack[stack_size++] = near_child;
+	}
+
+	return static_cast<int>( indices.size() - first );
+}
+
+Color3f PhotonMap::Irradiance( const Vector3 & position, const Vector3 & normal ) const
+{
+	int indices[kMaxNearest];
+	float sqr_radius = 0.0f;
+	const int found = FindNearest( position, no_nearest_, max_radius_, indices, sqr_radius );
+
+	if ( found == 0 ) return Color3f();
+
+	// sparse photons are spread over the whole search disc
+	if ( found < no_nearest_ ) sqr_radius = sqr( max_radius_ );
+
+	Color3f sum;
+
+	for ( int i = 0; i < found; ++i )
+	{
+		const Photon & photon = photons_[indices[i]];
+
+		if ( photon.direction.DotProduct( normal ) <= 0.0f ) continue;
+
+		sum += photon.power * ( 1.0f - ( photon.position - position ).SqrL2Norm() / sqr_radius );
+	}
+
+	// Epanechnikov kernel 2 / ( pi r^2 ) * ( 1 - d^2 / r^2 )
+	return sum * ( 2.0f / ( float( M_PI ) * sqr_radius ) );
+}
+
+const Photon & PhotonMap::photon( const int i ) const
+{
+	return photons_[i];
+}
+
+int PhotonMap::no_photons() const
+{
+	return static_cast<int>( photons_.size() );
+}
+
+int PhotonMap::no_emitted() const
+{
+	return no_emitted_;
+}
+
+void PhotonMap::set_no_nearest( const int no_nearest )
+{
+	assert( no_nearest > 0 && no_nearest <= kMaxNearest );
+
+	no_nearest_ = no_nearest;
+}
+
+void PhotonMap::set_max_radius( const float max_radius )
+{
+	assert( max_radius > 0.0f );
+
+	max_radius_ = max_radius;
+}
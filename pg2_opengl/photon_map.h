@@ -0,0 +1,87 @@
+#ifndef PHOTON_MAP_H_
+#define PHOTON_MAP_H_
+
+#include "scene.h"
+#include "lights.h"
+
+/*! \struct Photon
+\brief Flux carried to a diffuse surface, a node of the implicit kd-tree.
+*/
+struct Photon
+{
+	Vector3 position; /*!< Hit point. */
+	Color3f power; /*!< Carried flux. */
+	Vector3 direction; /*!< Unit direction towards the previous vertex of the photon path. */
+	int axis; /*!< Splitting axis of the kd-tree node. */
+};
+
+/*! \class PhotonMap
+\brief Caustic photon map (Jensen 1996), i.e. photons that reached a diffuse surface via at least one specular
+(Shader::MIRROR or Shader::GLASS) bounce.
+
+Photons leave the emissive triangles proportionally to their power (Lights::SampleByPower) from a uniform point
+in a cosine weighted direction on either side. Blocks of photons are traced in parallel, every photon draws its
+random numbers from a RandomStream keyed by its index, so that the map does not depend on the number of threads.
+
+The stored photons form a left-balanced kd-tree in a flat array, the children of the node i are the nodes
+2i + 1 and 2i + 2, so there are no pointers and the top levels of the tree share a few cache lines. The tree
+is balanced level by level, all nodes of a level are split in parallel by std::nth_element along the axis of the
+largest extent. All queries are const and allocate nothing but the output, any number of threads may run them.
+
+\code{.cpp}
+PhotonMap photon_map( scene, lights, 1 << 20 );
+tracer.set_photon_map( &photon_map );
+\endcode
+*/
+class PhotonMap
+{
+public:
+	PhotonMap( const Scene & scene, const Lights & lights, const int no_emitted = 1 << 20, const int max_depth = 8 );
+
+	/* discards the map and traces no_emitted new photons with the given seed */
+	void Emit( const int no_emitted, const unsigned int seed = 0 );
+
+	/* at most k nearest photons within max_radius, indices are stored as a max-heap of the distances (the first one
+	is the farthest), sqr_radius is the squared distance of the farthest photon found, returns their number */
+	int FindNearest( const Vector3 & position, const int k, const float max_radius, int * indices,
+		float & sqr_radius ) const;
+
+	/* appends the indices of all photons within radius, returns their number */
+	int FindInRadius( const Vector3 & position, const float radius, std::vector<int> & indices ) const;
+
+	/* irradiance at a point with the given unit normal estimated from the no_nearest photons within max_radius
+	arriving from the hemisphere above, weighted by the Epanechnikov kernel */
+	Color3f Irradiance( const Vector3 & position, const Vector3 & normal ) const;
+
+	const Photon & photon( const int i ) const;
+
+	int no_photons() const;
+
+	int no_emitted() const;
+
+	/* number of photons of the irradiance estimate, at most kMaxNearest */
+	void set_no_nearest( const int no_nearest );
+
+	void set_max_radius( const float max_radius );
+
+	static const int kMaxNearest = 256;
+
+private:
+	/* traces the photon with the given index, returns true and fills the photon if it was stored */
+	bool Trace( const int index, const unsigned int seed, Photon & photon ) const;
+
+	/* rearranges photons_ into the left-balanced kd-tree */
+	void Build();
+
+	const Scene & scene_;
+	const Lights & lights_;
+
+	std::vector<Photon> photons_;
+	int no_emitted_{ 0 };
+	int max_depth_{ 8 };
+
+	int no_nearest_{ 64 };
+	float max_radius_{ 0.05f };
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "pch.h"
+#include "quantized_bvh.h"
+
+/* slack covering the rounding of the decoding of a coordinate of the given magnitude */
+static float Margin( const float magnitude )
+{
+	return 4.0f * FLT_EPSILON * magnitude;
+}
+
+/* conservative 8-bit bounds of [lower, upper] on the grid of the frame along the axis */
+static void Quantize( const QuantizedFrame & frame, const int axis, const float lower, const float upper,
+	unsigned char & q_lower, unsigned char & q_upper )
+{
+	const float origin = frame.origin.data[axis];
+	const float scale = frame.scale.data[axis];
+
+	if ( scale <= 0.0f )
+	{
+		q_lower = 0;
+		q_upper = 0;
+
+		return;
+	}
+
+	const float margin = Margin( fabsf( origin ) + 255.0f * scale );
+	int l = static_cast<int>( floorf( ( lower - origin ) / scale ) );
+	int u = static_cast<int>( ceilf( ( upper - origin ) / scale ) );
+	l = max( 0, min( 255, l ) );
+	u = max( l, min( 255, u ) );
+
+	// the division may be off by one cell, step until the decoded bounds enclose the box with the margin
+	while ( l > 0 && origin + l * scale > lower - margin ) --l;
+	while ( u < 255 && origin + u * scale < upper + margin ) ++u;
+
+	q_lower = static_cast<unsigned char>( l );
+	q_upper = static_cast<unsigned char>( u );
+}
+
+static unsigned int PackLeaf( const BvhNode & node )
+{
+	assert( node.count >= 1 && node.count <= 16 );
+	assert( node.left_first < ( 1 << 27 ) );
+
+	return QuantizedBvh::kLeafFlag | ( static_cast<unsigned int>( node.left_first ) << 4 ) |
+		static_cast<unsigned int>( node.count - 1 );
+}
+
+void QuantizedBvh::Build( const Bvh & bvh )
+{
+	const std::vector<BvhNode> & source = bvh.nodes();
+
+	nodes_.clear();
+	root_ = kEmpty;
+	no_primitives_ = static_cast<int>( bvh.indices().size() );
+
+	if ( source.empty() ) return;
+
+	// root frame slightly enlarged so that its decoded upper bounds enclose the float box
+	const Aabb & box = source[0].bounds;
+
+	for ( int axis = 0; axis < 3; ++axis )
+	{
+		const float margin = Margin( max( fabsf( box.lower.data[axis] ), fabsf( box.upper.data[axis] ) ) );
+		const float lower = box.lower.data[axis] - margin;
+		float scale = ( box.upper.data[axis] + margin - lower ) / 255.0f;
+
+		while ( lower + 255.0f * scale < box.upper.data[axis] + margin ) scale *= 1.0f + FLT_EPSILON;
+
+		root_frame_.origin.data[axis] = lower;
+		root_frame_.scale.data[axis] = scale;
+	}
+
+	if ( source[0].is_leaf() )
+	{
+		root_ = PackLeaf( source[0] );
+
+		return;
+	}
+
+	nodes_.reserve( source.size() / 2 ); // one per interior node
+	root_ = 0;
+
+	// preorder, every interior node is followed by the subtree of its left child
+	struct Task { int source_index; QuantizedFrame frame; int parent; int slot; };
+	std::vector<Task> tasks;
+	tasks.push_back( Task{ 0, root_frame_, -1, 0 } );
+
+	while ( !tasks.empty() )
+	{
+		const Task task = tasks.back();
+		tasks.pop_back();
+
+		const BvhNode & node = source[task.source_index];
+		const int index = static_cast<int>( nodes_.size() );
+
+		if ( task.parent >= 0 ) nodes_[task.parent].children[task.slot] = static_cast<unsigned int>( index );
+
+		nodes_.emplace_back();
+
+		for ( int i = 0; i < 2; ++i )
+		{
+			const Aabb & child_box = source[node.left_first + i].bounds;
+
+			for ( int axis = 0; axis < 3; ++axis )
+			{
+				Quantize( task.frame, axis, child_box.lower.data[axis], child_box.upper.data[axis],
+					nodes_[index].lower[axis][i], nodes_[index].upper[axis][i] );
+			}
+		}
+
+		// the right child goes first to the stack, the left one is compressed next
+		for ( int i = 1; i >= 0; --i )
+		{
+			const BvhNode & child = source[node.left_first + i];
+
+			if ( child.is_leaf() )
+			{
+				nodes_[index].children[i] = PackLeaf( child );
+			}
+			else
+			{
+				nodes_[index].children[i] = kEmpty;
+				tasks.push_back( Task{ node.left_first + i, task.frame.Child( nodes_[index], i ), index, i } );
+			}
+		}
+	}
+}
+
+void QuantizedBvh::Print() const
+{
+	printf( "Quantized BVH: %d primitives, %I64u nodes, %0.1f MB, %0.2f bytes per primitive\n", no_primitives_,
+		nodes_.size(), memory() / ( 1024.0f * 1024.0f ), float( memory() ) / max( 1, no_primitives_ ) );
+}
@@ -0,0 +1,170 @@
+#ifndef QUANTIZED_BVH_H_
+#define QUANTIZED_BVH_H_
+
+#include "bvh.h"
+
+/*! \struct QuantizedBvhNode
+\brief An interior node of the compressed hierarchy holding the bounds of both its children (20 bytes).
+
+The bounds are 8-bit coordinates on the grid of 255 cells spanning the bounds of the node itself (its frame),
+lower ones rounded down and upper ones rounded up. A child reference is either the index of an interior node
+or a leaf packed as kLeafFlag | first << 4 | ( count - 1 ).
+*/
+struct QuantizedBvhNode
+{
+	unsigned char lower[3][2]; /*!< Lower bounds of the children along each axis. */
+	unsigned char upper[3][2]; /*!< Upper bounds of the children along each axis. */
+	unsigned int children[2]; /*!< References of the children. */
+};
+
+/*! \struct QuantizedFrame
+\brief Decoded bounds of a node, the coordinate q maps to origin + q * scale.
+*/
+struct QuantizedFrame
+{
+	Vector3 origin;
+	Vector3 scale;
+
+	/* frame of the i-th child of the node, build and traversal must decode exactly the same way */
+	QuantizedFrame Child( const QuantizedBvhNode & node, const int i ) const
+	{
+		QuantizedFrame child;
+
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			const float lower = origin.data[axis] + node.lower[axis][i] * scale.data[axis];
+			const float upper = origin.data[axis] + node.upper[axis][i] * scale.data[axis];
+
+			child.origin.data[axis] = lower;
+			child.scale.data[axis] = ( upper - lower ) * ( 1.0f / 255.0f );
+		}
+
+		return child;
+	}
+
+	Aabb bounds() const
+	{
+		Aabb box;
+		box.lower = origin;
+		box.upper = Vector3( origin.x + 255.0f * scale.x, origin.y + 255.0f * scale.y, origin.z + 255.0f * scale.z );
+
+		return box;
+	}
+};
+
+/*! \class QuantizedBvh
+\brief Compressed copy of a Bvh for large static meshes.
+
+An interior node stores the bounds of both children quantized to 8 bits relative to its own decoded bounds, so
+the nodes take 20 bytes instead of the two 32-byte float nodes of the children, leaves need no node at all and the
+primitive indices are not kept (the leaves address the primitives in the leaf order of the source Bvh, which is
+how Scene stores the triangles). The rounding is conservative, every decoded box contains the original one, so
+the traversal visits a superset of the leaves of the float hierarchy and finds exactly the same hits. The frames
+are decoded on the fly from the root down and carried on the traversal stack.
+
+\code{.cpp}
+QuantizedBvh compressed;
+compressed.Build( bvh );
+compressed.Traverse( ray, [&]( const int first, const int count ) { ... } ); // as Bvh::Traverse
+\endcode
+*/
+class QuantizedBvh
+{
+public:
+	/* compresses the hierarchy, its leaves must hold at most 16 primitives */
+	void Build( const Bvh & bvh );
+
+	/* the same contract as Bvh::Traverse */
+	template<class F> void Traverse( Ray & ray, F && leaf ) const;
+
+	bool empty() const
+	{
+		return root_ == kEmpty;
+	}
+
+	Aabb bounds() const
+	{
+		return ( empty() ) ? Aabb() : root_frame_.bounds();
+	}
+
+	const std::vector<QuantizedBvhNode> & nodes() const
+	{
+		return nodes_;
+	}
+
+	size_t memory() const
+	{
+		return nodes_.size() * sizeof( QuantizedBvhNode );
+	}
+
+	void Print() const;
+
+	static const unsigned int kLeafFlag = 0x80000000u;
+	static const unsigned int kEmpty = 0xffffffffu;
+
+private:
+	std::vector<QuantizedBvhNode> nodes_;
+	QuantizedFrame root_frame_;
+	unsigned int root_{ kEmpty };
+	int no_primitives_{ 0 };
+};
+
+template<class F> void QuantizedBvh::Traverse( Ray & ray, F && leaf ) const
+{
+	if ( empty() ) return;
+
+	const Vector3 inv_direction( 1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z );
+
+	struct Entry { unsigned int child; float t; QuantizedFrame frame; };
+	Entry stack[64];
+	int stack_size = 0;
+	unsigned int child = root_;
+	QuantizedFrame frame = root_frame_;
+
+	if ( frame.bounds().Intersect( ray.origin, inv_direction, ray.t_min, ray.t_max ) == FLT_MAX ) return;
+
+	while ( true )
+	{
+		if ( child & kLeafFlag )
+		{
+			if ( leaf( static_cast<int>( ( child & ~kLeafFlag ) >> 4 ), static_cast<int>( child & 15 ) + 1 ) ) return;
+		}
+		else
+		{
+			const QuantizedBvhNode & node = nodes_[child];
+			const QuantizedFrame left = frame.Child( node, 0 );
+			const QuantizedFrame right = frame.Child( node, 1 );
+			const float t_left = left.bounds().Intersect( ray.origin, inv_direction, ray.t_min, ray.t_max );
+			const float t_right = right.bounds().Intersect( ray.origin, inv_direction, ray.t_min, ray.t_max );
+
+			if ( t_left != FLT_MAX || t_right != FLT_MAX )
+			{
+				if ( t_left <= t_right )
+				{
+					if ( t_right != FLT_MAX ) stack[stack_size++] = Entry{ node.children[1], t_right, right };
+					child = node.children[0];
+					frame = left;
+				}
+				else
+				{
+					if ( t_left != FLT_MAX ) stack[stack_size++] = Entry{ node.children[0], t_left, left };
+					child = node.children[1];
+					frame = right;
+				}
+
+				continue;
+			}
+		}
+
+		do
+		{
+			if ( stack_size == 0 ) return;
+			--stack_size;
+		} while ( stack[stack_size].t > ray.t_max );
+
+		child = stack[stack_size].child;
+		frame = stack[stack_size].frame;
+	}
+}
+
+#endif
@@ -0,0 +1,197 @@
+#include "pch.h"
+#include "radiance_cache.h"
+#include "mymath.h"
+#include "utils.h"
+
+static const int kMaxProbes = 16;
+
+/* splitmix64 finalizer */
+static inline unsigned long long Mix64( unsigned long long x )
+{
+	x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+	x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111ebULL;
+
+	return x ^ ( x >> 31 );
+}
+
+static inline void AtomicAdd( std::atomic<float> & target, const float value )
+{
+	float expected = target.load( std::memory_order_relaxed );
+
+	while ( !target.compare_exchange_weak( expected, expected + value, std::memory_order_relaxed ) ) { }
+}
+
+RadianceCache::RadianceCache( const int no_cells, const float cell_size )
+{
+	no_cells_ = 1;
+	while ( no_cells_ < no_cells ) no_cells_ <<= 1;
+
+	cells_ = new Cell[no_cells_];
+	cell_size_ = cell_size;
+
+	Clear();
+}
+
+RadianceCache::~RadianceCache()
+{
+	SAFE_DELETE_ARRAY( cells_ );
+}
+
+int RadianceCache::Find( const Vector3 & position, const Vector3 & normal, const bool insert ) const
+{
+	// 19 bits per coordinate cell and 27 normal bins (3 per axis)
+	const float inv_cell_size = 1.0f / cell_size_;
+	const unsigned long long ix = static_cast<unsigned long long>( int( floorf( position.x * inv_cell_size ) ) ) & 0x7ffff;
+	const unsigned long long iy = static_cast<unsigned long long>( int( floorf( position.y * inv_cell_size ) ) ) & 0x7ffff;
+	const unsigned long long iz = static_cast<unsigned long long>( int( floorf( position.z * inv_cell_size ) ) ) & 0x7ffff;
+	const int nx = min( int( ( normal.x + 1.0f ) * 1.5f ), 2 );
+	const int ny = min( int( ( normal.y + 1.0f ) * 1.5f ), 2 );
+	const int nz = min( int( ( normal.z + 1.0f ) * 1.5f ), 2 );
+	const unsigned long long n = static_cast<unsigned long long>( max( 0, nx + 3 * ny + 9 * nz ) );
+
+	const unsigned long long hash = Mix64( ix | ( iy << 19 ) | ( iz << 38 ) | ( n << 57 ) );
+	const unsigned int checksum = static_cast<unsigned int>( hash >> 32 ) | 1;
+	int index = static_cast<int>( hash & ( no_cells_ - 1 ) );
+
+	for ( int probe = 0; probe < kMaxProbes; ++probe )
+	{
+		unsigned int current = cells_[index].checksum.load( std::memory_order_acquire );
+
+		if ( current == checksum ) return index;
+
+		if ( current == 0 )
+		{
+			if ( !insert ) return -1;
+
+			// claim the empty cell, another thread may have claimed it for the same key in the meantime
+			if ( cells_[index].checksum.compare_exchange_strong( current, checksum, std::memory_order_acq_rel ) ||
+				current == checksum )
+			{
+				return index;
+			}
+		}
+
+		index = ( index + 1 ) & ( no_cells_ - 1 );
+	}
+
+	if ( insert ) no_failed_inserts_.fetch_add( 1, std::memory_order_relaxed );
+
+	return -1;
+}
+
+void RadianceCache::Update( const Vector3 & position, const Vector3 & normal, const Color3f & value )
+{
+	if ( !( value.max_value() < FLT_MAX ) ) return; // skip NaNs and infinities
+
+	const int index = Find( position, normal, true );
+
+	if ( index < 0 ) return;
+
+	Cell & cell = cells_[index];
+
+	for ( int i = 0; i < 3; ++i )
+	{
+		AtomicAdd( cell.sum[i], value.data[i] );
+	}
+
+	AtomicAdd( cell.count, 1.0f );
+}
+
+bool RadianceCache::Query( const Vector3 & position, const Vector3 & normal, Color3f & value ) const
+{
+	const int index = Find( position, normal, false );
+
+	if ( index < 0 ) return false;
+
+	const Cell & cell = cells_[index];
+	const float count = cell.count.load( std::memory_order_relaxed );
+
+	if ( count < min_samples_ ) return false;
+
+	for ( int i = 0; i < 3; ++i )
+	{
+		value.data[i] = cell.sum[i].load( std::memory_order_relaxed ) / count;
+	}
+
+	return true;
+}
+
+void RadianceCache::NextFrame()
+{
+#pragma omp parallel for
+	for ( int i = 0; i < no_cells_; ++i )
+	{
+		Cell & cell = cells_[i];
+
+		if ( cell.checksum.load( std::memory_order_relaxed ) == 0 ) continue;
+
+		const float count = cell.count.load( std::memory_order_relaxed ) * decay_;
+
+		// nearly forgotten cells are not released, as that would break the probe chains of the other keys
+		cell.count.store( count, std::memory_order_relaxed );
+
+		for ( int j = 0; j < 3; ++j )
+		{
+			cell.sum[j].store( cell.sum[j].load( std::memory_order_relaxed ) * decay_, std::memory_order_relaxed );
+		}
+	}
+}
+
+void RadianceCache::Clear()
+{
+#pragma omp parallel for
+	for ( int i = 0; i < no_cells_; ++i )
+	{
+		cells_[i].checksum.store( 0, std::memory_order_relaxed );
+		cells_[i].count.store( 0.0f, std::memory_order_relaxed );
+
+		for ( int j = 0; j < 3; ++j )
+		{
+			cells_[i].sum[j].store( 0.0f, std::memory_order_relaxed );
+		}
+	}
+
+	no_failed_inserts_ = 0;
+}
+
+void RadianceCache::Print() const
+{
+	int no_occupied = 0;
+	double no_samples = 0.0;
+
+	for ( int i = 0; i < no_cells_; ++i )
+	{
+		if ( cells_[i].checksum.load( std::memory_order_relaxed ) != 0 )
+		{
+			++no_occupied;
+			no_samples += cells_[i].count.load( std::memory_order_relaxed );
+		}
+	}
+
+	printf( "Radiance cache: %d / %d cells occupied (%0.1f %%), %0.1f samples per cell, %I64d failed inserts, %0.1f MB\n",
+		no_occupied, no_cells_, 100.0 * no_occupied / no_cells_, no_samples / max( no_occupied, 1 ),
+		no_failed_inserts_.load(), no_cells_ * sizeof( Cell ) / ( 1024.0 * 1024.0 ) );
+}
+
+float RadianceCache::cell_size() const
+{
+	return cell_size_;
+}
+
+void RadianceCache::set_cell_size( const float cell_size )
+{
+	assert( cell_size > 0.0f );
+
+	cell_size_ = cell_size;
+	Clear();
+}
+
+void RadianceCache::set_decay( const float decay )
+{
+	decay_ = clamp( decay, 0.0f, 1.0f );
+}
+
+void RadianceCache::set_min_samples( const float min_samples )
+{
+	min_samples_ = min_samples;
+}
@@ -0,0 +1,78 @@
+#ifndef RADIANCE_CACHE_H_
+#define RADIANCE_CACHE_H_
+
+#include "vector3.h"
+#include "color.h"
+
+/*! \class RadianceCache
+\brief World-space hash grid of diffuse irradiance (reflected radiance divided by albedo).
+
+Positions are quantized to cubic cells of the given size and normals to 27 direction bins, the resulting key
+is hashed into a fixed-size open-addressing table (linear probing). Cells are claimed by a compare-and-swap
+of their checksum and the radiance sums are accumulated by atomic adds, so any number of threads may call
+Update and Query concurrently without locks. NextFrame multiplies all sums by the decay factor, so that old
+estimates fade out when the scene or lighting changes; it must not run concurrently with the updates.
+
+\code{.cpp}
+RadianceCache cache( 1 << 20, 0.05f );
+tracer.set_radiance_cache( &cache );
+tracer.Render( 16 );
+cache.NextFrame();
+\endcode
+*/
+class RadianceCache
+{
+public:
+	/* the number of cells is rounded up to a power of two */
+	RadianceCache( const int no_cells = 1 << 20, const float cell_size = 0.05f );
+	~RadianceCache();
+
+	RadianceCache( const RadianceCache & ) = delete;
+	RadianceCache & operator=( const RadianceCache & ) = delete;
+
+	/* adds a sample of irradiance / pi at the given point with the given unit normal */
+	void Update( const Vector3 & position, const Vector3 & normal, const Color3f & value );
+
+	/* mean of the samples of the cell if it has at least min_samples of them */
+	bool Query( const Vector3 & position, const Vector3 & normal, Color3f & value ) const;
+
+	/* fades out all cells by the decay factor */
+	void NextFrame();
+
+	void Clear();
+
+	/* prints the occupancy of the table */
+	void Print() const;
+
+	float cell_size() const;
+
+	/* changes the quantization, the cache is cleared */
+	void set_cell_size( const float cell_size );
+
+	/* weight of the previous frames <0, 1>, 0 discards them */
+	void set_decay( const float decay );
+
+	/* number of samples (after decay) a cell needs to answer queries */
+	void set_min_samples( const float min_samples );
+
+private:
+	struct Cell
+	{
+		std::atomic<unsigned int> checksum; // 0 if the cell is empty
+		std::atomic<float> sum[3];
+		std::atomic<float> count;
+	};
+
+	/* index of the cell with the key of the given point or -1 if there is none (or no room for it) */
+	int Find( const Vector3 & position, const Vector3 & normal, const bool insert ) const;
+
+	Cell * cells_{ nullptr };
+	int no_cells_{ 0 };
+	float cell_size_{ 0.05f };
+	float decay_{ 0.5f };
+	float min_samples_{ 4.0f };
+
+	mutable std::atomic<long long> no_failed_inserts_{ 0 };
+};
+
+#endif
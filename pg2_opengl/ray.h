@@ -0,0 +1,46 @@
+#ifndef RAY_H_
+#define RAY_H_
+
+#include <float.h>
+#include "vector3.h"
+
+/*! \struct Ray
+\brief A ray with origin, unit direction and the interval <t_min, t_max> of valid distances.
+*/
+struct Ray
+{
+	Vector3 origin; /*!< Ray origin. */
+	float t_min{ 0.0f }; /*!< Lower bound of the ray parameter. */
+	Vector3 direction; /*!< Unit direction of the ray. */
+	float t_max{ FLT_MAX }; /*!< Upper bound of the ray parameter, shortened to the closest hit found so far. */
+
+	Ray() { }
+
+	Ray( const Vector3 & origin, const Vector3 & direction, const float t_min = 0.0f, const float t_max = FLT_MAX ) :
+		origin( origin ), t_min( t_min ), direction( direction ), t_max( t_max ) { }
+
+	Vector3 point( const float t ) const
+	{
+		return origin + direction * t;
+	}
+};
+
+/*! \struct RayHit
+\brief Result of a closest-hit query.
+*/
+struct RayHit
+{
+	float t{ FLT_MAX }; /*!< Ray parameter of the hit. */
+	float u{ 0.0f }; /*!< Barycentric coordinate of the second vertex. */
+	float v{ 0.0f }; /*!< Barycentric coordinate of the third vertex. */
+	int surface_id{ -1 }; /*!< Index of the hit surface, -1 if nothing was hit. */
+	int triangle_id{ -1 }; /*!< Index of the hit triangle within the surface. */
+	int instance_id{ -1 }; /*!< Index of the hit instance, -1 if the scene is not instanced. */
+
+	bool is_valid() const
+	{
+		return surface_id >= 0;
+	}
+};
+
+#endif
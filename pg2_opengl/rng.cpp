@@ -0,0 +1,87 @@
+#include "pch.h"
+#include "rng.h"
+
+#if defined( __AVX2__ )
+#include <immintrin.h>
+
+/* eight lanes of Hash32 */
+static inline __m256i Hash32x8( __m256i x )
+{
+	x = _mm256_xor_si256( x, _mm256_srli_epi32( x, 16 ) );
+	x = _mm256_mullo_epi32( x, _mm256_set1_epi32( 0x7feb352d ) );
+	x = _mm256_xor_si256( x, _mm256_srli_epi32( x, 15 ) );
+	x = _mm256_mullo_epi32( x, _mm256_set1_epi32( int( 0x846ca68bU ) ) );
+	x = _mm256_xor_si256( x, _mm256_srli_epi32( x, 16 ) );
+
+	return x;
+}
+#endif
+
+Pcg32::Pcg32( const unsigned long long seed, const unsigned long long stream )
+{
+	Seed( seed, stream );
+}
+
+void Pcg32::Seed( const unsigned long long seed, const unsigned long long stream )
+{
+	state_ = 0;
+	inc_ = ( stream << 1 ) | 1;
+	NextUInt();
+	state_ += seed;
+	NextUInt();
+}
+
+unsigned int Pcg32::NextUInt()
+{
+	const unsigned long long old_state = state_;
+	state_ = old_state * 6364136223846793005ULL + inc_;
+	const unsigned int xor_shifted = static_cast<unsigned int>( ( ( old_state >> 18 ) ^ old_state ) >> 27 );
+	const unsigned int rot = static_cast<unsigned int>( old_state >> 59 );
+
+	return ( xor_shifted >> rot ) | ( xor_shifted << ( ( ~rot + 1 ) & 31 ) );
+}
+
+float Pcg32::NextFloat()
+{
+	return UIntToFloat( NextUInt() );
+}
+
+void Pcg32::Fill( float * values, const size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		values[i] = UIntToFloat( NextUInt() );
+	}
+}
+
+RandomStream::RandomStream( const unsigned int pixel, const unsigned int sample, const unsigned int seed )
+{
+	key_ = Hash32( pixel + Hash32( sample + Hash32( seed ) ) );
+}
+
+void RandomStream::Fill( float * values, const unsigned int first_dimension, const size_t n ) const
+{
+	size_t i = 0;
+
+#if defined( __AVX2__ )
+	const __m256i key = _mm256_set1_epi32( int( key_ ) );
+	const __m256i golden = _mm256_set1_epi32( int( 0x9e3779b9U ) );
+	const __m256 scale = _mm256_set1_ps( 1.0f / 16777216.0f );
+	__m256i dimension = _mm256_add_epi32( _mm256_set1_epi32( int( first_dimension ) ),
+		_mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ) );
+
+	for ( ; i + 8 <= n; i += 8 )
+	{
+		// the same sequence of operations as GetUInt, so the results are bit exact with the scalar path
+		__m256i x = Hash32x8( _mm256_add_epi32( dimension, golden ) );
+		x = Hash32x8( _mm256_xor_si256( x, key ) );
+		_mm256_storeu_ps( values + i, _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_srli_epi32( x, 8 ) ), scale ) );
+		dimension = _mm256_add_epi32( dimension, _mm256_set1_epi32( 8 ) );
+	}
+#endif
+
+	for ( ; i < n; ++i )
+	{
+		values[i] = Get( first_dimension + static_cast<unsigned int>( i ) );
+	}
+}
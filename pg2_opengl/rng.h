@@ -0,0 +1,102 @@
+#ifndef RNG_H_
+#define RNG_H_
+
+/*! \fn unsigned int Hash32( unsigned int x )
+\brief Integer finalizer with low bias (lowbias32), used to decorrelate seeds and counters.
+\param x Input value.
+\return Hashed value.
+*/
+inline unsigned int Hash32( unsigned int x )
+{
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+
+	return x;
+}
+
+/*! \fn float UIntToFloat( const unsigned int x )
+\brief Maps 32 random bits to a float uniformly distributed in <0, 1).
+*/
+inline float UIntToFloat( const unsigned int x )
+{
+	return float( x >> 8 ) * ( 1.0f / 16777216.0f ); // 24 bits of mantissa, never returns 1.0f
+}
+
+/*! \class Pcg32
+\brief Permuted congruential generator (PCG-XSH-RR) with 64-bit state and selectable stream.
+
+Small (16 bytes) and fast sequential generator intended to be owned by a single thread.
+Two generators with different streams produce independent sequences even for the same seed.
+
+\code{.cpp}
+Pcg32 rng( 42, thread_id );
+const float ksi = rng.NextFloat();
+\endcode
+*/
+class Pcg32
+{
+public:
+	Pcg32( const unsigned long long seed = 0x853c49e6748fea9bULL,
+		const unsigned long long stream = 0xda3e39cb94b95bdbULL );
+
+	void Seed( const unsigned long long seed, const unsigned long long stream );
+
+	unsigned int NextUInt();
+
+	/* returns a float uniformly distributed in <0, 1) */
+	float NextFloat();
+
+	/* fills the array with n floats uniformly distributed in <0, 1) */
+	void Fill( float * values, const size_t n );
+
+private:
+	unsigned long long state_{ 0 };
+	unsigned long long inc_{ 1 }; // stream selector, must be odd
+};
+
+/*! \class RandomStream
+\brief Stateless counter-based random stream keyed by (pixel, sample).
+
+Every value is a pure function of (seed, pixel, sample, dimension), so the rendered image does not depend
+on the number of threads nor on the order in which the pixels are processed. Dimensions are consumed by
+the integrator in a fixed order (e.g. 0-1 pixel jitter, 2-3 first bounce direction, ...).
+
+\code{.cpp}
+RandomStream stream( y * width + x, s );
+const float ksi_1 = stream.Get( 0 );
+float ksi[16];
+stream.Fill( ksi, 2, 16 ); // dimensions 2..17
+\endcode
+*/
+class RandomStream
+{
+public:
+	RandomStream( const unsigned int pixel, const unsigned int sample, const unsigned int seed = 0 );
+
+	/* returns the value of the given dimension in <0, 1) */
+	float Get( const unsigned int dimension ) const
+	{
+		return UIntToFloat( GetUInt( dimension ) );
+	}
+
+	unsigned int GetUInt( const unsigned int dimension ) const
+	{
+		return Hash32( key_ ^ Hash32( dimension + 0x9e3779b9U ) );
+	}
+
+	/* fills the array with values of dimensions <first_dimension, first_dimension + n), SIMD accelerated */
+	void Fill( float * values, const unsigned int first_dimension, const size_t n ) const;
+
+	unsigned int key() const
+	{
+		return key_;
+	}
+
+private:
+	unsigned int key_{ 0 };
+};
+
+#endif
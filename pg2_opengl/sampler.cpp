@@ -0,0 +1,171 @@
+#include "pch.h"
+#include "sampler.h"
+#include "rng.h"
+#include "mymath.h"
+
+static const unsigned int primes[HaltonSampler::kMaxDimensions] = {
+	2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+	59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131 };
+
+/* direction numbers of the first four Sobol dimensions (Joe & Kuo) */
+struct SobolMatrices
+{
+	unsigned int v[4][32];
+	unsigned int bytes[4][4][256]; // XOR of the direction numbers selected by each byte of the index
+
+	SobolMatrices()
+	{
+		// primitive polynomials (degree s, coefficients a) and initial numbers m
+		const int s[] = { 1, 2, 3 };
+		const unsigned int a[] = { 0, 1, 1 };
+		const unsigned int m[3][3] = { { 1, 0, 0 }, { 1, 3, 0 }, { 1, 3, 1 } };
+
+		for ( int i = 0; i < 32; ++i )
+		{
+			v[0][i] = 1U << ( 31 - i ); // van der Corput
+		}
+
+		for ( int d = 1; d < 4; ++d )
+		{
+			const int deg = s[d - 1];
+
+			for ( int i = 0; i < 32; ++i )
+			{
+				if ( i < deg )
+				{
+					v[d][i] = m[d - 1][i] << ( 31 - i );
+				}
+				else
+				{
+					v[d][i] = v[d][i - deg] ^ ( v[d][i - deg] >> deg );
+
+					for ( int k = 1; k < deg; ++k )
+					{
+						v[d][i] ^= ( ( a[d - 1] >> ( deg - 1 - k ) ) & 1 ) * v[d][i - k];
+					}
+				}
+			}
+		}
+
+		for ( int d = 0; d < 4; ++d )
+		{
+			for ( int b = 0; b < 4; ++b )
+			{
+				for ( int value = 0; value < 256; ++value )
+				{
+					unsigned int x = 0;
+
+					for ( int i = 0; i < 8; ++i )
+					{
+						if ( value & ( 1 << i ) ) x ^= v[d][8 * b + i];
+					}
+
+					bytes[d][b][value] = x;
+				}
+			}
+		}
+	}
+};
+
+static const SobolMatrices sobol_matrices;
+
+static inline unsigned int ReverseBits( unsigned int x )
+{
+	x = ( ( x >> 1 ) & 0x55555555U ) | ( ( x & 0x55555555U ) << 1 );
+	x = ( ( x >> 2 ) & 0x33333333U ) | ( ( x & 0x33333333U ) << 2 );
+	x = ( ( x >> 4 ) & 0x0f0f0f0fU ) | ( ( x & 0x0f0f0f0fU ) << 4 );
+	x = ( ( x >> 8 ) & 0x00ff00ffU ) | ( ( x & 0x00ff00ffU ) << 8 );
+
+	return ( x >> 16 ) | ( x << 16 );
+}
+
+/* hash-based nested uniform (Owen) scramble of 32-bit fixed point value, Burley 2020 */
+static inline unsigned int OwenScramble( unsigned int x, const unsigned int seed )
+{
+	x = ReverseBits( x );
+	x += seed;
+	x ^= x * 0x6c50b47cU;
+	x ^= x * 0xb82f1e52U;
+	x ^= x * 0xc7afe638U;
+	x ^= x * 0x8d22f6e6U;
+
+	return ReverseBits( x );
+}
+
+float RandomSampler::Get( const unsigned int pixel, const unsigned int sample, const unsigned int dimension ) const
+{
+	return RandomStream( pixel, sample, seed_ ).Get( dimension );
+}
+
+unsigned int SobolSampler::Sobol( const unsigned int index, const int dimension )
+{
+	assert( dimension >= 0 && dimension < 4 );
+
+	// shuffled indices use all 32 bits, so process them by bytes
+	const unsigned int ( &bytes )[4][256] = sobol_matrices.bytes[dimension];
+
+	return bytes[0][index & 0xff] ^ bytes[1][( index >> 8 ) & 0xff] ^
+		bytes[2][( index >> 16 ) & 0xff] ^ bytes[3][index >> 24];
+}
+
+float SobolSampler::Get( const unsigned int pixel, const unsigned int sample, const unsigned int dimension ) const
+{
+	const unsigned int group_seed = Hash32( pixel + Hash32( ( dimension >> 2 ) + Hash32( seed_ ) ) );
+	const unsigned int index = OwenScramble( sample, group_seed ); // shuffle the order of samples
+	const unsigned int x = OwenScramble( Sobol( index, dimension & 3 ), Hash32( group_seed + ( dimension & 3 ) ) );
+
+	return UIntToFloat( x );
+}
+
+float HaltonSampler::Get( const unsigned int pixel, const unsigned int sample, const unsigned int dimension ) const
+{
+	const unsigned int base = primes[dimension % kMaxDimensions];
+	const float inv_base = 1.0f / base;
+	const unsigned int seed = Hash32( pixel + Hash32( dimension + Hash32( seed_ ) ) );
+
+	// digits are permuted by random shifts, each depending on all the preceding digits (Owen scrambling)
+	unsigned int index = sample;
+	unsigned int prefix = seed;
+	float value = 0.0f;
+	float weight = inv_base;
+
+	while ( weight > 1e-7f )
+	{
+		const unsigned int digit = index % base;
+		const unsigned int permuted_digit = ( digit + Hash32( prefix ) ) % base;
+		value += permuted_digit * weight;
+		prefix = Hash32( prefix ^ ( digit + 1 ) );
+		index /= base;
+		weight *= inv_base;
+	}
+
+	return min( value, 1.0f - FLT_EPSILON * 0.5f );
+}
+
+BlueNoiseSampler::BlueNoiseSampler( const Sampler & sampler, const int width, const unsigned int seed ) :
+	Sampler( seed ), sampler_( sampler ), width_( width )
+{
+	assert( width > 0 );
+}
+
+float BlueNoiseSampler::Dither( const int x, const int y )
+{
+	// R2 sequence (plastic number), Roberts 2018
+	const double a1 = 0.7548776662466927;
+	const double a2 = 0.5698402909980532;
+	const double v = 0.5 + a1 * x + a2 * y;
+
+	return float( v - floor( v ) );
+}
+
+float BlueNoiseSampler::Get( const unsigned int pixel, const unsigned int sample, const unsigned int dimension ) const
+{
+	const int x = int( pixel % width_ );
+	const int y = int( pixel / width_ );
+
+	// rotate the mask per dimension by the golden ratio so that the dimensions are not correlated
+	const float offset = Dither( x, y ) + 0.618034f * ( dimension + seed_ );
+	const float v = sampler_.Get( 0, sample, dimension ) + offset;
+
+	return min( v - floorf( v ), 1.0f - FLT_EPSILON * 0.5f );
+}
@@ -0,0 +1,117 @@
+#ifndef SAMPLER_H_
+#define SAMPLER_H_
+
+#include "structs.h"
+
+/*! \class Sampler
+\brief Abstract stateless sampler of the unit hypercube.
+
+A sample is addressed by (pixel, sample index, dimension), so the integrator may ask for any value in any
+order and from any thread. Dimensions should be consumed in a fixed order along the path, low dimensions
+(pixel jitter, first bounce) are the best distributed ones.
+
+\code{.cpp}
+SobolSampler sampler;
+const Coord2f jitter = sampler.Get2D( y * width + x, s, 0 );
+const Coord2f ksi = sampler.Get2D( y * width + x, s, 2 );
+\endcode
+*/
+class Sampler
+{
+public:
+	Sampler( const unsigned int seed = 0 ) : seed_( seed ) { }
+
+	virtual ~Sampler() { }
+
+	/* returns the value of the given dimension in <0, 1) */
+	virtual float Get( const unsigned int pixel, const unsigned int sample, const unsigned int dimension ) const = 0;
+
+	/* returns the values of the dimensions (dimension, dimension + 1) */
+	Coord2f Get2D( const unsigned int pixel, const unsigned int sample, const unsigned int dimension ) const
+	{
+		return Coord2f{ Get( pixel, sample, dimension ), Get( pixel, sample, dimension + 1 ) };
+	}
+
+	virtual const char * name() const = 0;
+
+protected:
+	unsigned int seed_{ 0 };
+};
+
+/*! \class RandomSampler
+\brief Independent uniform samples (see RandomStream), the reference the other samplers are compared to.
+*/
+class RandomSampler : public Sampler
+{
+public:
+	using Sampler::Sampler;
+
+	float Get( const unsigned int pixel, const unsigned int sample, const unsigned int dimension ) const override;
+
+	const char * name() const override { return "random"; }
+};
+
+/*! \class SobolSampler
+\brief Owen-scrambled Sobol sequence.
+
+Dimensions are grouped by four, each group uses the first four Sobol dimensions with the sample index shuffled
+and the values scrambled by a hash-based nested uniform scramble seeded by (pixel, group), see Burley 2020,
+Practical Hash-based Owen Scrambling. The result is progressive (any prefix of samples is well stratified)
+and decorrelated across pixels.
+*/
+class SobolSampler : public Sampler
+{
+public:
+	using Sampler::Sampler;
+
+	float Get( const unsigned int pixel, const unsigned int sample, const unsigned int dimension ) const override;
+
+	const char * name() const override { return "sobol (owen)"; }
+
+	/* i-th element of the unscrambled Sobol sequence in the given dimension <0, 3>, 32-bit fixed point */
+	static unsigned int Sobol( const unsigned int index, const int dimension );
+};
+
+/*! \class HaltonSampler
+\brief Halton sequence with hash-based Owen scrambling of the digits in each prime base.
+
+Supports up to kMaxDimensions dimensions; higher dimensions reuse the bases with different scrambles.
+*/
+class HaltonSampler : public Sampler
+{
+public:
+	using Sampler::Sampler;
+
+	float Get( const unsigned int pixel, const unsigned int sample, const unsigned int dimension ) const override;
+
+	const char * name() const override { return "halton (owen)"; }
+
+	static const int kMaxDimensions = 32;
+};
+
+/*! \class BlueNoiseSampler
+\brief Decorator that offsets the samples of another sampler by a per-pixel blue-noise dither.
+
+All pixels share one sequence of the wrapped sampler and each dimension is toroidally shifted
+(Cranley-Patterson rotation) by the value of the R2 dither mask. Neighbouring pixels thus get well separated
+offsets and the error of low sample counts is pushed to high frequencies, where it is less visible and easier
+to filter. The pixel index is expected to be y * width + x.
+*/
+class BlueNoiseSampler : public Sampler
+{
+public:
+	BlueNoiseSampler( const Sampler & sampler, const int width, const unsigned int seed = 0 );
+
+	float Get( const unsigned int pixel, const unsigned int sample, const unsigned int dimension ) const override;
+
+	const char * name() const override { return "blue noise"; }
+
+	/* value of the dither mask at the given pixel in <0, 1) */
+	static float Dither( const int x, const int y );
+
+private:
+	const Sampler & sampler_;
+	int width_{ 1 };
+};
+
+#endif
@@ -0,0 +1,698 @@
+#include "pch.h"
+#include "scene.h"
+#include <numeric>
+
+/* world space bounds of the transformed box */
+static Aabb TransformBounds( const Matrix3x4 & transform, const Aabb & box )
+{
+	Aabb result;
+
+	for ( int i = 0; i < 8; ++i )
+	{
+		const Vector3 corner( ( i & 1 ) ? box.upper.x : box.lower.x, ( i & 2 ) ? box.upper.y : box.lower.y,
+			( i & 4 ) ? box.upper.z : box.lower.z );
+		result.Grow( transform.TransformPoint( corner ) );
+	}
+
+	return result;
+}
+
+Scene::Scene( const std::vector<Surface *> & surfaces, const std::vector<Material *> & materials,
+	const std::vector<Instance> & instances )
+{
+	surfaces_ = surfaces;
+	materials_.assign( materials.begin(), materials.end() );
+	materials_.push_back( &default_material_ );
+
+	std::map<const Material *, int> material_ids;
+
+	for ( int i = 0; i < static_cast<int>( materials.size() ); ++i )
+	{
+		material_ids[materials[i]] = i;
+	}
+
+	for ( int s = 0; s < static_cast<int>( surfaces_.size() ); ++s )
+	{
+		auto material_id = material_ids.find( surfaces_[s]->get_material() );
+		surface_material_ids_.push_back( ( material_id != material_ids.end() ) ? material_id->second : no_materials() - 1 );
+	}
+
+	if ( instances.empty() )
+	{
+		std::vector<int> surface_ids( surfaces_.size() );
+		std::iota( surface_ids.begin(), surface_ids.end(), 0 );
+
+		BuildMesh( surface_ids, mesh_ );
+		mesh_.bvh.Print();
+
+		return;
+	}
+
+	instances_ = instances;
+	inverse_transforms_.resize( instances_.size() );
+	meshes_.resize( surfaces_.size() );
+
+	std::vector<int> instanced_surfaces;
+	std::vector<char> is_instanced( surfaces_.size(), false );
+
+	for ( const Instance & instance : instances_ )
+	{
+		assert( instance.surface_id >= 0 && instance.surface_id < static_cast<int>( surfaces_.size() ) );
+
+		if ( !is_instanced[instance.surface_id] ) instanced_surfaces.push_back( instance.surface_id );
+
+		is_instanced[instance.surface_id] = true;
+	}
+
+	// bottom level, one BVH per surface in its object space
+	const int no_instanced_surfaces = static_cast<int>( instanced_surfaces.size() );
+
+#pragma omp parallel for schedule( dynamic, 1 )
+	for ( int i = 0; i < no_instanced_surfaces; ++i )
+	{
+		BuildMesh( { instanced_surfaces[i] }, meshes_[instanced_surfaces[i]] );
+	}
+
+	const int no_instances = static_cast<int>( instances_.size() );
+	long long no_placed_triangles = 0;
+
+#pragma omp parallel for reduction( + : no_placed_triangles )
+	for ( int i = 0; i < no_instances; ++i )
+	{
+		inverse_transforms_[i] = instances_[i].transform.Inverse();
+		no_placed_triangles += meshes_[instances_[i].surface_id].triangles.size();
+	}
+
+	BuildTopLevel();
+	top_level_.Print();
+
+	size_t no_stored_triangles = 0;
+
+	for ( const int surface_id : instanced_surfaces )
+	{
+		no_stored_triangles += meshes_[surface_id].triangles.size();
+	}
+
+	printf( "%d instances of %d surfaces, %I64d triangles placed, %I64u stored, %0.1f MB\n", no_instances,
+		no_instanced_surfaces, no_placed_triangles, no_stored_triangles, memory() / ( 1024.0 * 1024.0 ) );
+}
+
+void Scene::BuildMesh( const std::vector<int> & surface_ids, Mesh & mesh )
+{
+	std::vector<Aabb> bounds;
+	std::vector<Vector3> vertices;
+	std::vector<TriangleRef> triangles;
+
+	for ( const int s : surface_ids )
+	{
+		Surface * surface = surfaces_[s];
+
+		for ( int t = 0; t < surface->no_triangles(); ++t )
+		{
+			Triangle & triangle = surface->get_triangle( t );
+			Aabb box;
+
+			for ( int i = 0; i < 3; ++i )
+			{
+				box.Grow( triangle.vertex( i ).position );
+
+				if ( max_duplication_ > 0.0f ) vertices.push_back( triangle.vertex( i ).position );
+			}
+
+			bounds.push_back( box );
+			triangles.push_back( TriangleRef{ s, t } );
+		}
+	}
+
+	mesh.surface_ids = surface_ids;
+	mesh.compressed = QuantizedBvh();
+	if ( max_duplication_ > 0.0f )
+	{
+		mesh.bvh.BuildSpatial( vertices, 4, max_duplication_ );
+	}
+	else
+	{
+		mesh.bvh.Build( bounds );
+	}
+
+	mesh.built_sah = mesh.bvh.SahCost();
+
+	// reorder the triangles so that the leaves refer to contiguous ranges of vertex positions, split triangles repeat
+	const size_t no_references = mesh.bvh.indices().size();
+	mesh.triangles.resize( no_references );
+	mesh.blocks.assign( ( no_references + kTriangleBlockWidth - 1 ) / kTriangleBlockWidth, TriangleBlock() );
+
+	for ( size_t i = 0; i < no_references; ++i )
+	{
+		const TriangleRef & ref = triangles[mesh.bvh.indices()[i]];
+		Triangle & triangle = surfaces_[ref.surface_id]->get_triangle( ref.triangle_id );
+
+		mesh.triangles[i] = ref;
+		mesh.blocks[i / kTriangleBlockWidth].set( i % kTriangleBlockWidth, triangle.vertex( 0 ).position,
+			triangle.vertex( 1 ).position, triangle.vertex( 2 ).position );
+	}
+}
+
+void Scene::RefitMesh( Mesh & mesh, const std::vector<char> & deformed )
+{
+	assert( mesh.compressed.empty() );
+
+	const int n = static_cast<int>( mesh.triangles.size() );
+
+#pragma omp parallel for
+	for ( int i = 0; i < n; ++i )
+	{
+		const TriangleRef & ref = mesh.triangles[i];
+
+		if ( deformed[ref.surface_id] )
+		{
+			Triangle & triangle = surfaces_[ref.surface_id]->get_triangle( ref.triangle_id );
+			mesh.blocks[i / kTriangleBlockWidth].set( i % kTriangleBlockWidth, triangle.vertex( 0 ).position,
+				triangle.vertex( 1 ).position, triangle.vertex( 2 ).position );
+		}
+	}
+
+	// bounds of the whole triangles in the order of BuildMesh, the leaves may reference a triangle more than once
+	std::vector<Aabb> bounds( mesh.bvh.no_primitives() );
+	int first = 0;
+
+	for ( const int s : mesh.surface_ids )
+	{
+		Surface * surface = surfaces_[s];
+		const int no_triangles = surface->no_triangles();
+
+#pragma omp parallel for
+		for ( int t = 0; t < no_triangles; ++t )
+		{
+			Triangle & triangle = surface->get_triangle( t );
+
+			for ( int j = 0; j < 3; ++j )
+			{
+				bounds[first + t].Grow( triangle.vertex( j ).position );
+			}
+		}
+
+		first += no_triangles;
+	}
+
+	mesh.bvh.Refit( bounds );
+
+	if ( mesh.bvh.SahCost() > rebuild_threshold_ * mesh.built_sah )
+	{
+		const std::vector<int> surface_ids = mesh.surface_ids;
+		BuildMesh( surface_ids, mesh );
+		++no_rebuilds_;
+	}
+}
+
+void Scene::BuildTopLevel()
+{
+	top_level_instances_.clear();
+
+	for ( int i = 0; i < static_cast<int>( instances_.size() ); ++i )
+	{
+		if ( instances_[i].surface_id >= 0 ) top_level_instances_.push_back( i );
+	}
+
+	const int n = static_cast<int>( top_level_instances_.size() );
+	std::vector<Aabb> bounds( n );
+
+#pragma omp parallel for
+	for ( int i = 0; i < n; ++i )
+	{
+		const Instance & instance = instances_[top_level_instances_[i]];
+		bounds[i] = TransformBounds( instance.transform, meshes_[instance.surface_id].bounds() );
+	}
+
+	top_level_.Build( bounds, 1 );
+	top_level_sah_ = top_level_.SahCost();
+}
+
+void Scene::Refit( const std::vector<int> & surface_ids )
+{
+	std::vector<char> deformed( surfaces_.size(), false );
+
+	for ( const int surface_id : surface_ids )
+	{
+		deformed[surface_id] = true;
+	}
+
+	if ( instances_.empty() )
+	{
+		RefitMesh( mesh_, deformed );
+
+		return;
+	}
+
+	// every deformed mesh once, a surface listed twice would be refitted by two threads at once
+	std::vector<int> deformed_ids;
+
+	for ( int i = 0; i < static_cast<int>( deformed.size() ); ++i )
+	{
+		if ( deformed[i] ) deformed_ids.push_back( i );
+	}
+
+	const int n = static_cast<int>( deformed_ids.size() );
+
+#pragma omp parallel for schedule( dynamic, 1 )
+	for ( int i = 0; i < n; ++i )
+	{
+		Mesh & mesh = meshes_[deformed_ids[i]];
+
+		if ( !mesh.triangles.empty() ) RefitMesh( mesh, deformed );
+	}
+
+	refit_top_level_ = true;
+	Commit();
+}
+
+int Scene::AddSurface( Surface * surface )
+{
+	const auto material = std::find( materials_.begin(), materials_.end() - 1, surface->get_material() );
+
+	surfaces_.push_back( surface );
+	surface_material_ids_.push_back( static_cast<int>( material - materials_.begin() ) ); // the default one if not found
+	meshes_.resize( surfaces_.size() );
+	rebuild_mesh_ = true;
+
+	return static_cast<int>( surfaces_.size() ) - 1;
+}
+
+int Scene::AddInstance( const Instance & instance )
+{
+	assert( !instances_.empty() || mesh_.triangles.empty() );
+	assert( instance.surface_id >= 0 && instance.surface_id < static_cast<int>( surfaces_.size() ) );
+
+	meshes_.resize( surfaces_.size() );
+	Mesh & mesh = meshes_[instance.surface_id];
+
+	if ( mesh.triangles.empty() ) BuildMesh( { instance.surface_id }, mesh );
+
+	instances_.push_back( instance );
+	inverse_transforms_.push_back( instance.transform.Inverse() );
+	rebuild_top_level_ = true;
+
+	return static_cast<int>( instances_.size() ) - 1;
+}
+
+void Scene::RemoveInstance( const int instance_id )
+{
+	instances_[instance_id].surface_id = -1;
+	rebuild_top_level_ = true;
+}
+
+void Scene::SetTransform( const int instance_id, const Matrix3x4 & transform )
+{
+	instances_[instance_id].transform = transform;
+	inverse_transforms_[instance_id] = transform.Inverse();
+	refit_top_level_ = true;
+}
+
+void Scene::Commit()
+{
+	if ( instances_.empty() )
+	{
+		if ( rebuild_mesh_ )
+		{
+			std::vector<int> surface_ids( surfaces_.size() );
+			std::iota( surface_ids.begin(), surface_ids.end(), 0 );
+			BuildMesh( surface_ids, mesh_ );
+		}
+	}
+	else if ( rebuild_top_level_ )
+	{
+		BuildTopLevel();
+	}
+	else if ( refit_top_level_ )
+	{
+		const int n = static_cast<int>( top_level_instances_.size() );
+		std::vector<Aabb> bounds( n );
+
+#pragma omp parallel for
+		for ( int i = 0; i < n; ++i )
+		{
+			const Instance & instance = instances_[top_level_instances_[i]];
+			bounds[i] = TransformBounds( instance.transform, meshes_[instance.surface_id].bounds() );
+		}
+
+		top_level_.Refit( bounds );
+
+		if ( top_level_.SahCost() > rebuild_threshold_ * top_level_sah_ )
+		{
+			BuildTopLevel();
+			++no_rebuilds_;
+		}
+	}
+
+	rebuild_mesh_ = false;
+	rebuild_top_level_ = false;
+	refit_top_level_ = false;
+}
+
+void Scene::set_rebuild_threshold( const float threshold )
+{
+	assert( threshold >= 1.0f );
+
+	rebuild_threshold_ = threshold;
+}
+
+void Scene::UseSpatialSplits( const float max_duplication )
+{
+	assert( max_duplication >= 0.0f );
+
+	max_duplication_ = max_duplication;
+
+	if ( instances_.empty() )
+	{
+		if ( !mesh_.triangles.empty() ) BuildMesh( mesh_.surface_ids, mesh_ );
+
+		return;
+	}
+
+	const int no_meshes = static_cast<int>( meshes_.size() );
+
+#pragma omp parallel for schedule( dynamic, 1 )
+	for ( int i = 0; i < no_meshes; ++i )
+	{
+		if ( !meshes_[i].triangles.empty() ) BuildMesh( meshes_[i].surface_ids, meshes_[i] );
+	}
+}
+
+void Scene::OptimizeBvhs( const int iterations )
+{
+	auto optimize = [&]( Mesh & mesh ) {
+		mesh.bvh.Optimize( iterations );
+		mesh.built_sah = mesh.bvh.SahCost(); };
+
+	if ( instances_.empty() )
+	{
+		optimize( mesh_ );
+
+		return;
+	}
+
+	const int no_meshes = static_cast<int>( meshes_.size() );
+
+#pragma omp parallel for schedule( dynamic, 1 )
+	for ( int i = 0; i < no_meshes; ++i )
+	{
+		optimize( meshes_[i] );
+	}
+
+	top_level_.Optimize( iterations );
+	top_level_sah_ = top_level_.SahCost();
+}
+
+int Scene::no_rebuilds() const
+{
+	return no_rebuilds_.load();
+}
+
+void Scene::Compress()
+{
+	if ( instances_.empty() )
+	{
+		mesh_.compressed.Build( mesh_.bvh );
+		mesh_.bvh = Bvh();
+
+		return;
+	}
+
+	const int no_meshes = static_cast<int>( meshes_.size() );
+
+#pragma omp parallel for schedule( dynamic, 1 )
+	for ( int i = 0; i < no_meshes; ++i )
+	{
+		if ( meshes_[i].triangles.empty() || !meshes_[i].compressed.empty() ) continue;
+
+		meshes_[i].compressed.Build( meshes_[i].bvh );
+		meshes_[i].bvh = Bvh();
+	}
+}
+
+template<class F> void Scene::TraverseMesh( const Mesh & mesh, Ray & ray, F && leaf )
+{
+	if ( mesh.compressed.empty() )
+	{
+		mesh.bvh.Traverse( ray, leaf );
+	}
+	else
+	{
+		mesh.compressed.Traverse( ray, leaf );
+	}
+}
+
+bool Scene::IntersectMesh( const Mesh & mesh, Ray & ray, RayHit & hit )
+{
+	bool found = false;
+	const WatertightRay sheared( ray );
+
+	TraverseMesh( mesh, ray, [&]( const int first, const int count ) {
+		// the leaf may start and end in the middle of a block
+		for ( int block = first / kTriangleBlockWidth; block * kTriangleBlockWidth < first + count; ++block )
+		{
+			const int base = block * kTriangleBlockWidth;
+			float t, u, v;
+			const int lane = IntersectBlock( mesh.blocks[block], sheared, max( first - base, 0 ),
+				min( first + count - base, kTriangleBlockWidth ), ray.t_min, ray.t_max, t, u, v );
+
+			if ( lane >= 0 )
+			{
+				const int i = base + lane;
+				ray.t_max = t;
+				hit.t = t;
+				hit.u = u;
+				hit.v = v;
+				hit.surface_id = mesh.triangles[i].surface_id;
+				hit.triangle_id = mesh.triangles[i].triangle_id;
+				found = true;
+			}
+		}
+
+		return false;
+	} );
+
+	return found;
+}
+
+bool Scene::OccludedMesh( const Mesh & mesh, Ray & ray )
+{
+	bool occluded = false;
+	const WatertightRay sheared( ray );
+
+	TraverseMesh( mesh, ray, [&]( const int first, const int count ) {
+		for ( int block = first / kTriangleBlockWidth; block * kTriangleBlockWidth < first + count; ++block )
+		{
+			const int base = block * kTriangleBlockWidth;
+			float t, u, v;
+
+			if ( IntersectBlock( mesh.blocks[block], sheared, max( first - base, 0 ), min( first + count - base,
+				kTriangleBlockWidth ), ray.t_min, ray.t_max, t, u, v ) >= 0 )
+			{
+				occluded = true;
+
+				return true; // any hit terminates the traversal
+			}
+		}
+
+		return false;
+	} );
+
+	return occluded;
+}
+
+void Scene::Intersect( Ray & ray, RayHit & hit ) const
+{
+	if ( instances_.empty() )
+	{
+		IntersectMesh( mesh_, ray, hit );
+
+		return;
+	}
+
+	top_level_.Traverse( ray, [&]( const int first, const int count ) {
+		for ( int i = first; i < first + count; ++i )
+		{
+			const int instance_id = top_level_instances_[top_level_.indices()[i]];
+			const Matrix3x4 & inverse = inverse_transforms_[instance_id];
+			Ray object_ray( inverse.TransformPoint( ray.origin ), inverse.TransformVector( ray.direction ), ray.t_min,
+				ray.t_max );
+
+			if ( IntersectMesh( meshes_[instances_[instance_id].surface_id], object_ray, hit ) )
+			{
+				ray.t_max = object_ray.t_max;
+				hit.instance_id = instance_id;
+			}
+		}
+
+		return false;
+	} );
+}
+
+bool Scene::Occluded( Ray ray ) const
+{
+	if ( instances_.empty() ) return OccludedMesh( mesh_, ray );
+
+	bool occluded = false;
+
+	top_level_.Traverse( ray, [&]( const int first, const int count ) {
+		for ( int i = first; i < first + count; ++i )
+		{
+			const int instance_id = top_level_instances_[top_level_.indices()[i]];
+			const Matrix3x4 & inverse = inverse_transforms_[instance_id];
+			Ray object_ray( inverse.TransformPoint( ray.origin ), inverse.TransformVector( ray.direction ), ray.t_min,
+				ray.t_max );
+
+			if ( OccludedMesh( meshes_[instances_[instance_id].surface_id], object_ray ) )
+			{
+				occluded = true;
+
+				return true;
+			}
+		}
+
+		return false;
+	} );
+
+	return occluded;
+}
+
+void Scene::Interpolate( const RayHit & hit, Vector3 & position, Vector3 & shading_normal, Vector3 & geometric_normal,
+	Coord2f & tex_coord ) const
+{
+	assert( hit.is_valid() );
+
+	Triangle & triangle = surfaces_[hit.surface_id]->get_triangle( hit.triangle_id );
+	const Vertex v0 = triangle.vertex( 0 );
+	const Vertex v1 = triangle.vertex( 1 );
+	const Vertex v2 = triangle.vertex( 2 );
+	const float w = 1.0f - hit.u - hit.v;
+
+	position = v0.position * w + v1.position * hit.u + v2.position * hit.v;
+
+	geometric_normal = ( v1.position - v0.position ).CrossProduct( v2.position - v0.position );
+	geometric_normal.Normalize();
+
+	shading_normal = v0.normal * w + v1.normal * hit.u + v2.normal * hit.v;
+	if ( shading_normal.Normalize() == 0.0f ) shading_normal = geometric_normal;
+
+	tex_coord.u = v0.texture_coords[0].u * w + v1.texture_coords[0].u * hit.u + v2.texture_coords[0].u * hit.v;
+	tex_coord.v = v0.texture_coords[0].v * w + v1.texture_coords[0].v * hit.u + v2.texture_coords[0].v * hit.v;
+
+	if ( hit.instance_id >= 0 )
+	{
+		const Matrix3x4 & inverse = inverse_transforms_[hit.instance_id];
+
+		position = instances_[hit.instance_id].transform.TransformPoint( position );
+		geometric_normal = inverse.TransformNormal( geometric_normal );
+		geometric_normal.Normalize();
+		shading_normal = inverse.TransformNormal( shading_normal );
+		shading_normal.Normalize();
+	}
+}
+
+void Scene::TexCoordDifferentials( const RayHit & hit, const Ray & ray, const Vector3 & d_dx, const Vector3 & d_dy,
+	Coord2f & duv_dx, Coord2f & duv_dy ) const
+{
+	assert( hit.is_valid() );
+
+	duv_dx = Coord2f{ 0.0f, 0.0f };
+	duv_dy = Coord2f{ 0.0f, 0.0f };
+
+	Triangle & triangle = surfaces_[hit.surface_id]->get_triangle( hit.triangle_id );
+	const Vertex v0 = triangle.vertex( 0 );
+	const Vertex v1 = triangle.vertex( 1 );
+	const Vertex v2 = triangle.vertex( 2 );
+	const Vector3 e1 = v1.position - v0.position;
+	const Vector3 e2 = v2.position - v0.position;
+	const Vector3 normal = e1.CrossProduct( e2 );
+
+	// the triangle is in the object space of the instance, the distance of the hit is the same there
+	Vector3 direction = ray.direction;
+	Vector3 d_directions[2] = { d_dx, d_dy };
+
+	if ( hit.instance_id >= 0 )
+	{
+		const Matrix3x4 & inverse = inverse_transforms_[hit.instance_id];
+
+		direction = inverse.TransformVector( direction );
+		d_directions[0] = inverse.TransformVector( d_dx );
+		d_directions[1] = inverse.TransformVector( d_dy );
+	}
+
+	const float d_dot_n = direction.DotProduct( normal );
+	const float e11 = e1.DotProduct( e1 ), e12 = e1.DotProduct( e2 ), e22 = e2.DotProduct( e2 );
+	const float det = e11 * e22 - e12 * e12;
+
+	if ( d_dot_n == 0.0f || det == 0.0f ) return;
+
+	Coord2f * duvs[2] = { &duv_dx, &duv_dy };
+
+	for ( int i = 0; i < 2; ++i )
+	{
+		// offset of the hit point transferred onto the plane of the triangle (Igehy 1999)
+		const Vector3 dp = d_directions[i] * hit.t;
+		const Vector3 dp_plane = dp - direction * ( dp.DotProduct( normal ) / d_dot_n );
+
+		// barycentric offsets of the in-plane vector, dp = db1 e1 + db2 e2
+		const float r1 = dp_plane.DotProduct( e1 );
+		const float r2 = dp_plane.DotProduct( e2 );
+		const float db1 = ( e22 * r1 - e12 * r2 ) / det;
+		const float db2 = ( e11 * r2 - e12 * r1 ) / det;
+
+		duvs[i]->u = db1 * ( v1.texture_coords[0].u - v0.texture_coords[0].u ) + db2 * ( v2.texture_coords[0].u - v0.texture_coords[0].u );
+		duvs[i]->v = db1 * ( v1.texture_coords[0].v - v0.texture_coords[0].v ) + db2 * ( v2.texture_coords[0].v - v0.texture_coords[0].v );
+	}
+}
+
+int Scene::material_id( const RayHit & hit ) const
+{
+	return surface_material_ids_[hit.surface_id];
+}
+
+int Scene::surface_material_id( const int surface_id ) const
+{
+	return surface_material_ids_[surface_id];
+}
+
+const Material * Scene::material( const int material_id ) const
+{
+	return materials_[material_id];
+}
+
+int Scene::no_materials() const
+{
+	return static_cast<int>( materials_.size() );
+}
+
+const std::vector<Surface *> & Scene::surfaces() const
+{
+	return surfaces_;
+}
+
+const Bvh & Scene::bvh() const
+{
+	return ( instances_.empty() ) ? mesh_.bvh : top_level_;
+}
+
+const std::vector<Instance> & Scene::instances() const
+{
+	return instances_;
+}
+
+size_t Scene::memory() const
+{
+	auto mesh_memory = []( const Mesh & mesh ) {
+		return mesh.bvh.nodes().size() * sizeof( BvhNode ) + mesh.bvh.indices().size() * sizeof( int ) + mesh.compressed.memory() +
+			mesh.triangles.size() * sizeof( TriangleRef ) + mesh.blocks.size() * sizeof( TriangleBlock ); };
+
+	size_t bytes = mesh_memory( mesh_ );
+
+	for ( const Mesh & mesh : meshes_ )
+	{
+		bytes += mesh_memory( mesh );
+	}
+
+	return bytes + instances_.size() * ( sizeof( Instance ) + sizeof( Matrix3x4 ) ) +
+		top_level_.nodes().size() * sizeof( BvhNode ) + top_level_.indices().size() * 2 * sizeof( int );
+}
@@ -0,0 +1,188 @@
+#ifndef SCENE_H_
+#define SCENE_H_
+
+#include "surface.h"
+#include "bvh.h"
+#include "quantized_bvh.h"
+#include "triangle_block.h"
+#include "matrix3x4.h"
+
+/*! \struct Instance
+\brief A placement of a surface given by an affine transformation from its object space to the world space.
+*/
+struct Instance
+{
+	int surface_id; /*!< Index of the placed surface. */
+	Matrix3x4 transform; /*!< Object to world transformation. */
+};
+
+/*! \class Scene
+\brief Surfaces and materials prepared for ray tracing.
+
+Owns the acceleration structures, the surfaces and materials themselves remain owned by the caller (see LoadOBJ).
+
+Without instances every surface is placed once as it is and a single BVH is built over all triangles. With
+instances only the instances are placed, a surface may be placed any number of times. Every placed surface gets
+its own bottom-level BVH in the object space and a top-level BVH is built over the world space bounds of the
+instances. Rays entering an instance are transformed into its object space (the direction is not normalized, so
+the distances remain the same), hits report the instance (RayHit::instance_id) and Interpolate returns world
+space attributes. A forest of 100k identical trees thus costs one mesh and 100k transformations.
+
+Dynamic scenes: Refit takes the new vertex positions of deformed surfaces (same triangles) and refits their BVHs
+in O(n) in parallel. Instances may be moved, added and removed, Commit then refits the top level if the
+instances only moved and rebuilds it (the bottom levels are kept) if any were added or removed. Whenever the SAH
+cost of a refitted BVH exceeds rebuild_threshold times its cost after the last build, the BVH is rebuilt from
+scratch. None of this may run concurrently with ray queries and Lights are not updated.
+
+Compress replaces the float BVHs of the meshes by QuantizedBvh, which takes several times less memory at the cost
+of decoding the bounds during the traversal. The meshes are static afterwards (Refit must not be called and bvh()
+of a single-level scene is empty), instances may still be moved, added and removed as the top level stays a Bvh.
+
+\code{.cpp}
+Scene scene( surfaces, materials );
+Scene forest( surfaces, materials, { Instance{ 0, Matrix3x4::Translation( Vector3( 1, 0, 0 ) ) }, ... } );
+Ray ray = camera.GenerateRay( x, y );
+RayHit hit;
+scene.Intersect( ray, hit );
+\endcode
+*/
+class Scene
+{
+public:
+	Scene( const std::vector<Surface *> & surfaces, const std::vector<Material *> & materials,
+		const std::vector<Instance> & instances = {} );
+
+	Scene( const Scene & ) = delete;
+	Scene & operator=( const Scene & ) = delete;
+
+	/* finds the closest hit within <ray.t_min, ray.t_max>, ray.t_max is shortened to the hit distance */
+	void Intersect( Ray & ray, RayHit & hit ) const;
+
+	/* returns true if anything is hit within <ray.t_min, ray.t_max> */
+	bool Occluded( Ray ray ) const;
+
+	/* world space position, unit normals and texture coordinates of the hit point */
+	void Interpolate( const RayHit & hit, Vector3 & position, Vector3 & shading_normal, Vector3 & geometric_normal,
+		Coord2f & tex_coord ) const;
+
+	/* derivatives of the texture coordinates at the hit along the image axes, d_dx and d_dy are the derivatives of
+	the direction of the ray with a fixed origin (see Camera::RayDifferentials) */
+	void TexCoordDifferentials( const RayHit & hit, const Ray & ray, const Vector3 & d_dx, const Vector3 & d_dy,
+		Coord2f & duv_dx, Coord2f & duv_dy ) const;
+
+	/* index of the material of the hit surface, surfaces without a material share the default one */
+	int material_id( const RayHit & hit ) const;
+
+	/* index of the material of the given surface */
+	int surface_material_id( const int surface_id ) const;
+
+	const Material * material( const int material_id ) const;
+
+	int no_materials() const;
+
+	const std::vector<Surface *> & surfaces() const;
+
+	/* BVH over all triangles or the top-level BVH over the instances */
+	const Bvh & bvh() const;
+
+	/* empty unless the scene was built from instances, removed instances keep their index with surface_id -1 */
+	const std::vector<Instance> & instances() const;
+
+	/* re-reads the vertex positions of the deformed surfaces and refits their BVHs and the top level */
+	void Refit( const std::vector<int> & surface_ids );
+
+	/* returns the index of the new surface, it is built into the hierarchy by Commit (flat scenes) or AddInstance */
+	int AddSurface( Surface * surface );
+
+	/* only for scenes built from instances (or empty ones), returns the index of the instance */
+	int AddInstance( const Instance & instance );
+
+	void RemoveInstance( const int instance_id );
+
+	void SetTransform( const int instance_id, const Matrix3x4 & transform );
+
+	/* applies the pending changes of surfaces and instances */
+	void Commit();
+
+	/* relative growth of the SAH cost of a refitted BVH that triggers its rebuild */
+	void set_rebuild_threshold( const float threshold );
+
+	/* number of BVHs rebuilt because of their SAH cost since the construction */
+	int no_rebuilds() const;
+
+	/* rebuilds the meshes by the split BVH builder (Bvh::BuildSpatial) with the given duplication budget, zero
+	returns to the object splits, applies to the later rebuilds too */
+	void UseSpatialSplits( const float max_duplication = 0.3f );
+
+	/* treelet restructuring (Bvh::Optimize) of the BVHs of all meshes and of the top level */
+	void OptimizeBvhs( const int iterations = 3 );
+
+	/* replaces the BVHs of all meshes built so far by their quantized copies */
+	void Compress();
+
+	/* bytes of the acceleration structures and triangle positions */
+	size_t memory() const;
+
+private:
+	struct TriangleRef
+	{
+		int surface_id;
+		int triangle_id;
+	};
+
+	/* BVH over the triangles of one or more surfaces in their own coordinates */
+	struct Mesh
+	{
+		std::vector<TriangleRef> triangles; // in the order of the leaves of bvh
+		std::vector<TriangleBlock> blocks; // vertices in the order of the leaves of bvh, the i-th triangle is in block i / width
+		std::vector<int> surface_ids;
+		Bvh bvh;
+		float built_sah{ 0.0f }; // SAH cost after the last build
+		QuantizedBvh compressed; // replaces bvh after Compress
+
+		Aabb bounds() const
+		{
+			return ( compressed.empty() ) ? bvh.bounds() : compressed.bounds();
+		}
+	};
+
+	/* runs the traversal over whichever hierarchy the mesh has */
+	template<class F> static void TraverseMesh( const Mesh & mesh, Ray & ray, F && leaf );
+
+	void BuildMesh( const std::vector<int> & surface_ids, Mesh & mesh );
+
+	/* re-reads the positions of the deformed surfaces, rebuilds the mesh if its quality degraded too much */
+	void RefitMesh( Mesh & mesh, const std::vector<char> & deformed );
+
+	/* top-level BVH over the active instances */
+	void BuildTopLevel();
+
+	/* closest hit of the mesh, returns true and fills the hit (except the instance) if the ray was shortened */
+	static bool IntersectMesh( const Mesh & mesh, Ray & ray, RayHit & hit );
+	static bool OccludedMesh( const Mesh & mesh, Ray & ray );
+
+	std::vector<Surface *> surfaces_;
+	std::vector<const Material *> materials_; // the default material is the last one
+	std::vector<int> surface_material_ids_;
+	Material default_material_;
+
+	Mesh mesh_; // all surfaces of a scene without instances
+
+	// two-level hierarchy
+	std::vector<Instance> instances_;
+	std::vector<Matrix3x4> inverse_transforms_; // world to object space
+	std::vector<Mesh> meshes_; // of each surface, empty for surfaces that are not instanced
+	Bvh top_level_; // over the active instances
+	std::vector<int> top_level_instances_; // instance of each primitive of top_level_
+	float top_level_sah_{ 0.0f };
+
+	// pending changes and the quality monitor
+	bool rebuild_mesh_{ false };
+	bool rebuild_top_level_{ false };
+	bool refit_top_level_{ false };
+	float rebuild_threshold_{ 1.5f };
+	float max_duplication_{ 0.0f }; // zero for object splits only
+	std::atomic<int> no_rebuilds_{ 0 };
+};
+
+#endif
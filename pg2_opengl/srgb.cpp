@@ -0,0 +1,92 @@
+#include "pch.h"
+#include "srgb.h"
+#include "color.h"
+#include <immintrin.h>
+
+const std::array<float, 256> kSrgbToLinear = []() {
+	std::array<float, 256> values;
+	for ( int i = 0; i < 256; ++i ) values[i] = Color3f::c_linear( float( i ) * ( 1.0f / 255.0f ) );
+	return values; }();
+
+// least squares fits of 255 * sRGB( x ) over the 256 values of t in every segment, the bias includes the rounding
+const unsigned int kLinearToSrgb[104] = {
+	0x0073000d, 0x007a000d, 0x0080000d, 0x0087000d, 0x008d000d, 0x0094000d, 0x009a000d, 0x00a1000d,
+	0x00a7001a, 0x00b4001a, 0x00c1001a, 0x00ce001a, 0x00da001a, 0x00e7001a, 0x00f4001a, 0x0101001a,
+	0x010e0033, 0x01280033, 0x01410033, 0x015b0033, 0x01750033, 0x018f0033, 0x01a80033, 0x01c20033,
+	0x01dc0067, 0x020f0067, 0x02430067, 0x02760067, 0x02aa0067, 0x02dd0067, 0x03110067, 0x03440067,
+	0x037800ce, 0x03df00ce, 0x044600ce, 0x04ad00ce, 0x051400ce, 0x057b00c5, 0x05dd00bc, 0x063b00b5,
+	0x06970158, 0x07420142, 0x07e30130, 0x087b0120, 0x090b0112, 0x09940106, 0x0a1700fc, 0x0a9500f2,
+	0x0b0f01cb, 0x0bf401ae, 0x0ccb0195, 0x0d950180, 0x0e56016e, 0x0f0d015e, 0x0fbc0150, 0x10630143,
+	0x11070264, 0x1238023e, 0x1357021d, 0x14660201, 0x156601e9, 0x165a01d3, 0x174401c0, 0x182401af,
+	0x18fe0331, 0x1a9602fe, 0x1c1502d2, 0x1d7e02ad, 0x1ed4028d, 0x201a0270, 0x21520256, 0x227d0240,
+	0x239f0443, 0x25c003fe, 0x27bf03c4, 0x29a10392, 0x2b6a0367, 0x2d1d0341, 0x2ebe031f, 0x304d0300,
+	0x31d105b0, 0x34a80555, 0x37520507, 0x39d504c5, 0x3c37048b, 0x3e7c0458, 0x40a8042a, 0x42bd0401,
+	0x44c20798, 0x488e071e, 0x4c1c06b6, 0x4f76065d, 0x52a50610, 0x55ac05cc, 0x5892058f, 0x5b590559,
+	0x5e0c0a23, 0x631c0980, 0x67db08f6, 0x6c55087f, 0x70940818, 0x74a007bd, 0x787d076c, 0x7c330723
+};
+
+/* values per block of the bulk conversions */
+static const size_t kBlockSize = 1 << 14;
+
+#ifdef __AVX2__
+/* LinearToSrgb of eight values, the bytes are in the lower half */
+static __m128i LinearToSrgb8( const __m256 c )
+{
+	const __m256 clamped = _mm256_min_ps( _mm256_max_ps( c, _mm256_set1_ps( 1.220703125e-4f ) ), _mm256_set1_ps( 0.99999994f ) );
+	const __m256i bits = _mm256_castps_si256( clamped );
+	const __m256i index = _mm256_srli_epi32( _mm256_sub_epi32( bits, _mm256_set1_epi32( ( 127 - 13 ) << 23 ) ), 20 );
+	const __m256i segment = _mm256_i32gather_epi32( ( const int * )kLinearToSrgb, index, 4 );
+	const __m256i bias = _mm256_slli_epi32( _mm256_srli_epi32( segment, 16 ), 9 );
+	const __m256i slope = _mm256_and_si256( segment, _mm256_set1_epi32( 0xffff ) );
+	const __m256i t = _mm256_and_si256( _mm256_srli_epi32( bits, 12 ), _mm256_set1_epi32( 0xff ) );
+	const __m256i values = _mm256_srli_epi32( _mm256_add_epi32( bias, _mm256_mullo_epi32( slope, t ) ), 16 );
+	const __m128i words = _mm_packus_epi32( _mm256_castsi256_si128( values ), _mm256_extracti128_si256( values, 1 ) );
+
+	return _mm_packus_epi16( words, words );
+}
+#endif
+
+void SrgbToLinear( const unsigned char * srgb, float * linear, const size_t n )
+{
+	const int no_blocks = int( ( n + kBlockSize - 1 ) / kBlockSize );
+
+#pragma omp parallel for
+	for ( int block = 0; block < no_blocks; ++block )
+	{
+		size_t i = block * kBlockSize;
+		const size_t end = ( std::min )( n, i + kBlockSize );
+#ifdef __AVX2__
+		for ( ; i + 8 <= end; i += 8 )
+		{
+			const __m256i index = _mm256_cvtepu8_epi32( _mm_loadl_epi64( ( const __m128i * )( srgb + i ) ) );
+			_mm256_storeu_ps( linear + i, _mm256_i32gather_ps( kSrgbToLinear.data(), index, 4 ) );
+		}
+#endif
+		for ( ; i < end; ++i )
+		{
+			linear[i] = SrgbToLinear( srgb[i] );
+		}
+	}
+}
+
+void LinearToSrgb( const float * linear, unsigned char * srgb, const size_t n )
+{
+	const int no_blocks = int( ( n + kBlockSize - 1 ) / kBlockSize );
+
+#pragma omp parallel for
+	for ( int block = 0; block < no_blocks; ++block )
+	{
+		size_t i = block * kBlockSize;
+		const size_t end = ( std::min )( n, i + kBlockSize );
+#ifdef __AVX2__
+		for ( ; i + 8 <= end; i += 8 )
+		{
+			_mm_storel_epi64( ( __m128i * )( srgb + i ), LinearToSrgb8( _mm256_loadu_ps( linear + i ) ) );
+		}
+#endif
+		for ( ; i < end; ++i )
+		{
+			srgb[i] = LinearToSrgb( linear[i] );
+		}
+	}
+}
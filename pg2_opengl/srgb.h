@@ -0,0 +1,44 @@
+#ifndef SRGB_H_
+#define SRGB_H_
+
+#include <array>
+#include <cstring>
+
+/* linear values of the 8-bit sRGB values, the same as Color::c_linear( i * ( 1 / 255 ) ) */
+extern const std::array<float, 256> kSrgbToLinear;
+
+/* piecewise linear fit of the 8-bit sRGB curve, 8 segments per octave of the linear values from 2^-13 to 1,
+the upper 16 bits are the bias (in 1/128 of a step) and the lower ones the slope */
+extern const unsigned int kLinearToSrgb[104];
+
+inline float SrgbToLinear( const unsigned char c )
+{
+	return kSrgbToLinear[c];
+}
+
+/* 8-bit sRGB of a linear value clamped to <0, 1> (NaN gives 0), off the exact value by 0.545 of a step at most, so
+about 1 value in 2000 rounds to the other neighbour (F. Giesen, float->sRGB8 conversions) */
+inline unsigned char LinearToSrgb( float c )
+{
+	const float kMin = 1.220703125e-4f; // 2^-13, the smaller values give 0
+	const float kAlmostOne = 0.99999994f;
+
+	if ( !( c > kMin ) ) c = kMin;
+	if ( c > kAlmostOne ) c = kAlmostOne;
+
+	unsigned int bits;
+	memcpy( &bits, &c, sizeof( bits ) );
+
+	const unsigned int segment = kLinearToSrgb[( bits - ( ( 127u - 13u ) << 23 ) ) >> 20];
+	const unsigned int bias = ( segment >> 16 ) << 9;
+	const unsigned int slope = segment & 0xffff;
+	const unsigned int t = ( bits >> 12 ) & 0xff; // the next 8 bits of the mantissa
+
+	return static_cast<unsigned char>( ( bias + slope * t ) >> 16 );
+}
+
+/* bulk conversions of n values split among the threads, eight values per AVX2 instruction when built with AVX2 */
+void SrgbToLinear( const unsigned char * srgb, float * linear, const size_t n );
+void LinearToSrgb( const float * linear, unsigned char * srgb, const size_t n );
+
+#endif
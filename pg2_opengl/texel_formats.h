@@ -0,0 +1,301 @@
+#ifndef TEXEL_FORMATS_H_
+#define TEXEL_FORMATS_H_
+
+#include <cstring>
+#include <float.h>
+#include <immintrin.h>
+#include "color.h"
+
+// the conversions of half floats run on F16C (MSVC has no macro for it, AVX2 implies it)
+#if defined( __F16C__ ) || ( defined( _MSC_VER ) && defined( __AVX2__ ) )
+#define HALF_F16C
+#endif
+
+inline unsigned int FloatBits( const float value )
+{
+	unsigned int bits;
+	memcpy( &bits, &value, sizeof( bits ) );
+
+	return bits;
+}
+
+inline float BitsToFloat( const unsigned int bits )
+{
+	float value;
+	memcpy( &value, &bits, sizeof( value ) );
+
+	return value;
+}
+
+/* float to IEEE 754 binary16 rounded to the nearest even, overflows to infinity (F. Giesen) */
+inline unsigned short FloatToHalf( const float value )
+{
+	const unsigned int f32_infinity = 255u << 23;
+	const unsigned int f16_overflow = ( 127u + 16u ) << 23;
+	const unsigned int denormal_magic = ( ( 127u - 15u ) + ( 23u - 10u ) + 1u ) << 23;
+
+	unsigned int f = FloatBits( value );
+	const unsigned int sign = f & 0x80000000u;
+	f ^= sign;
+
+	unsigned int h;
+
+	if ( f >= f16_overflow )
+	{
+		h = ( f > f32_infinity ) ? 0x7e00u : 0x7c00u; // NaN stays NaN
+	}
+	else if ( f < ( 113u << 23 ) )
+	{
+		// the addition aligns the mantissa of a denormal half and rounds it
+		h = FloatBits( BitsToFloat( f ) + BitsToFloat( denormal_magic ) ) - denormal_magic;
+	}
+	else
+	{
+		const unsigned int odd = ( f >> 13 ) & 1u;
+		f += ( ( 15u - 127u ) << 23 ) + 0xfffu + odd;
+		h = f >> 13;
+	}
+
+	return static_cast<unsigned short>( h | ( sign >> 16 ) );
+}
+
+inline float HalfToFloat( const unsigned short h )
+{
+	const unsigned int exponent_mask = 0x7c00u << 13;
+	unsigned int f = ( h & 0x7fffu ) << 13;
+	const unsigned int exponent = f & exponent_mask;
+	f += ( 127u - 15u ) << 23;
+
+	if ( exponent == exponent_mask )
+	{
+		f += ( 128u - 16u ) << 23; // infinity or NaN
+	}
+	else if ( exponent == 0 )
+	{
+		f = FloatBits( BitsToFloat( f + ( 1u << 23 ) ) - BitsToFloat( 113u << 23 ) ); // denormal
+	}
+
+	return BitsToFloat( f | ( ( h & 0x8000u ) << 16 ) );
+}
+
+/*! \struct half
+\brief IEEE 754 binary16 storage type, arithmetic is done in floats.
+*/
+struct half
+{
+	half() : bits( 0 ) {}
+
+	explicit half( const float value ) : bits( FloatToHalf( value ) ) {}
+
+	explicit operator float() const
+	{
+		return HalfToFloat( bits );
+	}
+
+	unsigned short bits;
+};
+
+using Color3h = Color<3, half>;
+using Color4h = Color<4, half>;
+
+/* 16-bit unsigned normalized values of <0, 1> */
+using Color3us = Color<3, unsigned short>;
+using Color4us = Color<4, unsigned short>;
+
+/*! \struct Rgb9e5
+\brief Three 9-bit mantissas sharing a 5-bit exponent in 32 bits (GL_EXT_texture_shared_exponent), non-negative
+values up to 65408 with about 3 significant digits in the largest channel.
+*/
+struct Rgb9e5
+{
+	unsigned int bits;
+};
+
+/*! \struct Rgbe
+\brief Three 8-bit mantissas sharing an 8-bit exponent (the Radiance HDR format of G. Ward), non-negative values
+with the range of floats and about 2 significant digits in the largest channel.
+*/
+struct Rgbe
+{
+	unsigned char data[4];
+};
+
+/*! \struct TexelFormat
+\brief Conversion between the stored texels of type T and the values Texture::texel returns.
+
+The plain colour types are stored as they are. The compact HDR types decode to linear floats, they are loaded
+from and saved to float bitmaps and filtered in floats, so they only change the memory footprint of a texture.
+*/
+template <class T>
+struct TexelFormat
+{
+	using Value = T;
+
+	static Value Decode( const T & texel )
+	{
+		return texel;
+	}
+
+	static T Encode( const Value & value )
+	{
+		return value;
+	}
+};
+
+template <int N>
+struct TexelFormat<Color<N, half>>
+{
+	using Value = Color<N, float>;
+
+	static Value Decode( const Color<N, half> & texel )
+	{
+		Value value;
+#ifdef HALF_F16C
+		unsigned long long bits = 0;
+		memcpy( &bits, texel.data.data(), sizeof( texel.data ) );
+		alignas( 16 ) float values[4];
+		_mm_store_ps( values, _mm_cvtph_ps( _mm_cvtsi64_si128( static_cast<long long>( bits ) ) ) );
+		memcpy( value.data.data(), values, sizeof( value.data ) );
+#else
+		for ( int i = 0; i < N; ++i ) value.data[i] = HalfToFloat( texel.data[i].bits );
+#endif
+		return value;
+	}
+
+	static Color<N, half> Encode( const Value & value )
+	{
+		Color<N, half> texel;
+#ifdef HALF_F16C
+		alignas( 16 ) float values[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		memcpy( values, value.data.data(), sizeof( value.data ) );
+		const long long bits = _mm_cvtsi128_si64( _mm_cvtps_ph( _mm_load_ps( values ), _MM_FROUND_TO_NEAREST_INT ) );
+		unsigned short halves[4];
+		memcpy( halves, &bits, sizeof( halves ) );
+		for ( int i = 0; i < N; ++i ) texel.data[i].bits = halves[i];
+#else
+		for ( int i = 0; i < N; ++i ) texel.data[i].bits = FloatToHalf( value.data[i] );
+#endif
+		return texel;
+	}
+};
+
+template <int N>
+struct TexelFormat<Color<N, unsigned short>>
+{
+	using Value = Color<N, float>;
+
+	static Value Decode( const Color<N, unsigned short> & texel )
+	{
+		Value value;
+		for ( int i = 0; i < N; ++i ) value.data[i] = texel.data[i] * ( 1.0f / 65535.0f );
+
+		return value;
+	}
+
+	/* the values are clamped to <0, 1>, NaNs become zero */
+	static Color<N, unsigned short> Encode( const Value & value )
+	{
+		Color<N, unsigned short> texel;
+
+		for ( int i = 0; i < N; ++i )
+		{
+			const float c = ( value.data[i] > 0.0f ) ? ( std::min )( value.data[i], 1.0f ) : 0.0f;
+			texel.data[i] = static_cast<unsigned short>( c * 65535.0f + 0.5f );
+		}
+
+		return texel;
+	}
+};
+
+template <>
+struct TexelFormat<Rgb9e5>
+{
+	using Value = Color3f;
+
+	static Value Decode( const Rgb9e5 & texel )
+	{
+		// 2^( e - 15 - 9 ) built directly in the exponent bits
+		const float scale = BitsToFloat( ( ( texel.bits >> 27 ) + 127u - 24u ) << 23 );
+
+		return Value( { float( texel.bits & 511u ) * scale, float( ( texel.bits >> 9 ) & 511u ) * scale,
+			float( ( texel.bits >> 18 ) & 511u ) * scale } );
+	}
+
+	/* negative values and NaNs become zero, values over the range are clamped */
+	static Rgb9e5 Encode( const Value & value )
+	{
+		const float kMax = 511.0f / 512.0f * 65536.0f;
+		float c[3];
+
+		for ( int i = 0; i < 3; ++i )
+		{
+			c[i] = ( value.data[i] > 0.0f ) ? ( std::min )( value.data[i], kMax ) : 0.0f;
+		}
+
+		const float c_max = ( std::max )( c[0], ( std::max )( c[1], c[2] ) );
+
+		// the exponent of the largest channel, one more if its mantissa rounds up to 512
+		int exponent = ( std::max )( -16, int( ( FloatBits( c_max ) >> 23 ) & 255u ) - 127 ) + 16;
+		float scale = BitsToFloat( unsigned( 127 + 24 - exponent ) << 23 ); // 2^-( e - 24 )
+
+		if ( int( c_max * scale + 0.5f ) == 512 )
+		{
+			++exponent;
+			scale *= 0.5f;
+		}
+
+		Rgb9e5 texel;
+		texel.bits = unsigned( int( c[0] * scale + 0.5f ) ) | ( unsigned( int( c[1] * scale + 0.5f ) ) << 9 ) |
+			( unsigned( int( c[2] * scale + 0.5f ) ) << 18 ) | ( unsigned( exponent ) << 27 );
+
+		return texel;
+	}
+};
+
+template <>
+struct TexelFormat<Rgbe>
+{
+	using Value = Color3f;
+
+	static Value Decode( const Rgbe & texel )
+	{
+		// the mantissas are centred in their intervals, 2^( e - 128 - 8 ) built in the exponent bits (Encode never
+		// writes the exponents below 10 that would not fit, zero included)
+		const float scale = ( texel.data[3] > 9 ) ? BitsToFloat( unsigned( texel.data[3] - 9 ) << 23 ) : 0.0f;
+
+		return Value( { ( texel.data[0] + 0.5f ) * scale, ( texel.data[1] + 0.5f ) * scale, ( texel.data[2] + 0.5f ) * scale } );
+	}
+
+	/* negative values and NaNs become zero, as do the values below 1e-32, values from 2^127 up (infinity included)
+	saturate to the largest one */
+	static Rgbe Encode( const Value & value )
+	{
+		// the exponent of 2^127 and above would not fit into the 8 bits
+		static const float max_value = ldexpf( 255.0f / 256.0f, 127 );
+		float c[3];
+
+		for ( int i = 0; i < 3; ++i )
+		{
+			c[i] = ( value.data[i] > 0.0f ) ? ( std::min )( value.data[i], max_value ) : 0.0f;
+		}
+
+		const float c_max = ( std::max )( c[0], ( std::max )( c[1], c[2] ) );
+		Rgbe texel = { { 0, 0, 0, 0 } };
+
+		if ( c_max < 1e-32f ) return texel;
+
+		int exponent;
+		const float scale = frexpf( c_max, &exponent ) * 256.0f / c_max;
+
+		for ( int i = 0; i < 3; ++i )
+		{
+			texel.data[i] = static_cast<unsigned char>( ( std::min )( 255.0f, c[i] * scale ) );
+		}
+
+		texel.data[3] = static_cast<unsigned char>( exponent + 128 );
+
+		return texel;
+	}
+};
+
+#endif
@@ -44,6 +44,206 @@ FIBITMAP * BitmapFromFile( const char * file_name, int & width, int & height )
 	return dib;
 }
 
+/* channels ( r, g, b, a ) of an 8-bit pixel in the BGR(A) order of FreeImage, opaque if there are only three
+bytes, whole 4 bytes are read unless it is the last pixel of the row (the partial read stalls the load) */
+template <unsigned BYTESPP>
+static inline __m128 LoadPixel8( const BYTE * pixel, const bool last = false )
+{
+	int bits = -1;
+
+	if ( BYTESPP == 4 || !last )
+	{
+		memcpy( &bits, pixel, 4 );
+		bits |= ( BYTESPP == 3 ) ? int( 0xff000000 ) : 0;
+	}
+	else
+	{
+		memcpy( &bits, pixel, 3 );
+	}
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 bgra = _mm_cvtepi32_ps( _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( bits ), zero ), zero ) );
+
+	return _mm_shuffle_ps( bgra, bgra, _MM_SHUFFLE( FI_RGBA_ALPHA, FI_RGBA_BLUE, FI_RGBA_GREEN, FI_RGBA_RED ) );
+}
+
+/* channels of a 16-bit RGB(A) pixel scaled to <0, 1>, opaque if there are only three channels (see LoadPixel8) */
+template <int CHANNELS>
+static inline __m128 LoadPixel16( const BYTE * pixel, const bool last = false )
+{
+	unsigned long long bits = 0xffffull << 48;
+
+	if ( CHANNELS == 4 || !last )
+	{
+		memcpy( &bits, pixel, 8 );
+		bits |= ( CHANNELS == 3 ) ? 0xffffull << 48 : 0;
+	}
+	else
+	{
+		memcpy( &bits, pixel, 6 );
+	}
+
+	const __m128i rgba = _mm_unpacklo_epi16( _mm_loadl_epi64( ( const __m128i * )&bits ), _mm_setzero_si128() );
+
+	return _mm_div_ps( _mm_cvtepi32_ps( rgba ), _mm_set1_ps( 65535.0F ) );
+}
+
+/* stores the first N channels of the x-th pixel of a float row of the given width, a 3-channel pixel is written
+with 4 lanes except the last one, the extra lane is overwritten by the next pixel */
+template <int N>
+static inline void StorePixel( float * row, const unsigned x, const unsigned width, const __m128 pixel )
+{
+	if ( N == 4 || x + 1 < width )
+	{
+		_mm_storeu_ps( row + size_t( x ) * N, pixel );
+	}
+	else
+	{
+		float rgba[4];
+		_mm_storeu_ps( rgba, pixel );
+		memcpy( row + size_t( x ) * N, rgba, N * sizeof( float ) );
+	}
+}
+
+/* converts a row pixel by pixel, load( x ) returns the channels ( r, g, b, a ) of the x-th pixel */
+template <int N, class Load>
+static void ConvertRow( float * row, const unsigned width, const Load & load )
+{
+	for ( unsigned x = 0; x < width; ++x )
+	{
+		StorePixel<N>( row, x, width, load( x ) );
+	}
+}
+
+/* 32-bit BGRA row to RGBAF, two pixels per AVX2 instruction */
+static void ConvertRowBgra8( const BYTE * src, float * row, const unsigned width )
+{
+	unsigned x = 0;
+#ifdef __AVX2__
+	const __m256 scale = _mm256_set1_ps( 255.0F );
+
+	for ( ; x + 2 <= width; x += 2 )
+	{
+		const __m256 bgra = _mm256_cvtepi32_ps( _mm256_cvtepu8_epi32( _mm_loadl_epi64( ( const __m128i * )( src + x * 4 ) ) ) );
+		_mm256_storeu_ps( row + size_t( x ) * 4, _mm256_div_ps( _mm256_shuffle_ps( bgra, bgra,
+			_MM_SHUFFLE( FI_RGBA_ALPHA, FI_RGBA_BLUE, FI_RGBA_GREEN, FI_RGBA_RED ) ), scale ) );
+	}
+#endif
+	for ( ; x < width; ++x )
+	{
+		_mm_storeu_ps( row + size_t( x ) * 4, _mm_div_ps( LoadPixel8<4>( src + x * 4 ), _mm_set1_ps( 255.0F ) ) );
+	}
+}
+
+/* RGBA16 row to RGBAF, two pixels per AVX2 instruction */
+static void ConvertRowRgba16( const BYTE * src, float * row, const unsigned width )
+{
+	unsigned x = 0;
+#ifdef __AVX2__
+	const __m256 scale = _mm256_set1_ps( 65535.0F );
+
+	for ( ; x + 2 <= width; x += 2 )
+	{
+		const __m256i rgba = _mm256_cvtepu16_epi32( _mm_loadu_si128( ( const __m128i * )( src + x * 8 ) ) );
+		_mm256_storeu_ps( row + size_t( x ) * 4, _mm256_div_ps( _mm256_cvtepi32_ps( rgba ), scale ) );
+	}
+#endif
+	for ( ; x < width; ++x )
+	{
+		_mm_storeu_ps( row + size_t( x ) * 4, LoadPixel16<4>( src + x * 8 ) );
+	}
+}
+
+/* converts the pixels of src into the RGBF (N = 3) or RGBAF (N = 4) bitmap dst of the same size, the rows are
+split among the threads and converted with SSE (AVX2 for the RGBA sources to RGBAF), the values are the same as
+the ones of the scalar conversions of FreeImage except for the missing clamp of floats */
+template <int N>
+static void ConvertPixels( FIBITMAP * src, FIBITMAP * dst )
+{
+	const FREE_IMAGE_TYPE src_type = FreeImage_GetImageType( src );
+	const unsigned width = FreeImage_GetWidth( src );
+	const int height = int( FreeImage_GetHeight( src ) );
+	// 3 for 24-bit or 4 for 32-bit bitmaps
+	const unsigned bytespp = ( src_type == FIT_BITMAP ) ? FreeImage_GetLine( src ) / width : 0;
+
+	const size_t src_pitch = FreeImage_GetPitch( src );
+	const size_t dst_pitch = FreeImage_GetPitch( dst );
+	const BYTE * src_bits = ( BYTE * )FreeImage_GetBits( src );
+	BYTE * dst_bits = ( BYTE * )FreeImage_GetBits( dst );
+
+#pragma omp parallel for schedule( dynamic, 16 )
+	for ( int y = 0; y < height; ++y )
+	{
+		const BYTE * src_row = src_bits + y * src_pitch;
+		float * dst_row = ( float * )( dst_bits + y * dst_pitch );
+
+		switch ( src_type ) {
+		case FIT_BITMAP:
+			if ( N == 4 && bytespp == 4 )
+			{
+				ConvertRowBgra8( src_row, dst_row, width );
+			}
+			else if ( bytespp == 4 )
+			{
+				ConvertRow<N>( dst_row, width, [=]( const unsigned x ) {
+					return _mm_div_ps( LoadPixel8<4>( src_row + x * 4 ), _mm_set1_ps( 255.0F ) ); } );
+			}
+			else
+			{
+				ConvertRow<N>( dst_row, width, [=]( const unsigned x ) {
+					return _mm_div_ps( LoadPixel8<3>( src_row + x * 3, x + 1 == width ), _mm_set1_ps( 255.0F ) ); } );
+			}
+			break;
+
+		case FIT_UINT16:
+			// greyscale copied to each R, G, B channel
+			ConvertRow<N>( dst_row, width, [=]( const unsigned x ) {
+				const float value = ( float )( ( ( const WORD * )src_row )[x] ) / 65535.0F;
+				return _mm_set_ps( 1.0F, value, value, value ); } );
+			break;
+
+		case FIT_RGB16:
+			ConvertRow<N>( dst_row, width, [=]( const unsigned x ) { return LoadPixel16<3>( src_row + x * 6, x + 1 == width ); } );
+			break;
+
+		case FIT_RGBA16:
+			if ( N == 4 )
+			{
+				ConvertRowRgba16( src_row, dst_row, width );
+			}
+			else
+			{
+				// the alpha channel is ignored
+				ConvertRow<N>( dst_row, width, [=]( const unsigned x ) { return LoadPixel16<4>( src_row + x * 8 ); } );
+			}
+			break;
+
+		case FIT_FLOAT:
+			// NOT assume float values are in [0..1] !!!
+			ConvertRow<N>( dst_row, width, [=]( const unsigned x ) {
+				const float value = ( ( const float * )src_row )[x];
+				return _mm_set_ps( 1.0F, value, value, value ); } );
+			break;
+
+		case FIT_RGBF:
+			// a "dummy" alpha of 1.0
+			ConvertRow<N>( dst_row, width, [=]( const unsigned x ) {
+				const float * pixel = ( const float * )src_row + size_t( x ) * 3;
+				return _mm_set_ps( 1.0F, pixel[2], pixel[1], pixel[0] ); } );
+			break;
+
+		case FIT_RGBAF:
+			// the alpha channel is skipped
+			ConvertRow<N>( dst_row, width, [=]( const unsigned x ) {
+				return _mm_loadu_ps( ( const float * )src_row + size_t( x ) * 4 ); } );
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
 FIBITMAP * Custom_FreeImage_ConvertToRGBF( FIBITMAP * dib )
 {
 	FIBITMAP * src = NULL;
@@ -114,144 +314,7 @@ FIBITMAP * Custom_FreeImage_ConvertToRGBF( FIBITMAP * dib )
 
 	// convert from src type to RGBF
 
-	const unsigned src_pitch = FreeImage_GetPitch( src );
-	const unsigned dst_pitch = FreeImage_GetPitch( dst );
-
-	switch ( src_type ) {
-	case FIT_BITMAP:
-	{
-		// calculate the number of bytes per pixel (3 for 24-bit or 4 for 32-bit)
-		const unsigned bytespp = FreeImage_GetLine( src ) / FreeImage_GetWidth( src );
-
-		const BYTE * src_bits = ( BYTE * )FreeImage_GetBits( src );
-		BYTE * dst_bits = ( BYTE * )FreeImage_GetBits( dst );
-
-		for ( unsigned y = 0; y < height; y++ ) {
-			const BYTE * src_pixel = ( BYTE * )src_bits;
-			FIRGBF * dst_pixel = ( FIRGBF * )dst_bits;
-			for ( unsigned x = 0; x < width; x++ ) {
-				// convert and scale to the range [0..1]
-				dst_pixel->red = ( float )( src_pixel[FI_RGBA_RED] ) / 255.0F;
-				dst_pixel->green = ( float )( src_pixel[FI_RGBA_GREEN] ) / 255.0F;
-				dst_pixel->blue = ( float )( src_pixel[FI_RGBA_BLUE] ) / 255.0F;
-
-				src_pixel += bytespp;
-				dst_pixel++;
-			}
-			src_bits += src_pitch;
-			dst_bits += dst_pitch;
-		}
-	}
-	break;
-
-	case FIT_UINT16:
-	{
-		const BYTE * src_bits = ( BYTE * )FreeImage_GetBits( src );
-		BYTE * dst_bits = ( BYTE * )FreeImage_GetBits( dst );
-
-		for ( unsigned y = 0; y < height; y++ ) {
-			const WORD * src_pixel = ( WORD * )src_bits;
-			FIRGBF * dst_pixel = ( FIRGBF * )dst_bits;
-
-			for ( unsigned x = 0; x < width; x++ ) {
-				// convert and scale to the range [0..1]
-				const float dst_value = ( float )src_pixel[x] / 65535.0F;
-				dst_pixel[x].red = dst_value;
-				dst_pixel[x].green = dst_value;
-				dst_pixel[x].blue = dst_value;
-			}
-			src_bits += src_pitch;
-			dst_bits += dst_pitch;
-		}
-	}
-	break;
-
-	case FIT_RGB16:
-	{
-		const BYTE * src_bits = ( BYTE * )FreeImage_GetBits( src );
-		BYTE * dst_bits = ( BYTE * )FreeImage_GetBits( dst );
-
-		for ( unsigned y = 0; y < height; y++ ) {
-			const FIRGB16 * src_pixel = ( FIRGB16 * )src_bits;
-			FIRGBF * dst_pixel = ( FIRGBF * )dst_bits;
-
-			for ( unsigned x = 0; x < width; x++ ) {
-				// convert and scale to the range [0..1]
-				dst_pixel[x].red = ( float )( src_pixel[x].red ) / 65535.0F;
-				dst_pixel[x].green = ( float )( src_pixel[x].green ) / 65535.0F;
-				dst_pixel[x].blue = ( float )( src_pixel[x].blue ) / 65535.0F;
-			}
-			src_bits += src_pitch;
-			dst_bits += dst_pitch;
-		}
-	}
-	break;
-
-	case FIT_RGBA16:
-	{
-		const BYTE * src_bits = ( BYTE * )FreeImage_GetBits( src );
-		BYTE * dst_bits = ( BYTE * )FreeImage_GetBits( dst );
-
-		for ( unsigned y = 0; y < height; y++ ) {
-			const FIRGBA16 * src_pixel = ( FIRGBA16 * )src_bits;
-			FIRGBF * dst_pixel = ( FIRGBF * )dst_bits;
-
-			for ( unsigned x = 0; x < width; x++ ) {
-				// convert and scale to the range [0..1]
-				dst_pixel[x].red = ( float )( src_pixel[x].red ) / 65535.0F;
-				dst_pixel[x].green = ( float )( src_pixel[x].green ) / 65535.0F;
-				dst_pixel[x].blue = ( float )( src_pixel[x].blue ) / 65535.0F;
-			}
-			src_bits += src_pitch;
-			dst_bits += dst_pitch;
-		}
-	}
-	break;
-
-	case FIT_FLOAT:
-	{
-		const BYTE * src_bits = ( BYTE * )FreeImage_GetBits( src );
-		BYTE * dst_bits = ( BYTE * )FreeImage_GetBits( dst );
-
-		for ( unsigned y = 0; y < height; y++ ) {
-			const float * src_pixel = ( float * )src_bits;
-			FIRGBF * dst_pixel = ( FIRGBF * )dst_bits;
-
-			for ( unsigned x = 0; x < width; x++ ) {
-				// convert by copying greyscale channel to each R, G, B channels
-				// NOT assume float values are in [0..1] !!!
-				const float value = src_pixel[x];
-				dst_pixel[x].red = value;
-				dst_pixel[x].green = value;
-				dst_pixel[x].blue = value;
-			}
-			src_bits += src_pitch;
-			dst_bits += dst_pitch;
-		}
-	}
-	break;
-
-	case FIT_RGBAF:
-	{
-		const BYTE * src_bits = ( BYTE * )FreeImage_GetBits( src );
-		BYTE * dst_bits = ( BYTE * )FreeImage_GetBits( dst );
-
-		for ( unsigned y = 0; y < height; y++ ) {
-			const FIRGBAF * src_pixel = ( FIRGBAF * )src_bits;
-			FIRGBF * dst_pixel = ( FIRGBF * )dst_bits;
-
-			for ( unsigned x = 0; x < width; x++ ) {
-				// convert and skip alpha channel
-				dst_pixel[x].red = src_pixel[x].red;
-				dst_pixel[x].green = src_pixel[x].green;
-				dst_pixel[x].blue = src_pixel[x].blue;
-			}
-			src_bits += src_pitch;
-			dst_bits += dst_pitch;
-		}
-	}
-	break;
-	}
+	ConvertPixels<3>( src, dst );
 
 	if ( src != dib ) {
 		FreeImage_Unload( src );
@@ -330,154 +393,119 @@ FIBITMAP * Custom_FreeImage_ConvertToRGBAF( FIBITMAP * dib )
 
 	// convert from src type to RGBAF
 
-	const unsigned src_pitch = FreeImage_GetPitch( src );
-	const unsigned dst_pitch = FreeImage_GetPitch( dst );
+	ConvertPixels<4>( src, dst );
 
-	switch ( src_type ) {
-	case FIT_BITMAP:
-	{
-		// calculate the number of bytes per pixel (4 for 32-bit)
-		const unsigned bytespp = FreeImage_GetLine( src ) / FreeImage_GetWidth( src );
-
-		const BYTE * src_bits = ( BYTE * )FreeImage_GetBits( src );
-		BYTE * dst_bits = ( BYTE * )FreeImage_GetBits( dst );
-
-		for ( unsigned y = 0; y < height; y++ ) {
-			const BYTE * src_pixel = ( BYTE * )src_bits;
-			FIRGBAF * dst_pixel = ( FIRGBAF * )dst_bits;
-			for ( unsigned x = 0; x < width; x++ ) {
-				// convert and scale to the range [0..1]
-				dst_pixel->red = ( float )( src_pixel[FI_RGBA_RED] ) / 255.0F;
-				dst_pixel->green = ( float )( src_pixel[FI_RGBA_GREEN] ) / 255.0F;
-				dst_pixel->blue = ( float )( src_pixel[FI_RGBA_BLUE] ) / 255.0F;
-				dst_pixel->alpha = ( float )( src_pixel[FI_RGBA_ALPHA] ) / 255.0F;
-
-				src_pixel += bytespp;
-				dst_pixel++;
-			}
-			src_bits += src_pitch;
-			dst_bits += dst_pitch;
-		}
+	if ( src != dib ) {
+		FreeImage_Unload( src );
 	}
-	break;
 
-	case FIT_UINT16:
+	return dst;
+}
+
+/* pixels per block of the parallel range scans */
+static const size_t kRangeBlock = 1 << 16;
+
+void ChannelRange( const float * values, const size_t no_pixels, const int channels, double range[2] )
+{
+	assert( channels == 3 || channels == 4 );
+
+	const int no_blocks = int( ( no_pixels + kRangeBlock - 1 ) / kRangeBlock );
+	std::vector<float> lower( no_blocks, FLT_MAX );
+	std::vector<float> upper( no_blocks, -FLT_MAX );
+
+	// the alpha lanes of RGBA pixels are replaced by values that change neither the minimum nor the maximum
+	const __m128 alpha = _mm_castsi128_ps( ( channels == 4 ) ? _mm_set_epi32( -1, 0, 0, 0 ) : _mm_setzero_si128() );
+	const __m128 alpha_min = _mm_and_ps( alpha, _mm_set1_ps( FLT_MAX ) );
+	const __m128 alpha_max = _mm_and_ps( alpha, _mm_set1_ps( -FLT_MAX ) );
+
+#pragma omp parallel for schedule( dynamic )
+	for ( int block = 0; block < no_blocks; ++block )
 	{
-		const BYTE * src_bits = ( BYTE * )FreeImage_GetBits( src );
-		BYTE * dst_bits = ( BYTE * )FreeImage_GetBits( dst );
-
-		for ( unsigned y = 0; y < height; y++ ) {
-			const WORD * src_pixel = ( WORD * )src_bits;
-			FIRGBAF * dst_pixel = ( FIRGBAF * )dst_bits;
-
-			for ( unsigned x = 0; x < width; x++ ) {
-				// convert and scale to the range [0..1]
-				const float dst_value = ( float )src_pixel[x] / 65535.0F;
-				dst_pixel[x].red = dst_value;
-				dst_pixel[x].green = dst_value;
-				dst_pixel[x].blue = dst_value;
-				dst_pixel[x].alpha = 1.0F;
-			}
-			src_bits += src_pitch;
-			dst_bits += dst_pitch;
+		const size_t begin = block * kRangeBlock * channels;
+		const size_t end = ( std::min )( no_pixels, ( block + 1 ) * kRangeBlock ) * channels;
+		__m128 block_min = _mm_set1_ps( FLT_MAX );
+		__m128 block_max = _mm_set1_ps( -FLT_MAX );
+		size_t i = begin;
+
+		// NaNs are skipped as by Color::min_value, the minimum of SSE returns the second operand for them
+		for ( ; i + 4 <= end; i += 4 )
+		{
+			const __m128 value = _mm_andnot_ps( alpha, _mm_loadu_ps( values + i ) );
+			block_min = _mm_min_ps( _mm_or_ps( value, alpha_min ), block_min );
+			block_max = _mm_max_ps( _mm_or_ps( value, alpha_max ), block_max );
 		}
-	}
-	break;
 
-	case FIT_RGB16:
-	{
-		const BYTE * src_bits = ( BYTE * )FreeImage_GetBits( src );
-		BYTE * dst_bits = ( BYTE * )FreeImage_GetBits( dst );
-
-		for ( unsigned y = 0; y < height; y++ ) {
-			const FIRGB16 * src_pixel = ( FIRGB16 * )src_bits;
-			FIRGBAF * dst_pixel = ( FIRGBAF * )dst_bits;
-
-			for ( unsigned x = 0; x < width; x++ ) {
-				// convert and scale to the range [0..1]
-				dst_pixel[x].red = ( float )( src_pixel[x].red ) / 65535.0F;
-				dst_pixel[x].green = ( float )( src_pixel[x].green ) / 65535.0F;
-				dst_pixel[x].blue = ( float )( src_pixel[x].blue ) / 65535.0F;
-				dst_pixel[x].alpha = 1.0F;
-			}
-			src_bits += src_pitch;
-			dst_bits += dst_pitch;
+		alignas( 16 ) float mins[4];
+		alignas( 16 ) float maxs[4];
+		_mm_store_ps( mins, block_min );
+		_mm_store_ps( maxs, block_max );
+
+		// the tail of RGB rows
+		for ( ; i < end; ++i )
+		{
+			mins[0] = ( values[i] < mins[0] ) ? values[i] : mins[0];
+			maxs[0] = ( values[i] > maxs[0] ) ? values[i] : maxs[0];
 		}
-	}
-	break;
 
-	case FIT_RGBA16:
-	{
-		const BYTE * src_bits = ( BYTE * )FreeImage_GetBits( src );
-		BYTE * dst_bits = ( BYTE * )FreeImage_GetBits( dst );
-
-		for ( unsigned y = 0; y < height; y++ ) {
-			const FIRGBA16 * src_pixel = ( FIRGBA16 * )src_bits;
-			FIRGBAF * dst_pixel = ( FIRGBAF * )dst_bits;
-
-			for ( unsigned x = 0; x < width; x++ ) {
-				// convert and scale to the range [0..1]
-				dst_pixel[x].red = ( float )( src_pixel[x].red ) / 65535.0F;
-				dst_pixel[x].green = ( float )( src_pixel[x].green ) / 65535.0F;
-				dst_pixel[x].blue = ( float )( src_pixel[x].blue ) / 65535.0F;
-				dst_pixel[x].alpha = ( float )( src_pixel[x].alpha ) / 65535.0F;
-			}
-			src_bits += src_pitch;
-			dst_bits += dst_pitch;
+		for ( int j = 0; j < 4; ++j )
+		{
+			lower[block] = ( std::min )( lower[block], mins[j] );
+			upper[block] = ( std::max )( upper[block], maxs[j] );
 		}
 	}
-	break;
 
-	case FIT_FLOAT:
+	range[0] = ( no_pixels > 0 ) ? *std::min_element( lower.begin(), lower.end() ) : 0.0;
+	range[1] = ( no_pixels > 0 ) ? *std::max_element( upper.begin(), upper.end() ) : 0.0;
+}
+
+void ChannelRange( const unsigned char * values, const size_t no_pixels, const int channels, double range[2] )
+{
+	assert( channels == 3 || channels == 4 );
+
+	const int no_blocks = int( ( no_pixels + kRangeBlock - 1 ) / kRangeBlock );
+	std::vector<unsigned char> lower( no_blocks, 255 );
+	std::vector<unsigned char> upper( no_blocks, 0 );
+
+	// the alpha bytes of RGBA pixels are set to 255 for the minimum and to 0 for the maximum
+	const __m128i alpha = ( channels == 4 ) ? _mm_set1_epi32( int( 0xff000000 ) ) : _mm_setzero_si128();
+
+#pragma omp parallel for schedule( dynamic )
+	for ( int block = 0; block < no_blocks; ++block )
 	{
-		const BYTE * src_bits = ( BYTE * )FreeImage_GetBits( src );
-		BYTE * dst_bits = ( BYTE * )FreeImage_GetBits( dst );
-
-		for ( unsigned y = 0; y < height; y++ ) {
-			const float * src_pixel = ( float * )src_bits;
-			FIRGBAF * dst_pixel = ( FIRGBAF * )dst_bits;
-
-			for ( unsigned x = 0; x < width; x++ ) {
-				// convert by copying greyscale channel to each R, G, B channels
-				// NOT assume float values are in [0..1] !!!
-				const float value = src_pixel[x];
-				dst_pixel[x].red = value;
-				dst_pixel[x].green = value;
-				dst_pixel[x].blue = value;
-				dst_pixel[x].alpha = 1.0F;
-			}
-			src_bits += src_pitch;
-			dst_bits += dst_pitch;
+		const size_t begin = block * kRangeBlock * channels;
+		const size_t end = ( std::min )( no_pixels, ( block + 1 ) * kRangeBlock ) * channels;
+		__m128i block_min = _mm_set1_epi8( -1 );
+		__m128i block_max = _mm_setzero_si128();
+		size_t i = begin;
+
+		for ( ; i + 16 <= end; i += 16 )
+		{
+			const __m128i value = _mm_loadu_si128( ( const __m128i * )( values + i ) );
+			block_min = _mm_min_epu8( block_min, _mm_or_si128( value, alpha ) );
+			block_max = _mm_max_epu8( block_max, _mm_andnot_si128( alpha, value ) );
 		}
-	}
-	break;
 
-	case FIT_RGBF:
-	{
-		const BYTE * src_bits = ( BYTE * )FreeImage_GetBits( src );
-		BYTE * dst_bits = ( BYTE * )FreeImage_GetBits( dst );
-
-		for ( unsigned y = 0; y < height; y++ ) {
-			const FIRGBF * src_pixel = ( FIRGBF * )src_bits;
-			FIRGBAF * dst_pixel = ( FIRGBAF * )dst_bits;
-
-			for ( unsigned x = 0; x < width; x++ ) {
-				// convert pixels directly, while adding a "dummy" alpha of 1.0
-				dst_pixel[x].red = src_pixel[x].red;
-				dst_pixel[x].green = src_pixel[x].green;
-				dst_pixel[x].blue = src_pixel[x].blue;
-				dst_pixel[x].alpha = 1.0F;
-			}
-			src_bits += src_pitch;
-			dst_bits += dst_pitch;
+		alignas( 16 ) unsigned char mins[16];
+		alignas( 16 ) unsigned char maxs[16];
+		_mm_store_si128( ( __m128i * )mins, block_min );
+		_mm_store_si128( ( __m128i * )maxs, block_max );
+
+		for ( int j = 0; j < 16; ++j )
+		{
+			lower[block] = ( std::min )( lower[block], mins[j] );
+			upper[block] = ( std::max )( upper[block], maxs[j] );
 		}
-	}
-	break;
-	}
 
-	if ( src != dib ) {
-		FreeImage_Unload( src );
+		// the tail of the block
+		for ( ; i < end; ++i )
+		{
+			if ( channels == 4 && i % 4 == 3 ) continue;
+
+			lower[block] = ( std::min )( lower[block], values[i] );
+			upper[block] = ( std::max )( upper[block], values[i] );
+		}
 	}
 
-	return dst;
+	range[0] = ( no_pixels > 0 ) ? *std::min_element( lower.begin(), lower.end() ) : 0.0;
+	range[1] = ( no_pixels > 0 ) ? *std::max_element( upper.begin(), upper.end() ) : 0.0;
 }
@@ -4,6 +4,7 @@
 #include <vector>
 #include <freeimage.h>
 #include "color.h"
+#include "texel_formats.h"
 
 FIBITMAP * BitmapFromFile( const char * file_name, int & width, int & height );
 // Note that all float images in FreeImage are forced to have a range in <0, 1> after applying build-in conversions!!!
@@ -11,6 +12,153 @@ FIBITMAP * BitmapFromFile( const char * file_name, int & width, int & height );
 FIBITMAP * Custom_FreeImage_ConvertToRGBF( FIBITMAP * dib ); // this fix removes clamp from conversion of float images
 FIBITMAP * Custom_FreeImage_ConvertToRGBAF( FIBITMAP * dib );  // this fix removes clamp from conversion of float images
 
+/* minimum and maximum of the colour channels (the alpha of 4 channels excluded) of the pixels, computed in parallel
+by blocks of pixels with SSE */
+void ChannelRange( const float * values, const size_t no_pixels, const int channels, double range[2] );
+void ChannelRange( const unsigned char * values, const size_t no_pixels, const int channels, double range[2] );
+
+/* addressing of the texture coordinates outside <0, 1> */
+enum class TextureWrap : char { REPEAT = 0, CLAMP = 1, MIRROR = 2 };
+
+/* reconstruction filter of Texture::texel */
+enum class TextureFilter : char { NEAREST = 0, BILINEAR = 1 };
+
+/* bilinear blend of the corners ( x0, y0 ), ( x1, y0 ), ( x0, y1 ), ( x1, y1 ) with 8-bit weights, the products fit
+into 32 bits and the result is rounded to the nearest */
+template<int N>
+inline Color<N, unsigned char> Bilerp( const Color<N, unsigned char> * c, const float fx, const float fy )
+{
+	const int wx = int( fx * 256.0f + 0.5f );
+	const int wy = int( fy * 256.0f + 0.5f );
+	Color<N, unsigned char> value;
+
+	for ( int i = 0; i < N; ++i )
+	{
+		const int top = c[0].data[i] * ( 256 - wx ) + c[1].data[i] * wx;
+		const int bottom = c[2].data[i] * ( 256 - wx ) + c[3].data[i] * wx;
+		value.data[i] = static_cast<unsigned char>( ( top * ( 256 - wy ) + bottom * wy + 32768 ) >> 16 );
+	}
+
+	return value;
+}
+
+/* blend of two samples with the same 8-bit weights, e.g. of two mip levels */
+template<int N>
+inline Color<N, unsigned char> Lerp( const Color<N, unsigned char> & a, const Color<N, unsigned char> & b, const float t )
+{
+	const Color<N, unsigned char> c[4] = { a, b, a, b };
+
+	return Bilerp( c, t, 0.0f );
+}
+
+/*! \struct LinearLayout
+\brief Row-major order of texels, the layout of the files and of the rendered images.
+*/
+struct LinearLayout
+{
+	static const bool kLinear = true;
+
+	static size_t size( const int width, const int height )
+	{
+		return size_t( width ) * size_t( height );
+	}
+
+	static size_t index( const int x, const int y, const int width )
+	{
+		return size_t( x ) + size_t( y ) * size_t( width );
+	}
+};
+
+/*! \struct TiledLayout
+\brief Row-major order of S x S texel tiles, the texels of a tile are row-major too, the texture is padded to
+whole tiles. The taps of a bilinear sample mostly share a tile and so a few cache lines.
+*/
+template <int S>
+struct TiledLayout
+{
+	static_assert( S > 0 && ( S & ( S - 1 ) ) == 0, "the tile size must be a power of two" );
+
+	static const bool kLinear = false;
+
+	static size_t size( const int width, const int height )
+	{
+		return size_t( ( width + S - 1 ) / S ) * size_t( ( height + S - 1 ) / S ) * S * S;
+	}
+
+	static size_t index( const int x, const int y, const int width )
+	{
+		const size_t tile = size_t( x / S ) + size_t( y / S ) * size_t( ( width + S - 1 ) / S );
+
+		return tile * S * S + size_t( ( y & ( S - 1 ) ) * S + ( x & ( S - 1 ) ) );
+	}
+};
+
+/*! \struct MortonLayout
+\brief The same tiles as TiledLayout with the texels of a tile in the Morton (Z) order, so that every aligned
+2 x 2 block of texels is contiguous.
+*/
+template <int S>
+struct MortonLayout
+{
+	static_assert( S > 0 && S <= 16 && ( S & ( S - 1 ) ) == 0, "the tile size must be a power of two up to 16" );
+
+	static const bool kLinear = false;
+
+	static size_t size( const int width, const int height )
+	{
+		return TiledLayout<S>::size( width, height );
+	}
+
+	static size_t index( const int x, const int y, const int width )
+	{
+		const size_t tile = size_t( x / S ) + size_t( y / S ) * size_t( ( width + S - 1 ) / S );
+
+		return tile * S * S + ( Spread( x & ( S - 1 ) ) | ( Spread( y & ( S - 1 ) ) << 1 ) );
+	}
+
+	/* moves the lower 4 bits of a to the even bits */
+	static size_t Spread( unsigned int a )
+	{
+		a = ( a | ( a << 2 ) ) & 0x33u;
+		a = ( a | ( a << 1 ) ) & 0x55u;
+
+		return a;
+	}
+};
+
+/* conversion of a loaded bitmap to the pixel format of the texel type */
+template <class T>
+FIBITMAP * ConvertBitmap( FIBITMAP * dib )
+{
+	throw "Convert method is defined only for particular Texture types";
+
+	return nullptr;
+}
+
+template<>
+inline FIBITMAP * ConvertBitmap<Color3u>( FIBITMAP * dib )
+{
+	return FreeImage_ConvertTo24Bits( dib );
+}
+
+template<>
+inline FIBITMAP * ConvertBitmap<Color4u>( FIBITMAP * dib )
+{
+	return FreeImage_ConvertTo32Bits( dib );
+}
+
+template<>
+inline FIBITMAP * ConvertBitmap<Color3f>( FIBITMAP * dib )
+{
+	return Custom_FreeImage_ConvertToRGBF( dib );
+}
+
+template<>
+inline FIBITMAP * ConvertBitmap<Color4f>( FIBITMAP * dib )
+{
+	return Custom_FreeImage_ConvertToRGBAF( dib );
+}
+
 /*! \class Texture
 \brief A simple templated representation of texture.
 
@@ -18,15 +166,43 @@ Texture3f normal = Texture3f( "../../../data/denoise/normal_100spp.exr");
 Texture3f output = Texture3f( width, height );
 output.Save( "denoised.exr" );
 
+Texels are sampled with the nearest neighbour (FAST_INTERP) or bilinear filter and the coordinates outside <0, 1>
+repeat, clamp to the edge or mirror. The bilinear filter of 8-bit textures runs in 8-bit fixed point.
+
+texture.set_filter( TextureFilter::BILINEAR );
+texture.set_wrap( TextureWrap::MIRROR );
+const Color3u c = texture.texel( u, v );
+
+Minified textures are sampled from a mip chain (BuildMipmaps) at the level of detail of the footprint of the
+sample, 8-bit textures are averaged in linear space.
+
+texture.BuildMipmaps();
+const Color3u c = texture.texel( u, v, texture.lod( du_dx, dv_dx, du_dy, dv_dy ) );
+
+The order of the texels in memory is given by the layout L at compile time, row-major by default. Tiled layouts
+keep the neighbourhood of a texel in a few cache lines, data() then follows the layout (see index), the texels
+are reordered on load and on Save.
+
+Texture<Color3u, FIT_BITMAP, MortonLayout<8>> tiled( file_name );
+
+The texels may be stored in a compact HDR format (see TexelFormat), half floats or a shared exponent, texel then
+returns the decoded linear floats (Value) and the files are loaded and saved through float bitmaps.
+
+Texture3h sky( "sky.exr" ); // 6 bytes per texel instead of 12
+const Color3f c = sky.texel( u, v );
+
 \author Tom Fabin
 \version 1.0
 \date 2020
 */
 
-template <class T, FREE_IMAGE_TYPE F>
+template <class T, FREE_IMAGE_TYPE F, class L = LinearLayout>
 class Texture
 {
 public:
+	/* type of the decoded texels */
+	using Value = typename TexelFormat<T>::Value;
+
 	Texture( const int width, const int height )
 	{
 		assert( width > 0 && height > 0 );
@@ -34,7 +210,27 @@ public:
 		width_ = width;
 		height_ = height;
 
-		data_.resize( size_t( width ) * size_t( height ) );
+		data_.resize( L::size( width, height ) );
+		levels_.assign( 1, MipLevel{ 0, width_, height_ } );
+	}
+
+	/* copy of a texture in another layout or texel format, the mip chain is rebuilt if the source has one */
+	template <class T2, FREE_IMAGE_TYPE F2, class L2>
+	explicit Texture( const Texture<T2, F2, L2> & texture ) : Texture( texture.width(), texture.height() )
+	{
+#pragma omp parallel for
+		for ( int y = 0; y < height_; ++y )
+		{
+			for ( int x = 0; x < width_; ++x )
+			{
+				data_[L::index( x, y, width_ )] = TexelFormat<T>::Encode( Value( TexelFormat<T2>::Decode( texture.pixel( x, y ) ) ) );
+			}
+		}
+
+		wrap_ = texture.wrap();
+		filter_ = texture.filter();
+
+		if ( texture.no_levels() > 1 ) BuildMipmaps();
 	}
 
 	Texture( const std::string & file_name )
@@ -51,30 +247,37 @@ public:
 				dib = dib_new;
 			}			
 
-			data_.resize( size_t( width_ ) * size_t( height_ ) );
-
-			const int scan_width = FreeImage_GetPitch( dib ); // (bytes)
 			const int bpp = FreeImage_GetBPP( dib ); // (bites)
 
-			assert( bpp == sizeof( T ) * 8 );
+			assert( bpp == sizeof( Value ) * 8 );
 
-			FreeImage_ConvertToRawBits( ( BYTE * )( data_.data() ), dib, scan_width, bpp,
+			// the rows of the bitmap are padded to 4 bytes, the rows of texels are not
+			std::vector<Value> rows( size_t( width_ ) * size_t( height_ ) );
+			FreeImage_ConvertToRawBits( ( BYTE * )( rows.data() ), dib, width_ * int( sizeof( Value ) ), bpp,
 				FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, TRUE );
 
 			FreeImage_Unload( dib );
 			dib = nullptr;
 
-			double range[] = { ( std::numeric_limits<double>::max )( ), std::numeric_limits<double>::lowest() };
+			double range[2];
+			ChannelRange( rows.front().data.data(), rows.size(), Value::channels, range );
+
+			levels_.assign( 1, MipLevel{ 0, width_, height_ } );
 
-			for ( const auto & pixel : data_ )
+			data_.resize( L::size( width_, height_ ) );
+
+#pragma omp parallel for
+			for ( int y = 0; y < height_; ++y )
 			{
-				range[0] = ( std::min )( range[0], double( pixel.min_value() ) );
-				range[1] = ( std::max )( range[1], double( pixel.max_value() ) );				
-			}			
+				for ( int x = 0; x < width_; ++x )
+				{
+					data_[L::index( x, y, width_ )] = TexelFormat<T>::Encode( rows[size_t( x ) + size_t( y ) * size_t( width_ )] );
+				}
+			}
 
 			printf( "Texture '%s' (%d x %d px, %d bpp, <%0.3f, %0.3f>, %0.1f MB) loaded.\n",
-				file_name.c_str(), width_, height_, bpp, range[0], range[1],
-				scan_width * height_ / ( 1024.0f * 1024.0f ) );
+				file_name.c_str(), width_, height_, int( sizeof( T ) * 8 ), range[0], range[1],
+				data_.size() * sizeof( T ) / ( 1024.0f * 1024.0f ) );
 		}
 		else
 		{
@@ -86,20 +289,167 @@ public:
 	{
 		assert( x >= 0 && x < width_ && y >= 0 && y < height_ );
 
-		return data_[size_t( x ) + size_t( y ) * size_t( width_ )];
+		return data_[L::index( x, y, width_ )];
 	}
 
-	T texel( const float u, const float v ) const
+	/* index of the texel of the level in data() */
+	size_t index( const int x, const int y, const int level = 0 ) const
 	{
-		T value;
+		const MipLevel & mip = levels_[level];
+		assert( x >= 0 && x < mip.width && y >= 0 && y < mip.height );
 
-#ifdef FAST_INTERP
-		value = pixel( int( u * width_ ), int( v * height_ ) ); // nearest neighbour
-#else
-		// TODO bilinear interpolation	
-#endif
+		return mip.offset + L::index( x, y, mip.width );
+	}
 
-		return value;
+	/* indices in data() of the four texels read by a bilinear sample of the level */
+	void taps( const float u, const float v, const int level, size_t * indices ) const
+	{
+		const Footprint footprint = Locate( level, u, v );
+
+		indices[0] = footprint.i00;
+		indices[1] = footprint.i10;
+		indices[2] = footprint.i01;
+		indices[3] = footprint.i11;
+	}
+
+	Value texel( const float u, const float v ) const
+	{
+		return Sample( 0, u, v );
+	}
+
+	/* trilinear sample, the blend of the two mip levels around the given level of detail */
+	Value texel( const float u, const float v, const float lod ) const
+	{
+		const float level = ( std::min )( ( std::max )( lod, 0.0f ), float( no_levels() - 1 ) );
+
+		if ( filter_ == TextureFilter::NEAREST ) return Sample( int( level + 0.5f ), u, v );
+
+		const int level0 = int( level );
+		const float blend = level - level0;
+		const Value value0 = Sample( level0, u, v );
+
+		if ( blend == 0.0f ) return value0;
+
+		// the bilinear weights of a pair of texels blend the levels
+		const Value values[4] = { value0, Sample( level0 + 1, u, v ), value0, value0 };
+
+		return Bilerp( values, blend, 0.0f );
+	}
+
+	/* level of detail of a footprint given by the derivatives of the texture coordinates along the image axes */
+	float lod( const float du_dx, const float dv_dx, const float du_dy, const float dv_dy ) const
+	{
+		const float sqr_x = du_dx * du_dx * width_ * width_ + dv_dx * dv_dx * height_ * height_;
+		const float sqr_y = du_dy * du_dy * width_ * width_ + dv_dy * dv_dy * height_ * height_;
+
+		return 0.5f * log2f( ( std::max )( sqr_x, sqr_y ) );
+	}
+
+	/* builds the chain of levels halving the resolution down to 1 x 1 px with a 2 x 2 box filter */
+	void BuildMipmaps()
+	{
+		if ( levels_.empty() ) return;
+
+		data_.resize( L::size( width_, height_ ) );
+		levels_.resize( 1 );
+
+		// every level is reduced from the previous one kept in linear floats (row-major), not from its rounded texels
+		std::vector<Color<Value::channels, float>> linear( size_t( width_ ) * size_t( height_ ) );
+
+#pragma omp parallel for
+		for ( int y = 0; y < height_; ++y )
+		{
+			for ( int x = 0; x < width_; ++x )
+			{
+				linear[size_t( x ) + size_t( y ) * size_t( width_ )] = ToLinear( TexelFormat<T>::Decode( data_[L::index( x, y, width_ )] ) );
+			}
+		}
+
+		while ( levels_.back().width > 1 || levels_.back().height > 1 )
+		{
+			const MipLevel & source = levels_.back();
+			const MipLevel level{ data_.size(), ( std::max )( 1, source.width / 2 ), ( std::max )( 1, source.height / 2 ) };
+			std::vector<Color<Value::channels, float>> reduced( size_t( level.width ) * size_t( level.height ) );
+
+			data_.resize( data_.size() + L::size( level.width, level.height ) );
+
+#pragma omp parallel for
+			for ( int y = 0; y < level.height; ++y )
+			{
+				const size_t row0 = size_t( ( std::min )( 2 * y, source.height - 1 ) ) * size_t( source.width );
+				const size_t row1 = size_t( ( std::min )( 2 * y + 1, source.height - 1 ) ) * size_t( source.width );
+
+				for ( int x = 0; x < level.width; ++x )
+				{
+					const size_t x0 = size_t( ( std::min )( 2 * x, source.width - 1 ) );
+					const size_t x1 = size_t( ( std::min )( 2 * x + 1, source.width - 1 ) );
+					const size_t i = size_t( x ) + size_t( y ) * size_t( level.width );
+
+					reduced[i] = ( linear[row0 + x0] + linear[row0 + x1] + linear[row1 + x0] + linear[row1 + x1] ) * 0.25f;
+					data_[level.offset + L::index( x, y, level.width )] = TexelFormat<T>::Encode( FromLinear( reduced[i], Value() ) );
+				}
+			}
+
+			levels_.push_back( level );
+			linear.swap( reduced );
+		}
+	}
+
+	int no_levels() const
+	{
+		return static_cast<int>( levels_.size() );
+	}
+
+	/* samples n coordinate pairs at once, the addresses of a whole batch are resolved before the texels are read */
+	void texel( const float * u, const float * v, const int n, Value * values ) const
+	{
+		if ( filter_ == TextureFilter::NEAREST )
+		{
+			for ( int i = 0; i < n; ++i )
+			{
+				values[i] = texel( u[i], v[i] );
+			}
+
+			return;
+		}
+
+		const int kBatch = 64;
+		Footprint footprints[kBatch];
+
+		for ( int first = 0; first < n; first += kBatch )
+		{
+			const int count = ( std::min )( kBatch, n - first );
+
+			for ( int i = 0; i < count; ++i )
+			{
+				footprints[i] = Locate( 0, u[first + i], v[first + i] );
+			}
+
+			for ( int i = 0; i < count; ++i )
+			{
+				values[first + i] = Filter( footprints[i] );
+			}
+		}
+	}
+
+	TextureWrap wrap() const
+	{
+		return wrap_;
+	}
+
+	void set_wrap( const TextureWrap wrap )
+	{
+		wrap_ = wrap;
+	}
+
+	TextureFilter filter() const
+	{
+		return filter_;
+	}
+
+	void set_filter( const TextureFilter filter )
+	{
+		filter_ = filter;
 	}
 
 	int width() const
@@ -117,11 +467,20 @@ public:
 		return data_.data();
 	}
 
-	FIBITMAP * Convert( FIBITMAP * dib )
+	const T * data() const
 	{
-		throw "Convert method is defined only for particular Texture types";
+		return data_.data();
+	}
+
+	/* bytes of the texels of all levels */
+	size_t memory() const
+	{
+		return data_.size() * sizeof( T );
+	}
 
-		return nullptr;
+	FIBITMAP * Convert( FIBITMAP * dib )
+	{
+		return ConvertBitmap<Value>( dib );
 	}
 
 	/*static Texture Load( const std::string & file_name )
@@ -129,14 +488,33 @@ public:
 		throw "Load method is defined only for particular Texture types";
 	}*/
 
+	/* float texels go to the formats without float bitmaps (PNG, JPEG, ...) as 8-bit sRGB */
 	void Save( const std::string & file_name ) const
 	{
-		FIBITMAP * bitmap = FreeImage_AllocateT( F, width_, height_, sizeof( T ) * 8 ); // FIT_BITMAP, FIT_BITMAP, FIT_RGBF, FIT_RGBAF
+		FREE_IMAGE_FORMAT fif = FreeImage_GetFIFFromFilename( file_name.c_str() );
+		const bool srgb = ( F != FIT_BITMAP ) && !FreeImage_FIFSupportsExportType( fif, F );
+
+		FIBITMAP * bitmap = ( srgb ) ? FreeImage_AllocateT( FIT_BITMAP, width_, height_, Value::channels * 8 ) :
+			FreeImage_AllocateT( F, width_, height_, sizeof( Value ) * 8 ); // FIT_BITMAP, FIT_BITMAP, FIT_RGBF, FIT_RGBAF
 		BYTE * data = ( BYTE * )( FreeImage_GetBits( bitmap ) );
 		const int scan_width = FreeImage_GetPitch( bitmap );
-		memcpy( data, data_.data(), scan_width * height_ );
+		std::vector<Value> texels( ( srgb ) ? size_t( width_ ) * size_t( height_ ) : 0 );
+
+		// rows of the bitmap are padded, the texels are copied in the row-major order
+		for ( int y = 0; y < height_; ++y )
+		{
+			Value * row = ( srgb ) ? texels.data() + size_t( y ) * size_t( width_ ) :
+				reinterpret_cast<Value *>( data + size_t( y ) * size_t( scan_width ) );
+
+			for ( int x = 0; x < width_; ++x )
+			{
+				row[x] = TexelFormat<T>::Decode( data_[L::index( x, y, width_ )] );
+			}
+		}
+
+		if ( srgb ) ToSrgb( texels.data(), width_, height_, data, scan_width );
+
 		FreeImage_FlipVertical( bitmap );
-		FREE_IMAGE_FORMAT fif = FreeImage_GetFIFFromFilename( file_name.c_str() );
 		if ( FreeImage_Save( fif, bitmap, file_name.c_str() ) )
 		{
 			printf( "Texture has been saved successfully in '%s'.\n", file_name.c_str() );
@@ -151,39 +529,207 @@ public:
 	}
 
 private:
-	std::vector<T> data_;
+	/* a level of the mip chain stored in data_ from the offset on, level 0 is the texture itself */
+	struct MipLevel
+	{
+		size_t offset;
+		int width;
+		int height;
+	};
+
+	/* four texels around a sample and the weights of the right and the bottom ones */
+	struct Footprint
+	{
+		size_t i00, i10, i01, i11;
+		float fx, fy;
+	};
+
+	/* maps the coordinate into <0, 1> */
+	float Wrap( float t ) const
+	{
+		switch ( wrap_ )
+		{
+		case TextureWrap::REPEAT:
+			return t - floorf( t );
+
+		case TextureWrap::MIRROR:
+			t -= 2.0f * floorf( 0.5f * t );
+			return ( t > 1.0f ) ? 2.0f - t : t;
+
+		default:
+			return ( std::min )( ( std::max )( t, 0.0f ), 1.0f );
+		}
+	}
+
+	/* index of a texel at most one texel outside the texture */
+	int Address( const int i, const int n ) const
+	{
+		if ( i < 0 ) return ( wrap_ == TextureWrap::REPEAT ) ? n - 1 : 0;
+		if ( i >= n ) return ( wrap_ == TextureWrap::REPEAT ) ? 0 : n - 1;
+
+		return i;
+	}
+
+	Footprint Locate( const int level, const float u, const float v ) const
+	{
+		const MipLevel & mip = levels_[level];
+
+		// texel centres are at ( x + 0.5 ) / width
+		const float x = Wrap( u ) * mip.width - 0.5f;
+		const float y = Wrap( v ) * mip.height - 0.5f;
+		const float x_floor = floorf( x );
+		const float y_floor = floorf( y );
+		const int x0 = int( x_floor );
+		const int y0 = int( y_floor );
+
+		const int row0 = Address( y0, mip.height );
+		const int row1 = Address( y0 + 1, mip.height );
+		const int column0 = Address( x0, mip.width );
+		const int column1 = Address( x0 + 1, mip.width );
+
+		return Footprint{ mip.offset + L::index( column0, row0, mip.width ), mip.offset + L::index( column1, row0, mip.width ),
+			mip.offset + L::index( column0, row1, mip.width ), mip.offset + L::index( column1, row1, mip.width ),
+			x - x_floor, y - y_floor };
+	}
+
+	/* a sample of a single level with the filter of the texture */
+	Value Sample( const int level, const float u, const float v ) const
+	{
+		if ( filter_ == TextureFilter::NEAREST )
+		{
+			const MipLevel & mip = levels_[level];
+			const int x = Address( int( floorf( Wrap( u ) * mip.width ) ), mip.width );
+			const int y = Address( int( floorf( Wrap( v ) * mip.height ) ), mip.height );
+
+			return TexelFormat<T>::Decode( data_[mip.offset + L::index( x, y, mip.width )] );
+		}
+
+		return Filter( Locate( level, u, v ) );
+	}
+
+	Value Filter( const Footprint & footprint ) const
+	{
+		const Value corners[4] = { TexelFormat<T>::Decode( data_[footprint.i00] ), TexelFormat<T>::Decode( data_[footprint.i10] ),
+			TexelFormat<T>::Decode( data_[footprint.i01] ), TexelFormat<T>::Decode( data_[footprint.i11] ) };
+
+		return Bilerp( corners, footprint.fx, footprint.fy );
+	}
+
+	template<int N>
+	static Color<N, float> Bilerp( const Color<N, float> * c, const float fx, const float fy )
+	{
+		Color<N, float> value;
+
+		for ( int i = 0; i < N; ++i )
+		{
+			const float top = c[0].data[i] + fx * ( c[1].data[i] - c[0].data[i] );
+			const float bottom = c[2].data[i] + fx * ( c[3].data[i] - c[2].data[i] );
+			value.data[i] = top + fy * ( bottom - top );
+		}
+
+		return value;
+	}
+
+	/* see ::Bilerp */
+	template<int N>
+	static Color<N, unsigned char> Bilerp( const Color<N, unsigned char> * c, const float fx, const float fy )
+	{
+		return ::Bilerp( c, fx, fy );
+	}
+
+	template<int N>
+	static Color<N, float> ToLinear( const Color<N, float> & c )
+	{
+		return c;
+	}
+
+	/* sRGB texels are decoded by a table */
+	template<int N>
+	static Color<N, float> ToLinear( const Color<N, unsigned char> & c )
+	{
+		Color<N, float> value;
+
+		for ( int i = 0; i < N; ++i )
+		{
+			value.data[i] = SrgbToLinear( c.data[i] );
+		}
+
+		return value;
+	}
+
+	/* the second argument selects the overload only */
+	template<int N>
+	static Color<N, float> FromLinear( const Color<N, float> & c, const Color<N, float> & )
+	{
+		return c;
+	}
+
+	template<int N>
+	static Color<N, unsigned char> FromLinear( const Color<N, float> & c, const Color<N, unsigned char> & )
+	{
+		Color<N, unsigned char> value;
+
+		for ( int i = 0; i < N; ++i )
+		{
+			value.data[i] = LinearToSrgb( c.data[i] );
+		}
+
+		return value;
+	}
+
+	/* linear texels in the row-major order to the 8-bit sRGB pixels of a bitmap, the alpha stays linear */
+	template<int N>
+	static void ToSrgb( const Color<N, float> * texels, const int width, const int height, BYTE * bits, const int pitch )
+	{
+		std::vector<unsigned char> values( size_t( width ) * size_t( height ) * N );
+		LinearToSrgb( texels->data.data(), values.data(), values.size() );
+
+#pragma omp parallel for
+		for ( int y = 0; y < height; ++y )
+		{
+			for ( int x = 0; x < width; ++x )
+			{
+				const size_t i = size_t( x ) + size_t( y ) * size_t( width );
+				BYTE * pixel = bits + size_t( y ) * size_t( pitch ) + size_t( x ) * N;
+
+				pixel[FI_RGBA_RED] = values[i * N];
+				pixel[FI_RGBA_GREEN] = values[i * N + 1];
+				pixel[FI_RGBA_BLUE] = values[i * N + 2];
+				if ( N == 4 ) pixel[FI_RGBA_ALPHA] = static_cast<BYTE>( ( std::min )( ( std::max )( texels[i].data[N - 1], 0.0f ), 1.0f ) * 255.0f + 0.5f );
+			}
+		}
+	}
+
+	/* 8-bit textures are saved as they are */
+	template<int N>
+	static void ToSrgb( const Color<N, unsigned char> *, const int, const int, BYTE *, const int )
+	{
+		assert( false );
+	}
+
+	std::vector<T> data_; // all levels of the mip chain one after another
+	std::vector<MipLevel> levels_;
 
 	int width_{ 0 };
 	int height_{ 0 };
+
+	TextureWrap wrap_{ TextureWrap::REPEAT };
+#ifdef FAST_INTERP
+	TextureFilter filter_{ TextureFilter::NEAREST };
+#else
+	TextureFilter filter_{ TextureFilter::BILINEAR };
+#endif
 };
 
 using Texture3f = Texture<Color3f, FIT_RGBF>;
 using Texture4f = Texture<Color4f, FIT_RGBAF>;
 using Texture3u = Texture<Color3u, FIT_BITMAP>;
 using Texture4u = Texture<Color4u, FIT_BITMAP>;
-
-template<>
-FIBITMAP * Texture3u::Convert( FIBITMAP * dib )
-{
-	return FreeImage_ConvertTo24Bits( dib );
-}
-
-template<>
-FIBITMAP * Texture4u::Convert( FIBITMAP * dib )
-{
-	return FreeImage_ConvertTo32Bits( dib );
-}
-
-template<>
-FIBITMAP * Texture3f::Convert( FIBITMAP * dib )
-{
-	return Custom_FreeImage_ConvertToRGBF( dib );
-}
-
-template<>
-FIBITMAP * Texture4f::Convert( FIBITMAP * dib )
-{
-	return Custom_FreeImage_ConvertToRGBAF( dib );
-}
+using Texture3h = Texture<Color3h, FIT_RGBF>;
+using Texture4h = Texture<Color4h, FIT_RGBAF>;
+using Texture3us = Texture<Color3us, FIT_RGBF>;
+using Texture4us = Texture<Color4us, FIT_RGBAF>;
+using TextureRgb9e5 = Texture<Rgb9e5, FIT_RGBF>;
+using TextureRgbe = Texture<Rgbe, FIT_RGBF>;
 
 #endif
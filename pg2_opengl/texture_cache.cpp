@@ -0,0 +1,320 @@
+#include "pch.h"
+#include "texture_cache.h"
+#include "utils.h"
+
+static_assert( TextureCache::kNoShards == 16, "the shard is given by the top 4 bits of the hash of the key" );
+
+static const size_t kTileBytes = size_t( TextureCache::kTileSize ) * TextureCache::kTileSize * sizeof( Color3u );
+
+TextureCache::TextureCache( const size_t budget )
+{
+	set_budget( budget );
+}
+
+TextureCache::~TextureCache()
+{
+	Clear();
+
+	for ( auto & entry : entries_ )
+	{
+		if ( entry->file )
+		{
+			fclose( entry->file );
+			entry->file = nullptr;
+		}
+	}
+}
+
+int TextureCache::Register( const std::string & file_name, TextureLoader loader )
+{
+	const int handle = static_cast<int>( entries_.size() );
+
+	if ( !loader )
+	{
+		auto registered = handles_.find( file_name );
+
+		if ( registered != handles_.end() ) return registered->second;
+
+		handles_[file_name] = handle;
+		loader = []( const std::string & file_name ) { return new Texture3u( file_name ); };
+	}
+
+	assert( handle < ( 1 << 24 ) );
+
+	entries_.push_back( std::unique_ptr<Entry>( new Entry() ) );
+	entries_.back()->file_name = file_name;
+	entries_.back()->loader = loader;
+
+	return handle;
+}
+
+void TextureCache::Open( Entry & entry ) const
+{
+	Texture3u * texture = entry.loader( entry.file_name );
+
+	if ( !texture || texture->width() < 1 || texture->height() < 1 || !( entry.file = std::tmpfile() ) )
+	{
+		printf( "Texture '%s' not cached.\n", entry.file_name.c_str() );
+		SAFE_DELETE( texture );
+
+		return;
+	}
+
+	if ( texture->no_levels() == 1 ) texture->BuildMipmaps();
+
+	// tiles of every level in the row-major order, partial tiles on the borders are padded to the full size
+	std::vector<Color3u> tile( size_t( kTileSize ) * kTileSize );
+	long long offset = 0;
+	bool written = true;
+
+	for ( int level = 0; level < texture->no_levels() && written; ++level )
+	{
+		const int width = ( std::max )( 1, texture->width() >> level );
+		const int height = ( std::max )( 1, texture->height() >> level );
+		const int no_tiles_x = ( width + kTileSize - 1 ) / kTileSize;
+		const int no_tiles_y = ( height + kTileSize - 1 ) / kTileSize;
+
+		entry.levels.push_back( Level{ width, height, no_tiles_x, offset } );
+
+		for ( int tile_y = 0; tile_y < no_tiles_y && written; ++tile_y )
+		{
+			for ( int tile_x = 0; tile_x < no_tiles_x && written; ++tile_x )
+			{
+				for ( int y = 0; y < kTileSize; ++y )
+				{
+					for ( int x = 0; x < kTileSize; ++x )
+					{
+						const int i = ( std::min )( tile_x * kTileSize + x, width - 1 );
+						const int j = ( std::min )( tile_y * kTileSize + y, height - 1 );
+						tile[size_t( x ) + size_t( y ) * kTileSize] = texture->data()[texture->index( i, j, level )];
+					}
+				}
+
+				written = fwrite( tile.data(), kTileBytes, 1, entry.file ) == 1;
+				offset += kTileBytes;
+			}
+		}
+	}
+
+	// a full temporary disk leaves the texture invalid rather than serving missing tiles
+	if ( !written || fflush( entry.file ) != 0 )
+	{
+		printf( "Texture '%s' not cached, the tile file cannot be written.\n", entry.file_name.c_str() );
+		fclose( entry.file );
+		entry.file = nullptr;
+		entry.levels.clear();
+		SAFE_DELETE( texture );
+
+		return;
+	}
+
+	entry.valid = true;
+	++no_open_textures_;
+
+	printf( "Texture '%s' (%d x %d px, %d levels, %0.1f MB) paged out.\n", entry.file_name.c_str(), texture->width(),
+		texture->height(), texture->no_levels(), offset / ( 1024.0f * 1024.0f ) );
+
+	SAFE_DELETE( texture );
+}
+
+TextureCache::Entry * TextureCache::Opened( const int handle ) const
+{
+	assert( handle >= 0 && handle < static_cast<int>( entries_.size() ) );
+
+	Entry & entry = *entries_[handle];
+	std::call_once( entry.opened, [this, &entry]() { Open( entry ); } );
+
+	return ( entry.valid ) ? &entry : nullptr;
+}
+
+unsigned long long TextureCache::Key( const int handle, const int level, const int tile_x, const int tile_y )
+{
+	// 24 bits for the handle, 8 bits for the level and 16 bits for each tile coordinate
+	return ( static_cast<unsigned long long>( handle ) << 40 ) | ( static_cast<unsigned long long>( level ) << 32 ) |
+		( static_cast<unsigned long long>( tile_y ) << 16 ) | static_cast<unsigned long long>( tile_x );
+}
+
+std::shared_ptr<const TextureCache::Tile> TextureCache::Fetch( Entry & entry, const int handle, const int level,
+	const int tile_x, const int tile_y ) const
+{
+	const unsigned long long key = Key( handle, level, tile_x, tile_y );
+	Shard & shard = shards_[( key * 0x9e3779b97f4a7c15ull ) >> 60];
+
+	++lookups_;
+
+	{
+		std::lock_guard<std::mutex> lock( shard.mutex );
+		auto found = shard.tiles.find( key );
+
+		if ( found != shard.tiles.end() )
+		{
+			shard.lru.splice( shard.lru.begin(), shard.lru, found->second.second );
+			++hits_;
+
+			return found->second.first;
+		}
+	}
+
+	// the shard is not locked while the tile is read, another thread may read the same tile meanwhile
+	std::shared_ptr<Tile> tile = std::make_shared<Tile>();
+	tile->texels.resize( size_t( kTileSize ) * kTileSize );
+
+	{
+		const Level & mip = entry.levels[level];
+		std::lock_guard<std::mutex> lock( entry.file_mutex );
+
+		// a short read is not cached, the lookups needing the tile fail instead
+		if ( _fseeki64( entry.file, mip.offset + ( long long )( tile_x + tile_y * mip.no_tiles_x ) * kTileBytes, SEEK_SET ) != 0 ||
+			fread( tile->texels.data(), kTileBytes, 1, entry.file ) != 1 )
+		{
+			return nullptr;
+		}
+	}
+
+	bytes_read_ += kTileBytes;
+
+	std::lock_guard<std::mutex> lock( shard.mutex );
+	auto found = shard.tiles.find( key );
+
+	if ( found != shard.tiles.end() ) return found->second.first;
+
+	shard.lru.push_front( key );
+	shard.tiles.emplace( key, std::make_pair( std::shared_ptr<const Tile>( tile ), shard.lru.begin() ) );
+	shard.bytes += kTileBytes;
+	resident_bytes_ += kTileBytes;
+
+	long long peak = peak_resident_bytes_.load();
+	while ( resident_bytes_.load() > peak && !peak_resident_bytes_.compare_exchange_weak( peak, resident_bytes_.load() ) );
+
+	// the tile just read stays even when it alone exceeds the budget
+	while ( shard.bytes > shard_budget_ && shard.lru.size() > 1 )
+	{
+		shard.tiles.erase( shard.lru.back() );
+		shard.lru.pop_back();
+		shard.bytes -= kTileBytes;
+		resident_bytes_ -= kTileBytes;
+		++evictions_;
+	}
+
+	return tile;
+}
+
+bool TextureCache::Bilinear( Entry & entry, const int handle, const int level, const float u, const float v,
+	Color3u & value ) const
+{
+	const Level & mip = entry.levels[level];
+
+	// texel centres are at ( x + 0.5 ) / width, the same as Texture::texel with TextureWrap::REPEAT
+	const float x = ( u - floorf( u ) ) * mip.width - 0.5f;
+	const float y = ( v - floorf( v ) ) * mip.height - 0.5f;
+	const float x_floor = floorf( x );
+	const float y_floor = floorf( y );
+	const int xs[2] = { ( int( x_floor ) + mip.width ) % mip.width, ( int( x_floor ) + 1 ) % mip.width };
+	const int ys[2] = { ( int( y_floor ) + mip.height ) % mip.height, ( int( y_floor ) + 1 ) % mip.height };
+
+	// the taps mostly share a tile, every distinct tile is fetched once
+	std::shared_ptr<const Tile> tiles[4];
+	int keys[4];
+	Color3u corners[4];
+
+	for ( int i = 0; i < 4; ++i )
+	{
+		const int tile_x = xs[i & 1] / kTileSize;
+		const int tile_y = ys[i >> 1] / kTileSize;
+		keys[i] = tile_x + tile_y * mip.no_tiles_x;
+
+		int j = 0;
+		while ( j < i && keys[j] != keys[i] ) ++j;
+		tiles[i] = ( j < i ) ? tiles[j] : Fetch( entry, handle, level, tile_x, tile_y );
+
+		if ( !tiles[i] ) return false;
+
+		corners[i] = tiles[i]->texels[size_t( xs[i & 1] % kTileSize ) + size_t( ys[i >> 1] % kTileSize ) * kTileSize];
+	}
+
+	value = Bilerp( corners, x - x_floor, y - y_floor );
+
+	return true;
+}
+
+bool TextureCache::texel( const int handle, const float u, const float v, const float lod, Color3u & value ) const
+{
+	Entry * entry = Opened( handle );
+
+	if ( !entry ) return false;
+
+	const float level = ( std::min )( ( std::max )( lod, 0.0f ), float( entry->levels.size() - 1 ) );
+	const int level0 = int( level );
+	const float blend = level - level0;
+
+	if ( !Bilinear( *entry, handle, level0, u, v, value ) ) return false;
+
+	if ( blend > 0.0f )
+	{
+		Color3u value1;
+
+		if ( !Bilinear( *entry, handle, level0 + 1, u, v, value1 ) ) return false;
+
+		value = Lerp( value, value1, blend );
+	}
+
+	return true;
+}
+
+float TextureCache::lod( const int handle, const float du_dx, const float dv_dx, const float du_dy, const float dv_dy ) const
+{
+	Entry * entry = Opened( handle );
+
+	if ( !entry ) return 0.0f;
+
+	const float width = float( entry->levels[0].width );
+	const float height = float( entry->levels[0].height );
+	const float sqr_x = du_dx * du_dx * width * width + dv_dx * dv_dx * height * height;
+	const float sqr_y = du_dy * du_dy * width * width + dv_dy * dv_dy * height * height;
+
+	return 0.5f * log2f( ( std::max )( sqr_x, sqr_y ) );
+}
+
+void TextureCache::set_budget( const size_t budget )
+{
+	shard_budget_ = budget / kNoShards;
+}
+
+void TextureCache::Clear()
+{
+	for ( Shard & shard : shards_ )
+	{
+		std::lock_guard<std::mutex> lock( shard.mutex );
+		resident_bytes_ -= shard.bytes;
+		shard.tiles.clear();
+		shard.lru.clear();
+		shard.bytes = 0;
+	}
+}
+
+TextureCacheStatistics TextureCache::statistics() const
+{
+	TextureCacheStatistics statistics;
+	statistics.lookups = lookups_.load();
+	statistics.hits = hits_.load();
+	statistics.evictions = evictions_.load();
+	statistics.bytes_read = bytes_read_.load();
+	statistics.resident_bytes = resident_bytes_.load();
+	statistics.peak_resident_bytes = peak_resident_bytes_.load();
+	statistics.no_textures = static_cast<int>( entries_.size() );
+	statistics.no_open_textures = no_open_textures_.load();
+
+	return statistics;
+}
+
+void TextureCache::Print() const
+{
+	const TextureCacheStatistics s = statistics();
+	const float mb = 1.0f / ( 1024.0f * 1024.0f );
+
+	printf( "Texture cache: %d/%d textures open, %0.2f%% hits of %0.0f lookups, %0.0f evictions, %0.1f MB read\n",
+		s.no_open_textures, s.no_textures, 100.0f * s.hit_rate(), double( s.lookups ), double( s.evictions ),
+		s.bytes_read * mb );
+	printf( "Texture cache: %0.1f MB resident (%0.1f MB peak) of %0.1f MB budget\n", s.resident_bytes * mb,
+		s.peak_resident_bytes * mb, shard_budget_ * kNoShards * mb );
+}
@@ -0,0 +1,145 @@
+#ifndef TEXTURE_CACHE_H_
+#define TEXTURE_CACHE_H_
+
+#include <memory>
+#include <mutex>
+#include <list>
+#include <unordered_map>
+#include "texture.h"
+
+/* decodes the whole image when a registered texture is opened, nullptr if it cannot be loaded */
+using TextureLoader = std::function<Texture3u *( const std::string & file_name )>;
+
+/*! \struct TextureCacheStatistics
+\brief Counters of a TextureCache since its construction.
+*/
+struct TextureCacheStatistics
+{
+	long long lookups{ 0 }; /*!< Tile requests of the texel lookups. */
+	long long hits{ 0 }; /*!< Requests served by resident tiles. */
+	long long evictions{ 0 }; /*!< Tiles dropped to keep the budget. */
+	long long bytes_read{ 0 }; /*!< Bytes of tiles read from the tile files. */
+	long long resident_bytes{ 0 }; /*!< Bytes of the resident tiles. */
+	long long peak_resident_bytes{ 0 }; /*!< Maximum of resident_bytes. */
+	int no_textures{ 0 }; /*!< Registered textures. */
+	int no_open_textures{ 0 }; /*!< Textures opened by a lookup so far. */
+
+	float hit_rate() const
+	{
+		return ( lookups > 0 ) ? float( hits ) / lookups : 0.0f;
+	}
+};
+
+/*! \class TextureCache
+\brief Out-of-core store of 8-bit textures keeping only the recently sampled tiles in memory.
+
+Registering a texture costs nothing, the image is decoded by the first lookup only. The decoded image and its mip
+chain are then written tile by tile (kTileSize x kTileSize texels) into an anonymous temporary file and dropped,
+so at most one decoded image per opening thread is in memory at a time. Lookups read the tiles they need from the
+file into a cache of resident tiles bounded by a byte budget, the least recently used tiles are evicted first.
+
+The resident tiles are split into shards with their own locks, so that lookups from many render threads rarely
+wait for each other, and are handed out as shared pointers, so an evicted tile stays valid for a lookup using it.
+Registration must not run concurrently with lookups.
+
+\code{.cpp}
+TextureCache cache( 256 << 20 ); // 256 MB
+const int handle = cache.Register( "wood.png" );
+Color3u value;
+if ( cache.texel( handle, u, v, lod, value ) ) { ... }
+cache.Print();
+\endcode
+*/
+class TextureCache
+{
+public:
+	/* budget of the resident tiles in bytes */
+	explicit TextureCache( const size_t budget );
+	~TextureCache();
+
+	TextureCache( const TextureCache & ) = delete;
+	TextureCache & operator=( const TextureCache & ) = delete;
+
+	/* handle of the texture, the file is loaded by the loader (Texture3u by default) once the texture is sampled,
+	a file registered again with the default loader gets the same handle */
+	int Register( const std::string & file_name, TextureLoader loader = nullptr );
+
+	/* trilinear lookup with the repeat addressing (see Texture::texel), false if the texture cannot be loaded or
+	its tiles read */
+	bool texel( const int handle, const float u, const float v, const float lod, Color3u & value ) const;
+
+	/* level of detail of the footprint (see Texture::lod), the texture is opened if it has not been yet */
+	float lod( const int handle, const float du_dx, const float dv_dx, const float du_dy, const float dv_dy ) const;
+
+	void set_budget( const size_t budget );
+
+	/* drops all resident tiles, the counters are kept */
+	void Clear();
+
+	TextureCacheStatistics statistics() const;
+
+	void Print() const;
+
+	static const int kTileSize = 32;
+	static const int kNoShards = 16;
+
+private:
+	struct Tile
+	{
+		std::vector<Color3u> texels;
+	};
+
+	/* a level of the mip chain in the tile file */
+	struct Level
+	{
+		int width;
+		int height;
+		int no_tiles_x;
+		long long offset; // of the first tile in the file
+	};
+
+	struct Entry
+	{
+		std::string file_name;
+		TextureLoader loader;
+		std::once_flag opened;
+		bool valid{ false };
+		FILE * file{ nullptr };
+		std::mutex file_mutex;
+		std::vector<Level> levels;
+	};
+
+	struct Shard
+	{
+		std::mutex mutex;
+		std::list<unsigned long long> lru; // most recently used first
+		std::unordered_map<unsigned long long, std::pair<std::shared_ptr<const Tile>, std::list<unsigned long long>::iterator>> tiles;
+		size_t bytes{ 0 };
+	};
+
+	/* decodes the image and writes the tiles of all its levels into the tile file */
+	void Open( Entry & entry ) const;
+	Entry * Opened( const int handle ) const;
+
+	/* the tile containing the texel, read from the file if it is not resident, nullptr if the read fails */
+	std::shared_ptr<const Tile> Fetch( Entry & entry, const int handle, const int level, const int tile_x,
+		const int tile_y ) const;
+	bool Bilinear( Entry & entry, const int handle, const int level, const float u, const float v, Color3u & value ) const;
+
+	static unsigned long long Key( const int handle, const int level, const int tile_x, const int tile_y );
+
+	std::vector<std::unique_ptr<Entry>> entries_;
+	std::map<std::string, int> handles_; // of the files with the default loader
+	mutable Shard shards_[kNoShards];
+	size_t shard_budget_;
+
+	mutable std::atomic<long long> lookups_{ 0 };
+	mutable std::atomic<long long> hits_{ 0 };
+	mutable std::atomic<long long> evictions_{ 0 };
+	mutable std::atomic<long long> bytes_read_{ 0 };
+	mutable std::atomic<long long> resident_bytes_{ 0 };
+	mutable std::atomic<long long> peak_resident_bytes_{ 0 };
+	mutable std::atomic<int> no_open_textures_{ 0 };
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "pch.h"
+#include "texture_library.h"
+#include "mymath.h"
+
+/* bytes of the first level */
+static size_t LevelBytes( const Texture3u & texture )
+{
+	return size_t( texture.width() ) * texture.height() * sizeof( Color3u );
+}
+
+TextureLibrary::TextureLibrary( TextureLoader loader ) : loader_( loader )
+{
+	if ( !loader_ )
+	{
+		loader_ = []( const std::string & file_name ) { return new Texture3u( file_name ); };
+	}
+}
+
+std::shared_ptr<Texture3u> TextureLibrary::Load( const std::string & file_name )
+{
+	auto file = files_.find( file_name );
+
+	if ( file != files_.end() ) return file->second;
+
+	std::shared_ptr<Texture3u> texture( loader_( file_name ) );
+
+	if ( !texture || texture->width() < 1 || texture->height() < 1 )
+	{
+		files_[file_name] = texture;
+
+		return texture;
+	}
+
+	// the first level is stored first, the resolution tells apart images with the same texels in other shapes
+	const BYTE * texels = reinterpret_cast<const BYTE *>( texture->data() );
+	const unsigned long long hash = QuickHash( texels, LevelBytes( *texture ),
+		( static_cast<unsigned long long>( texture->width() ) << 32 ) | static_cast<unsigned long long>( texture->height() ) );
+
+	auto candidates = contents_.equal_range( hash );
+
+	for ( auto candidate = candidates.first; candidate != candidates.second; ++candidate )
+	{
+		const Texture3u & original = *candidate->second;
+
+		if ( original.width() == texture->width() && original.height() == texture->height() &&
+			memcmp( original.data(), texels, LevelBytes( original ) ) == 0 )
+		{
+			++no_duplicates_;
+			bytes_saved_ += original.memory();
+
+			return files_[file_name] = candidate->second;
+		}
+	}
+
+	if ( texture->no_levels() == 1 ) texture->BuildMipmaps();
+
+	contents_.emplace( hash, texture );
+
+	return files_[file_name] = texture;
+}
+
+void TextureLibrary::Print() const
+{
+	printf( "Texture library: %d files, %d textures, %d duplicates, %0.1f MB saved\n", no_files(), no_textures(),
+		no_duplicates_, bytes_saved_ / ( 1024.0f * 1024.0f ) );
+}
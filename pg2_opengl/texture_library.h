@@ -0,0 +1,70 @@
+#ifndef TEXTURE_LIBRARY_H_
+#define TEXTURE_LIBRARY_H_
+
+#include <memory>
+#include <map>
+#include <unordered_map>
+#include "texture_cache.h"
+
+/*! \class TextureLibrary
+\brief Loads the textures of a scene so that every distinct image is in memory once.
+
+Textures are looked up by the file name first. A file loaded for the first time is hashed (QuickHash of the texels
+of the first level and of the resolution) and compared texel by texel with the textures of the same hash, so the
+same image exported under another name shares the texture loaded before and only the new file is decoded. The
+textures are handed out as shared pointers, so the materials using a texture own it together.
+
+\code{.cpp}
+TextureLibrary library;
+material->set_texture( Material::kDiffuseMapSlot, library.Load( "wood.png" ) );
+library.Print(); // duplicates and the memory saved by sharing them
+\endcode
+*/
+class TextureLibrary
+{
+public:
+	/* the files are loaded by the loader, the texture of the file by default, mip maps are built for textures
+	with the first level only */
+	explicit TextureLibrary( TextureLoader loader = nullptr );
+
+	/* the texture of the file shared with the files of the same name or content loaded before, a file which
+	could not be loaded gives a texture without texels (or nullptr from a custom loader) */
+	std::shared_ptr<Texture3u> Load( const std::string & file_name );
+
+	/* files loaded so far */
+	int no_files() const
+	{
+		return static_cast<int>( files_.size() );
+	}
+
+	/* distinct textures in memory */
+	int no_textures() const
+	{
+		return static_cast<int>( contents_.size() );
+	}
+
+	/* files whose content was loaded before under another name */
+	int no_duplicates() const
+	{
+		return no_duplicates_;
+	}
+
+	/* memory the duplicates would take as separate textures */
+	size_t bytes_saved() const
+	{
+		return bytes_saved_;
+	}
+
+	void Print() const;
+
+private:
+	TextureLoader loader_;
+
+	std::map<std::string, std::shared_ptr<Texture3u>> files_;
+	std::unordered_multimap<unsigned long long, std::shared_ptr<Texture3u>> contents_; // hash of the texels
+
+	int no_duplicates_{ 0 };
+	size_t bytes_saved_{ 0 };
+};
+
+#endif
@@ -0,0 +1,30 @@
+#include "pch.h"
+#include "texture_sampler.h"
+#include "texture_cache.h"
+
+bool TextureSampler::texel( const float u, const float v, const float lod, Color3f & value ) const
+{
+	Color3u texel_value;
+
+	if ( !texel( u, v, lod, texel_value ) ) return false;
+
+	value = Color3f( texel_value );
+
+	return true;
+}
+
+CachedTextureSampler::CachedTextureSampler( const TextureCache * texture_cache, const int handle ) :
+	texture_cache_( texture_cache ), handle_( handle )
+{
+	assert( texture_cache_ && handle_ >= 0 );
+}
+
+bool CachedTextureSampler::texel( const float u, const float v, const float lod, Color3u & value ) const
+{
+	return texture_cache_->texel( handle_, u, v, lod, value );
+}
+
+float CachedTextureSampler::lod( const float du_dx, const float dv_dx, const float du_dy, const float dv_dy ) const
+{
+	return texture_cache_->lod( handle_, du_dx, dv_dx, du_dy, dv_dy );
+}
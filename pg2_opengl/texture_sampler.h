@@ -0,0 +1,88 @@
+#ifndef TEXTURE_SAMPLER_H_
+#define TEXTURE_SAMPLER_H_
+
+#include <memory>
+#include "texture.h"
+
+class TextureCache;
+
+/*! \class TextureSampler
+\brief Source of the texels of a material slot.
+
+A slot samples a single source, a Texture3u, the tiles of a TextureCache, the blocks of a CompressedTexture or a
+colour map in linear values (LinearTexture). A new kind of texture storage implements this interface and is set to
+the slot by Material::set_texture, the material does not need to know about it.
+
+\code{.cpp}
+std::shared_ptr<const TextureSampler> sampler = std::make_shared<CachedTextureSampler>( &cache, handle );
+material->set_texture( Material::kDiffuseMapSlot, sampler );
+Color3f albedo;
+if ( sampler->texel( u, v, sampler->lod( du_dx, dv_dx, du_dy, dv_dy ), albedo ) ) { ... }
+\endcode
+*/
+class TextureSampler
+{
+public:
+	virtual ~TextureSampler() { }
+
+	/* trilinear sample in 8-bit values (see Texture::texel), lod 0 is the bilinear sample of the first level, false
+	if the texels cannot be read */
+	virtual bool texel( const float u, const float v, const float lod, Color3u & value ) const = 0;
+
+	/* the same sample in linear values, the 8-bit values are converted from sRGB (see Color3f( Color3u )) */
+	virtual bool texel( const float u, const float v, const float lod, Color3f & value ) const;
+
+	/* see Texture::lod */
+	virtual float lod( const float du_dx, const float dv_dx, const float du_dy, const float dv_dy ) const = 0;
+};
+
+/*! \class TextureSamplerOf
+\brief TextureSampler of a texture sharing its ownership, T has the texel and lod methods of Texture3u
+(Texture3u, CompressedTexture).
+*/
+template <class T>
+class TextureSamplerOf : public TextureSampler
+{
+public:
+	using TextureSampler::texel;
+
+	explicit TextureSamplerOf( std::shared_ptr<const T> texture ) : texture_( texture )
+	{
+	}
+
+	bool texel( const float u, const float v, const float lod, Color3u & value ) const override
+	{
+		value = texture_->texel( u, v, lod );
+
+		return true;
+	}
+
+	float lod( const float du_dx, const float dv_dx, const float du_dy, const float dv_dy ) const override
+	{
+		return texture_->lod( du_dx, dv_dx, du_dy, dv_dy );
+	}
+
+private:
+	std::shared_ptr<const T> texture_;
+};
+
+/*! \class CachedTextureSampler
+\brief TextureSampler of a texture registered in a TextureCache, the cache must outlive it.
+*/
+class CachedTextureSampler : public TextureSampler
+{
+public:
+	using TextureSampler::texel;
+
+	CachedTextureSampler( const TextureCache * texture_cache, const int handle );
+
+	bool texel( const float u, const float v, const float lod, Color3u & value ) const override;
+
+	float lod( const float du_dx, const float dv_dx, const float du_dy, const float dv_dy ) const override;
+
+private:
+	const TextureCache * texture_cache_;
+	int handle_;
+};
+
+#endif
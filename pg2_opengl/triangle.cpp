@@ -12,3 +12,88 @@ Vertex Triangle::vertex( const int i )
 {
 	return vertices_[i];
 }
+
+bool Triangle::Intersect( const Ray & ray, float & t, float & u, float & v ) const
+{
+	return Intersect( vertices_[0].position, vertices_[1].position, vertices_[2].position, ray, t, u, v );
+}
+
+bool Triangle::Intersect( const Vector3 & p0, const Vector3 & p1, const Vector3 & p2, const Ray & ray,
+	float & t, float & u, float & v )
+{
+	const Vector3 e1 = p1 - p0;
+	const Vector3 e2 = p2 - p0;
+	const Vector3 p = ray.direction.CrossProduct( e2 );
+	const float det = e1.DotProduct( p );
+
+	if ( fabsf( det ) < 1e-12f ) return false; // ray parallel to the triangle
+
+	const float inv_det = 1.0f / det;
+	const Vector3 s = ray.origin - p0;
+
+	u = s.DotProduct( p ) * inv_det;
+	if ( u < 0.0f || u > 1.0f ) return false;
+
+	const Vector3 q = s.CrossProduct( e1 );
+
+	v = ray.direction.DotProduct( q ) * inv_det;
+	if ( v < 0.0f || u + v > 1.0f ) return false;
+
+	t = e2.DotProduct( q ) * inv_det;
+
+	return t >= ray.t_min && t <= ray.t_max;
+}
+
+bool Triangle::IntersectWatertight( const Vector3 & p0, const Vector3 & p1, const Vector3 & p2, const Ray & ray,
+	float & t, float & u, float & v )
+{
+	// permute the axes so that z is the dominant axis of the direction, keep the winding
+	const Vector3 & d = ray.direction;
+	const int kz = ( fabsf( d.x ) > fabsf( d.y ) ) ? ( ( fabsf( d.x ) > fabsf( d.z ) ) ? 0 : 2 ) : ( ( fabsf( d.y ) > fabsf( d.z ) ) ? 1 : 2 );
+	int kx = ( kz + 1 ) % 3;
+	int ky = ( kx + 1 ) % 3;
+	if ( d.data[kz] < 0.0f ) std::swap( kx, ky );
+
+	const float sx = d.data[kx] / d.data[kz];
+	const float sy = d.data[ky] / d.data[kz];
+	const float sz = 1.0f / d.data[kz];
+
+	// shear the vertices into the space of the ray going along z
+	const Vector3 a = p0 - ray.origin;
+	const Vector3 b = p1 - ray.origin;
+	const Vector3 c = p2 - ray.origin;
+	const float ax = a.data[kx] - sx * a.data[kz], ay = a.data[ky] - sy * a.data[kz];
+	const float bx = b.data[kx] - sx * b.data[kz], by = b.data[ky] - sy * b.data[kz];
+	const float cx = c.data[kx] - sx * c.data[kz], cy = c.data[ky] - sy * c.data[kz];
+
+	float eu = cx * by - cy * bx;
+	float ev = ax * cy - ay * cx;
+	float ew = bx * ay - by * ax;
+
+	// the sign is certain only beyond the rounding error of the products, otherwise exactly in doubles
+	const float tolerance = 4.0f * FLT_EPSILON;
+
+	if ( fabsf( eu ) <= tolerance * ( fabsf( cx * by ) + fabsf( cy * bx ) ) ||
+		fabsf( ev ) <= tolerance * ( fabsf( ax * cy ) + fabsf( ay * cx ) ) ||
+		fabsf( ew ) <= tolerance * ( fabsf( bx * ay ) + fabsf( by * ax ) ) )
+	{
+		eu = float( double( cx ) * by - double( cy ) * bx );
+		ev = float( double( ax ) * cy - double( ay ) * cx );
+		ew = float( double( bx ) * ay - double( by ) * ax );
+	}
+
+	if ( ( eu < 0.0f || ev < 0.0f || ew < 0.0f ) && ( eu > 0.0f || ev > 0.0f || ew > 0.0f ) ) return false;
+
+	const float det = eu + ev + ew;
+
+	if ( det == 0.0f ) return false;
+
+	const float distance = sz * ( eu * a.data[kz] + ev * b.data[kz] + ew * c.data[kz] );
+	const float inv_det = 1.0f / det;
+
+	t = distance * inv_det;
+	u = ev * inv_det;
+	v = ew * inv_det;
+
+	return t >= ray.t_min && t <= ray.t_max;
+}
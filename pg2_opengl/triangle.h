@@ -2,6 +2,7 @@
 #define TRIANGLE_H_
 
 #include "vertex.h"
+#include "ray.h"
 
 class Surface; // dopedn deklarace tdy
 
@@ -42,6 +43,26 @@ public:
 	*/
 	Vertex vertex( const int i );		
 
+	//! Prsek s paprskem.
+	/*!
+	\param ray paprsek.
+	\param t vzdlenost prseku od potku paprsku.
+	\param u barycentrick souadnice druhho vrcholu.
+	\param v barycentrick souadnice tetho vrcholu.
+
+	\return True pokud paprsek protne trojhelnk v intervalu <ray.t_min, ray.t_max>.
+	*/
+	bool Intersect( const Ray & ray, float & t, float & u, float & v ) const;
+
+	/* Mller-Trumbore test paprsku proti trojhelnku (p0, p1, p2) */
+	static bool Intersect( const Vector3 & p0, const Vector3 & p1, const Vector3 & p2, const Ray & ray,
+		float & t, float & u, float & v );
+
+	/* vodotsn test (Woop, Benthin, Wald 2013), paprsek prochzejc sdlenou hranou nebo vrcholem uzaven
+	st vdy zashne alespo jeden z trojhelnk, vznam vstup je stejn jako u Intersect */
+	static bool IntersectWatertight( const Vector3 & p0, const Vector3 & p1, const Vector3 & p2, const Ray & ray,
+		float & t, float & u, float & v );
+
 private:
 	Vertex vertices_[3]; /*!< Vrcholy trojhelnka. Nic jinho tu nesm bt, jinak padne VBO v OpenGL! */	
 };
@@ -0,0 +1,197 @@
+#include "pch.h"
+#include "triangle_block.h"
+#include "mymath.h"
+#include <immintrin.h>
+
+TriangleBlock::TriangleBlock()
+{
+	memset( p, 0, sizeof( p ) );
+}
+
+void TriangleBlock::set( const int lane, const Vector3 & p0, const Vector3 & p1, const Vector3 & p2 )
+{
+	assert( lane >= 0 && lane < kTriangleBlockWidth );
+
+	const Vector3 * vertices[3] = { &p0, &p1, &p2 };
+
+	for ( int i = 0; i < 3; ++i )
+	{
+		for ( int axis = 0; axis < 3; ++axis )
+		{
+			p[i][axis][lane] = vertices[i]->data[axis];
+		}
+	}
+}
+
+Vector3 TriangleBlock::vertex( const int lane, const int i ) const
+{
+	return Vector3( p[i][0][lane], p[i][1][lane], p[i][2][lane] );
+}
+
+WatertightRay::WatertightRay( const Ray & ray ) : origin( ray.origin )
+{
+	const Vector3 & d = ray.direction;
+
+	kz = ( fabsf( d.x ) > fabsf( d.y ) ) ? ( ( fabsf( d.x ) > fabsf( d.z ) ) ? 0 : 2 ) : ( ( fabsf( d.y ) > fabsf( d.z ) ) ? 1 : 2 );
+	kx = ( kz + 1 ) % 3;
+	ky = ( kx + 1 ) % 3;
+
+	// keep the winding of the triangles
+	if ( d.data[kz] < 0.0f ) std::swap( kx, ky );
+
+	sx = d.data[kx] / d.data[kz];
+	sy = d.data[ky] / d.data[kz];
+	sz = 1.0f / d.data[kz];
+}
+
+#if defined( __AVX2__ )
+typedef __m256 vfloat;
+static inline vfloat vset( const float a ) { return _mm256_set1_ps( a ); }
+static inline vfloat vload( const float * a ) { return _mm256_load_ps( a ); }
+static inline void vstore( float * a, const vfloat b ) { _mm256_store_ps( a, b ); }
+static inline vfloat vadd( const vfloat a, const vfloat b ) { return _mm256_add_ps( a, b ); }
+static inline vfloat vsub( const vfloat a, const vfloat b ) { return _mm256_sub_ps( a, b ); }
+static inline vfloat vmul( const vfloat a, const vfloat b ) { return _mm256_mul_ps( a, b ); }
+static inline vfloat vdiv( const vfloat a, const vfloat b ) { return _mm256_div_ps( a, b ); }
+static inline vfloat vand( const vfloat a, const vfloat b ) { return _mm256_and_ps( a, b ); }
+static inline vfloat vandnot( const vfloat a, const vfloat b ) { return _mm256_andnot_ps( a, b ); }
+static inline vfloat vor( const vfloat a, const vfloat b ) { return _mm256_or_ps( a, b ); }
+static inline vfloat vxor( const vfloat a, const vfloat b ) { return _mm256_xor_ps( a, b ); }
+static inline vfloat vlt( const vfloat a, const vfloat b ) { return _mm256_cmp_ps( a, b, _CMP_LT_OQ ); }
+static inline vfloat vle( const vfloat a, const vfloat b ) { return _mm256_cmp_ps( a, b, _CMP_LE_OQ ); }
+static inline vfloat veq( const vfloat a, const vfloat b ) { return _mm256_cmp_ps( a, b, _CMP_EQ_OQ ); }
+static inline int vmask( const vfloat a ) { return _mm256_movemask_ps( a ); }
+static inline vfloat vlanes() { return _mm256_setr_ps( 0, 1, 2, 3, 4, 5, 6, 7 ); }
+#else
+typedef __m128 vfloat;
+static inline vfloat vset( const float a ) { return _mm_set1_ps( a ); }
+static inline vfloat vload( const float * a ) { return _mm_load_ps( a ); }
+static inline void vstore( float * a, const vfloat b ) { _mm_store_ps( a, b ); }
+static inline vfloat vadd( const vfloat a, const vfloat b ) { return _mm_add_ps( a, b ); }
+static inline vfloat vsub( const vfloat a, const vfloat b ) { return _mm_sub_ps( a, b ); }
+static inline vfloat vmul( const vfloat a, const vfloat b ) { return _mm_mul_ps( a, b ); }
+static inline vfloat vdiv( const vfloat a, const vfloat b ) { return _mm_div_ps( a, b ); }
+static inline vfloat vand( const vfloat a, const vfloat b ) { return _mm_and_ps( a, b ); }
+static inline vfloat vandnot( const vfloat a, const vfloat b ) { return _mm_andnot_ps( a, b ); }
+static inline vfloat vor( const vfloat a, const vfloat b ) { return _mm_or_ps( a, b ); }
+static inline vfloat vxor( const vfloat a, const vfloat b ) { return _mm_xor_ps( a, b ); }
+static inline vfloat vlt( const vfloat a, const vfloat b ) { return _mm_cmplt_ps( a, b ); }
+static inline vfloat vle( const vfloat a, const vfloat b ) { return _mm_cmple_ps( a, b ); }
+static inline vfloat veq( const vfloat a, const vfloat b ) { return _mm_cmpeq_ps( a, b ); }
+static inline int vmask( const vfloat a ) { return _mm_movemask_ps( a ); }
+static inline vfloat vlanes() { return _mm_setr_ps( 0, 1, 2, 3 ); }
+#endif
+
+/* edge functions of a single lane from the sheared vertices, the products of floats are exact in doubles */
+static void EdgeFunctions( const float ( &x )[3][kTriangleBlockWidth], const float ( &y )[3][kTriangleBlockWidth],
+	const int lane, float & u, float & v, float & w )
+{
+	u = float( double( x[2][lane] ) * y[1][lane] - double( y[2][lane] ) * x[1][lane] );
+	v = float( double( x[0][lane] ) * y[2][lane] - double( y[0][lane] ) * x[2][lane] );
+	w = float( double( x[1][lane] ) * y[0][lane] - double( y[1][lane] ) * x[0][lane] );
+}
+
+int IntersectBlock( const TriangleBlock & block, const WatertightRay & ray, const int begin, const int end,
+	const float t_min, const float t_max, float & t, float & u, float & v )
+{
+	const vfloat lanes = vlanes();
+	const vfloat active = vand( vle( vset( float( begin ) ), lanes ), vlt( lanes, vset( float( end ) ) ) );
+
+	// vertices relative to the origin, sheared so that the ray goes along the z axis
+	const vfloat ox = vset( ray.origin.data[ray.kx] );
+	const vfloat oy = vset( ray.origin.data[ray.ky] );
+	const vfloat oz = vset( ray.origin.data[ray.kz] );
+	const vfloat sx = vset( ray.sx );
+	const vfloat sy = vset( ray.sy );
+	const vfloat sz = vset( ray.sz );
+
+	vfloat x[3], y[3], z[3];
+
+	for ( int i = 0; i < 3; ++i )
+	{
+		const vfloat pz = vsub( vload( block.p[i][ray.kz] ), oz );
+		x[i] = vsub( vsub( vload( block.p[i][ray.kx] ), ox ), vmul( sx, pz ) );
+		y[i] = vsub( vsub( vload( block.p[i][ray.ky] ), oy ), vmul( sy, pz ) );
+		z[i] = vmul( sz, pz );
+	}
+
+	vfloat eu = vsub( vmul( x[2], y[1] ), vmul( y[2], x[1] ) );
+	vfloat ev = vsub( vmul( x[0], y[2] ), vmul( y[0], x[2] ) );
+	vfloat ew = vsub( vmul( x[1], y[0] ), vmul( y[1], x[0] ) );
+
+	// the sign of an edge function is certain only beyond the rounding error of its two products (a fused
+	// multiply-add may round differently in the neighbouring triangle), the rest is redone exactly in doubles
+	const vfloat abs_mask = vset( -0.0f );
+	const vfloat tolerance = vset( 4.0f * FLT_EPSILON );
+	const vfloat mu = vmul( tolerance, vadd( vandnot( abs_mask, vmul( x[2], y[1] ) ), vandnot( abs_mask, vmul( y[2], x[1] ) ) ) );
+	const vfloat mv = vmul( tolerance, vadd( vandnot( abs_mask, vmul( x[0], y[2] ) ), vandnot( abs_mask, vmul( y[0], x[2] ) ) ) );
+	const vfloat mw = vmul( tolerance, vadd( vandnot( abs_mask, vmul( x[1], y[0] ) ), vandnot( abs_mask, vmul( y[1], x[0] ) ) ) );
+	const int uncertain = vmask( vand( active, vor( vor( vle( vandnot( abs_mask, eu ), mu ), vle( vandnot( abs_mask, ev ), mv ) ),
+		vle( vandnot( abs_mask, ew ), mw ) ) ) );
+
+	if ( uncertain )
+	{
+		alignas( 32 ) float xs[3][kTriangleBlockWidth], ys[3][kTriangleBlockWidth];
+		alignas( 32 ) float us[kTriangleBlockWidth], vs[kTriangleBlockWidth], ws[kTriangleBlockWidth];
+
+		for ( int i = 0; i < 3; ++i )
+		{
+			vstore( xs[i], x[i] );
+			vstore( ys[i], y[i] );
+		}
+
+		vstore( us, eu );
+		vstore( vs, ev );
+		vstore( ws, ew );
+
+		for ( int lane = 0; lane < kTriangleBlockWidth; ++lane )
+		{
+			if ( uncertain & ( 1 << lane ) ) EdgeFunctions( xs, ys, lane, us[lane], vs[lane], ws[lane] );
+		}
+
+		eu = vload( us );
+		ev = vload( vs );
+		ew = vload( ws );
+	}
+
+	const vfloat zero = vset( 0.0f );
+
+	// all edge functions must have the same sign (zero counts as both)
+	const vfloat negative = vor( vor( vlt( eu, zero ), vlt( ev, zero ) ), vlt( ew, zero ) );
+	const vfloat positive = vor( vor( vlt( zero, eu ), vlt( zero, ev ) ), vlt( zero, ew ) );
+	const vfloat det = vadd( vadd( eu, ev ), ew );
+	const vfloat distance = vadd( vadd( vmul( eu, z[0] ), vmul( ev, z[1] ) ), vmul( ew, z[2] ) );
+
+	// compare the distance scaled by the determinant without the division
+	const vfloat sign = vand( det, abs_mask );
+	const vfloat abs_det = vxor( det, sign );
+	const vfloat signed_distance = vxor( distance, sign );
+	const vfloat in_range = vand( vle( vmul( vset( t_min ), abs_det ), signed_distance ),
+		vle( signed_distance, vmul( vset( t_max ), abs_det ) ) );
+
+	const vfloat hit = vand( vand( active, in_range ), vandnot( vand( negative, positive ), vlt( zero, abs_det ) ) );
+	const int hits = vmask( hit );
+
+	if ( !hits ) return -1;
+
+	alignas( 32 ) float ts[kTriangleBlockWidth];
+	vstore( ts, vdiv( distance, det ) );
+
+	int closest = -1;
+
+	for ( int lane = 0; lane < kTriangleBlockWidth; ++lane )
+	{
+		if ( ( hits & ( 1 << lane ) ) && ( closest < 0 || ts[lane] < ts[closest] ) ) closest = lane;
+	}
+
+	alignas( 32 ) float us[kTriangleBlockWidth], vs[kTriangleBlockWidth], ds[kTriangleBlockWidth];
+	vstore( us, ev );
+	vstore( vs, ew );
+	vstore( ds, det );
+
+	t = min( t_max, max( t_min, ts[closest] ) ); // the division may round out of the range
+	u = us[closest] / ds[closest];
+	v = vs[closest] / ds[closest];
+
+	return closest;
+}
@@ -0,0 +1,60 @@
+#ifndef TRIANGLE_BLOCK_H_
+#define TRIANGLE_BLOCK_H_
+
+#include "ray.h"
+
+// one ray against a block of triangles in a single SIMD step
+#if defined( __AVX2__ )
+static const int kTriangleBlockWidth = 8;
+#else
+static const int kTriangleBlockWidth = 4;
+#endif
+
+/*! \struct TriangleBlock
+\brief Vertices of kTriangleBlockWidth triangles in the SoA layout, p[i][axis][lane] is the axis coordinate of
+the i-th vertex of the triangle in the lane.
+
+The vertices are kept as they are, not as a vertex and two edges, because the watertight test needs the vertices
+exactly, an edge added back to the vertex would move the shared edges of the neighbouring triangles apart. Unused
+lanes hold degenerate triangles which are never hit.
+*/
+struct alignas( 32 ) TriangleBlock
+{
+	float p[3][3][kTriangleBlockWidth];
+
+	TriangleBlock();
+
+	void set( const int lane, const Vector3 & p0, const Vector3 & p1, const Vector3 & p2 );
+
+	Vector3 vertex( const int lane, const int i ) const;
+};
+
+/*! \struct WatertightRay
+\brief Per-ray part of the watertight test (Woop, Benthin and Wald 2013), the permutation of the axes that
+makes the z axis the dominant one of the direction and the shear that aligns the ray with it.
+*/
+struct WatertightRay
+{
+	explicit WatertightRay( const Ray & ray );
+
+	Vector3 origin;
+	int kx, ky, kz;
+	float sx, sy, sz;
+};
+
+/*! \fn int IntersectBlock( const TriangleBlock & block, const WatertightRay & ray, const int begin, const int end,
+	const float t_min, const float t_max, float & t, float & u, float & v )
+\brief Closest hit among the triangles in the lanes [begin, end) of the block within <t_min, t_max>.
+
+The edge functions are evaluated in the sheared space of the ray with a fallback to exact doubles for the lanes
+where the sign of any of them is within the rounding error, so a ray through a shared edge or vertex of a closed
+mesh never passes between the triangles (even when the compiler fuses the products). Runs on kTriangleBlockWidth
+lanes with SSE or AVX2.
+
+\return The lane of the hit or -1, t is the distance and u, v are the barycentric coordinates of the second and
+the third vertex, the same as Triangle::Intersect returns.
+*/
+int IntersectBlock( const TriangleBlock & block, const WatertightRay & ray, const int begin, const int end,
+	const float t_min, const float t_max, float & t, float & u, float & v );
+
+#endif
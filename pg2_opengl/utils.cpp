@@ -1,30 +1,15 @@
 #include "pch.h"
+#include "rng.h"
+#include <sys/stat.h>
 
-using std::mt19937;
-using std::uniform_real_distribution;
-
-typedef mt19937                                     Engine;
-typedef uniform_real_distribution<float>            Distribution;
-
-auto uniform_generator = std::bind( Distribution( 0.0f, 1.0f ), Engine( 1 ) );
+static std::atomic<unsigned long long> next_stream{ 1 };
 
+/* every thread owns its generator on an independent stream, no locking is needed */
+static thread_local Pcg32 uniform_generator( 1, next_stream.fetch_add( 1 ) );
 
 float Random( const float range_min, const float range_max )
 {
-	float ksi;
-
-//#pragma omp critical ( random ) 
-	{
-		//ksi = static_cast<float>( rand() ) / ( RAND_MAX + 1 );		
-		ksi = static_cast<float>( uniform_generator() );
-
-		/*static float randoms[] = { 0.1f, 0.2f, 0.3f, 0.4f, 0.5f, 0.6f, 0.7f, 0.8f, 0.9f };
-		static int next = 0;
-		ksi = randoms[next];
-#pragma omp atomic
-		next++;
-		if ( next > 10 ) next = 0;*/
-	}
+	const float ksi = uniform_generator.NextFloat();
 
 	return ksi * ( range_max - range_min ) + range_min;
 }
@@ -47,6 +32,13 @@ long long GetFileSize64( const char * file_name )
 	return 0;	
 }
 
+long long GetFileTime64( const char * file_name )
+{
+	struct _stat64 info;
+
+	return ( _stat64( file_name, &info ) == 0 ) ? static_cast<long long>( info.st_mtime ) : 0;
+}
+
 void PrintTime( double t, char * buffer )
 {
 	// rozklad asu
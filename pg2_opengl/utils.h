@@ -63,6 +63,12 @@ float Random( const float range_min = 0.0f, const float range_max = 1.0f );
 */
 long long GetFileSize64( const char * file_name );
 
+/*! \fn long long GetFileTime64( const char * file_name )
+\brief Vrt as posledn zmny souboru v sekundch od 1. 1. 1970, 0 pokud soubor neexistuje.
+\param file_name pln cesta k souboru
+*/
+long long GetFileTime64( const char * file_name );
+
 /*! \fn void PrintTime( double t )
 \brief Vytiskne na stdout as ve formtu Dd:Mm:Ss.
 \param t as v sekundch.
@@ -0,0 +1,751 @@
+#include "pch.h"
+#include "wavefront.h"
+#include "mymath.h"
+#include "utils.h"
+
+static const float kEpsilon = 1e-4f; // offset of secondary ray origins
+
+static Color3f Gray( const float value )
+{
+	return Color3f( { value, value, value } );
+}
+
+WavefrontTracer::WavefrontTracer( const Scene & scene, const Camera & camera, const Sampler & sampler ) :
+	scene_( scene ), camera_( camera ), sampler_( sampler )
+{
+}
+
+void WavefrontTracer::set_background( const Color3f & background )
+{
+	background_ = background;
+}
+
+void WavefrontTracer::set_environment( const EnvironmentLight * environment )
+{
+	environment_ = environment;
+}
+
+void WavefrontTracer::set_lights( const Lights * lights )
+{
+	lights_ = ( lights && lights->no_lights() > 0 ) ? lights : nullptr;
+}
+
+void WavefrontTracer::set_radiance_cache( RadianceCache * cache )
+{
+	cache_ = cache;
+}
+
+void WavefrontTracer::set_photon_map( const PhotonMap * photon_map )
+{
+	photon_map_ = photon_map;
+}
+
+void WavefrontTracer::set_max_depth( const int max_depth )
+{
+	assert( max_depth > 0 );
+
+	max_depth_ = max_depth;
+}
+
+void WavefrontTracer::set_batch_size( const int batch_size )
+{
+	assert( batch_size > 0 );
+
+	batch_size_ = batch_size;
+}
+
+Texture3f WavefrontTracer::Render( const int spp )
+{
+	const int width = camera_.width();
+	const int height = camera_.height();
+	const int no_pixels = width * height;
+	const int batch_size = min( batch_size_, no_pixels );
+
+	Texture3f image( width, height );
+	Color3f * pixels = image.data();
+
+	rays_.resize( batch_size );
+	hits_.resize( batch_size );
+	throughput_.resize( batch_size );
+	radiance_.resize( batch_size );
+	alive_.resize( batch_size );
+	count_background_.resize( batch_size );
+	mis_pdf_.resize( batch_size );
+	previous_position_.resize( batch_size );
+	previous_normal_.resize( batch_size );
+	caustic_chain_.resize( batch_size );
+	shadow_rays_.resize( batch_size * kShadowRaysPerPath );
+	shadow_contributions_.resize( batch_size * kShadowRaysPerPath );
+	has_shadow_ray_.resize( batch_size * kShadowRaysPerPath );
+	no_cache_vertices_.resize( batch_size );
+	if ( cache_ ) cache_vertices_.resize( size_t( batch_size ) * max_depth_ );
+	keys_.resize( batch_size );
+	order_.resize( batch_size );
+	records_.resize( batch_size );
+
+	const auto t0 = std::chrono::high_resolution_clock::now();
+	long long no_rays = 0;
+
+	// every batch holds each of its pixels once so the accumulation needs no synchronization
+	for ( int s = 0; s < spp; ++s )
+	{
+		for ( int first_pixel = 0; first_pixel < no_pixels; first_pixel += batch_size )
+		{
+			const int no_paths = min( batch_size, no_pixels - first_pixel );
+
+			Generate( first_pixel, no_paths, s );
+
+			for ( int bounce = 0; bounce < max_depth_ && !active_.empty(); ++bounce )
+			{
+				no_rays += active_.size();
+
+				Extend();
+				Sort( bounce );
+				Shade( bounce, s );
+				Connect();
+				Compact();
+			}
+
+			if ( cache_ ) UpdateCache( no_paths );
+
+			const float weight = 1.0f / spp;
+
+#pragma omp parallel for
+			for ( int i = 0; i < no_paths; ++i )
+			{
+				pixels[first_pixel + i] += radiance_[i] * weight;
+			}
+		}
+	}
+
+	const double t = std::chrono::duration<double>( std::chrono::high_resolution_clock::now() - t0 ).count();
+	printf( "Rendered %d x %d px, %d spp in %s (%0.2f Mrays/s excluding shadow rays).\n",
+		width, height, spp, TimeToString( t ).c_str(), no_rays / t * 1e-6 );
+
+	return image;
+}
+
+void WavefrontTracer::RenderFeatures( const int spp, Texture3f & albedo, Texture3f & normal, Texture3f & depth ) const
+{
+	const int width = camera_.width();
+	const int height = camera_.height();
+
+	assert( albedo.width() == width && normal.width() == width && depth.width() == width );
+	assert( albedo.height() == height && normal.height() == height && depth.height() == height );
+
+#pragma omp parallel for schedule( dynamic, 16 )
+	for ( int pixel = 0; pixel < width * height; ++pixel )
+	{
+		Color3f albedo_sum;
+		Vector3 normal_sum;
+		float depth_sum = 0.0f;
+
+		for ( int s = 0; s < spp; ++s )
+		{
+			const Coord2f jitter = sampler_.Get2D( pixel, s, 0 );
+			Ray ray = camera_.GenerateRay( pixel % width + jitter.u, pixel / width + jitter.v );
+			RayHit hit;
+			scene_.Intersect( ray, hit );
+
+			if ( !hit.is_valid() )
+			{
+				albedo_sum += Gray( 1.0f );
+				continue;
+			}
+
+			Vector3 position, shading_normal, geometric_normal;
+			Coord2f tex_coord, duv_dx, duv_dy;
+			Vector3 d_dx, d_dy;
+			scene_.Interpolate( hit, position, shading_normal, geometric_normal, tex_coord );
+			camera_.RayDifferentials( ray.direction, d_dx, d_dy );
+			scene_.TexCoordDifferentials( hit, ray, d_dx, d_dy, duv_dx, duv_dy );
+
+			if ( geometric_normal.DotProduct( ray.direction ) > 0.0f ) shading_normal = -shading_normal;
+
+			const Material * material = scene_.material( scene_.material_id( hit ) );
+
+			// emitted radiance is not modulated by the albedo, emitters are treated like the background
+			if ( !material->emission().is_zero() || material->shader() == Shader::GLASS )
+			{
+				albedo_sum += Gray( 1.0f );
+			}
+			else if ( material->shader() == Shader::MIRROR )
+			{
+				albedo_sum += material->specular( &tex_coord, duv_dx, duv_dy );
+			}
+			else
+			{
+				albedo_sum += material->diffuse( &tex_coord, duv_dx, duv_dy );
+			}
+
+			normal_sum += shading_normal;
+			depth_sum += hit.t;
+		}
+
+		const float weight = 1.0f / spp;
+		albedo.data()[pixel] = albedo_sum * weight;
+		normal.data()[pixel] = Color3f( { normal_sum.x * weight, normal_sum.y * weight, normal_sum.z * weight } );
+		depth.data()[pixel] = Gray( depth_sum * weight );
+	}
+}
+
+void WavefrontTracer::Generate( const int first_pixel, const int no_paths, const int sample )
+{
+	first_pixel_ = first_pixel;
+	active_.resize( no_paths );
+
+	const int width = camera_.width();
+
+#pragma omp parallel for
+	for ( int i = 0; i < no_paths; ++i )
+	{
+		const int pixel = first_pixel + i;
+		const Coord2f jitter = sampler_.Get2D( pixel, sample, 0 );
+
+		rays_[i] = camera_.GenerateRay( pixel % width + jitter.u, pixel / width + jitter.v );
+		throughput_[i] = Gray( 1.0f );
+		radiance_[i] = Color3f();
+		alive_[i] = true;
+		count_background_[i] = true;
+		mis_pdf_[i] = 0.0f;
+		caustic_chain_[i] = 0;
+		no_cache_vertices_[i] = 0;
+		active_[i] = i;
+	}
+}
+
+void WavefrontTracer::Extend()
+{
+	const int n = static_cast<int>( active_.size() );
+
+#pragma omp parallel for schedule( dynamic, 256 )
+	for ( int i = 0; i < n; ++i )
+	{
+		const int path = active_[i];
+
+		hits_[path] = RayHit();
+
+		for ( int k = 0; k < kShadowRaysPerPath; ++k )
+		{
+			has_shadow_ray_[path * kShadowRaysPerPath + k] = false;
+		}
+
+		scene_.Intersect( rays_[path], hits_[path] );
+
+		if ( hits_[path].is_valid() )
+		{
+			const Material * material = scene_.material( scene_.material_id( hits_[path] ) );
+			const Color3f emission = material->emission();
+
+			// caustic paths are estimated by the photon map
+			if ( emission.is_zero() || caustic_chain_[path] == 2 ) continue;
+
+			float weight = 1.0f;
+
+			// the emitter might have been sampled by next event estimation at the previous vertex as well
+			if ( lights_ && mis_pdf_[path] > 0.0f )
+			{
+				const int light = lights_->light_id( hits_[path] );
+				const float cos_l = fabsf( lights_->light( light ).normal.DotProduct( rays_[path].direction ) );
+
+				if ( cos_l > 0.0f )
+				{
+					const float pdf_light = lights_->Pdf( previous_position_[path], previous_normal_[path], hits_[path] ) *
+						sqr( hits_[path].t ) / cos_l;
+					weight = sqr( mis_pdf_[path] ) / ( sqr( mis_pdf_[path] ) + sqr( pdf_light ) );
+				}
+			}
+
+			radiance_[path] += throughput_[path] * emission * weight;
+		}
+		else
+		{
+			if ( environment_ )
+			{
+				float weight = 1.0f;
+
+				// the direction might have been sampled from the environment map at the previous vertex as well
+				if ( mis_pdf_[path] > 0.0f )
+				{
+					const float pdf_environment = environment_->Pdf( rays_[path].direction );
+					weight = sqr( mis_pdf_[path] ) / ( sqr( mis_pdf_[path] ) + sqr( pdf_environment ) );
+				}
+
+				radiance_[path] += throughput_[path] * environment_->Le( rays_[path].direction ) * weight;
+			}
+			else if ( count_background_[path] )
+			{
+				radiance_[path] += throughput_[path] * background_;
+			}
+
+			alive_[path] = false;
+		}
+	}
+}
+
+void WavefrontTracer::Sort( const int bounce )
+{
+	const int n = static_cast<int>( active_.size() );
+	const int no_materials = scene_.no_materials();
+	const int no_buckets = 9 * no_materials; // Shader values are <1, 8>
+
+	// keys of the hits, misses go to bucket 0
+#pragma omp parallel for
+	for ( int i = 0; i < n; ++i )
+	{
+		const int path = active_[i];
+
+		if ( alive_[path] )
+		{
+			const int material_id = scene_.material_id( hits_[path] );
+			keys_[i] = int( scene_.material( material_id )->shader() ) * no_materials + material_id;
+		}
+		else
+		{
+			keys_[i] = 0;
+		}
+	}
+
+	// counting sort of the active paths by their keys
+	bucket_offsets_.assign( no_buckets + 1, 0 );
+
+	for ( int i = 0; i < n; ++i )
+	{
+		++bucket_offsets_[keys_[i] + 1];
+	}
+
+	for ( int b = 0; b < no_buckets; ++b )
+	{
+		bucket_offsets_[b + 1] += bucket_offsets_[b];
+	}
+
+	std::vector<int> next( bucket_offsets_.begin(), bucket_offsets_.end() - 1 );
+
+	for ( int i = 0; i < n; ++i )
+	{
+		order_[next[keys_[i]]++] = active_[i];
+	}
+
+	// gather the shading attributes into contiguous records
+#pragma omp parallel for
+	for ( int i = bucket_offsets_[1]; i < n; ++i )
+	{
+		const int path = order_[i];
+		const RayHit & hit = hits_[path];
+		ShadingRecord & record = records_[i];
+
+		record.path = path;
+		record.material_id = scene_.material_id( hit );
+		scene_.Interpolate( hit, record.position, record.normal, record.geometric_normal, record.tex_coord );
+		record.wo = -rays_[path].direction;
+		record.duv_dx = Coord2f{ 0.0f, 0.0f };
+		record.duv_dy = Coord2f{ 0.0f, 0.0f };
+
+		if ( bounce == 0 )
+		{
+			Vector3 d_dx, d_dy;
+			camera_.RayDifferentials( rays_[path].direction, d_dx, d_dy );
+			scene_.TexCoordDifferentials( hit, rays_[path], d_dx, d_dy, record.duv_dx, record.duv_dy );
+		}
+		record.front_face = record.geometric_normal.DotProduct( record.wo ) >= 0.0f;
+
+		if ( !record.front_face )
+		{
+			record.geometric_normal = -record.geometric_normal;
+			record.normal = -record.normal;
+		}
+	}
+}
+
+void WavefrontTracer::Shade( const int bounce, const int sample )
+{
+	const int dimension = 2 + bounce * kDimensionsPerBounce;
+	const int no_materials = scene_.no_materials();
+
+	// every non-empty bucket is a contiguous run of records with the same shader and material
+	for ( int b = no_materials; b + 1 < static_cast<int>( bucket_offsets_.size() ); ++b )
+	{
+		const int begin = bucket_offsets_[b];
+		const int n = bucket_offsets_[b + 1] - begin;
+
+		if ( n == 0 ) continue;
+
+		const ShadingRecord * records = &records_[begin];
+
+		switch ( Shader( b / no_materials ) )
+		{
+		case Shader::NORMAL: ShadeNormal( records, n ); break;
+		case Shader::PHONG: ShadePhong( records, n, dimension, sample ); break;
+		case Shader::MIRROR: ShadeMirror( records, n ); break;
+		case Shader::GLASS: ShadeGlass( records, n, dimension, sample ); break;
+		default: ShadeLambert( records, n, bounce, dimension, sample ); break;
+		}
+	}
+
+	if ( bounce < 3 ) return;
+
+	// Russian roulette
+	const int n = static_cast<int>( active_.size() );
+
+#pragma omp parallel for
+	for ( int i = 0; i < n; ++i )
+	{
+		const int path = active_[i];
+
+		if ( !alive_[path] ) continue;
+
+		const float q = min( 0.95f, throughput_[path].max_value() );
+
+		if ( sampler_.Get( first_pixel_ + path, sample, dimension + 5 ) >= q )
+		{
+			Terminate( path );
+		}
+		else
+		{
+			throughput_[path] *= 1.0f / q;
+		}
+	}
+}
+
+void WavefrontTracer::Connect()
+{
+	const int n = static_cast<int>( active_.size() );
+
+#pragma omp parallel for schedule( dynamic, 256 )
+	for ( int i = 0; i < n; ++i )
+	{
+		const int path = active_[i];
+
+		for ( int k = path * kShadowRaysPerPath; k < ( path + 1 ) * kShadowRaysPerPath; ++k )
+		{
+			if ( has_shadow_ray_[k] && !scene_.Occluded( shadow_rays_[k] ) )
+			{
+				radiance_[path] += shadow_contributions_[k];
+			}
+		}
+	}
+}
+
+void WavefrontTracer::UpdateCache( const int no_paths )
+{
+#pragma omp parallel for schedule( dynamic, 256 )
+	for ( int path = 0; path < no_paths; ++path )
+	{
+		for ( int k = 0; k < no_cache_vertices_[path]; ++k )
+		{
+			const CacheVertex & vertex = cache_vertices_[size_t( path ) * max_depth_ + k];
+			Color3f value;
+			bool valid = true;
+
+			// the radiance added after the vertex divided by the throughput and albedo of the vertex
+			for ( int i = 0; i < 3; ++i )
+			{
+				const float denominator = vertex.throughput.data[i] * vertex.albedo.data[i];
+				valid &= denominator > 0.0f;
+				value.data[i] = ( valid ) ? ( radiance_[path].data[i] - vertex.radiance.data[i] ) / denominator : 0.0f;
+			}
+
+			if ( valid ) cache_->Update( vertex.position, vertex.normal, value );
+		}
+	}
+}
+
+void WavefrontTracer::Compact()
+{
+	active_.erase( std::remove_if( active_.begin(), active_.end(), [&]( const int path ) {
+		return !alive_[path]; } ), active_.end() );
+}
+
+void WavefrontTracer::Continue( const ShadingRecord & record, const Vector3 & origin, const Vector3 & direction,
+	const Color3f & weight, const float pdf, const bool count_background )
+{
+	const int path = record.path;
+
+	rays_[path] = Ray( origin, direction );
+	throughput_[path] *= weight;
+	count_background_[path] = count_background;
+	mis_pdf_[path] = ( lights_ || environment_ ) ? pdf : 0.0f;
+	previous_position_[path] = record.position;
+	previous_normal_[path] = record.normal;
+
+	if ( throughput_[path].is_zero() ) Terminate( path );
+}
+
+void WavefrontTracer::ContinueCausticChain( const int path )
+{
+	if ( caustic_chain_[path] > 0 ) caustic_chain_[path] = 2;
+}
+
+void WavefrontTracer::Terminate( const int path )
+{
+	alive_[path] = false;
+}
+
+bool WavefrontTracer::SamplesBackground() const
+{
+	return environment_ || !background_.is_zero();
+}
+
+void WavefrontTracer::ConnectBackground( const ShadingRecord & record, const Color3f & albedo, const int dimension,
+	const int sample )
+{
+	if ( environment_ )
+	{
+		Color3f radiance;
+		float pdf_environment = 0.0f;
+		const Vector3 direction = environment_->Sample( sampler_.Get2D( first_pixel_ + record.path, sample, dimension + 3 ),
+			radiance, pdf_environment );
+		const float cos_s = direction.DotProduct( record.normal );
+
+		if ( pdf_environment <= 0.0f || cos_s <= 0.0f || direction.DotProduct( record.geometric_normal ) <= 0.0f ) return;
+
+		// power heuristic against the cosine weighted sampling of the same lobe
+		const float pdf_bsdf = cos_s / float( M_PI );
+		const float weight = sqr( pdf_environment ) / ( sqr( pdf_environment ) + sqr( pdf_bsdf ) );
+
+		const int k = record.path * kShadowRaysPerPath;
+		shadow_rays_[k] = Ray( record.position + record.geometric_normal * kEpsilon, direction );
+		shadow_contributions_[k] = throughput_[record.path] * albedo * radiance *
+			( cos_s * weight / ( float( M_PI ) * pdf_environment ) );
+		has_shadow_ray_[k] = true;
+
+		return;
+	}
+
+	if ( background_.is_zero() ) return;
+
+	const Coord2f ksi = sampler_.Get2D( first_pixel_ + record.path, sample, dimension + 3 );
+	float pdf = 0.0f;
+	const Vector3 direction = basis( record.normal ) * sample_cosine_hemisphere( ksi.u, ksi.v, pdf );
+
+	if ( direction.DotProduct( record.geometric_normal ) <= 0.0f ) return;
+
+	// ( albedo / pi ) * L * cos( theta ) / pdf = albedo * L
+	const int k = record.path * kShadowRaysPerPath;
+	shadow_rays_[k] = Ray( record.position + record.geometric_normal * kEpsilon, direction );
+	shadow_contributions_[k] = throughput_[record.path] * albedo * background_;
+	has_shadow_ray_[k] = true;
+}
+
+void WavefrontTracer::ConnectLight( const ShadingRecord & record, const Color3f & albedo, const int dimension,
+	const int sample )
+{
+	if ( !lights_ ) return;
+
+	const int pixel = first_pixel_ + record.path;
+	LightSample light;
+
+	if ( !lights_->Sample( record.position, record.normal, sampler_.Get( pixel, sample, dimension + 6 ),
+		sampler_.Get2D( pixel, sample, dimension + 7 ), light ) )
+	{
+		return;
+	}
+
+	Vector3 direction = light.position - record.position;
+	const float sqr_distance = direction.SqrL2Norm();
+	const float distance = sqrtf( sqr_distance );
+	direction /= distance;
+
+	const float cos_s = direction.DotProduct( record.normal );
+	const float cos_l = fabsf( direction.DotProduct( light.normal ) );
+
+	if ( cos_s <= 0.0f || cos_l <= 0.0f || direction.DotProduct( record.geometric_normal ) <= 0.0f ) return;
+
+	// power heuristic against the cosine weighted sampling of the same lobe
+	const float pdf_light = light.pdf * sqr_distance / cos_l;
+	const float pdf_bsdf = cos_s / float( M_PI );
+	const float weight = sqr( pdf_light ) / ( sqr( pdf_light ) + sqr( pdf_bsdf ) );
+
+	const int k = record.path * kShadowRaysPerPath + 1;
+	shadow_rays_[k] = Ray( record.position + record.geometric_normal * kEpsilon, direction, 0.0f,
+		distance * ( 1.0f - 1e-3f ) );
+	shadow_contributions_[k] = throughput_[record.path] * albedo * light.emission *
+		( cos_s * weight / ( float( M_PI ) * pdf_light ) );
+	has_shadow_ray_[k] = true;
+}
+
+void WavefrontTracer::ShadeNormal( const ShadingRecord * records, const int n )
+{
+#pragma omp parallel for
+	for ( int i = 0; i < n; ++i )
+	{
+		const ShadingRecord & record = records[i];
+		const Vector3 & normal = record.normal;
+
+		radiance_[record.path] = Color3f( { normal.x * 0.5f + 0.5f, normal.y * 0.5f + 0.5f, normal.z * 0.5f + 0.5f } );
+		Terminate( record.path );
+	}
+}
+
+void WavefrontTracer::ShadeLambert( const ShadingRecord * records, const int n, const int bounce, const int dimension,
+	const int sample )
+{
+	const Material * material = scene_.material( records[0].material_id );
+
+#pragma omp parallel for
+	for ( int i = 0; i < n; ++i )
+	{
+		const ShadingRecord & record = records[i];
+		const Color3f albedo = material->diffuse( &record.tex_coord, record.duv_dx, record.duv_dy );
+
+		if ( cache_ )
+		{
+			Color3f value;
+
+			// beyond the first bounce the rest of the path is replaced by the cached estimate
+			if ( bounce > 0 && cache_->Query( record.position, record.normal, value ) )
+			{
+				radiance_[record.path] += throughput_[record.path] * albedo * value;
+				Terminate( record.path );
+				continue;
+			}
+
+			// deep vertices have too few bounces left to give a complete estimate
+			if ( 2 * bounce < max_depth_ )
+			{
+				cache_vertices_[size_t( record.path ) * max_depth_ + no_cache_vertices_[record.path]++] =
+					CacheVertex{ record.position, record.normal, albedo, throughput_[record.path], radiance_[record.path] };
+			}
+		}
+
+		if ( photon_map_ )
+		{
+			radiance_[record.path] += throughput_[record.path] * albedo *
+				( photon_map_->Irradiance( record.position, record.normal ) * float( M_1_PI ) );
+		}
+
+		ConnectBackground( record, albedo, dimension, sample );
+		ConnectLight( record, albedo, dimension, sample );
+
+		caustic_chain_[record.path] = ( photon_map_ ) ? 1 : 0;
+
+		const Coord2f ksi = sampler_.Get2D( first_pixel_ + record.path, sample, dimension + 1 );
+		float pdf = 0.0f;
+		const Vector3 direction = basis( record.normal ) * sample_cosine_hemisphere( ksi.u, ksi.v, pdf );
+
+		if ( direction.DotProduct( record.geometric_normal ) <= 0.0f )
+		{
+			Terminate( record.path );
+			continue;
+		}
+
+		Continue( record, record.position + record.geometric_normal * kEpsilon, direction, albedo, pdf,
+			!SamplesBackground() );
+	}
+}
+
+void WavefrontTracer::ShadePhong( const ShadingRecord * records, const int n, const int dimension, const int sample )
+{
+	const Material * material = scene_.material( records[0].material_id );
+	const float exponent = max( 0.0f, material->shininess );
+
+#pragma omp parallel for
+	for ( int i = 0; i < n; ++i )
+	{
+		const ShadingRecord & record = records[i];
+		const Color3f diffuse = material->diffuse( &record.tex_coord, record.duv_dx, record.duv_dy );
+		const Color3f specular = material->specular( &record.tex_coord, record.duv_dx, record.duv_dy );
+
+		// choose the lobe proportionally to its albedo
+		const float p_d = diffuse.max_value();
+		const float p_s = specular.max_value();
+
+		if ( p_d + p_s <= 0.0f )
+		{
+			Terminate( record.path );
+			continue;
+		}
+
+		const float p_diffuse = p_d / ( p_d + p_s );
+		caustic_chain_[record.path] = 0; // glossy vertices do not gather photons
+		const int pixel = first_pixel_ + record.path;
+		const Coord2f ksi = sampler_.Get2D( pixel, sample, dimension + 1 );
+
+		if ( sampler_.Get( pixel, sample, dimension ) < p_diffuse )
+		{
+			const Color3f weight = diffuse * ( 1.0f / p_diffuse );
+
+			ConnectBackground( record, weight, dimension, sample );
+			ConnectLight( record, weight, dimension, sample );
+
+			float pdf = 0.0f;
+			const Vector3 direction = basis( record.normal ) * sample_cosine_hemisphere( ksi.u, ksi.v, pdf );
+
+			if ( direction.DotProduct( record.geometric_normal ) <= 0.0f )
+			{
+				Terminate( record.path );
+				continue;
+			}
+
+			Continue( record, record.position + record.geometric_normal * kEpsilon, direction, weight, pdf,
+				!SamplesBackground() );
+		}
+		else
+		{
+			// normalized modified Phong lobe around the mirror direction, pdf = ( n + 1 ) / ( 2 pi ) cos^n( alpha )
+			const float cos_alpha = powf( ksi.u, 1.0f / ( exponent + 1.0f ) );
+			const float sin_alpha = sqrtf( max( 0.0f, 1.0f - sqr( cos_alpha ) ) );
+			const float phi = 2.0f * float( M_PI ) * ksi.v;
+			const Vector3 r = reflect( record.wo, record.normal );
+			const Vector3 direction = basis( r ) * Vector3( sin_alpha * cosf( phi ), sin_alpha * sinf( phi ), cos_alpha );
+			const float cos_theta = direction.DotProduct( record.normal );
+
+			if ( cos_theta <= 0.0f || direction.DotProduct( record.geometric_normal ) <= 0.0f )
+			{
+				Terminate( record.path );
+				continue;
+			}
+
+			const float p_specular = 1.0f - p_diffuse;
+			Continue( record, record.position + record.geometric_normal * kEpsilon, direction,
+				specular * ( ( exponent + 2.0f ) / ( exponent + 1.0f ) * cos_theta / p_specular ), 0.0f, true );
+		}
+	}
+}
+
+void WavefrontTracer::ShadeMirror( const ShadingRecord * records, const int n )
+{
+	const Material * material = scene_.material( records[0].material_id );
+
+#pragma omp parallel for
+	for ( int i = 0; i < n; ++i )
+	{
+		const ShadingRecord & record = records[i];
+		const Vector3 direction = reflect( record.wo, record.normal );
+
+		ContinueCausticChain( record.path );
+		Continue( record, record.position + record.geometric_normal * kEpsilon, direction,
+			material->specular( &record.tex_coord, record.duv_dx, record.duv_dy ), 0.0f, true );
+	}
+}
+
+void WavefrontTracer::ShadeGlass( const ShadingRecord * records, const int n, const int dimension, const int sample )
+{
+	const Material * material = scene_.material( records[0].material_id );
+	const float ior = ( material->ior > 0.0f ) ? material->ior : IOR_GLASS;
+
+#pragma omp parallel for
+	for ( int i = 0; i < n; ++i )
+	{
+		const ShadingRecord & record = records[i];
+		const float eta = ( record.front_face ) ? IOR_AIR / ior : ior / IOR_AIR; // n1 / n2
+		const float cos_i = min( 1.0f, record.wo.DotProduct( record.normal ) );
+		float cos_t = 0.0f;
+		const float reflectance = fresnel_dielectric( cos_i, eta, cos_t );
+
+		ContinueCausticChain( record.path );
+
+		if ( sampler_.Get( first_pixel_ + record.path, sample, dimension ) < reflectance )
+		{
+			Continue( record, record.position + record.geometric_normal * kEpsilon,
+				reflect( record.wo, record.normal ), Gray( 1.0f ), 0.0f, true );
+		}
+		else
+		{
+			Vector3 direction = -record.wo * eta + record.normal * ( eta * cos_i - cos_t );
+			direction.Normalize();
+
+			Continue( record, record.position - record.geometric_normal * kEpsilon, direction, Gray( 1.0f ), 0.0f, true );
+		}
+	}
+}
@@ -0,0 +1,184 @@
+#ifndef WAVEFRONT_H_
+#define WAVEFRONT_H_
+
+#include "scene.h"
+#include "lights.h"
+#include "environment_light.h"
+#include "radiance_cache.h"
+#include "photon_map.h"
+#include "camera.h"
+#include "sampler.h"
+#include "texture.h"
+
+/*! \struct ShadingRecord
+\brief Everything a shading kernel needs to know about a single hit, stored contiguously per material.
+*/
+struct ShadingRecord
+{
+	int path; /*!< Index of the path within the batch. */
+	int material_id; /*!< Index of the material in the scene. */
+	Vector3 position; /*!< Hit point. */
+	Vector3 normal; /*!< Unit shading normal facing the incoming ray. */
+	Vector3 geometric_normal; /*!< Unit geometric normal facing the incoming ray. */
+	Vector3 wo; /*!< Unit direction towards the previous path vertex. */
+	Coord2f tex_coord; /*!< Texture coordinates of the hit point. */
+	Coord2f duv_dx; /*!< Derivative of the texture coordinates along the x axis of the image, zero beyond the primary hits. */
+	Coord2f duv_dy; /*!< Derivative of the texture coordinates along the y axis of the image, zero beyond the primary hits. */
+	bool front_face; /*!< True if the ray hit the side the geometric normal points to. */
+};
+
+/*! \class WavefrontTracer
+\brief CPU path tracer processing large batches of paths stage by stage.
+
+Every bounce runs over all active paths of the batch in separate stages:
+
+1. Extend - closest hit of all path rays, emission and background of the hit or missed rays
+2. Sort - hits are bucketed by ( Material::shader(), material id ) with a counting sort and their shading
+attributes are gathered into contiguous arrays of ShadingRecord
+3. Shade - one kernel per shader type runs over each homogeneous bucket, samples the next path segment and
+enqueues a shadow ray
+4. Connect - visibility of all shadow rays
+
+The buckets keep the shading kernels free of branches on the material type per hit. Shaders without a dedicated
+kernel (PBR, TS, CT) fall back to the Lambert kernel.
+
+If emitters are set (see set_lights), diffuse lobes also connect to a point sampled on an emissive triangle and
+the emission hit by the BSDF sampled rays is weighted by the power heuristic (MIS) at the previous vertex. The same
+holds for an importance sampled environment map (see set_environment) which replaces the constant background.
+
+With a radiance cache (see set_radiance_cache) Lambertian vertices store their reflected radiance in the cache
+when the batch finishes, and paths reaching a Lambertian vertex after the first bounce are terminated with the
+cached value if the cell is already populated.
+
+With a caustic photon map (see set_photon_map) Lambertian vertices add the radiance estimated from the photons
+and the emission reached by a diffuse bounce followed by specular ones only is discarded, as the photon map
+already holds these (L S+ D) paths.
+
+\code{.cpp}
+Scene scene( surfaces, materials );
+SobolSampler sampler;
+WavefrontTracer tracer( scene, camera, sampler );
+tracer.Render( 16 ).Save( "image.exr" );
+\endcode
+*/
+class WavefrontTracer
+{
+public:
+	WavefrontTracer( const Scene & scene, const Camera & camera, const Sampler & sampler );
+
+	/* renders the image with the given number of samples per pixel, returns linear radiance */
+	Texture3f Render( const int spp );
+
+	/* first hit albedo, shading normal (facing the camera) and distance averaged over spp primary rays, misses and
+	emitters have albedo 1, misses normal 0 and depth 0; these are the guides of the Denoiser, all textures must have the image size */
+	void RenderFeatures( const int spp, Texture3f & albedo, Texture3f & normal, Texture3f & depth ) const;
+
+	/* constant radiance of the sky */
+	void set_background( const Color3f & background );
+
+	/* HDR environment map used instead of the constant background, nullptr restores the background */
+	void set_environment( const EnvironmentLight * environment );
+
+	/* emitters used for next event estimation, nullptr disables it */
+	void set_lights( const Lights * lights );
+
+	/* cache queried and updated by Lambertian vertices, nullptr disables it */
+	void set_radiance_cache( RadianceCache * cache );
+
+	/* caustics gathered at Lambertian vertices, nullptr leaves them to path tracing */
+	void set_photon_map( const PhotonMap * photon_map );
+
+	void set_max_depth( const int max_depth );
+
+	/* maximal number of paths processed at once */
+	void set_batch_size( const int batch_size );
+
+	static const int kDimensionsPerBounce = 9;
+	static const int kShadowRaysPerPath = 2; // sky and emitter
+
+private:
+	void Generate( const int first_pixel, const int no_paths, const int sample );
+	void Extend();
+	/* primary hits (bounce 0) also get the footprints of their texture lookups */
+	void Sort( const int bounce );
+	void Shade( const int bounce, const int sample );
+	void Connect();
+	void Compact();
+	/* feeds the reflected radiance estimates of the recorded vertices of finished paths to the cache */
+	void UpdateCache( const int no_paths );
+
+	/* kernels processing contiguous runs of records sharing the material */
+	void ShadeNormal( const ShadingRecord * records, const int n );
+	void ShadeLambert( const ShadingRecord * records, const int n, const int bounce, const int dimension,
+		const int sample );
+	void ShadePhong( const ShadingRecord * records, const int n, const int dimension, const int sample );
+	void ShadeMirror( const ShadingRecord * records, const int n );
+	/* continues the caustic chain of the path through a specular bounce */
+	void ContinueCausticChain( const int path );
+	void ShadeGlass( const ShadingRecord * records, const int n, const int dimension, const int sample );
+
+	/* shadow ray towards the sky, either in a cosine weighted direction or importance sampled from the environment
+	map, the lobe is albedo / pi */
+	void ConnectBackground( const ShadingRecord & record, const Color3f & albedo, const int dimension, const int sample );
+	/* shadow ray towards a point sampled on an emitter, the lobe is albedo / pi */
+	void ConnectLight( const ShadingRecord & record, const Color3f & albedo, const int dimension, const int sample );
+	/* true if the sky is sampled by ConnectBackground and BSDF sampled rays do not count it unweighted */
+	bool SamplesBackground() const;
+	/* pdf is the solid angle density of the sampled direction for MIS, 0 for specular events */
+	void Continue( const ShadingRecord & record, const Vector3 & origin, const Vector3 & direction, const Color3f & weight,
+		const float pdf, const bool count_background );
+	void Terminate( const int path );
+
+	const Scene & scene_;
+	const Camera & camera_;
+	const Sampler & sampler_;
+	const Lights * lights_{ nullptr };
+	const EnvironmentLight * environment_{ nullptr };
+	RadianceCache * cache_{ nullptr };
+	const PhotonMap * photon_map_{ nullptr };
+
+	Color3f background_; // black by default
+	int max_depth_{ 8 };
+	int batch_size_{ 1 << 18 };
+
+	// path state (SoA), indexed by the path
+	int first_pixel_{ 0 };
+	std::vector<Ray> rays_;
+	std::vector<RayHit> hits_;
+	std::vector<Color3f> throughput_;
+	std::vector<Color3f> radiance_;
+	std::vector<char> alive_;
+	std::vector<char> count_background_; // false if the constant background has already been sampled by a shadow ray
+	std::vector<float> mis_pdf_; // pdf of the last sampled direction, 0 if the emission is not weighted
+	std::vector<Vector3> previous_position_;
+	std::vector<Vector3> previous_normal_;
+	std::vector<char> caustic_chain_; // 1 after a gathering diffuse vertex, 2 if specular bounces followed it
+
+	// shadow rays, at most kShadowRaysPerPath per path
+	std::vector<Ray> shadow_rays_;
+	std::vector<Color3f> shadow_contributions_;
+	std::vector<char> has_shadow_ray_;
+
+	std::vector<int> active_; // indices of active paths
+
+	// Lambertian vertices of the paths, max_depth_ per path, fed to the radiance cache
+	struct CacheVertex
+	{
+		Vector3 position;
+		Vector3 normal;
+		Color3f albedo;
+		Color3f throughput; // at the arrival to the vertex
+		Color3f radiance; // of the path before the vertex reflected anything
+	};
+
+	std::vector<CacheVertex> cache_vertices_;
+	std::vector<int> no_cache_vertices_;
+
+	// shading queues
+	std::vector<int> keys_;
+	std::vector<int> bucket_offsets_;
+	std::vector<int> order_;
+	std::vector<ShadingRecord> records_;
+};
+
+#endif